@@ -0,0 +1,465 @@
+/**
+ * @file batch.c
+ * @brief Implementation of the CSV, JSON Lines and binary sample writers.
+ */
+
+#include "batch.h"
+#include <errno.h>  // For EINTR
+#include <stddef.h> // For offsetof()
+#include <stdlib.h> // For malloc(), realloc(), free()
+#include <string.h> // For memcpy(), strcmp()
+#include <time.h>   // For clock_gettime()
+#include <unistd.h> // For write()
+
+#define NSEC_PER_SEC 1000000000LL
+#define BATCH_FIXED_LEN 512 // Text outside the per-CPU and memory columns
+#define BATCH_MEM_LEN 48    // Widest memory column: JSON key, value and separators
+#define BATCH_CPU_LEN 12    // Widest per-CPU column: ",cpu1023" or ",100.00"
+#define BATCH_OVERHEAD_LEN 512 // Overhead columns with their names
+#define BATCH_WINDOWS_LEN 512 // Window statistics with their names
+#define BATCH_ALERTS_LEN (BATCH_MAX_ALERTS * (RULES_LABEL_LEN + 3) + 32) // Quoted labels, separators and "+N"
+
+// Memory counters exported per sample, in column order
+static const struct {
+    const char *name;
+    size_t offset;
+} mem_columns[BATCH_MEM_FIELDS] = {
+    { "mem_total_kb", offsetof(MemInfo, mem_total) },
+    { "mem_free_kb", offsetof(MemInfo, mem_free) },
+    { "mem_available_kb", offsetof(MemInfo, mem_available) },
+    { "buffers_kb", offsetof(MemInfo, buffers) },
+    { "cached_kb", offsetof(MemInfo, cached) },
+    { "swap_total_kb", offsetof(MemInfo, swap_total) },
+    { "swap_free_kb", offsetof(MemInfo, swap_free) },
+    { "dirty_kb", offsetof(MemInfo, dirty) },
+    { "writeback_kb", offsetof(MemInfo, writeback) },
+    { "shmem_kb", offsetof(MemInfo, shmem) },
+    { "slab_kb", offsetof(MemInfo, slab) },
+};
+
+// Overhead columns, in order (BATCH_OVERHEAD_FIELDS)
+static const char *const overhead_columns[BATCH_OVERHEAD_FIELDS] = {
+    "self_cpu", "self_rss_kb", "cpu_ns", "mem_ns", "procs_ns",
+    "self_ns", "sinks_ns", "write_ns", "proc_opens", "proc_reads",
+};
+
+struct BatchWriter {
+    int fd;
+    BatchFormat format;
+    int num_cpus;
+    int flags;
+    long write_ns; // Formatting and writing the previous sample
+    const WindowStats *stats; // CPU window statistics to add, NULL for none
+    const RuleSet *rules; // Alerts to list, NULL for none
+    RuleAlert alerts[BATCH_MAX_ALERTS];
+    size_t cap; // Size of buf, enough for the largest sample
+    char *buf;
+};
+
+static unsigned long mem_column(const MemInfo *mem, int i) {
+    return *(const unsigned long *)((const char *)mem + mem_columns[i].offset);
+}
+
+// Percentage as an integer number of hundredths, clamped to 0..10000
+static unsigned int to_centi(double percent) {
+    if (!(percent > 0.0))
+        return 0;
+    if (percent >= 100.0)
+        return 10000;
+    return (unsigned int)(percent * 100.0 + 0.5);
+}
+
+/* ------------------ Text formatting ------------------ */
+
+static char *put_str(char *p, const char *s) {
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static char *put_u64(char *p, unsigned long long v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0)
+        *p++ = tmp[--n];
+    return p;
+}
+
+static char *put_i64(char *p, long long v) {
+    if (v < 0) {
+        *p++ = '-';
+        return put_u64(p, 0ULL - (unsigned long long)v);
+    }
+    return put_u64(p, (unsigned long long)v);
+}
+
+// Hundredths as "12.34"
+static char *put_centi(char *p, unsigned int centi) {
+    p = put_u64(p, centi / 100);
+    *p++ = '.';
+    *p++ = (char)('0' + centi / 10 % 10);
+    *p++ = (char)('0' + centi % 10);
+    return p;
+}
+
+static long long wallclock_ns(const Sample *s) {
+    return (long long)s->wallclock.tv_sec * NSEC_PER_SEC + s->wallclock.tv_nsec;
+}
+
+// Integer overhead column i (1 .. BATCH_OVERHEAD_FIELDS - 1; 0 is the CPU percentage)
+static unsigned long overhead_column(const BatchWriter *w, const Sample *s, int i) {
+    switch (i) {
+    case 1: return s->self.rss_kb;
+    case 2: return (unsigned long)s->cost.cpu_ns;
+    case 3: return (unsigned long)s->cost.mem_ns;
+    case 4: return (unsigned long)s->cost.procs_ns;
+    case 5: return (unsigned long)s->cost.self_ns;
+    case 6: return (unsigned long)s->cost.sinks_ns;
+    case 7: return (unsigned long)w->write_ns;
+    case 8: return s->self.io_delta.opens;
+    default: return s->self.io_delta.reads;
+    }
+}
+
+/*
+ * Labels of the firing alerts, each between quote (empty for CSV) and
+ * separated by sep, then "+N" for those beyond BATCH_MAX_ALERTS.
+ */
+static char *put_alerts(char *p, BatchWriter *w, const char *quote, char sep) {
+    int n = list_firing_alerts(w->rules, w->alerts, BATCH_MAX_ALERTS);
+    for (int i = 0; i < n; i++) {
+        if (i > 0)
+            *p++ = sep;
+        p = put_str(p, quote);
+        p += format_alert_label(w->rules, w->alerts[i].rule, w->alerts[i].instance, p, RULES_LABEL_LEN);
+        p = put_str(p, quote);
+    }
+    int more = rules_firing(w->rules) - n;
+    if (more > 0) {
+        *p++ = sep;
+        p = put_str(p, quote);
+        *p++ = '+';
+        p = put_u64(p, (unsigned long long)more);
+        p = put_str(p, quote);
+    }
+    return p;
+}
+
+// Summaries of the CPU usage over every window
+static void get_cpu_windows(const BatchWriter *w, WindowSummary windows[WINSTATS_WINDOWS]) {
+    for (int i = 0; i < WINSTATS_WINDOWS; i++)
+        get_window_summary(w->stats, WINSTATS_CPU, i, &windows[i]);
+}
+
+static size_t format_csv(BatchWriter *w, const Sample *s) {
+    char *p = w->buf;
+    p = put_u64(p, s->seq);
+    *p++ = ',';
+    p = put_i64(p, wallclock_ns(s));
+    *p++ = ',';
+    p = put_i64(p, (long long)(s->interval * 1e6));
+    *p++ = ',';
+    p = put_i64(p, s->jitter_ns);
+    *p++ = ',';
+    p = put_u64(p, s->dropped);
+    *p++ = ',';
+    p = put_centi(p, to_centi(s->cpu.usage));
+    for (int i = 0; i < BATCH_MEM_FIELDS; i++) {
+        *p++ = ',';
+        p = put_u64(p, mem_column(&s->mem, i));
+    }
+    for (int i = 0; i < w->num_cpus; i++) {
+        *p++ = ',';
+        p = put_centi(p, to_centi(s->cpu.thread_usage[i]));
+    }
+    if (w->flags & BATCH_OVERHEAD) {
+        *p++ = ',';
+        p = put_centi(p, to_centi(s->self.cpu_usage));
+        for (int i = 1; i < BATCH_OVERHEAD_FIELDS; i++) {
+            *p++ = ',';
+            p = put_u64(p, overhead_column(w, s, i));
+        }
+    }
+    if (w->stats != NULL) {
+        WindowSummary windows[WINSTATS_WINDOWS];
+        get_cpu_windows(w, windows);
+        for (int i = 0; i < BATCH_WINDOW_FIELDS; i++) {
+            *p++ = ',';
+            p = put_centi(p, to_centi(window_figure(&windows[i / WINSTATS_FIGURES], i % WINSTATS_FIGURES)));
+        }
+    }
+    if (w->rules != NULL) {
+        *p++ = ',';
+        p = put_alerts(p, w, "", ';');
+    }
+    *p++ = '\n';
+    return (size_t)(p - w->buf);
+}
+
+static size_t format_jsonl(BatchWriter *w, const Sample *s) {
+    char *p = w->buf;
+    p = put_str(p, "{\"seq\":");
+    p = put_u64(p, s->seq);
+    p = put_str(p, ",\"time_ns\":");
+    p = put_i64(p, wallclock_ns(s));
+    p = put_str(p, ",\"interval_us\":");
+    p = put_i64(p, (long long)(s->interval * 1e6));
+    p = put_str(p, ",\"jitter_ns\":");
+    p = put_i64(p, s->jitter_ns);
+    p = put_str(p, ",\"dropped\":");
+    p = put_u64(p, s->dropped);
+    p = put_str(p, ",\"cpu\":");
+    p = put_centi(p, to_centi(s->cpu.usage));
+    p = put_str(p, ",\"mem\":{");
+    for (int i = 0; i < BATCH_MEM_FIELDS; i++) {
+        if (i > 0)
+            *p++ = ',';
+        *p++ = '"';
+        p = put_str(p, mem_columns[i].name);
+        p = put_str(p, "\":");
+        p = put_u64(p, mem_column(&s->mem, i));
+    }
+    p = put_str(p, "},\"threads\":[");
+    for (int i = 0; i < w->num_cpus; i++) {
+        if (i > 0)
+            *p++ = ',';
+        p = put_centi(p, to_centi(s->cpu.thread_usage[i]));
+    }
+    *p++ = ']';
+    if (w->flags & BATCH_OVERHEAD) {
+        p = put_str(p, ",\"overhead\":{\"self_cpu\":");
+        p = put_centi(p, to_centi(s->self.cpu_usage));
+        for (int i = 1; i < BATCH_OVERHEAD_FIELDS; i++) {
+            p = put_str(p, ",\"");
+            p = put_str(p, overhead_columns[i]);
+            p = put_str(p, "\":");
+            p = put_u64(p, overhead_column(w, s, i));
+        }
+        *p++ = '}';
+    }
+    if (w->stats != NULL) {
+        WindowSummary windows[WINSTATS_WINDOWS];
+        get_cpu_windows(w, windows);
+        p = put_str(p, ",\"windows\":{");
+        for (int i = 0; i < WINSTATS_WINDOWS; i++) {
+            p = put_str(p, i > 0 ? ",\"" : "\"");
+            p = put_str(p, window_name(i));
+            p = put_str(p, "\":{");
+            for (int f = 0; f < WINSTATS_FIGURES; f++) {
+                p = put_str(p, f > 0 ? ",\"" : "\"");
+                p = put_str(p, window_figure_name(f));
+                p = put_str(p, "\":");
+                p = put_centi(p, to_centi(window_figure(&windows[i], f)));
+            }
+            *p++ = '}';
+        }
+        *p++ = '}';
+    }
+    if (w->rules != NULL) {
+        p = put_str(p, ",\"alerts\":[");
+        p = put_alerts(p, w, "\"", ',');
+        *p++ = ']';
+    }
+    p = put_str(p, "}\n");
+    return (size_t)(p - w->buf);
+}
+
+/* ------------------ Binary records ------------------ */
+
+#define PUT_FIXED(p, type, value) \
+    do { type v_ = (type)(value); memcpy((p), &v_, sizeof(v_)); (p) += sizeof(v_); } while (0)
+
+size_t batch_record_size(int num_cpus) {
+    return 8 + 8 + 4 + 4 + 4 + 2 + 2 + 8 * BATCH_MEM_FIELDS + 2 * (size_t)num_cpus;
+}
+
+static size_t format_binary(BatchWriter *w, const Sample *s) {
+    char *p = w->buf;
+    long jitter_us = s->jitter_ns / 1000;
+    PUT_FIXED(p, uint64_t, s->seq);
+    PUT_FIXED(p, int64_t, wallclock_ns(s));
+    PUT_FIXED(p, uint32_t, s->interval * 1e6);
+    PUT_FIXED(p, uint32_t, jitter_us > 0 ? jitter_us : 0);
+    PUT_FIXED(p, uint32_t, s->dropped);
+    PUT_FIXED(p, uint16_t, to_centi(s->cpu.usage));
+    PUT_FIXED(p, uint16_t, 0);
+    for (int i = 0; i < BATCH_MEM_FIELDS; i++)
+        PUT_FIXED(p, uint64_t, mem_column(&s->mem, i));
+    for (int i = 0; i < w->num_cpus; i++)
+        PUT_FIXED(p, uint16_t, to_centi(s->cpu.thread_usage[i]));
+    if (w->flags & BATCH_OVERHEAD) {
+        PUT_FIXED(p, uint32_t, to_centi(s->self.cpu_usage));
+        for (int i = 1; i < BATCH_OVERHEAD_FIELDS; i++)
+            PUT_FIXED(p, uint32_t, overhead_column(w, s, i));
+    }
+    if (w->stats != NULL) {
+        WindowSummary windows[WINSTATS_WINDOWS];
+        get_cpu_windows(w, windows);
+        for (int i = 0; i < BATCH_WINDOW_FIELDS; i++)
+            PUT_FIXED(p, uint16_t, to_centi(window_figure(&windows[i / WINSTATS_FIGURES], i % WINSTATS_FIGURES)));
+        PUT_FIXED(p, uint16_t, 0);
+    }
+    if (w->rules != NULL)
+        PUT_FIXED(p, uint32_t, rules_firing(w->rules));
+    return (size_t)(p - w->buf);
+}
+
+/* ------------------ Writer ------------------ */
+
+int parse_batch_format(const char *name, BatchFormat *format) {
+    if (strcmp(name, "csv") == 0)
+        *format = BATCH_CSV;
+    else if (strcmp(name, "jsonl") == 0 || strcmp(name, "json") == 0)
+        *format = BATCH_JSONL;
+    else if (strcmp(name, "bin") == 0 || strcmp(name, "binary") == 0)
+        *format = BATCH_BINARY;
+    else
+        return -1;
+    return 0;
+}
+
+BatchWriter *create_batch_writer(int fd, BatchFormat format, int num_cpus, int flags) {
+    BatchWriter *w = calloc(1, sizeof(*w));
+    if (w == NULL)
+        return NULL;
+    w->fd = fd;
+    w->format = format;
+    w->num_cpus = num_cpus;
+    w->flags = flags;
+    // Also large enough for the CSV header line
+    w->cap = BATCH_FIXED_LEN + BATCH_MEM_FIELDS * BATCH_MEM_LEN + (size_t)num_cpus * BATCH_CPU_LEN +
+             ((flags & BATCH_OVERHEAD) ? BATCH_OVERHEAD_LEN : 0);
+    w->buf = malloc(w->cap);
+    if (w->buf == NULL) {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+int set_batch_rules(BatchWriter *w, const RuleSet *rules) {
+    if (w->rules == NULL && rules != NULL) {
+        char *buf = realloc(w->buf, w->cap + BATCH_ALERTS_LEN);
+        if (buf == NULL)
+            return -1;
+        w->buf = buf;
+        w->cap += BATCH_ALERTS_LEN;
+    }
+    w->rules = rules;
+    return 0;
+}
+
+int set_batch_stats(BatchWriter *w, const WindowStats *stats) {
+    if (w->stats == NULL && stats != NULL) {
+        char *buf = realloc(w->buf, w->cap + BATCH_WINDOWS_LEN);
+        if (buf == NULL)
+            return -1;
+        w->buf = buf;
+        w->cap += BATCH_WINDOWS_LEN;
+    }
+    w->stats = stats;
+    return 0;
+}
+
+// Write len bytes; one write() unless the kernel takes less (pipes, signals)
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int write_batch_header(BatchWriter *w) {
+    char *p = w->buf;
+    switch (w->format) {
+    case BATCH_CSV:
+        p = put_str(p, "seq,time_ns,interval_us,jitter_ns,dropped,cpu");
+        for (int i = 0; i < BATCH_MEM_FIELDS; i++) {
+            *p++ = ',';
+            p = put_str(p, mem_columns[i].name);
+        }
+        for (int i = 0; i < w->num_cpus; i++) {
+            p = put_str(p, ",cpu");
+            p = put_u64(p, (unsigned long long)i);
+        }
+        for (int i = 0; (w->flags & BATCH_OVERHEAD) && i < BATCH_OVERHEAD_FIELDS; i++) {
+            *p++ = ',';
+            p = put_str(p, overhead_columns[i]);
+        }
+        for (int i = 0; w->stats != NULL && i < BATCH_WINDOW_FIELDS; i++) {
+            p = put_str(p, ",cpu_");
+            p = put_str(p, window_name(i / WINSTATS_FIGURES));
+            *p++ = '_';
+            p = put_str(p, window_figure_name(i % WINSTATS_FIGURES));
+        }
+        if (w->rules != NULL)
+            p = put_str(p, ",alerts");
+        *p++ = '\n';
+        break;
+    case BATCH_BINARY: {
+        BatchBinHeader header = {
+            .magic = { BATCH_BIN_MAGIC[0], BATCH_BIN_MAGIC[1], BATCH_BIN_MAGIC[2], BATCH_BIN_MAGIC[3] },
+            .version = BATCH_BIN_VERSION,
+            .num_cpus = (uint16_t)w->num_cpus,
+            .record_size = (uint32_t)(batch_record_size(w->num_cpus) +
+                                      ((w->flags & BATCH_OVERHEAD) ? 4 * BATCH_OVERHEAD_FIELDS : 0) +
+                                      (w->stats != NULL ? 2 * BATCH_WINDOW_FIELDS + 2 : 0) +
+                                      (w->rules != NULL ? 4 : 0)),
+            .mem_fields = BATCH_MEM_FIELDS,
+        };
+        memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        break;
+    }
+    case BATCH_JSONL:
+        break; // Self-describing
+    }
+    return write_all(w->fd, w->buf, (size_t)(p - w->buf));
+}
+
+size_t format_batch_sample(BatchWriter *w, const Sample *s, const char **data) {
+    size_t len = 0;
+    switch (w->format) {
+    case BATCH_CSV:
+        len = format_csv(w, s);
+        break;
+    case BATCH_JSONL:
+        len = format_jsonl(w, s);
+        break;
+    case BATCH_BINARY:
+        len = format_binary(w, s);
+        break;
+    }
+    *data = w->buf;
+    return len;
+}
+
+// Timed for the next record's write_ns column
+int write_batch_sample(BatchWriter *w, const Sample *s) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const char *data;
+    size_t len = format_batch_sample(w, s, &data);
+    int rc = write_all(w->fd, data, len);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    w->write_ns = (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+    return rc;
+}
+
+void destroy_batch_writer(BatchWriter *w) {
+    if (w == NULL)
+        return;
+    free(w->buf);
+    free(w);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file batch.h
+ * @brief Headless export of collector samples as CSV, JSON Lines or binary.
+ *
+ * Each sample is formatted into a buffer preallocated for the number of CPUs
+ * and handed to the kernel with a single write(), so a batch run costs one
+ * system call per sample on top of the collector itself. The module has no
+ * ncurses dependency and is shared by the TUI build and the headless build.
+ *
+ * Binary layout (native byte order, all fields fixed width):
+ *  - file header: BatchBinHeader, written once by write_batch_header();
+ *  - one record per sample: u64 seq, i64 wall-clock ns, u32 interval us,
+ *    u32 jitter us, u32 dropped, u16 CPU usage in hundredths of a percent,
+ *    u16 reserved, u64 kB for each of the BATCH_MEM_FIELDS memory counters,
+ *    then u16 hundredths for every CPU slot;
+ *  - with BATCH_OVERHEAD each record ends with BATCH_OVERHEAD_FIELDS u32:
+ *    the monitor's CPU in hundredths of a percent, its RSS in kB, the ns
+ *    spent on /proc/stat, /proc/meminfo, processes, /proc/self and sinks,
+ *    the ns the writer took for the previous record, and the procfs opens
+ *    and reads of the interval. record_size in the header includes them;
+ *  - with window statistics (set_batch_stats()) follow BATCH_WINDOW_FIELDS
+ *    u16: the CPU usage's min, mean, p95, p99 and max over the last 1, 5
+ *    and 15 minutes in hundredths of a percent, then a u16 of padding;
+ *  - with rules (set_batch_rules()) each record ends with a u32: the number
+ *    of alerts firing after the sample, likewise counted in record_size.
+ *
+ * With window statistics, CSV lines carry cpu_1m_min ... cpu_15m_max columns
+ * and JSON objects a "windows" object of the same figures.
+ *
+ * With rules, CSV lines end with an "alerts" column and JSON objects with an
+ * "alerts" array, both listing the labels of the firing alerts (at most
+ * BATCH_MAX_ALERTS, then "+N" for the rest).
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "collector.h"
+#include "rules.h"
+#include "winstats.h"
+#include <stdint.h> // For the binary layout
+
+#define BATCH_BIN_MAGIC "RMB1" // First four bytes of a binary stream
+#define BATCH_BIN_VERSION 1    // Reads as 256 when the byte order differs
+#define BATCH_MEM_FIELDS 11    // Memory counters exported per sample
+#define BATCH_OVERHEAD_FIELDS 10 // Self-cost counters exported with BATCH_OVERHEAD
+#define BATCH_MAX_ALERTS 16    // Alert labels listed per sample
+#define BATCH_WINDOW_FIELDS (WINSTATS_WINDOWS * WINSTATS_FIGURES) // Windowed CPU figures per sample
+
+/* Flags of create_batch_writer() */
+#define BATCH_OVERHEAD 0x1 // Append the monitor's own cost (needs COLLECTOR_SELF samples)
+
+/**
+ * @brief Output format of a batch run.
+ */
+typedef enum {
+    BATCH_CSV,    /**< Header line, then one comma-separated line per sample. */
+    BATCH_JSONL,  /**< One JSON object per line. */
+    BATCH_BINARY, /**< BatchBinHeader, then fixed-size records. */
+} BatchFormat;
+
+/**
+ * @brief Header of a binary stream.
+ */
+typedef struct {
+    char magic[4];        /**< BATCH_BIN_MAGIC. */
+    uint16_t version;     /**< BATCH_BIN_VERSION. */
+    uint16_t num_cpus;    /**< CPU slots per record. */
+    uint32_t record_size; /**< Bytes per record. */
+    uint32_t mem_fields;  /**< BATCH_MEM_FIELDS. */
+} BatchBinHeader;
+
+/**
+ * @brief Opaque writer: output descriptor, format and preallocated buffer.
+ */
+typedef struct BatchWriter BatchWriter;
+
+/**
+ * @brief Parses "csv", "jsonl" (or "json") and "bin" (or "binary").
+ *
+ * @return int 0 on success, -1 for an unknown name.
+ */
+int parse_batch_format(const char *name, BatchFormat *format);
+
+/**
+ * @brief Creates a writer for samples with num_cpus CPU slots.
+ *
+ * @param fd Output descriptor (not closed by the writer).
+ * @param flags 0 or BATCH_OVERHEAD.
+ * @return BatchWriter* The writer, or NULL if out of memory.
+ */
+BatchWriter *create_batch_writer(int fd, BatchFormat format, int num_cpus, int flags);
+
+/**
+ * @brief Adds the alerts of rules to every sample. Call before
+ * write_batch_header() and evaluate the rules before each sample is written.
+ *
+ * @return int 0 on success, -1 if the line buffer could not grow (the writer
+ * is left without rules).
+ */
+int set_batch_rules(BatchWriter *writer, const RuleSet *rules);
+
+/**
+ * @brief Adds the CPU usage's window statistics to every sample. Call
+ * before write_batch_header() and record each sample in stats before it is
+ * written.
+ *
+ * @return int 0 on success, -1 if the line buffer could not grow (the writer
+ * is left without statistics).
+ */
+int set_batch_stats(BatchWriter *writer, const WindowStats *stats);
+
+/**
+ * @brief Writes the CSV header line or the binary file header (nothing for JSON Lines).
+ *
+ * @return int 0 on success, -1 on a write error (errno is set).
+ */
+int write_batch_header(BatchWriter *writer);
+
+/**
+ * @brief Formats one sample into the writer's buffer without writing it.
+ *
+ * @param data Set to the formatted bytes, valid until the next call.
+ * @return size_t Number of bytes formatted.
+ */
+size_t format_batch_sample(BatchWriter *writer, const Sample *sample, const char **data);
+
+/**
+ * @brief Formats one sample and writes it with a single write().
+ *
+ * @return int 0 on success, -1 on a write error (errno is set).
+ */
+int write_batch_sample(BatchWriter *writer, const Sample *sample);
+
+/**
+ * @brief Size in bytes of one binary record for num_cpus CPU slots, without
+ * the 4 * BATCH_OVERHEAD_FIELDS bytes of BATCH_OVERHEAD, the
+ * 2 * BATCH_WINDOW_FIELDS + 2 bytes of window statistics and the 4 bytes of
+ * the alert count.
+ */
+size_t batch_record_size(int num_cpus);
+
+/**
+ * @brief Frees the writer. Accepts NULL.
+ */
+void destroy_batch_writer(BatchWriter *writer);
+
+#endif // BATCH_H
@@ -0,0 +1,439 @@
+/**
+ * @file cgroupinfo_manip.c
+ * @brief Implementation of the cgroup v2 sampler and its inotify watches.
+ */
+
+#include "cgroupinfo_manip.h"
+#include "psi_manip.h"       // For parse_psi_lines(), calculate_psi_stall()
+#include <dirent.h>          // For opendir(), readdir()
+#include <stdalign.h>        // For alignas
+#include <stdio.h>           // For snprintf()
+#include <stdlib.h>          // For calloc(), free()
+#include <string.h>          // For strcmp(), strrchr()
+#include <sys/inotify.h>     // For inotify_init1(), inotify_add_watch()
+#include <time.h>            // For clock_gettime()
+#include <unistd.h>          // For access(), read(), close()
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define CGROUP_HYBRID_ROOT "/sys/fs/cgroup/unified" // v2 next to the v1 controllers
+#define EVENT_BUF_LEN 4096
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+// Files kept open per cgroup; only cpu.stat is required
+enum { FILE_CPU_STAT, FILE_MEMORY_CURRENT, FILE_MEMORY_STAT, FILE_MEMORY_EVENTS, FILE_CPU_PRESSURE, CGROUP_FILES };
+static const char *const file_names[CGROUP_FILES] = {
+    "cpu.stat", "memory.current", "memory.stat", "memory.events", "cpu.pressure",
+};
+static const size_t file_caps[CGROUP_FILES] = { 512, 64, 4096, 256, 256 };
+
+static const char *const cpu_keys[] = { "usage_usec", "user_usec", "system_usec",
+                                        "nr_periods", "nr_throttled", "throttled_usec" };
+static const char *const memory_stat_keys[] = { "anon", "file" };
+static const char *const memory_event_keys[] = { "high", "max", "oom_kill" };
+static const char *const sort_names[CGROUP_SORT_KEYS] = { "CPU", "memory", "throttled" };
+
+// One tracked cgroup; stays put while the directory exists
+typedef struct {
+    int used;
+    int parent;                 // Slot of the parent directory, -1 for the root
+    int depth;                  // 1 for a child of the root
+    int wd;                     // inotify watch on the directory, -1 at the deepest level
+    int fresh;                  // No reading yet: rates 0 at the next sample
+    ProcFile file[CGROUP_FILES]; // fd -1 for a file the cgroup lacks
+    CgroupStats last;           // Counters at the previous read
+    char path[CGROUP_PATH_LEN]; // Below the root, e.g. "system.slice/docker-1f2e.scope"
+} CgroupSlot;
+
+struct CgroupSampler {
+    char root[PROC_PATH_MAX / 2]; // The hierarchy, already under the proc root
+    int available;
+    int inotify_fd;             // -1 without inotify
+    int root_wd;
+    CgroupSlot slot[CGROUP_MAX_GROUPS];
+    struct timespec when;       // CLOCK_MONOTONIC time of the previous read
+    unsigned long changes;
+    unsigned long scans;
+    unsigned long skipped;
+    alignas(struct inotify_event) char events[EVENT_BUF_LEN];
+};
+
+int parse_cgroup_keys(const char *text, const char *const *keys, int n, unsigned long long *values) {
+    int found = 0;
+    for (const char *p = text; *p; p = next_line(p)) {
+        const char *key = p;
+        while (*p && *p != ' ' && *p != '\n')
+            p++;
+        size_t len = (size_t)(p - key);
+        for (int i = 0; i < n; i++) {
+            if (strncmp(keys[i], key, len) == 0 && keys[i][len] == '\0') {
+                values[i] = scan_ullong(&p);
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+// Increase of a counter; a cgroup's counters only go back if it was recreated
+static unsigned long long cgroup_delta(unsigned long long prev, unsigned long long curr) {
+    return curr >= prev ? curr - prev : 0;
+}
+
+void calculate_cgroup_rates(const CgroupStats *prev, const CgroupStats *curr, double seconds, CgroupEntry *e) {
+    e->cpu_pct = e->user_pct = e->system_pct = 0.0;
+    e->throttled_pct = e->throttled_ms_ps = e->pressure_pct = e->memory_events_ps = 0.0;
+    if (seconds <= 0.0)
+        return;
+    double usec = seconds * 1e6;
+    e->cpu_pct = (double)cgroup_delta(prev->usage_usec, curr->usage_usec) * 100.0 / usec;
+    e->user_pct = (double)cgroup_delta(prev->user_usec, curr->user_usec) * 100.0 / usec;
+    e->system_pct = (double)cgroup_delta(prev->system_usec, curr->system_usec) * 100.0 / usec;
+    unsigned long long periods = cgroup_delta(prev->nr_periods, curr->nr_periods);
+    if (periods > 0)
+        e->throttled_pct = (double)cgroup_delta(prev->nr_throttled, curr->nr_throttled) * 100.0 / (double)periods;
+    e->throttled_ms_ps = (double)cgroup_delta(prev->throttled_usec, curr->throttled_usec) / 1e3 / seconds;
+    e->pressure_pct = calculate_psi_stall(prev->some_usec, curr->some_usec, seconds);
+    e->memory_events_ps = (double)(cgroup_delta(prev->high_events, curr->high_events) +
+                                   cgroup_delta(prev->max_events, curr->max_events)) / seconds;
+}
+
+// Value a cgroup is ranked by
+static double sort_value(const CgroupEntry *e, CgroupSortKey key) {
+    switch (key) {
+    case CGROUP_SORT_MEMORY:
+        return (double)e->memory_bytes;
+    case CGROUP_SORT_THROTTLED:
+        return e->throttled_pct;
+    default:
+        return e->cpu_pct;
+    }
+}
+
+// Insertion sort: at most CGROUP_MAX_GROUPS entries, stable, no allocation
+void rank_cgroups(const CgroupInfo *info, CgroupSortKey key, int *order) {
+    for (int i = 0; i < info->count; i++) {
+        double v = sort_value(&info->group[i], key);
+        int j = i;
+        while (j > 0 && sort_value(&info->group[order[j - 1]], key) < v) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+}
+
+const char *cgroup_sort_name(CgroupSortKey key) {
+    return key >= 0 && key < CGROUP_SORT_KEYS ? sort_names[key] : "?";
+}
+
+static const char *leaf_name(const CgroupSlot *c) {
+    const char *slash = strrchr(c->path, '/');
+    return slash ? slash + 1 : c->path;
+}
+
+// Slot of the tracked child of parent named name, -1 if none
+static int find_child(const CgroupSampler *s, int parent, const char *name) {
+    for (int i = 0; i < CGROUP_MAX_GROUPS; i++)
+        if (s->slot[i].used && s->slot[i].parent == parent && strcmp(leaf_name(&s->slot[i]), name) == 0)
+            return i;
+    return -1;
+}
+
+// Slot watched by wd: -1 for the root, -2 for a watch no slot holds any more
+static int find_watch(const CgroupSampler *s, int wd) {
+    if (wd == s->root_wd)
+        return -1;
+    for (int i = 0; i < CGROUP_MAX_GROUPS; i++)
+        if (s->slot[i].used && s->slot[i].wd == wd)
+            return i;
+    return -2;
+}
+
+// Directory of a slot (-1 for the root), or a file in it when name is given
+static void slot_path(const CgroupSampler *s, int i, const char *name, char *buf) {
+    if (i < 0)
+        snprintf(buf, PROC_PATH_MAX, "%s/%s", s->root, name ? name : "");
+    else
+        snprintf(buf, PROC_PATH_MAX, "%s/%s/%s", s->root, s->slot[i].path, name ? name : "");
+}
+
+// Release a slot and every tracked cgroup below it
+static void release_slot(CgroupSampler *s, int i) {
+    for (int k = 0; k < CGROUP_MAX_GROUPS; k++)
+        if (s->slot[k].used && s->slot[k].parent == i)
+            release_slot(s, k);
+    CgroupSlot *c = &s->slot[i];
+    if (c->wd >= 0)
+        inotify_rm_watch(s->inotify_fd, c->wd); // EINVAL once the directory is gone
+    for (int f = 0; f < CGROUP_FILES; f++)
+        close_proc_file(&c->file[f]);
+    c->used = 0;
+    s->changes++;
+}
+
+// Track the child directory name of parent: its files and, above the
+// deepest level, a watch. -1 if it is no cgroup or nothing is free
+static int take_slot(CgroupSampler *s, int parent, const char *name) {
+    char path[PROC_PATH_MAX];
+    int free_slot = -1;
+    for (int i = 0; i < CGROUP_MAX_GROUPS && free_slot < 0; i++)
+        if (!s->slot[i].used)
+            free_slot = i;
+    CgroupSlot *c = free_slot >= 0 ? &s->slot[free_slot] : NULL;
+    char rel[CGROUP_PATH_LEN];
+    int len = parent < 0 ? snprintf(rel, sizeof(rel), "%s", name)
+                         : snprintf(rel, sizeof(rel), "%s/%s", s->slot[parent].path, name);
+    if (len >= (int)sizeof(rel))
+        return -1;
+    if (c == NULL) {
+        s->skipped++;
+        return -1;
+    }
+
+    memset(c, 0, sizeof(*c));
+    memcpy(c->path, rel, (size_t)len + 1);
+    for (int f = 0; f < CGROUP_FILES; f++) {
+        slot_path(s, free_slot, file_names[f], path);
+        if (open_proc_file(&c->file[f], path, file_caps[f]) < 0 && f == FILE_CPU_STAT)
+            return -1; // Not a cgroup (or removed already); the slot stays free
+    }
+    c->used = 1;
+    c->parent = parent;
+    c->depth = parent < 0 ? 1 : s->slot[parent].depth + 1;
+    c->fresh = 1;
+    c->wd = -1;
+    if (s->inotify_fd >= 0 && c->depth < CGROUP_MAX_DEPTH) {
+        slot_path(s, free_slot, NULL, path);
+        c->wd = inotify_add_watch(s->inotify_fd, path, WATCH_MASK);
+    }
+    s->changes++;
+    return free_slot;
+}
+
+// Take a slot for every untracked child directory of parent (-1 for the
+// root); the slots taken are appended to queue
+static void scan_children(CgroupSampler *s, int parent, int *queue, int *tail) {
+    char path[PROC_PATH_MAX];
+    slot_path(s, parent, NULL, path);
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return;
+    s->scans++;
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL) {
+        if (d->d_name[0] == '.' || (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN))
+            continue;
+        if (find_child(s, parent, d->d_name) >= 0)
+            continue;
+        int k = take_slot(s, parent, d->d_name);
+        if (k >= 0 && *tail < CGROUP_MAX_GROUPS)
+            queue[(*tail)++] = k;
+    }
+    closedir(dir);
+}
+
+/*
+ * Track the subtree below first (-1 for the whole hierarchy) breadth first,
+ * so shallow cgroups get the slots when there are too many. Each directory
+ * is watched before it is listed, so a child created meanwhile is not lost.
+ */
+static void walk_cgroups(CgroupSampler *s, int first) {
+    int queue[CGROUP_MAX_GROUPS];
+    int head = 0, tail = 0;
+    if (first < 0)
+        scan_children(s, -1, queue, &tail);
+    else
+        queue[tail++] = first;
+    while (head < tail) {
+        int i = queue[head++];
+        if (s->slot[i].used && s->slot[i].depth < CGROUP_MAX_DEPTH)
+            scan_children(s, i, queue, &tail);
+    }
+}
+
+// Take or release the slots of cgroups created or removed since the last call
+static void apply_cgroup_events(CgroupSampler *s) {
+    for (;;) {
+        ssize_t n = read(s->inotify_fd, s->events, sizeof(s->events));
+        count_proc_io(0, 1);
+        if (n <= 0)
+            return; // EAGAIN: nothing more pending
+        for (ssize_t off = 0; off < n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)(s->events + off);
+            off += (ssize_t)(sizeof(*ev) + ev->len);
+            if (ev->mask & IN_Q_OVERFLOW) {
+                walk_cgroups(s, -1); // Events were lost: look for new cgroups everywhere
+                continue;
+            }
+            if (!(ev->mask & IN_ISDIR) || ev->len == 0)
+                continue;
+            int parent = find_watch(s, ev->wd);
+            if (parent < -1)
+                continue;
+            int k = find_child(s, parent, ev->name);
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                if (k < 0 && (k = take_slot(s, parent, ev->name)) >= 0)
+                    walk_cgroups(s, k);
+            } else if (k >= 0) {
+                release_slot(s, k);
+            }
+        }
+    }
+}
+
+// Read every file of a slot; -1 if cpu.stat is gone
+static int read_cgroup_slot(CgroupSlot *c, CgroupStats *st, int *flags) {
+    memset(st, 0, sizeof(*st));
+    *flags = 0;
+    if (read_proc_file(&c->file[FILE_CPU_STAT]) < 0)
+        return -1;
+    unsigned long long cpu[6] = { 0 };
+    parse_cgroup_keys(c->file[FILE_CPU_STAT].buf, cpu_keys, 6, cpu);
+    if (strstr(c->file[FILE_CPU_STAT].buf, "nr_periods") != NULL)
+        *flags |= CGROUP_HAS_LIMIT;
+    st->usage_usec = cpu[0];
+    st->user_usec = cpu[1];
+    st->system_usec = cpu[2];
+    st->nr_periods = cpu[3];
+    st->nr_throttled = cpu[4];
+    st->throttled_usec = cpu[5];
+
+    ProcFile *mem = &c->file[FILE_MEMORY_CURRENT];
+    if (mem->fd >= 0 && read_proc_file(mem) >= 0) {
+        const char *p = mem->buf;
+        st->memory_current = scan_ullong(&p);
+        *flags |= CGROUP_HAS_MEMORY;
+        unsigned long long values[3] = { 0 };
+        if (c->file[FILE_MEMORY_STAT].fd >= 0 && read_proc_file(&c->file[FILE_MEMORY_STAT]) >= 0) {
+            parse_cgroup_keys(c->file[FILE_MEMORY_STAT].buf, memory_stat_keys, 2, values);
+            st->anon = values[0];
+            st->file = values[1];
+        }
+        if (c->file[FILE_MEMORY_EVENTS].fd >= 0 && read_proc_file(&c->file[FILE_MEMORY_EVENTS]) >= 0) {
+            values[0] = values[1] = values[2] = 0;
+            parse_cgroup_keys(c->file[FILE_MEMORY_EVENTS].buf, memory_event_keys, 3, values);
+            st->high_events = values[0];
+            st->max_events = values[1];
+            st->oom_kills = values[2];
+        }
+    }
+
+    ProcFile *psi = &c->file[FILE_CPU_PRESSURE];
+    PSILine some, full;
+    if (psi->fd >= 0 && read_proc_file(psi) >= 0 && parse_psi_lines(psi->buf, &some, &full) == 0) {
+        st->some_usec = some.total_us;
+        *flags |= CGROUP_HAS_PRESSURE;
+    }
+    return 0;
+}
+
+// Path of a slot as shown: "..." and its end when it does not fit
+static void copy_cgroup_name(char *dst, const char *path) {
+    size_t len = strlen(path);
+    if (len < CGROUP_NAME_LEN) {
+        memcpy(dst, path, len + 1);
+        return;
+    }
+    memcpy(dst, "...", 3);
+    memcpy(dst + 3, path + len - (CGROUP_NAME_LEN - 4), CGROUP_NAME_LEN - 3); // The end and the NUL
+}
+
+// Read every slot; with info, fill one entry per cgroup
+static int read_cgroup_slots(CgroupSampler *s, double seconds, CgroupInfo *info) {
+    int count = 0;
+    for (int i = 0; i < CGROUP_MAX_GROUPS; i++) {
+        CgroupSlot *c = &s->slot[i];
+        if (!c->used)
+            continue;
+        CgroupStats curr;
+        int flags;
+        if (read_cgroup_slot(c, &curr, &flags) < 0) {
+            release_slot(s, i); // Removed without an event
+            continue;
+        }
+        if (c->fresh) {
+            c->last = curr; // No previous reading: rates 0 this time
+            c->fresh = 0;
+        }
+        if (info != NULL) {
+            CgroupEntry *e = &info->group[count];
+            copy_cgroup_name(e->name, c->path);
+            e->slot = i;
+            e->depth = c->depth;
+            e->flags = flags;
+            e->memory_bytes = curr.memory_current;
+            e->anon_bytes = curr.anon;
+            e->file_bytes = curr.file;
+            e->oom_kills = curr.oom_kills;
+            calculate_cgroup_rates(&c->last, &curr, seconds, e);
+        }
+        c->last = curr;
+        count++;
+    }
+    return count;
+}
+
+CgroupSampler *create_cgroup_sampler(void) {
+    char path[PROC_PATH_MAX];
+    CgroupSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->inotify_fd = -1;
+    s->root_wd = -1;
+    clock_gettime(CLOCK_MONOTONIC, &s->when);
+
+    // cgroup.controllers only exists at the root of a v2 hierarchy
+    static const char *const roots[] = { CGROUP_ROOT, CGROUP_HYBRID_ROOT };
+    for (int r = 0; r < 2 && !s->available; r++) {
+        snprintf(s->root, sizeof(s->root), "%s", proc_path(roots[r], path));
+        slot_path(s, -1, "cgroup.controllers", path);
+        s->available = access(path, R_OK) == 0;
+    }
+    if (!s->available)
+        return s;
+
+    s->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (s->inotify_fd >= 0)
+        s->root_wd = inotify_add_watch(s->inotify_fd, s->root, WATCH_MASK);
+    walk_cgroups(s, -1);
+    read_cgroup_slots(s, 0.0, NULL);
+    return s;
+}
+
+int sample_cgroup_info(CgroupSampler *s, CgroupInfo *info) {
+    info->available = s->available;
+    info->count = 0;
+    info->skipped = s->skipped;
+    if (!s->available)
+        return 0;
+    if (s->inotify_fd >= 0)
+        apply_cgroup_events(s);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double)(now.tv_sec - s->when.tv_sec) + (double)(now.tv_nsec - s->when.tv_nsec) / 1e9;
+    s->when = now;
+    info->interval = seconds;
+    info->count = read_cgroup_slots(s, seconds, info);
+    info->skipped = s->skipped;
+    return info->count;
+}
+
+unsigned long cgroup_slot_changes(const CgroupSampler *s) {
+    return s->changes;
+}
+
+unsigned long cgroup_scans(const CgroupSampler *s) {
+    return s->scans;
+}
+
+void destroy_cgroup_sampler(CgroupSampler *s) {
+    if (s == NULL)
+        return;
+    for (int i = 0; i < CGROUP_MAX_GROUPS; i++)
+        for (int f = 0; f < CGROUP_FILES && s->slot[i].used; f++)
+            close_proc_file(&s->slot[i].file[f]);
+    if (s->inotify_fd >= 0)
+        close(s->inotify_fd); // Drops every watch
+    free(s);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file cgroupinfo_manip.h
+ * @brief Per-cgroup CPU, throttling, memory and CPU pressure from the cgroup v2 unified hierarchy.
+ *
+ * Host-wide figures hide which container burns the CPU or hits its quota.
+ * The sampler tracks every cgroup down to CGROUP_MAX_DEPTH levels below
+ * /sys/fs/cgroup (or /sys/fs/cgroup/unified on a hybrid v1/v2 system) in a
+ * fixed table of CGROUP_MAX_GROUPS slots. A slot keeps persistent
+ * descriptors on the cgroup's cpu.stat, memory.current, memory.stat,
+ * memory.events and cpu.pressure, re-read with pread() every sample; the
+ * files a cgroup lacks (controllers not enabled for it) are left closed.
+ *
+ * The tree is walked once, breadth first, at creation. After that every
+ * tracked directory above the deepest level carries an inotify watch:
+ * mkdir and rmdir of a cgroup take or release its slot at the next sample,
+ * so a stable tree costs one non-blocking read() on the inotify descriptor
+ * and never a directory scan. A cgroup whose cpu.stat can no longer be read
+ * (removed without an event) releases its slot too. Cgroups found while
+ * every slot is taken are counted in skipped and not sampled.
+ *
+ * Rates follow the delta model of calculate_cpu_usage(): two readings of
+ * monotonic counters and the CLOCK_MONOTONIC time between them.
+ */
+
+#ifndef CGROUPINFO_MANIP_H
+#define CGROUPINFO_MANIP_H
+
+#include "procfile.h" // For the persistent cgroup file readers
+
+#define CGROUP_MAX_GROUPS 64 // Slots: five descriptors each
+#define CGROUP_MAX_DEPTH 4   // Levels below the root (kubepods.slice/.../pod.slice/container.scope)
+#define CGROUP_NAME_LEN 48   // Path shown for a cgroup, shortened from the left
+#define CGROUP_PATH_LEN 256  // Longest path below the root that is tracked
+
+/* Files of a cgroup present at the last read, in CgroupEntry.flags */
+#define CGROUP_HAS_MEMORY 0x1   // memory.current, memory.stat and memory.events
+#define CGROUP_HAS_PRESSURE 0x2 // cpu.pressure
+#define CGROUP_HAS_LIMIT 0x4    // cpu.stat bandwidth fields (cpu controller enabled)
+
+/**
+ * @brief Panel ordering of the cgroups.
+ */
+typedef enum {
+    CGROUP_SORT_CPU,       /**< CPU usage. */
+    CGROUP_SORT_MEMORY,    /**< memory.current. */
+    CGROUP_SORT_THROTTLED, /**< Share of enforcement periods throttled. */
+    CGROUP_SORT_KEYS
+} CgroupSortKey;
+
+/**
+ * @brief Counters of one cgroup's files that the monitor tracks.
+ */
+typedef struct {
+    unsigned long long usage_usec;     /**< cpu.stat: CPU time of every task. */
+    unsigned long long user_usec;      /**< cpu.stat: in user mode. */
+    unsigned long long system_usec;    /**< cpu.stat: in kernel mode. */
+    unsigned long long nr_periods;     /**< cpu.stat: cpu.max enforcement periods elapsed. */
+    unsigned long long nr_throttled;   /**< cpu.stat: periods in which the group was throttled. */
+    unsigned long long throttled_usec; /**< cpu.stat: time throttled. */
+    unsigned long long memory_current; /**< memory.current in bytes. */
+    unsigned long long anon;           /**< memory.stat: anonymous memory in bytes. */
+    unsigned long long file;           /**< memory.stat: page cache in bytes. */
+    unsigned long long high_events;    /**< memory.events: reclaims forced by memory.high. */
+    unsigned long long max_events;     /**< memory.events: allocations that hit memory.max. */
+    unsigned long long oom_kills;      /**< memory.events: processes killed by the OOM killer. */
+    unsigned long long some_usec;      /**< cpu.pressure: time some task waited for a CPU. */
+} CgroupStats;
+
+/**
+ * @brief One cgroup over the last interval.
+ */
+typedef struct {
+    char name[CGROUP_NAME_LEN];        /**< Path below the root, "..." and its end if longer. */
+    int slot;                          /**< Slot held in the sampler, stable while the cgroup exists. */
+    int depth;                         /**< 1 for a child of the root. */
+    int flags;                         /**< CGROUP_HAS_* files present. */
+    double cpu_pct;                    /**< CPU time per second, in percent of one CPU. */
+    double user_pct;                   /**< Likewise in user mode. */
+    double system_pct;                 /**< Likewise in kernel mode. */
+    double throttled_pct;              /**< Enforcement periods throttled, in percent. */
+    double throttled_ms_ps;            /**< Milliseconds throttled per second. */
+    double pressure_pct;               /**< Share of the interval some task waited for a CPU. */
+    double memory_events_ps;           /**< memory.high and memory.max events per second. */
+    unsigned long long memory_bytes;   /**< memory.current. */
+    unsigned long long anon_bytes;     /**< Anonymous memory. */
+    unsigned long long file_bytes;     /**< Page cache. */
+    unsigned long long oom_kills;      /**< OOM kills since the cgroup was created. */
+} CgroupEntry;
+
+/**
+ * @brief Every tracked cgroup of one sample, in slot order.
+ */
+typedef struct {
+    int available;                     /**< 1 if a cgroup v2 hierarchy was found. */
+    int count;                         /**< Cgroups in group. */
+    unsigned long skipped;             /**< Cgroups found with every slot taken, since creation. */
+    double interval;                   /**< Seconds between the two reads behind the rates. */
+    CgroupEntry group[CGROUP_MAX_GROUPS];
+} CgroupInfo;
+
+/**
+ * @brief Opaque sampler: the hierarchy's slots, their files and the inotify watches.
+ */
+typedef struct CgroupSampler CgroupSampler;
+
+/**
+ * @brief Finds the unified hierarchy, walks it and takes the first reading,
+ * so the next sample_cgroup_info() already returns rates.
+ *
+ * A system without cgroup v2 is not an error: the sampler reports nothing
+ * available. Without inotify the tree found at creation is kept.
+ *
+ * @return CgroupSampler* The sampler, or NULL if it could not be allocated.
+ */
+CgroupSampler *create_cgroup_sampler(void);
+
+/**
+ * @brief Applies the cgroups created and removed since the previous call,
+ * re-reads every tracked cgroup and fills the rates.
+ *
+ * A cgroup that just appeared reports 0 rates until its second sample.
+ *
+ * @return int Number of cgroups in info.
+ */
+int sample_cgroup_info(CgroupSampler *sampler, CgroupInfo *info);
+
+/**
+ * @brief Parses "key value" lines (cpu.stat, memory.stat, memory.events):
+ * values[i] is set for each keys[i] found and left alone otherwise.
+ *
+ * @return int Number of keys found.
+ */
+int parse_cgroup_keys(const char *text, const char *const *keys, int n, unsigned long long *values);
+
+/**
+ * @brief Rates of one cgroup from two readings taken seconds apart.
+ *
+ * Only the rate members of entry are written. Everything is 0 if seconds is
+ * not positive; the throttled share is 0 without enforcement periods.
+ */
+void calculate_cgroup_rates(const CgroupStats *prev, const CgroupStats *curr, double seconds, CgroupEntry *entry);
+
+/**
+ * @brief Orders the cgroups of info by key, largest first (slot order on
+ * ties), into order (info->count indices).
+ */
+void rank_cgroups(const CgroupInfo *info, CgroupSortKey key, int *order);
+
+/**
+ * @brief "CPU", "memory" or "throttled".
+ */
+const char *cgroup_sort_name(CgroupSortKey key);
+
+/**
+ * @brief Slots taken or released since the sampler was created (the cgroups
+ * found by create_cgroup_sampler() included).
+ */
+unsigned long cgroup_slot_changes(const CgroupSampler *sampler);
+
+/**
+ * @brief Directories listed since the sampler was created: every tracked
+ * one above the deepest level at creation, then only those of cgroups
+ * created since (and all again after a lost inotify queue).
+ */
+unsigned long cgroup_scans(const CgroupSampler *sampler);
+
+/**
+ * @brief Closes every file and watch and frees the sampler. Accepts NULL.
+ */
+void destroy_cgroup_sampler(CgroupSampler *sampler);
+
+#endif // CGROUPINFO_MANIP_H
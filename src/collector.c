@@ -0,0 +1,464 @@
+/**
+ * @file collector.c
+ * @brief Implementation of the sampling thread and its sample ring.
+ */
+
+#include "collector.h"
+#include "ring.h"
+#include <errno.h>       // For errno
+#include <poll.h>        // For poll()
+#include <pthread.h>     // For the sampling thread
+#include <stdatomic.h>   // For the sort key
+#include <stdint.h>      // For uint64_t
+#include <stdlib.h>      // For calloc(), free()
+#include <sys/eventfd.h> // For the stop and notify descriptors
+#include <sys/timerfd.h> // For the sampling timer
+#include <unistd.h>      // For read(), write(), close()
+
+#define NSEC_PER_SEC 1000000000L
+
+struct Collector {
+    CPUSampler *cpu_sampler;  // /proc/stat
+    ProcFile meminfo_file;    // /proc/meminfo
+    ProcTable *procs;         // /proc/[pid]/stat, NULL without COLLECTOR_PROCESSES
+    SelfSampler *self;        // /proc/self, NULL without COLLECTOR_SELF
+    CPUTopology *topology;    // Current CPU layout, NULL without COLLECTOR_TOPOLOGY
+    ProcFile online_file;     // /sys/devices/system/cpu/online, checked every sample
+    ThermalSampler *thermal;  // Thermal zones and throttle counters, NULL without COLLECTOR_THERMAL
+    DiskSampler *disks;       // /proc/diskstats, NULL without COLLECTOR_DISKS
+    NetSampler *net;          // /proc/net/dev, NULL without COLLECTOR_NET
+    PSISampler *psi;          // /proc/pressure, NULL without COLLECTOR_PSI
+    CgroupSampler *cgroups;   // /sys/fs/cgroup, NULL without COLLECTOR_CGROUPS
+    IrqSampler *irqs;         // /proc/interrupts and /proc/softirqs, NULL without COLLECTOR_IRQS
+    CPUTopology *retired[COLLECTOR_RING_SLOTS + 2]; // Replaced layouts slots may still point at
+    int retired_count;
+    CPUInfo cpu;              // Static CPU information copied at creation
+    long interval_ns;         // Sampling period
+
+    SpscRing ring;            // Indices into slots
+    Sample slots[COLLECTOR_RING_SLOTS];
+    Sample scratch;           // Target of samples taken while the ring is full
+    double *usage_block;      // thread_usage storage of every slot and the scratch
+    unsigned int *freq_block; // freq_khz storage, likewise (COLLECTOR_TOPOLOGY)
+    IrqCpu *irq_block;        // irqs.cpu storage, likewise (COLLECTOR_IRQS)
+
+    pthread_t thread;
+    int running;              // 1 while the thread is joinable
+    int timer_fd;             // Periodic CLOCK_MONOTONIC timerfd
+    int stop_fd;              // eventfd written by stop_collector()
+    int notify_fd;            // eventfd written after each published sample
+    atomic_int proc_sort;     // ProcSortKey for the next sample
+
+    struct {
+        CollectorSink fn;
+        void *ctx;
+    } sinks[COLLECTOR_MAX_SINKS]; // Run after every sample on this thread
+    int sink_count;
+
+    long sinks_ns;            // Time the sinks took for the previous sample
+    unsigned long seq;        // Samples taken
+    unsigned long dropped;    // Samples lost to a full ring
+    long max_jitter_ns;       // Worst wake-up delay
+};
+
+// Add ns nanoseconds to a timespec
+static void timespec_add_ns(struct timespec *ts, long ns) {
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= NSEC_PER_SEC) {
+        ts->tv_nsec -= NSEC_PER_SEC;
+        ts->tv_sec++;
+    }
+}
+
+// Nanoseconds since the clock's epoch
+static long long timespec_to_ns(const struct timespec *ts) {
+    return (long long)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+// a - b in nanoseconds
+static long timespec_diff_ns(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) * NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+Collector *create_collector(const CPUInfo *cpu, long interval_ms, int flags) {
+    Collector *c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return NULL;
+    char path[PROC_PATH_MAX];
+
+    c->cpu = *cpu;
+    c->cpu.thread_usage = NULL; // Slots own their arrays
+    if (interval_ms < COLLECTOR_MIN_INTERVAL_MS)
+        interval_ms = COLLECTOR_MIN_INTERVAL_MS;
+    c->interval_ns = interval_ms * 1000000L;
+    c->meminfo_file.fd = -1;
+    c->online_file.fd = -1;
+    init_spsc_ring(&c->ring, COLLECTOR_RING_SLOTS);
+    atomic_init(&c->proc_sort, PROC_SORT_CPU);
+
+    // The thread sleeps in poll() on the timer and the stop event together
+    c->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    c->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    c->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    // One block for the per-thread usage of every slot plus the scratch sample
+    c->usage_block = calloc((size_t)(COLLECTOR_RING_SLOTS + 1) * cpu->num_cpus, sizeof(double));
+    c->cpu_sampler = create_cpu_sampler(cpu->num_cpus);
+    if (flags & COLLECTOR_PROCESSES)
+        c->procs = create_proc_table(0);
+    if (flags & COLLECTOR_SELF)
+        c->self = create_self_sampler();
+    if (flags & COLLECTOR_TOPOLOGY) {
+        c->topology = discover_cpu_topology(cpu->num_cpus);
+        if (c->topology != NULL)
+            open_cpu_freq(c->topology);
+        c->freq_block = calloc((size_t)(COLLECTOR_RING_SLOTS + 1) * cpu->num_cpus, sizeof(unsigned int));
+    }
+    if (flags & COLLECTOR_THERMAL)
+        c->thermal = create_thermal_sampler(cpu->num_cpus);
+    if (flags & COLLECTOR_DISKS)
+        c->disks = create_disk_sampler();
+    if (flags & COLLECTOR_NET)
+        c->net = create_net_sampler();
+    if (flags & COLLECTOR_PSI)
+        c->psi = create_psi_sampler();
+    if (flags & COLLECTOR_CGROUPS)
+        c->cgroups = create_cgroup_sampler();
+    if (flags & COLLECTOR_IRQS) {
+        c->irqs = create_irq_sampler(cpu->num_cpus);
+        c->irq_block = calloc((size_t)(COLLECTOR_RING_SLOTS + 1) * cpu->num_cpus, sizeof(IrqCpu));
+    }
+    if (c->timer_fd < 0 || c->stop_fd < 0 || c->notify_fd < 0 ||
+        c->usage_block == NULL || c->cpu_sampler == NULL ||
+        ((flags & COLLECTOR_PROCESSES) && c->procs == NULL) ||
+        ((flags & COLLECTOR_SELF) && c->self == NULL) ||
+        ((flags & COLLECTOR_TOPOLOGY) && (c->topology == NULL || c->freq_block == NULL ||
+                                          open_cpu_online(&c->online_file) < 0)) ||
+        ((flags & COLLECTOR_THERMAL) && c->thermal == NULL) ||
+        ((flags & COLLECTOR_DISKS) && c->disks == NULL) ||
+        ((flags & COLLECTOR_NET) && c->net == NULL) ||
+        ((flags & COLLECTOR_PSI) && c->psi == NULL) ||
+        ((flags & COLLECTOR_CGROUPS) && c->cgroups == NULL) ||
+        ((flags & COLLECTOR_IRQS) && (c->irqs == NULL || c->irq_block == NULL)) ||
+        open_proc_file(&c->meminfo_file, proc_path("/proc/meminfo", path), MEMINFO_BUF_LEN) < 0) {
+        int saved = errno;
+        destroy_collector(c);
+        errno = saved;
+        return NULL;
+    }
+
+    for (int i = 0; i <= COLLECTOR_RING_SLOTS; i++) {
+        Sample *s = i < COLLECTOR_RING_SLOTS ? &c->slots[i] : &c->scratch;
+        s->cpu = c->cpu;
+        s->cpu.thread_usage = c->usage_block + (size_t)i * cpu->num_cpus;
+        if (c->freq_block != NULL)
+            s->freq_khz = c->freq_block + (size_t)i * cpu->num_cpus;
+        if (c->irq_block != NULL)
+            s->irqs.cpu = c->irq_block + (size_t)i * cpu->num_cpus;
+    }
+
+    // Baseline for per-process deltas
+    if (c->procs != NULL) {
+        ProcTop unused;
+        sample_processes(c->procs, PROC_SORT_CPU, 0, &unused);
+    }
+    return c;
+}
+
+// Nanoseconds elapsed since *since, which is moved to now
+static long lap_ns(struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ns = timespec_diff_ns(&now, since);
+    *since = now;
+    return ns;
+}
+
+// Free the replaced layouts that no slot points at any more
+static void free_retired_topologies(Collector *c) {
+    int kept = 0;
+    for (int r = 0; r < c->retired_count; r++) {
+        CPUTopology *t = c->retired[r];
+        int used = (c->scratch.topology == t);
+        for (int i = 0; i < COLLECTOR_RING_SLOTS && !used; i++)
+            used = (c->slots[i].topology == t);
+        if (used)
+            c->retired[kept++] = t;
+        else
+            destroy_cpu_topology(t);
+    }
+    c->retired_count = kept;
+}
+
+// Rediscover the layout after a hotplug event; the consumer may still be
+// drawing a sample of the old one, so it is retired instead of freed
+static void refresh_topology(Collector *c) {
+    if (c->retired_count > 0)
+        free_retired_topologies(c);
+    if (topology_is_current(c->topology, &c->online_file) != 0)
+        return; // Unchanged, or unreadable: keep the last layout
+    if (c->retired_count == COLLECTOR_RING_SLOTS + 2)
+        return; // Cannot happen: at most one retired layout per slot
+    CPUTopology *next = discover_cpu_topology(c->cpu.num_cpus);
+    if (next == NULL)
+        return;
+    open_cpu_freq(next);
+    c->retired[c->retired_count++] = c->topology;
+    c->topology = next;
+}
+
+// Sample every source into s, timing each; returns -1 if a mandatory source failed
+static int take_sample(Collector *c, Sample *s) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    if (sample_cpu_usage(c->cpu_sampler, &s->cpu) < 0)
+        return -1;
+    s->cost.cpu_ns = lap_ns(&t);
+    if (read_memory_info(&c->meminfo_file, &s->mem) < 0)
+        return -1;
+    s->cost.mem_ns = lap_ns(&t);
+    s->cost.disk_ns = 0;
+    if (c->disks != NULL) {
+        if (sample_disk_info(c->disks, &s->disks) < 0)
+            s->disks.count = 0; // Not the rates this slot held a ring ago
+        s->cost.disk_ns = lap_ns(&t);
+    }
+    s->cost.net_ns = 0;
+    if (c->net != NULL) {
+        if (sample_net_info(c->net, &s->net) < 0)
+            s->net.count = 0;
+        s->cost.net_ns = lap_ns(&t);
+    }
+    s->cost.psi_ns = 0;
+    if (c->psi != NULL) {
+        sample_psi_info(c->psi, &s->psi);
+        s->cost.psi_ns = lap_ns(&t);
+    }
+    s->cost.cgroup_ns = 0;
+    if (c->cgroups != NULL) {
+        sample_cgroup_info(c->cgroups, &s->cgroups);
+        s->cost.cgroup_ns = lap_ns(&t);
+    }
+    s->cost.irq_ns = 0;
+    if (c->irqs != NULL) {
+        sample_irq_info(c->irqs, &s->irqs);
+        s->cost.irq_ns = lap_ns(&t);
+    }
+    s->cost.procs_ns = 0;
+    if (c->procs != NULL) {
+        sample_processes(c->procs, (ProcSortKey)atomic_load(&c->proc_sort), PROC_TOP_MAX, &s->procs);
+        s->cost.procs_ns = lap_ns(&t);
+    }
+    s->cost.topo_ns = 0;
+    if (c->topology != NULL) {
+        refresh_topology(c);
+        read_cpu_freq(c->topology, s->freq_khz);
+        s->topology = c->topology;
+        s->cost.topo_ns = lap_ns(&t);
+    }
+    s->cost.thermal_ns = 0;
+    if (c->thermal != NULL) {
+        sample_thermal_info(c->thermal, &s->cpu, &s->thermal);
+        s->cost.thermal_ns = lap_ns(&t);
+    }
+    s->cost.self_ns = 0;
+    if (c->self != NULL && sample_self_info(c->self, &s->self) == 0)
+        s->cost.self_ns = lap_ns(&t);
+    s->cost.sinks_ns = c->sinks_ns;
+    return 0;
+}
+
+// Sampling thread: a periodic timerfd armed on absolute deadlines, so the
+// period never drifts and overruns show up as extra expirations
+static void *collector_main(void *arg) {
+    Collector *c = arg;
+    struct timespec first_deadline, previous, now, wallclock;
+
+    clock_gettime(CLOCK_MONOTONIC, &first_deadline);
+    previous = first_deadline;
+    long first = COLLECTOR_FIRST_DELAY_MS * 1000000L;
+    timespec_add_ns(&first_deadline, first < c->interval_ns ? first : c->interval_ns);
+
+    struct itimerspec spec = {
+        .it_interval = { c->interval_ns / NSEC_PER_SEC, c->interval_ns % NSEC_PER_SEC },
+        .it_value = first_deadline,
+    };
+    if (timerfd_settime(c->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0)
+        return NULL;
+
+    // The timer, the stop event, then the PSI triggers (POLLPRI when one fires)
+    struct pollfd fds[2 + PSI_MAX_TRIGGERS] = {
+        { .fd = c->timer_fd, .events = POLLIN },
+        { .fd = c->stop_fd, .events = POLLIN },
+    };
+    int triggers = c->psi != NULL ? psi_trigger_count(c->psi) : 0;
+    for (int i = 0; i < triggers; i++) {
+        fds[2 + i].fd = psi_trigger_fd(c->psi, i);
+        fds[2 + i].events = POLLPRI;
+    }
+    long long first_ns = timespec_to_ns(&first_deadline);
+    uint64_t expirations = 0; // Timer periods elapsed since the first deadline
+
+    for (;;) {
+        if (poll(fds, (nfds_t)(2 + triggers), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            break;
+        unsigned int woken = 0;
+        for (int i = 0; i < triggers; i++) {
+            if (fds[2 + i].revents & POLLPRI)
+                woken |= 1u << psi_trigger_resource(c->psi, i);
+            else if (fds[2 + i].revents & (POLLERR | POLLNVAL))
+                fds[2 + i].fd = -1; // Trigger gone; poll() skips negative descriptors
+        }
+        uint64_t ticks = 0;
+        if (!(fds[0].revents & POLLIN) || read(c->timer_fd, &ticks, sizeof(ticks)) != sizeof(ticks))
+            ticks = 0;
+        if (ticks == 0 && woken == 0)
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        clock_gettime(CLOCK_REALTIME, &wallclock);
+
+        // Deadline of the latest expiration; periods missed while sampling
+        // overran are skipped rather than sampled late. A sample woken by a
+        // trigger alone has no deadline
+        long jitter = 0;
+        if (ticks > 0) {
+            expirations += ticks;
+            long long deadline_ns = first_ns + (long long)(expirations - 1) * c->interval_ns;
+            jitter = (long)(timespec_to_ns(&now) - deadline_ns);
+            if (jitter > c->max_jitter_ns)
+                c->max_jitter_ns = jitter;
+        }
+
+        // When the consumer is behind, sample into the scratch slot so every
+        // source's baseline still advances, then drop the result
+        long slot = ring_write_slot(&c->ring);
+        Sample *s = slot < 0 ? &c->scratch : &c->slots[slot];
+        if (take_sample(c, s) == 0) {
+            s->seq = ++c->seq;
+            s->timestamp = now;
+            s->wallclock = wallclock;
+            s->interval = timespec_diff_ns(&now, &previous) / 1e9;
+            s->jitter_ns = jitter;
+            s->max_jitter_ns = c->max_jitter_ns;
+            s->dropped = c->dropped;
+            s->psi.woken = woken;
+            struct timespec sinks_start;
+            clock_gettime(CLOCK_MONOTONIC, &sinks_start);
+            for (int i = 0; i < c->sink_count; i++)
+                c->sinks[i].fn(c->sinks[i].ctx, s, cpu_sampler_counters(c->cpu_sampler));
+            c->sinks_ns = c->sink_count > 0 ? lap_ns(&sinks_start) : 0;
+            if (slot < 0) {
+                c->dropped++;
+            } else {
+                ring_commit_write(&c->ring);
+                uint64_t one = 1;
+                ssize_t unused = write(c->notify_fd, &one, sizeof(one));
+                (void)unused; // Only fails if the counter saturates
+            }
+        }
+        previous = now;
+    }
+    return NULL;
+}
+
+int add_collector_psi_trigger(Collector *c, PSIResource res, int full, unsigned long stall_us,
+                              unsigned long window_us) {
+    if (c->psi == NULL || c->running) {
+        errno = EINVAL;
+        return -1;
+    }
+    return add_psi_trigger(c->psi, res, full, stall_us, window_us) < 0 ? -1 : 0;
+}
+
+int add_collector_sink(Collector *c, CollectorSink sink, void *ctx) {
+    if (c->running || c->sink_count == COLLECTOR_MAX_SINKS)
+        return -1;
+    c->sinks[c->sink_count].fn = sink;
+    c->sinks[c->sink_count].ctx = ctx;
+    c->sink_count++;
+    return 0;
+}
+
+int start_collector(Collector *c) {
+    if (c->running)
+        return 0;
+    uint64_t pending;
+    ssize_t unused = read(c->stop_fd, &pending, sizeof(pending)); // Clear an earlier stop
+    (void)unused;
+    if (pthread_create(&c->thread, NULL, collector_main, c) != 0)
+        return -1;
+    c->running = 1;
+    return 0;
+}
+
+void stop_collector(Collector *c) {
+    if (!c->running)
+        return;
+    uint64_t one = 1;
+    ssize_t unused = write(c->stop_fd, &one, sizeof(one)); // Wakes the poll() at once
+    (void)unused;
+    pthread_join(c->thread, NULL);
+    c->running = 0;
+}
+
+void destroy_collector(Collector *c) {
+    if (c == NULL)
+        return;
+    stop_collector(c);
+    destroy_proc_table(c->procs);
+    destroy_self_sampler(c->self);
+    destroy_thermal_sampler(c->thermal);
+    destroy_disk_sampler(c->disks);
+    destroy_net_sampler(c->net);
+    destroy_psi_sampler(c->psi);
+    destroy_cgroup_sampler(c->cgroups);
+    destroy_irq_sampler(c->irqs);
+    destroy_cpu_sampler(c->cpu_sampler);
+    close_proc_file(&c->meminfo_file);
+    close_proc_file(&c->online_file);
+    for (int r = 0; r < c->retired_count; r++)
+        destroy_cpu_topology(c->retired[r]);
+    destroy_cpu_topology(c->topology);
+    free(c->freq_block);
+    free(c->irq_block);
+    free(c->usage_block);
+    if (c->timer_fd >= 0)
+        close(c->timer_fd);
+    if (c->stop_fd >= 0)
+        close(c->stop_fd);
+    if (c->notify_fd >= 0)
+        close(c->notify_fd);
+    free(c);
+}
+
+const Sample *collector_peek(Collector *c) {
+    long slot = ring_read_slot(&c->ring);
+    return slot < 0 ? NULL : &c->slots[slot];
+}
+
+void collector_release(Collector *c) {
+    ring_release_read(&c->ring);
+}
+
+int collector_event_fd(const Collector *c) {
+    return c->notify_fd;
+}
+
+void collector_clear_event(Collector *c) {
+    uint64_t count;
+    ssize_t unused = read(c->notify_fd, &count, sizeof(count));
+    (void)unused; // EAGAIN just means nothing was pending
+}
+
+int collector_pending(Collector *c) {
+    return (int)ring_count(&c->ring);
+}
+
+void set_collector_proc_sort(Collector *c, ProcSortKey key) {
+    atomic_store(&c->proc_sort, (int)key);
+}
@@ -0,0 +1,211 @@
+/**
+ * @file collector.h
+ * @brief Dedicated sampling thread that publishes timestamped samples.
+ *
+ * The collector owns every data source (CPU sampler, /proc/meminfo, process
+ * table) and samples them on its own thread, driven by a periodic
+ * CLOCK_MONOTONIC timerfd on absolute deadlines. Each Sample is written into a preallocated slot of a
+ * single-producer/single-consumer lock-free ring, so a slow consumer (e.g.
+ * a stalled terminal) never stretches the sampling interval: when the ring
+ * is full the newest sample is dropped and counted instead.
+ *
+ * Every sample also carries the time spent in each of its sources and, with
+ * COLLECTOR_SELF, the monitor's own CPU, memory and procfs system calls.
+ *
+ * With COLLECTOR_TOPOLOGY the collector keeps the CPU topology discovered at
+ * start and rediscovers it only when the online mask changes; every sample
+ * points at the snapshot in force and carries the per-CPU frequencies. A
+ * replaced snapshot is freed once no slot of the ring refers to it.
+ *
+ * With COLLECTOR_THERMAL every sample carries the thermal zones and throttle
+ * counters, correlated with the CPU usage of the same sample, with
+ * COLLECTOR_DISKS the I/O rates of every block device and with COLLECTOR_NET
+ * the traffic of every network interface.
+ *
+ * With COLLECTOR_PSI every sample carries the CPU, memory and I/O pressure.
+ * PSI triggers added with add_collector_psi_trigger() are polled next to the
+ * timer: when one fires the thread samples at once, between two ticks, and
+ * marks the sample in psi.woken.
+ *
+ * With COLLECTOR_CGROUPS every sample carries the CPU, throttling, memory and
+ * CPU pressure of each cgroup of the unified hierarchy.
+ *
+ * With COLLECTOR_IRQS every sample carries the hardware interrupt and softirq
+ * rates of each CPU and its busiest interrupt sources.
+ */
+
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include "cgroupinfo_manip.h"
+#include "cpuinfo_manip.h"
+#include "diskinfo_manip.h"
+#include "irqinfo_manip.h"
+#include "meminfo_manip.h"
+#include "netinfo_manip.h"
+#include "procinfo_manip.h"
+#include "psi_manip.h"
+#include "selfinfo_manip.h"
+#include "thermal_manip.h"
+#include "topology_manip.h"
+#include <time.h> // For struct timespec
+
+#define COLLECTOR_RING_SLOTS 16   // Ring capacity (power of two)
+#define COLLECTOR_FIRST_DELAY_MS 100 // First sample after a short delta
+#define COLLECTOR_MIN_INTERVAL_MS 10 // Shortest accepted sampling interval
+
+#define COLLECTOR_MAX_SINKS 8       // Sinks per collector
+
+/* Optional sources, OR-ed into the flags of create_collector() */
+#define COLLECTOR_PROCESSES 0x1 // Per-process top-N table (the most expensive source)
+#define COLLECTOR_SELF 0x2      // The monitor's own usage (selfinfo_manip.h)
+#define COLLECTOR_TOPOLOGY 0x4  // CPU topology and frequencies (topology_manip.h)
+#define COLLECTOR_THERMAL 0x8   // Thermal zones and throttling (thermal_manip.h)
+#define COLLECTOR_DISKS 0x10    // Block device I/O from /proc/diskstats (diskinfo_manip.h)
+#define COLLECTOR_NET 0x20      // Network interface traffic from /proc/net/dev (netinfo_manip.h)
+#define COLLECTOR_PSI 0x40      // Pressure stall information (psi_manip.h)
+#define COLLECTOR_CGROUPS 0x80  // Per-cgroup usage from the cgroup v2 hierarchy (cgroupinfo_manip.h)
+#define COLLECTOR_IRQS 0x100    // Per-CPU interrupts from /proc/interrupts and /proc/softirqs (irqinfo_manip.h)
+
+/**
+ * @brief Time spent taking one sample, per phase, in nanoseconds.
+ */
+typedef struct {
+    long cpu_ns;     /**< sample_cpu_usage(): /proc/stat. */
+    long mem_ns;     /**< read_memory_info(): /proc/meminfo. */
+    long disk_ns;    /**< sample_disk_info(), 0 without COLLECTOR_DISKS. */
+    long net_ns;     /**< sample_net_info(), 0 without COLLECTOR_NET. */
+    long psi_ns;     /**< sample_psi_info(), 0 without COLLECTOR_PSI. */
+    long cgroup_ns;  /**< sample_cgroup_info(), 0 without COLLECTOR_CGROUPS. */
+    long irq_ns;     /**< sample_irq_info(), 0 without COLLECTOR_IRQS. */
+    long procs_ns;   /**< sample_processes(), 0 without COLLECTOR_PROCESSES. */
+    long self_ns;    /**< sample_self_info(), 0 without COLLECTOR_SELF. */
+    long topo_ns;    /**< Hotplug check and read_cpu_freq(), 0 without COLLECTOR_TOPOLOGY. */
+    long thermal_ns; /**< sample_thermal_info(), 0 without COLLECTOR_THERMAL. */
+    long sinks_ns;   /**< Sinks run for the previous sample (e.g. the recorder). */
+} SampleCost;
+
+/**
+ * @brief One timestamped snapshot of every data source.
+ */
+typedef struct {
+    unsigned long seq;         /**< Sample number, starting at 1. */
+    struct timespec timestamp; /**< CLOCK_MONOTONIC time the sample was taken. */
+    struct timespec wallclock; /**< CLOCK_REALTIME at the same moment, for exported data. */
+    double interval;           /**< Measured seconds since the previous sample. */
+    long jitter_ns;            /**< Wake-up time minus the scheduled deadline, 0 for a sample woken by a PSI trigger. */
+    long max_jitter_ns;        /**< Largest jitter seen since start. */
+    unsigned long dropped;     /**< Samples dropped so far because the ring was full. */
+    CPUInfo cpu;               /**< CPU usage; thread_usage points into this slot. */
+    MemInfo mem;               /**< Memory snapshot. */
+    DiskInfo disks;            /**< Block device rates (count 0 without COLLECTOR_DISKS). */
+    NetInfo net;               /**< Interface rates (count 0 without COLLECTOR_NET). */
+    PSIInfo psi;               /**< Pressure (nothing available without COLLECTOR_PSI). */
+    CgroupInfo cgroups;        /**< Cgroups (nothing available without COLLECTOR_CGROUPS). */
+    IrqInfo irqs;              /**< Interrupts; cpu points into this slot (NULL and not available without COLLECTOR_IRQS). */
+    ProcTop procs;             /**< Top processes by the current sort key (empty without COLLECTOR_PROCESSES). */
+    SampleCost cost;           /**< Time spent taking this sample. */
+    SelfInfo self;             /**< The monitor's own usage (zero without COLLECTOR_SELF). */
+    const CPUTopology *topology; /**< CPU layout in force, NULL without COLLECTOR_TOPOLOGY. */
+    unsigned int *freq_khz;    /**< cpu.num_cpus current frequencies in kHz (0 if unknown), NULL without COLLECTOR_TOPOLOGY. */
+    ThermalInfo thermal;       /**< Zones and throttling (zone_count 0 without COLLECTOR_THERMAL). */
+} Sample;
+
+/**
+ * @brief Opaque collector: data sources, sampling thread and sample ring.
+ */
+typedef struct Collector Collector;
+
+/**
+ * @brief Callback run on the sampling thread for every sample taken,
+ * including samples the ring drops.
+ *
+ * @param ctx Pointer given to add_collector_sink().
+ * @param sample The sample just taken.
+ * @param counters Raw /proc/stat counters behind the sample's CPU usage.
+ */
+typedef void (*CollectorSink)(void *ctx, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief Creates the collector and opens every data source.
+ *
+ * @param cpu Static CPU information (copied; num_cpus sizes the slots).
+ * @param interval_ms Sampling interval in milliseconds (at least COLLECTOR_MIN_INTERVAL_MS).
+ * @param flags Optional sources to sample (COLLECTOR_PROCESSES, COLLECTOR_SELF, COLLECTOR_TOPOLOGY, COLLECTOR_THERMAL, COLLECTOR_DISKS, COLLECTOR_NET, COLLECTOR_PSI, COLLECTOR_CGROUPS, COLLECTOR_IRQS); CPU and memory are always sampled.
+ * @return Collector* The collector, or NULL on failure (errno is set).
+ */
+Collector *create_collector(const CPUInfo *cpu, long interval_ms, int flags);
+
+/**
+ * @brief Registers a sink. Must be called before start_collector().
+ *
+ * Sinks run on the sampling thread, in registration order, and must not
+ * block for long: they delay the next sample.
+ *
+ * @return int 0 on success, -1 if COLLECTOR_MAX_SINKS are already registered.
+ */
+int add_collector_sink(Collector *collector, CollectorSink sink, void *ctx);
+
+/**
+ * @brief Wakes the collector when a resource is stalled (some or full) for
+ * stall_us within window_us. Needs COLLECTOR_PSI; must be called before
+ * start_collector().
+ *
+ * @return int 0 on success, -1 on failure (errno is set, see add_psi_trigger()).
+ */
+int add_collector_psi_trigger(Collector *collector, PSIResource res, int full, unsigned long stall_us,
+                              unsigned long window_us);
+
+/**
+ * @brief Starts the sampling thread.
+ *
+ * @return int 0 on success, -1 on failure.
+ */
+int start_collector(Collector *collector);
+
+/**
+ * @brief Stops and joins the sampling thread. Safe to call if not started.
+ */
+void stop_collector(Collector *collector);
+
+/**
+ * @brief Stops the collector if needed and frees everything. Accepts NULL.
+ */
+void destroy_collector(Collector *collector);
+
+/**
+ * @brief Consumer: oldest unread sample, or NULL when none is pending.
+ *
+ * The sample stays valid until collector_release().
+ */
+const Sample *collector_peek(Collector *collector);
+
+/**
+ * @brief Consumer: releases the sample returned by collector_peek().
+ */
+void collector_release(Collector *collector);
+
+/**
+ * @brief Consumer: eventfd that becomes readable when a sample is published.
+ *
+ * Meant for poll() in the consumer's event loop; clear it with
+ * collector_clear_event() before draining the ring.
+ */
+int collector_event_fd(const Collector *collector);
+
+/**
+ * @brief Consumer: resets the event descriptor returned by collector_event_fd().
+ */
+void collector_clear_event(Collector *collector);
+
+/**
+ * @brief Consumer: number of samples published and not yet released.
+ */
+int collector_pending(Collector *collector);
+
+/**
+ * @brief Changes the process ranking key used from the next sample on.
+ */
+void set_collector_proc_sort(Collector *collector, ProcSortKey key);
+
+#endif // COLLECTOR_H
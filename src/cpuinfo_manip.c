@@ -7,21 +7,26 @@
  */
 
 #include "cpuinfo_manip.h" // Include our header file
+#include "procfile.h"      // For the persistent /proc/stat reader
+#include "topology_manip.h" // For the sysfs core and package counts
 #include <stdio.h>         // For file operations and printf
-#include <stdlib.h>        // For exit()
+#include <stdlib.h>        // For exit(), calloc(), free()
 #include <string.h>        // For string operations
-#include <unistd.h>        // For sleep()
+#include <pthread.h>       // For the per-sampler mutex
+#include <unistd.h>        // For sysconf()
 #include <ctype.h>         // For isdigit()
 
-// Get static CPU information from /proc/cpuinfo
+// Get static CPU information from /proc/cpuinfo and the sysfs topology
 void get_cpu_info(CPUInfo *cpu) {
     // Initialize CPUInfo members to ensure sane defaults
     cpu->name[0] = '\0';
     cpu->cores = 0;
     cpu->threads = 0;
-    // cpu->usage and cpu->thread_usage are populated by get_cpu_usage()
+    // cpu->usage and cpu->thread_usage are populated by sample_cpu_usage()
 
-    FILE *file = fopen("/proc/cpuinfo", "r"); // Open cpuinfo file
+    char path[PROC_PATH_MAX];
+    FILE *file = fopen(proc_path("/proc/cpuinfo", path), "r"); // Open cpuinfo file
+    count_proc_io(1, 0); // Its reads go through stdio and are not counted
     if (file == NULL) { // Check if file opened successfully
         perror("Error opening /proc/cpuinfo"); // Print error
         // For a library function, returning an error status is generally preferred over exit().
@@ -106,65 +111,138 @@ void get_cpu_info(CPUInfo *cpu) {
     if (cpu->threads < cpu->cores) cpu->threads = cpu->cores; // Logical threads cannot be less than physical cores.
 
     fclose(file); // Close the file
-}
 
-// Initialize CPU stats structure array with zeros
-void init_cpu_stats_array(CPUStats *stats, int count) {
-    memset(stats, 0, sizeof(CPUStats) * count); // Zero out the structures
-}
+    // Per-thread usage is sized at runtime from the online CPU mask
+    cpu->num_cpus = count_cpu_slots();
 
-// Read current CPU statistics from /proc/stat for all CPUs
-void read_cpu_stats_all(CPUStats *stats, int num_threads) {
-    FILE *file = fopen("/proc/stat", "r"); // Open stat file
-    if (file == NULL) {
-        perror("Error opening /proc/stat");
-        // Consider returning an error or setting a flag instead of exiting in a library function.
+    // The sysfs topology is exact where the lines above are per package or missing
+    cpu->packages = 1;
+    CPUTopology *topo = discover_cpu_topology(cpu->num_cpus);
+    if (topo != NULL && topo->from_sysfs) {
+        cpu->cores = topo->cores;
+        cpu->threads = topo->online;
+        cpu->packages = topo->packages;
+    }
+    destroy_cpu_topology(topo);
+    cpu->usage = 0.0;
+    cpu->thread_usage = calloc(cpu->num_cpus, sizeof(double));
+    if (cpu->thread_usage == NULL) {
+        perror("Error allocating per-thread usage");
         exit(EXIT_FAILURE);
     }
+}
 
-    char line[256]; // Buffer for reading lines
-    int cpu_index;
-    int items_parsed;
+// Release the per-thread usage array
+void free_cpu_info(CPUInfo *cpu) {
+    free(cpu->thread_usage);
+    cpu->thread_usage = NULL;
+    cpu->num_cpus = 0;
+}
 
-    // Read file line by line
-    while (fgets(line, sizeof(line), file)) {
-        // Parse the aggregate "cpu" line (must have a space after "cpu")
-        if (strncmp(line, "cpu ", 4) == 0) {
-            items_parsed = sscanf(line + 3, " %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", // Skip "cpu" and parse from space
-                                  &stats[0].user, &stats[0].nice, &stats[0].system, &stats[0].idle,
-                                  &stats[0].iowait, &stats[0].irq, &stats[0].softirq, &stats[0].steal,
-                                  &stats[0].guest, &stats[0].guest_nice);
-            if (items_parsed != 10) {
-                // Log error or handle incomplete parse for aggregate CPU line
-                fprintf(stderr, "Warning: Failed to parse aggregate CPU line in /proc/stat\n");
-            }
-        // Parse individual CPU lines "cpuX ..."
-        } else if (sscanf(line, "cpu%d ", &cpu_index) == 1) {
-            if (cpu_index < num_threads) {
-                // The format string for sscanf needs to capture the numbers after "cpu%d "
-                // Adjust pointer to start scanning after "cpu%d " part.
-                char* p = line;
-                while (*p && !isspace(*p)) p++; // Move past "cpu%d"
-                while (*p && isspace(*p)) p++;  // Move past spaces
-
-                items_parsed = sscanf(p, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                                      &stats[cpu_index + 1].user, &stats[cpu_index + 1].nice,
-                                      &stats[cpu_index + 1].system, &stats[cpu_index + 1].idle,
-                                      &stats[cpu_index + 1].iowait, &stats[cpu_index + 1].irq,
-                                      &stats[cpu_index + 1].softirq, &stats[cpu_index + 1].steal,
-                                      &stats[cpu_index + 1].guest, &stats[cpu_index + 1].guest_nice);
-                if (items_parsed != 10) {
-                    // Log error or handle incomplete parse for individual CPU line
-                    fprintf(stderr, "Warning: Failed to parse CPU%d line in /proc/stat\n", cpu_index);
+// Highest CPU number + 1 in a mask file such as "0-3,6,8-11"; 0 if missing
+static int mask_slots(const char *file) {
+    int slots = 0;
+    ProcFile mask;
+    char path[PROC_PATH_MAX];
+
+    if (open_proc_file(&mask, proc_path(file, path), 0) == 0) {
+        if (read_proc_file(&mask) > 0) {
+            const char *p = mask.buf;
+            while (*p >= '0' && *p <= '9') {
+                unsigned long last = scan_ulong(&p);
+                if (*p == '-') {
+                    p++;
+                    last = scan_ulong(&p);
                 }
+                if ((int)last + 1 > slots)
+                    slots = (int)last + 1;
+                if (*p == ',')
+                    p++;
             }
-        } else if (strncmp(line, "cpu", 3) != 0) {
-            // If we've read past all 'cpu' lines, we can stop.
-            break;
         }
+        close_proc_file(&mask);
     }
+    return slots;
+}
 
-    fclose(file); // Close the file
+// Every CPU that can ever come online gets a slot, so one parked at startup
+// (the big cores of a big.LITTLE board) is tracked once it is brought up
+int count_cpu_slots(void) {
+    int slots = mask_slots("/sys/devices/system/cpu/possible");
+    if (slots == 0)
+        slots = mask_slots("/sys/devices/system/cpu/present");
+
+    if (slots == 0) {
+        long conf = sysconf(_SC_NPROCESSORS_CONF); // No sysfs (e.g. minimal containers)
+        slots = conf > 0 ? (int)conf : 1;
+    }
+    return slots;
+}
+
+// Allocate all fields of the store in one zeroed block
+int init_cpu_stats_store(CPUStatsStore *store, int count) {
+    unsigned long *block = calloc((size_t)count * CPU_STAT_FIELDS, sizeof(unsigned long));
+    if (block == NULL) {
+        store->count = 0;
+        return -1;
+    }
+    store->count = count;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        store->field[f] = block + (size_t)f * count;
+    }
+    return 0;
+}
+
+// The block is owned by the first field pointer
+void free_cpu_stats_store(CPUStatsStore *store) {
+    free(store->field[0]);
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        store->field[f] = NULL;
+    }
+    store->count = 0;
+}
+
+// Zero slots [first, last) of every field: CPUs without a line in /proc/stat
+static void clear_cpu_stats_slots(CPUStatsStore *store, int first, int last) {
+    if (first >= last)
+        return;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        memset(store->field[f] + first, 0, (size_t)(last - first) * sizeof(unsigned long));
+    }
+}
+
+// Read current CPU statistics from /proc/stat for all CPUs
+int read_cpu_stats_all(ProcFile *stat_file, CPUStatsStore *store) {
+    if (read_proc_file(stat_file) < 0)
+        return -1;
+
+    // The "cpu" lines always come first; stop at the first line that is not one
+    const char *p = stat_file->buf;
+    int next = 0; // First slot not written yet; lines come in CPU order
+    while (p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+        const char *q = p + 3;
+        int slot;
+
+        if (*q == ' ') {
+            slot = 0; // Aggregate "cpu" line
+        } else {
+            slot = (int)scan_ulong(&q) + 1; // "cpuN" goes to index N + 1
+        }
+
+        if (slot < store->count) {
+            // An offline CPU has no line: its slot must not keep an older sample
+            clear_cpu_stats_slots(store, next, slot);
+            // Fields missing on older kernels scan as 0
+            for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+                store->field[f][slot] = scan_ulong(&q);
+            }
+            if (slot >= next)
+                next = slot + 1;
+        }
+        p = next_line(q);
+    }
+    clear_cpu_stats_slots(store, next, store->count);
+    return 0;
 }
 
 // Calculate CPU usage percentage between two measurements
@@ -193,31 +271,119 @@ double calculate_cpu_usage(const CPUStats *prev, const CPUStats *curr) {
     return (double)(total_diff - idle_diff) * 100.0 / total_diff;
 }
 
-// Get current CPU usage percentage (aggregate and per-thread)
-void get_cpu_usage(CPUInfo *cpu) {
-    static CPUStats prev_stats[MAX_CPUS + 1], curr_stats[MAX_CPUS + 1]; // Persistent between calls
-    static int first_run = 1; // Flag for first run
-    int num_threads = cpu->threads;
+// Same computation as calculate_cpu_usage() over a range of slots in one pass
+void calculate_cpu_usage_all(const CPUStatsStore *prev, const CPUStatsStore *curr,
+                             int first, int count, double *usage) {
+    const unsigned long *restrict pu = prev->field[CPU_USER] + first;
+    const unsigned long *restrict pn = prev->field[CPU_NICE] + first;
+    const unsigned long *restrict ps = prev->field[CPU_SYSTEM] + first;
+    const unsigned long *restrict pi = prev->field[CPU_IDLE] + first;
+    const unsigned long *restrict pw = prev->field[CPU_IOWAIT] + first;
+    const unsigned long *restrict pq = prev->field[CPU_IRQ] + first;
+    const unsigned long *restrict pf = prev->field[CPU_SOFTIRQ] + first;
+    const unsigned long *restrict pt = prev->field[CPU_STEAL] + first;
+    const unsigned long *restrict cu = curr->field[CPU_USER] + first;
+    const unsigned long *restrict cn = curr->field[CPU_NICE] + first;
+    const unsigned long *restrict cs = curr->field[CPU_SYSTEM] + first;
+    const unsigned long *restrict ci = curr->field[CPU_IDLE] + first;
+    const unsigned long *restrict cw = curr->field[CPU_IOWAIT] + first;
+    const unsigned long *restrict cq = curr->field[CPU_IRQ] + first;
+    const unsigned long *restrict cf = curr->field[CPU_SOFTIRQ] + first;
+    const unsigned long *restrict ct = curr->field[CPU_STEAL] + first;
 
-    if (first_run) { // Initialize on first run
-        init_cpu_stats_array(prev_stats, num_threads + 1); // Zero out previous stats
-        read_cpu_stats_all(prev_stats, num_threads);       // Take initial measurement
-        first_run = 0;                                     // Clear flag
-        sleep(1);                                          // Wait before next measurement for accurate delta
+    for (int i = 0; i < count; i++) {
+        unsigned long prev_idle = pi[i] + pw[i];
+        unsigned long curr_idle = ci[i] + cw[i];
+        unsigned long prev_busy = pu[i] + pn[i] + ps[i] + pq[i] + pf[i] + pt[i];
+        unsigned long curr_busy = cu[i] + cn[i] + cs[i] + cq[i] + cf[i] + ct[i];
+        // Deltas of each group; unsigned wraparound cancels out as in the scalar version
+        long idle_diff = (long)(curr_idle - prev_idle);
+        long busy_diff = (long)(curr_busy - prev_busy);
+        long total_diff = idle_diff + busy_diff;
+        // An offline CPU reads as all zeros in either snapshot: no delta, so
+        // 0% until its second sample back online. Branch-free guards keep the
+        // loop vectorizable and the result within 0..100.
+        int valid = total_diff > 0 && prev_idle + prev_busy != 0 && curr_idle + curr_busy != 0;
+        double denom = valid ? (double)total_diff : 1.0;
+        double busy = valid && busy_diff > 0 ? (double)busy_diff : 0.0;
+        busy = busy < denom ? busy : denom;
+        usage[i] = busy * 100.0 / denom;
     }
+}
+
+/*
+ * Sampler state. Each sampler owns its /proc/stat descriptor and its two
+ * snapshots, so independent samplers (e.g. different intervals) can coexist
+ * in one process. The mutex makes a single sampler safe to share.
+ */
+struct CPUSampler {
+    pthread_mutex_t lock; // Serializes sample_cpu_usage() on this sampler
+    ProcFile stat_file;   // Persistent /proc/stat reader
+    int num_cpus;         // Logical CPU slots tracked (store slot 0 is the aggregate)
+    CPUStatsStore prev;   // Snapshot from the previous sample
+    CPUStatsStore curr;   // Snapshot being filled by the current sample
+};
+
+// Create a sampler and take its first snapshot so the next sample yields a delta
+CPUSampler *create_cpu_sampler(int num_cpus) {
+    if (num_cpus < 1)
+        num_cpus = 1;
 
-    read_cpu_stats_all(curr_stats, num_threads); // Take current measurement
+    CPUSampler *sampler = calloc(1, sizeof(*sampler));
+    if (sampler == NULL)
+        return NULL;
+    char path[PROC_PATH_MAX];
 
-    // Calculate aggregate usage
-    // Store aggregate usage in cpu->usage (as per previous convention, though cpu->usage was a single double)
-    // If cpu->usage is meant for the array, it would be cpu->usage[0]
-    cpu->usage = calculate_cpu_usage(&prev_stats[0], &curr_stats[0]); // This matches CPUInfo.usage
+    sampler->num_cpus = num_cpus;
+    sampler->stat_file.fd = -1;
+    pthread_mutex_init(&sampler->lock, NULL);
 
-    // Calculate usage for each thread
-    for (int i = 0; i < num_threads; i++) {
-        cpu->thread_usage[i] = calculate_cpu_usage(&prev_stats[i + 1], &curr_stats[i + 1]);
+    if (init_cpu_stats_store(&sampler->prev, num_cpus + 1) < 0 ||
+        init_cpu_stats_store(&sampler->curr, num_cpus + 1) < 0 ||
+        open_proc_file(&sampler->stat_file, proc_path("/proc/stat", path), (size_t)(num_cpus + 1) * STAT_LINE_LEN) < 0 ||
+        read_cpu_stats_all(&sampler->stat_file, &sampler->prev) < 0) {
+        destroy_cpu_sampler(sampler);
+        return NULL;
     }
 
-    // Current becomes previous for next call
-    memcpy(prev_stats, curr_stats, sizeof(CPUStats) * (num_threads + 1));
-}
\ No newline at end of file
+    return sampler;
+}
+
+// Get CPU usage (aggregate and per-thread) since the previous sample
+int sample_cpu_usage(CPUSampler *sampler, CPUInfo *cpu) {
+    pthread_mutex_lock(&sampler->lock);
+
+    if (read_cpu_stats_all(&sampler->stat_file, &sampler->curr) < 0) {
+        pthread_mutex_unlock(&sampler->lock);
+        return -1;
+    }
+
+    // Aggregate (slot 0) and every thread (slots 1..n) in two contiguous passes
+    int n = cpu->num_cpus < sampler->num_cpus ? cpu->num_cpus : sampler->num_cpus;
+    calculate_cpu_usage_all(&sampler->prev, &sampler->curr, 0, 1, &cpu->usage);
+    calculate_cpu_usage_all(&sampler->prev, &sampler->curr, 1, n, cpu->thread_usage);
+
+    // Current becomes previous for next call (swap instead of copying)
+    CPUStatsStore tmp = sampler->prev;
+    sampler->prev = sampler->curr;
+    sampler->curr = tmp;
+
+    pthread_mutex_unlock(&sampler->lock);
+    return 0;
+}
+
+// Raw counters of the latest sample (swapped into prev by sample_cpu_usage())
+const CPUStatsStore *cpu_sampler_counters(const CPUSampler *sampler) {
+    return &sampler->prev;
+}
+
+// Release everything owned by the sampler
+void destroy_cpu_sampler(CPUSampler *sampler) {
+    if (sampler == NULL)
+        return;
+    close_proc_file(&sampler->stat_file);
+    free_cpu_stats_store(&sampler->prev);
+    free_cpu_stats_store(&sampler->curr);
+    pthread_mutex_destroy(&sampler->lock);
+    free(sampler);
+}
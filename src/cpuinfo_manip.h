@@ -4,15 +4,18 @@
  * @brief Header for CPU Information and Usage Manipulation.
  *
  * Defines structures and declares functions to retrieve CPU hardware details
- * (model, cores, threads) from /proc/cpuinfo and to calculate real-time CPU
- * usage (aggregate and per-thread) by processing /proc/stat.
+ * (model from /proc/cpuinfo, cores and threads from the sysfs topology) and to
+ * calculate real-time CPU usage (aggregate and per-thread) by processing
+ * /proc/stat.
  */
 
 #ifndef CPUINFO_MANIP_H // Header guard to prevent multiple inclusions
 #define CPUINFO_MANIP_H
 
-#define MAX_CPUS 32         // Maximum number of CPUs supported
+#include "procfile.h" // For the persistent /proc/stat reader
+
 #define MAX_NAME_LENGTH 128 // Maximum length for CPU name string
+#define STAT_LINE_LEN 256   // Upper bound of one "cpuN" line, used to size the /proc/stat buffer
 
 /**
  * @brief Stores raw CPU time statistics for a single CPU core or aggregate.
@@ -34,23 +37,61 @@ typedef struct {
     unsigned long guest_nice; /**< Running a niced guest virtual CPU. */
 } CPUStats;
 
+/**
+ * @brief Field indices of the structure-of-arrays store (same order as /proc/stat).
+ */
+enum {
+    CPU_USER, CPU_NICE, CPU_SYSTEM, CPU_IDLE, CPU_IOWAIT,
+    CPU_IRQ, CPU_SOFTIRQ, CPU_STEAL, CPU_GUEST, CPU_GUEST_NICE,
+    CPU_STAT_FIELDS
+};
+
+/**
+ * @brief Runtime-sized raw CPU counters laid out as structure-of-arrays.
+ *
+ * field[CPU_USER][i] is the user time of slot i, and so on. Slot 0 is the
+ * aggregate "cpu" line and slot N + 1 is cpuN. All fields live in a single
+ * allocation so the per-tick delta pass streams through contiguous memory.
+ */
+typedef struct {
+    int count;                             /**< Number of slots (online CPU slots + 1). */
+    unsigned long *field[CPU_STAT_FIELDS]; /**< One contiguous array of count counters per field. */
+} CPUStatsStore;
+
 /**
  * @brief Consolidates static CPU information and dynamic usage statistics.
  */
 typedef struct {
     char name[MAX_NAME_LENGTH]; /**< CPU model name, e.g., "Intel(R) Core(TM) i7-8750H CPU @ 2.20GHz". */
-    int cores;                  /**< Number of physical cores per CPU package. */
-    int threads;                /**< Number of logical processors (threads) per CPU package (includes SMT). */
+    int cores;                  /**< Physical cores over all packages (per package from the /proc/cpuinfo fallback). */
+    int threads;                /**< Online logical processors, SMT siblings included (per package from the fallback). */
+    int packages;               /**< Physical packages (sockets); 1 from the fallback. */
+    int num_cpus;               /**< Number of logical CPU slots, i.e. highest online CPU number + 1 (offline holes included). */
     double usage;               /**< Aggregate CPU usage percentage (0.0 to 100.0). */
-    double thread_usage[MAX_CPUS]; /**< Usage percentage for each logical thread/CPU (0.0 to 100.0). Index corresponds to CPU number (e.g., thread_usage[0] for cpu0). */
-    CPUStats thread_stats[MAX_CPUS + 1]; /**< Raw CPU statistics. Index 0 for aggregate ("cpu" line in /proc/stat), indices 1 to MAX_CPUS for individual logical CPUs (cpu0, cpu1, ...). Note: This field is populated by internal static arrays in get_cpu_usage and not directly exposed or necessarily kept up-to-date in the passed CPUInfo struct by current functions. It's more of a placeholder for potential future use or internal state if refactored. */
+    double *thread_usage;       /**< num_cpus usage percentages (0.0 to 100.0), allocated by get_cpu_info(). Index corresponds to CPU number (e.g., thread_usage[0] for cpu0). */
 } CPUInfo;
 
+/**
+ * @brief Opaque CPU usage sampler.
+ *
+ * Owns its own /proc/stat descriptor and the previous/current snapshots, so
+ * several samplers can run in one process. All calls on one sampler are
+ * serialized by an internal mutex, making it safe to share between threads.
+ */
+typedef struct CPUSampler CPUSampler;
+
 // Public function declarations
-void get_cpu_info(CPUInfo *cpu); /**< @brief Populates the CPUInfo struct with static CPU details from /proc/cpuinfo. This includes model name, core count, and thread count. */
-void get_cpu_usage(CPUInfo *cpu); /**< @brief Calculates and updates the aggregate and per-thread CPU usage percentages in the CPUInfo struct. It reads /proc/stat, compares with previous readings, and computes the deltas. */
-void init_cpu_stats_array(CPUStats *stats, int count); /**< @brief Initializes an array of CPUStats structures to zero. Helper function. */
-void read_cpu_stats_all(CPUStats *stats, int num_threads); /**< @brief Reads current CPU time statistics from /proc/stat for the aggregate CPU and each logical thread. Stores results in the provided stats array. Index 0 is for aggregate, subsequent indices for cpu0, cpu1, etc. */
+void get_cpu_info(CPUInfo *cpu); /**< @brief Populates the CPUInfo struct with static CPU details from /proc/cpuinfo. This includes model name, core count, and thread count. Also sizes and allocates thread_usage from the online CPU mask; release it with free_cpu_info(). */
+void free_cpu_info(CPUInfo *cpu); /**< @brief Frees the thread_usage array allocated by get_cpu_info(). */
+int count_cpu_slots(void); /**< @brief Returns the highest possible CPU number + 1, parsed from /sys/devices/system/cpu/possible (falls back to present, then sysconf). */
+CPUSampler *create_cpu_sampler(int num_cpus); /**< @brief Creates a sampler for num_cpus logical CPU slots and takes its first snapshot immediately (no sleep), so the next sample_cpu_usage() already returns a delta. Returns NULL on failure. */
+int sample_cpu_usage(CPUSampler *sampler, CPUInfo *cpu); /**< @brief Updates the aggregate and per-thread CPU usage percentages in the CPUInfo struct from the delta since the previous sample. Returns 0 on success, -1 if /proc/stat could not be read. */
+const CPUStatsStore *cpu_sampler_counters(const CPUSampler *sampler); /**< @brief Raw counters read by the latest sample_cpu_usage() (the snapshot the next delta starts from). Only valid until the next sample on the same sampler. */
+void destroy_cpu_sampler(CPUSampler *sampler); /**< @brief Closes /proc/stat and frees the sampler. Accepts NULL. */
+int init_cpu_stats_store(CPUStatsStore *store, int count); /**< @brief Allocates and zeroes a store of count slots in a single block. Returns 0 on success, -1 on allocation failure. */
+void free_cpu_stats_store(CPUStatsStore *store); /**< @brief Frees the store allocated by init_cpu_stats_store(). */
+int read_cpu_stats_all(ProcFile *stat_file, CPUStatsStore *store); /**< @brief Reads current CPU time statistics from an opened /proc/stat ProcFile into the store. Slot 0 is the aggregate, slot N + 1 is cpuN; CPUs beyond store->count are ignored, and the slot of a CPU without a line (offline) is zeroed. The file is re-read with pread() into its preallocated buffer and the counters are scanned in place without allocating. Returns 0 on success, -1 on read failure. */
 double calculate_cpu_usage(const CPUStats *prev, const CPUStats *curr); /**< @brief Calculates CPU usage percentage based on two CPUStats snapshots (previous and current). */
+void calculate_cpu_usage_all(const CPUStatsStore *prev, const CPUStatsStore *curr, int first, int count, double *usage); /**< @brief Calculates the usage percentage of slots [first, first + count) in one branch-free pass over the field arrays, writing usage[0..count). A slot that is all zeros in either store (an offline CPU) and a tick without time accounted give 0; results are kept within 0..100. */
 
 #endif // CPUINFO_MANIP_H
\ No newline at end of file
@@ -0,0 +1,672 @@
+/**
+ * @file dashboard.c
+ * @brief Implementation of the dashboard frame: CPU, interrupt, memory, alert, disk, network, cgroup and process panels.
+ */
+
+#include "dashboard.h"
+#include "tui.h"
+#include <stdio.h>  // For snprintf()
+#include <string.h> // For strcmp(), memcpy()
+#include <time.h>   // For clock_gettime()
+
+#define SPARK_OFFSET 16     // Sparkline column after "Usage: 100.00%"
+#define HEATMAP_LABEL 8     // "cpu12   " or "  0-3   " before each heatmap row
+#define HEATMAP_MAX_ROWS 128
+
+// A graph fed from the history; rebuilt when its size or folding changes
+typedef struct {
+    tui_graph_t *graph;
+    int fold;             // Series folded into each row, shown as their maximum
+    unsigned long pushes; // history_pushes() when it was last fed
+} HistoryGraph;
+
+static FrameCost last_cost; // Times of the previous frame
+static HistoryGraph cpu_graph, mem_graph, thread_graph;
+
+static long elapsed_ns(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000000000L + (to->tv_nsec - from->tv_nsec);
+}
+
+// Events per second in at most six characters, e.g. "950", "9.0k", "12k" or "1.2M"
+static void format_event_rate(double rate, char *buf, size_t size) {
+    if (rate < 1e3)
+        snprintf(buf, size, "%.0f", rate);
+    else if (rate < 1e4)
+        snprintf(buf, size, "%.1fk", rate / 1e3);
+    else if (rate < 1e6)
+        snprintf(buf, size, "%.0fk", rate / 1e3);
+    else
+        snprintf(buf, size, "%.1fM", rate / 1e6);
+}
+
+// Percentage of part over whole, 0 when whole is 0
+static double percent_of(unsigned long part, unsigned long whole) {
+    return whole ? (double)part * 100.0 / (double)whole : 0.0;
+}
+
+/*
+ * Draw the memory panel from the numeric snapshot, one line per row.
+ * Stops one line above the bottom of the screen. Returns the next free row.
+ */
+static int draw_memory_panel(tui_coord_t pos, const MemInfo *mem, int max_rows) {
+    char lines[8][96];
+    int n = 0;
+
+    snprintf(lines[n++], sizeof(lines[0]), "Total physical memory: %lu MB", mem->mem_total / 1024);
+    snprintf(lines[n++], sizeof(lines[0]), "Usage: %.2f%%", percent_of(mem_used_kb(mem), mem->mem_total));
+    snprintf(lines[n++], sizeof(lines[0]), "Available: %lu MB", mem->mem_available / 1024);
+    snprintf(lines[n++], sizeof(lines[0]), "Dirty / Writeback: %lu / %lu kB", mem->dirty, mem->writeback);
+    snprintf(lines[n++], sizeof(lines[0]), "Slab: %lu MB  Shmem: %lu MB", mem->slab / 1024, mem->shmem / 1024);
+    snprintf(lines[n++], sizeof(lines[0]), "HugePages: %lu / %lu free", mem->hugepages_free, mem->hugepages_total);
+    snprintf(lines[n++], sizeof(lines[0]), "Total swap: %lu MB", mem->swap_total / 1024);
+    snprintf(lines[n++], sizeof(lines[0]), "Usage: %.2f%%", percent_of(swap_used_kb(mem), mem->swap_total));
+
+    for (int i = 0; i < n && pos.row < max_rows - 1; i++, pos.row++) {
+        tui_draw_field(pos, lines[i]);
+    }
+    return pos.row;
+}
+
+/*
+ * Draw one row per whole disk that has done I/O since boot, at most
+ * DISK_PANEL_ROWS, e.g. "mmcblk0    148.0   70.0   0.61   0.57   5.2 ms  62%".
+ * Returns the next free row.
+ */
+static int draw_disk_panel(tui_coord_t pos, const DiskInfo *disks, int max_rows) {
+    char line[96];
+
+    tui_draw_field(pos, "--- Disk I/O ---");
+    pos.row += 2;
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    tui_draw_field(pos, "Device         r/s    w/s  rMB/s  wMB/s    await util");
+    pos.row++;
+
+    int shown = 0;
+    for (int i = 0; i < disks->count && shown < DISK_PANEL_ROWS && pos.row < max_rows - 1; i++) {
+        const DiskDevice *d = &disks->dev[i];
+        if (d->partition || d->ios == 0) // Partitions and never-used loop/ram devices
+            continue;
+        snprintf(line, sizeof(line), "%-10s %7.1f %6.1f %6.2f %6.2f %5.1f ms %3.0f%%", d->name, d->read_iops,
+                 d->write_iops, d->read_mbps, d->write_mbps, d->await_ms, d->util);
+        tui_draw_field(pos, line);
+        pos.row++;
+        shown++;
+    }
+    return pos.row;
+}
+
+/*
+ * Draw one row per interface other than loopback, at most NET_PANEL_ROWS, in
+ * Mbit/s and packets/s with drops and errors of both directions summed,
+ * e.g. "eth0       91.32    4.10    9512    4230    2.0   0.0".
+ * Returns the next free row.
+ */
+static int draw_net_panel(tui_coord_t pos, const NetInfo *net, int max_rows) {
+    char line[96];
+
+    tui_draw_field(pos, "--- Network ---");
+    pos.row += 2;
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    tui_draw_field(pos, "Iface      rxMb/s  txMb/s  rxpk/s  txpk/s drop/s err/s");
+    pos.row++;
+
+    int shown = 0;
+    for (int i = 0; i < net->count && shown < NET_PANEL_ROWS && pos.row < max_rows - 1; i++) {
+        const NetIface *n = &net->iface[i];
+        if (strcmp(n->name, "lo") == 0) // Loopback never saturates a link
+            continue;
+        snprintf(line, sizeof(line), "%-9s %7.2f %7.2f %7.0f %7.0f %6.1f %5.1f", n->name,
+                 n->rx_bytes_ps * 8 / 1e6, n->tx_bytes_ps * 8 / 1e6, n->rx_packets_ps, n->tx_packets_ps,
+                 n->rx_drops_ps + n->tx_drops_ps, n->rx_errors_ps + n->tx_errors_ps);
+        tui_draw_field(pos, line);
+        pos.row++;
+        shown++;
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the busiest cgroups by key, at most CGROUP_PANEL_ROWS, e.g.
+ * "  87.5  42.0   512.3   3.1 system.slice/docker-web.scope"; "-" marks a
+ * figure whose controller is not enabled for the cgroup. Returns the next
+ * free row.
+ */
+static int draw_cgroup_panel(tui_coord_t pos, const CgroupInfo *cg, CgroupSortKey key, int max_rows) {
+    char line[128], thr[16], mem[24], psi[16];
+    int order[CGROUP_MAX_GROUPS];
+
+    snprintf(line, sizeof(line), "--- Cgroups (%s, %d tracked, 'c' to sort) ---", cgroup_sort_name(key), cg->count);
+    tui_draw_field(pos, line);
+    pos.row += 2;
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    tui_draw_field(pos, "  CPU%  thr%  MEM MB  PSI% Cgroup");
+    pos.row++;
+
+    rank_cgroups(cg, key, order);
+    for (int i = 0; i < cg->count && i < CGROUP_PANEL_ROWS && pos.row < max_rows - 1; i++, pos.row++) {
+        const CgroupEntry *e = &cg->group[order[i]];
+        snprintf(thr, sizeof(thr), e->flags & CGROUP_HAS_LIMIT ? "%5.1f" : "    -", e->throttled_pct);
+        snprintf(mem, sizeof(mem), e->flags & CGROUP_HAS_MEMORY ? "%7.1f" : "      -", e->memory_bytes / 1048576.0);
+        snprintf(psi, sizeof(psi), e->flags & CGROUP_HAS_PRESSURE ? "%5.1f" : "    -", e->pressure_pct);
+        snprintf(line, sizeof(line), "%6.1f %s %s %s %s", e->cpu_pct, thr, mem, psi, e->name);
+        tui_draw_field(pos, line);
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the firing alerts in reverse video, at most ALERT_PANEL_ROWS, e.g.
+ * "hot_thread (cpu3)    99.2  for 12 s". Returns the next free row.
+ */
+static int draw_alert_panel(tui_coord_t pos, const RuleSet *rules, const Sample *s, int max_rows) {
+    char line[128], label[RULES_LABEL_LEN];
+    RuleAlert alerts[ALERT_PANEL_ROWS];
+    int firing = rules_firing(rules);
+
+    snprintf(line, sizeof(line), "--- Alerts: %d firing (%d rules) ---", firing, rule_count(rules));
+    tui_draw_field(pos, line);
+    pos.row += 2;
+
+    long long now = (long long)s->timestamp.tv_sec * 1000000000LL + s->timestamp.tv_nsec;
+    int n = list_firing_alerts(rules, alerts, ALERT_PANEL_ROWS);
+    for (int i = 0; i < n && pos.row < max_rows - 1; i++, pos.row++) {
+        format_alert_label(rules, alerts[i].rule, alerts[i].instance, label, sizeof(label));
+        snprintf(line, sizeof(line), "%-28.28s %8.1f  for %lld s", label, alerts[i].value,
+                 (now - alerts[i].since_ns) / 1000000000LL);
+        tui_draw_field_attr(pos, line, A_REVERSE | A_BOLD);
+    }
+    if (firing > n && pos.row < max_rows - 1) {
+        snprintf(line, sizeof(line), "... and %d more", firing - n);
+        tui_draw_field(pos, line);
+        pos.row++;
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the monitor's own cost: the collector's phases for this sample and
+ * the previous frame's render times. Returns the next free row.
+ */
+static int draw_overhead_panel(tui_coord_t pos, const Sample *s, int max_rows) {
+    char lines[6][128];
+    int n = 0;
+    const SampleCost *c = &s->cost;
+
+    snprintf(lines[n++], sizeof(lines[0]), "--- Monitor Overhead ('o' to hide) ---");
+    snprintf(lines[n++], sizeof(lines[0]), "CPU: %.2f%%  RSS: %.1f MB (peak %.1f)  threads %d",
+             s->self.cpu_usage, s->self.rss_kb / 1024.0, s->self.hwm_kb / 1024.0, s->self.threads);
+    snprintf(lines[n++], sizeof(lines[0]), "Sample us: cpu %.0f mem %.0f disk %.0f net %.0f irq %.0f procs %.0f",
+             c->cpu_ns / 1e3, c->mem_ns / 1e3, c->disk_ns / 1e3, c->net_ns / 1e3, c->irq_ns / 1e3,
+             c->procs_ns / 1e3);
+    snprintf(lines[n++], sizeof(lines[0]), "           psi %.0f cgroups %.0f topo %.0f thermal %.0f self %.0f sinks %.0f",
+             c->psi_ns / 1e3, c->cgroup_ns / 1e3, c->topo_ns / 1e3, c->thermal_ns / 1e3, c->self_ns / 1e3,
+             c->sinks_ns / 1e3);
+    snprintf(lines[n++], sizeof(lines[0]), "Frame us: format %.1f  refresh %.1f",
+             last_cost.format_ns / 1e3, last_cost.refresh_ns / 1e3);
+    snprintf(lines[n++], sizeof(lines[0]), "procfs: %lu opens %lu reads per sample (%lu / %lu total)",
+             s->self.io_delta.opens, s->self.io_delta.reads, s->self.io.opens, s->self.io.reads);
+
+    for (int i = 0; i < n && pos.row < max_rows - 1; i++, pos.row++) {
+        tui_draw_field(pos, lines[i]);
+        if (i == 0)
+            pos.row++;
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the share of the last interval each resource was stalled, e.g.
+ * "Stalled: cpu 12.3%  mem 0.4/0.1%  io 6.0/2.5%  (some/full)", and the
+ * kernel's 10 s averages. The CPU has no system-wide "full" figure. A
+ * sample woken by a PSI trigger is marked. Returns the next free row.
+ */
+static int draw_psi_lines(tui_coord_t pos, const PSIInfo *psi) {
+    char line[96];
+    const PSIPressure *cpu = &psi->res[PSI_CPU], *mem = &psi->res[PSI_MEMORY], *io = &psi->res[PSI_IO];
+
+    int len = snprintf(line, sizeof(line), "Stalled: cpu %.1f%%  mem %.1f/%.1f%%  io %.1f/%.1f%%", cpu->some_pct,
+                       mem->some_pct, mem->full_pct, io->some_pct, io->full_pct);
+    if (psi->woken)
+        snprintf(line + len, sizeof(line) - (size_t)len, "  STALL");
+    tui_draw_field(pos, line);
+    pos.row++;
+    snprintf(line, sizeof(line), "avg10:   cpu %.1f%%  mem %.1f/%.1f%%  io %.1f/%.1f%%", cpu->some.avg10,
+             mem->some.avg10, mem->full.avg10, io->some.avg10, io->full.avg10);
+    tui_draw_field(pos, line);
+    pos.row++;
+    return pos.row;
+}
+
+/*
+ * Draw the hottest zone, e.g. "Temp: 86.0 C (cpu-thermal, trip 85.0)", and
+ * the throttling state, e.g. "Throttles: +2 (41 total)  THROTTLED x3".
+ * Returns the next free row.
+ */
+static int draw_thermal_lines(tui_coord_t pos, const ThermalInfo *t) {
+    char line[96];
+    const ThermalZone *z = &t->zones[t->hottest];
+    if (z->trip_mc > 0)
+        snprintf(line, sizeof(line), "Temp: %.1f C (%s, trip %.1f)", z->temp_mc / 1000.0, z->type, z->trip_mc / 1000.0);
+    else
+        snprintf(line, sizeof(line), "Temp: %.1f C (%s)", z->temp_mc / 1000.0, z->type);
+    tui_draw_field(pos, line);
+    pos.row++;
+
+    int len = snprintf(line, sizeof(line), "Throttles: +%lu (%lu total)",
+                       t->core_throttles + t->package_throttles, t->throttle_total);
+    if (t->flags & THERMAL_THROTTLED)
+        snprintf(line + len, sizeof(line) - (size_t)len, "  THROTTLED x%lu", t->throttled_frames);
+    tui_draw_field(pos, line);
+    pos.row++;
+    return pos.row;
+}
+
+/*
+ * Draw per-thread usage one core per row, e.g. "Core   3 2400 MHz  cpu3  12%  cpu7  45%",
+ * under a package/cluster header when there is more than one. Without a
+ * topology, one row per CPU. Returns the next free row.
+ */
+static int draw_thread_panel(tui_coord_t pos, const Sample *s, int max_rows) {
+    char line[160];
+    const CPUTopology *topo = s->topology;
+
+    if (topo == NULL) {
+        for (int i = 0; i < s->cpu.num_cpus; i++, pos.row++) {
+            if (pos.row >= max_rows - 1) { // -1 leaves one line margin
+                tui_draw_field(pos, "..."); // Indicate more threads exist
+                break;
+            }
+            snprintf(line, sizeof(line), "Thread %2d: %6.2f%%", i, s->cpu.thread_usage[i]);
+            tui_draw_field(pos, line);
+        }
+        return pos.row;
+    }
+
+    int grouped = topo->clusters > 1 || topo->packages > 1;
+    int len = 0;
+    for (int i = 0; i < topo->online; i++) {
+        int cpu = topo->order[i];
+        const CPUTopoEntry *e = &topo->cpu[cpu];
+        const CPUTopoEntry *prev = i > 0 ? &topo->cpu[topo->order[i - 1]] : NULL;
+
+        if (prev == NULL || e->core_index != prev->core_index) {
+            if (len > 0) { // Finish the previous core's row
+                tui_draw_field(pos, line);
+                pos.row++;
+                len = 0;
+            }
+            if (grouped && (prev == NULL || e->cluster_index != prev->cluster_index) && pos.row < max_rows - 1) {
+                if (e->cluster >= 0)
+                    snprintf(line, sizeof(line), "Package %d, cluster %d:", e->package, e->cluster);
+                else
+                    snprintf(line, sizeof(line), "Package %d:", e->package);
+                tui_draw_field(pos, line);
+                pos.row++;
+            }
+            if (pos.row >= max_rows - 1) {
+                tui_draw_field(pos, "...");
+                return pos.row;
+            }
+            len = snprintf(line, sizeof(line), "Core %3d %4u MHz", e->core, s->freq_khz[cpu] / 1000);
+        }
+        if (len < (int)sizeof(line))
+            len += snprintf(line + len, sizeof(line) - (size_t)len, "  cpu%-3d%3.0f%%", cpu, s->cpu.thread_usage[cpu]);
+    }
+    if (len > 0) {
+        tui_draw_field(pos, line);
+        pos.row++;
+    }
+    return pos.row;
+}
+
+/*
+ * Bring a graph of count series starting at first up to date with the
+ * history: rows x width cells, each row the maximum of fold series. Only the
+ * columns recorded since the last call are pushed; a new size rebuilds the
+ * graph from the newest width columns. NULL if it cannot be allocated.
+ */
+static tui_graph_t *feed_history_graph(HistoryGraph *hg, tui_graph_style_t style, const History *h,
+                                       int first, int count, int rows, int width) {
+    int fold = (count + rows - 1) / rows;
+    if (hg->graph == NULL || tui_graph_rows(hg->graph) != rows || tui_graph_width(hg->graph) != width ||
+        hg->fold != fold) {
+        tui_destroy_graph(hg->graph);
+        hg->graph = tui_create_graph(style, rows, width);
+        hg->fold = fold;
+        hg->pushes = 0; // Refill from the history
+        if (hg->graph == NULL)
+            return NULL;
+    }
+
+    unsigned long fresh = history_pushes(h) - hg->pushes;
+    int n = fresh < (unsigned long)width ? (int)fresh : width;
+    if (n > history_count(h))
+        n = history_count(h);
+    float level[HEATMAP_MAX_ROWS];
+    for (int age = n - 1; age >= 0; age--) {
+        const float *column = history_column(h, age) + first;
+        for (int r = 0, i = 0; r < rows; r++) {
+            float peak = 0.0f;
+            for (int end = i + fold < count ? i + fold : count; i < end; i++)
+                if (column[i] > peak)
+                    peak = column[i];
+            level[r] = peak / 100.0f;
+        }
+        tui_push_graph(hg->graph, level);
+    }
+    hg->pushes = history_pushes(h);
+    return hg->graph;
+}
+
+// One-row graph of a percentage series at pos, if at least a few cells fit
+static void draw_sparkline(HistoryGraph *hg, tui_coord_t pos, const History *h, int series, int width) {
+    if (width > HISTORY_CAPACITY)
+        width = HISTORY_CAPACITY;
+    if (width < 4)
+        return;
+    tui_graph_t *g = feed_history_graph(hg, TUI_SPARKLINE, h, series, 1, 1, width);
+    if (g != NULL)
+        tui_draw_graph(pos, g);
+}
+
+/*
+ * Draw per-thread usage as a threads x time heatmap, one row per CPU, or
+ * per group of CPUs showing their maximum when they outnumber the rows, so
+ * a spike on a single core stays visible. Returns the next free row.
+ */
+static int draw_thread_heatmap(tui_coord_t pos, const History *h, int width, int max_rows) {
+    char label[32];
+    int cpus = history_series(h) - HISTORY_THREADS;
+    int rows = max_rows - 1 - pos.row;
+    if (rows > HEATMAP_MAX_ROWS)
+        rows = HEATMAP_MAX_ROWS;
+    width -= HEATMAP_LABEL;
+    if (width > HISTORY_CAPACITY)
+        width = HISTORY_CAPACITY;
+    if (cpus <= 0 || rows <= 0 || width < 4)
+        return pos.row;
+    int fold = (cpus + rows - 1) / rows;
+    rows = (cpus + fold - 1) / fold;
+
+    tui_graph_t *g = feed_history_graph(&thread_graph, TUI_HEATMAP, h, HISTORY_THREADS, cpus, rows, width);
+    if (g == NULL)
+        return pos.row;
+    for (int r = 0; r < rows; r++) {
+        int lo = r * fold, hi = lo + fold < cpus ? lo + fold - 1 : cpus - 1;
+        if (lo == hi)
+            snprintf(label, sizeof(label), "cpu%d", lo);
+        else
+            snprintf(label, sizeof(label), "%3d-%d", lo, hi);
+        tui_draw_field((tui_coord_t){ pos.row + r, pos.col }, label);
+    }
+    tui_draw_graph((tui_coord_t){ pos.row, pos.col + HEATMAP_LABEL }, g);
+    return pos.row + rows;
+}
+
+/*
+ * Draw the window statistics of the CPU total and of every thread, one row
+ * each with the current usage first, e.g. "   3   12    0   10   41   77   93".
+ * Returns the next free row.
+ */
+static int draw_window_panel(tui_coord_t pos, const WindowStats *ws, int window, const Sample *s, int max_rows) {
+    char line[96];
+    int cpus = window_stats_series(ws) - WINSTATS_THREADS;
+    if (cpus > s->cpu.num_cpus)
+        cpus = s->cpu.num_cpus;
+
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    tui_draw_field(pos, " cpu  now  min mean  p95  p99  max");
+    pos.row++;
+    for (int i = -1; i < cpus; i++, pos.row++) {
+        if (pos.row >= max_rows - 1) {
+            tui_draw_field(pos, "...");
+            break;
+        }
+        WindowSummary w;
+        get_window_summary(ws, i < 0 ? WINSTATS_CPU : WINSTATS_THREADS + i, window, &w);
+        char label[16];
+        if (i < 0)
+            snprintf(label, sizeof(label), "all");
+        else
+            snprintf(label, sizeof(label), "%d", i);
+        snprintf(line, sizeof(line), "%4s %4.0f %4.0f %4.0f %4.0f %4.0f %4.0f", label,
+                 i < 0 ? s->cpu.usage : s->cpu.thread_usage[i], w.min, w.mean, w.p95, w.p99, w.max);
+        tui_draw_field(pos, line);
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the interrupt load of every CPU next to its usage, then its busiest
+ * sources as fit in width, e.g. "   1   45   9.0k   7.0k  eth0-rx-0 9.0k
+ * NET_RX 7.0k". Returns the next free row.
+ */
+static int draw_irq_panel(tui_coord_t pos, const Sample *s, int width, int max_rows) {
+    char line[160], irq_ps[16], soft_ps[16];
+    const IrqInfo *irq = &s->irqs;
+    int cpus = irq->num_cpus < s->cpu.num_cpus ? irq->num_cpus : s->cpu.num_cpus;
+    if (width > (int)sizeof(line) - 1)
+        width = (int)sizeof(line) - 1;
+
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    format_event_rate(irq->irq_ps, irq_ps, sizeof(irq_ps));
+    format_event_rate(irq->softirq_ps, soft_ps, sizeof(soft_ps));
+    snprintf(line, sizeof(line), "Total: %s irq/s  %s softirq/s  %d sources", irq_ps, soft_ps, irq->sources);
+    tui_draw_field(pos, line);
+    pos.row++;
+    if (pos.row >= max_rows - 1)
+        return pos.row;
+    tui_draw_field(pos, " cpu use%  irq/s soft/s  top sources");
+    pos.row++;
+    for (int i = 0; i < cpus; i++, pos.row++) {
+        if (pos.row >= max_rows - 1) {
+            tui_draw_field(pos, "...");
+            break;
+        }
+        const IrqCpu *c = &irq->cpu[i];
+        format_event_rate(c->irq_ps, irq_ps, sizeof(irq_ps));
+        format_event_rate(c->softirq_ps, soft_ps, sizeof(soft_ps));
+        int len = snprintf(line, sizeof(line), "%4d %4.0f %6s %6s ", i, s->cpu.thread_usage[i], irq_ps, soft_ps);
+        for (int k = 0; k < IRQ_TOP_SOURCES && c->top[k].rate > 0.0; k++) {
+            char source[40], rate[16];
+            format_event_rate(c->top[k].rate, rate, sizeof(rate));
+            int n = snprintf(source, sizeof(source), " %.10s %s", c->top[k].name, rate);
+            if (len + n > width)
+                break;
+            memcpy(line + len, source, (size_t)n + 1);
+            len += n;
+        }
+        tui_draw_field(pos, line);
+    }
+    return pos.row;
+}
+
+/*
+ * Draw the top processes panel, as many rows as fit above the bottom line.
+ */
+static void draw_process_panel(tui_coord_t pos, const ProcTop *top, ProcSortKey key, int max_rows) {
+    char line[96];
+
+    snprintf(line, sizeof(line), "--- Top Processes (%s, %d total, 's' to sort) ---",
+             key == PROC_SORT_CPU ? "CPU" : "RSS", top->total);
+    tui_draw_field(pos, line);
+    pos.row += 2;
+
+    if (pos.row >= max_rows - 1)
+        return;
+    tui_draw_field(pos, "    PID COMMAND          S   CPU%     RSS MB");
+    pos.row++;
+
+    for (int i = 0; i < top->count && pos.row < max_rows - 1; i++, pos.row++) {
+        const ProcEntry *e = &top->entries[i];
+        snprintf(line, sizeof(line), "%7d %-16s %c %6.1f %10.1f",
+                 e->pid, e->comm, e->state, e->cpu_usage, e->rss_kb / 1024.0);
+        tui_draw_field(pos, line);
+    }
+}
+
+// One complete frame; only fields whose text changed reach the terminal
+void draw_dashboard(const CPUInfo *cpu, const Sample *sample, const DashboardView *view) {
+    struct timespec start, formatted, done;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Buffer for formatting display strings
+    char display_buffer[256];
+    int max_rows, max_cols; // Variables to store terminal dimensions
+    ui_get_dims(&max_rows, &max_cols);
+
+    ui_begin_frame(); // Only fields whose text changed reach the terminal
+
+    // --- CPU Information ---
+    tui_coord_t current_pos = tui_get_relative_coord(0.05f, 0.05f);
+
+    tui_draw_field(current_pos, "--- CPU Information ---");
+    current_pos.row++;
+    current_pos.row++;
+
+    snprintf(display_buffer, sizeof(display_buffer), "Model: %s", cpu->name);
+    tui_draw_field(current_pos, display_buffer);
+    current_pos.row++;
+
+    // The sample's topology follows hotplug events; cpu was read at start
+    const CPUTopology *topo = sample->topology;
+    snprintf(display_buffer, sizeof(display_buffer), "Cores: %d", topo ? topo->cores : cpu->cores);
+    tui_draw_field(current_pos, display_buffer);
+    current_pos.row++;
+
+    snprintf(display_buffer, sizeof(display_buffer), "Threads: %d", topo ? topo->online : cpu->threads);
+    tui_draw_field(current_pos, display_buffer);
+    current_pos.row++;
+
+    if (topo != NULL) {
+        snprintf(display_buffer, sizeof(display_buffer), "Packages: %d  Clusters: %d  NUMA nodes: %d",
+                 topo->packages, topo->clusters, topo->nodes);
+        tui_draw_field(current_pos, display_buffer);
+        current_pos.row++;
+    }
+
+    // Panels on the left end two columns before the memory panel
+    tui_coord_t mem_pos = tui_get_relative_coord(0.05f, 0.50f);
+    int left_width = mem_pos.col - current_pos.col - 2;
+
+    snprintf(display_buffer, sizeof(display_buffer), "Usage: %.2f%%", sample->cpu.usage);
+    tui_draw_field(current_pos, display_buffer);
+    if (view->history != NULL)
+        draw_sparkline(&cpu_graph, (tui_coord_t){ current_pos.row, current_pos.col + SPARK_OFFSET }, view->history,
+                       HISTORY_CPU, left_width - SPARK_OFFSET);
+    current_pos.row++;
+
+    if (sample->psi.res[PSI_CPU].available)
+        current_pos.row = draw_psi_lines(current_pos, &sample->psi);
+
+    if (sample->thermal.zone_count > 0)
+        current_pos.row = draw_thermal_lines(current_pos, &sample->thermal);
+
+    // --- Thread Usage ---
+    current_pos.row += 2;
+    if (view->show_stats > 0 && view->stats != NULL) {
+        int window = view->show_stats - 1;
+        snprintf(display_buffer, sizeof(display_buffer), "--- Thread Usage, last %d min ('w') ---",
+                 window_seconds(window) / 60);
+        tui_draw_field(current_pos, display_buffer);
+        current_pos.row += 2;
+        draw_window_panel(current_pos, view->stats, window, sample, max_rows);
+    } else if (view->show_irqs && sample->irqs.available) {
+        tui_draw_field(current_pos, "--- Interrupts per CPU ('i') ---");
+        current_pos.row += 2;
+        draw_irq_panel(current_pos, sample, left_width, max_rows);
+    } else if (view->show_heatmap && view->history != NULL) {
+        tui_draw_field(current_pos, "--- Thread Usage over Time ('g') ---");
+        current_pos.row += 2;
+        draw_thread_heatmap(current_pos, view->history, left_width, max_rows);
+    } else {
+        tui_draw_field(current_pos, topo ? "--- Thread Usage by Core ---" : "--- Thread Usage ---");
+        current_pos.row += 2;
+        draw_thread_panel(current_pos, sample, max_rows);
+    }
+
+    // --- Memory Information ---
+    // Position memory info to the right (e.g., 50% across)
+    tui_draw_field(mem_pos, "--- Memory Information ---");
+    mem_pos.row++;
+    mem_pos.row++;
+
+    tui_coord_t mem_usage_pos = { mem_pos.row + 1, mem_pos.col + SPARK_OFFSET }; // Second line of the panel
+    mem_pos.row = draw_memory_panel(mem_pos, &sample->mem, max_rows);
+    if (view->history != NULL && mem_usage_pos.row < mem_pos.row)
+        draw_sparkline(&mem_graph, mem_usage_pos, view->history, HISTORY_MEM, max_cols - mem_usage_pos.col - 1);
+
+    // --- Alerts ---
+    if (view->rules != NULL) {
+        mem_pos.row += 2;
+        mem_pos.row = draw_alert_panel(mem_pos, view->rules, sample, max_rows);
+    }
+
+    // --- Disk I/O ---
+    if (sample->disks.count > 0) {
+        mem_pos.row += 2;
+        mem_pos.row = draw_disk_panel(mem_pos, &sample->disks, max_rows);
+    }
+
+    // --- Network ---
+    if (sample->net.count > 0) {
+        mem_pos.row += 2;
+        mem_pos.row = draw_net_panel(mem_pos, &sample->net, max_rows);
+    }
+
+    // --- Cgroups ---
+    if (sample->cgroups.available && sample->cgroups.count > 0) {
+        mem_pos.row += 2;
+        mem_pos.row = draw_cgroup_panel(mem_pos, &sample->cgroups, view->cgroup_sort, max_rows);
+    }
+
+    // --- Monitor Overhead ---
+    if (view->show_overhead) {
+        mem_pos.row += 2;
+        mem_pos.row = draw_overhead_panel(mem_pos, sample, max_rows);
+    }
+
+    // --- Top Processes ---
+    mem_pos.row += 2;
+    draw_process_panel(mem_pos, &sample->procs, view->proc_sort, max_rows);
+
+    // --- Sampling status on the last line ---
+    tui_coord_t status_pos = { max_rows - 1, 0 };
+    snprintf(display_buffer, sizeof(display_buffer),
+             "sample #%lu  interval %.3f s  jitter %.3f ms (max %.3f ms)  dropped %lu",
+             sample->seq, sample->interval, sample->jitter_ns / 1e6,
+             sample->max_jitter_ns / 1e6, sample->dropped);
+    tui_draw_field(status_pos, display_buffer);
+
+    clock_gettime(CLOCK_MONOTONIC, &formatted);
+    ui_end_frame(); // Update the screen
+    clock_gettime(CLOCK_MONOTONIC, &done);
+    last_cost.format_ns = elapsed_ns(&start, &formatted);
+    last_cost.refresh_ns = elapsed_ns(&formatted, &done);
+}
+
+void get_frame_cost(FrameCost *cost) {
+    *cost = last_cost;
+}
+
+void record_dashboard_history(History *history, const Sample *s) {
+    float *column = push_history(history);
+    column[HISTORY_CPU] = (float)s->cpu.usage;
+    column[HISTORY_MEM] = (float)percent_of(mem_used_kb(&s->mem), s->mem.mem_total);
+    int cpus = history_series(history) - HISTORY_THREADS;
+    for (int i = 0; i < cpus; i++)
+        column[HISTORY_THREADS + i] = i < s->cpu.num_cpus ? (float)s->cpu.thread_usage[i] : 0.0f;
+}
+
+void release_dashboard(void) {
+    HistoryGraph *graphs[] = { &cpu_graph, &mem_graph, &thread_graph };
+    for (int i = 0; i < 3; i++) {
+        tui_destroy_graph(graphs[i]->graph);
+        graphs[i]->graph = NULL;
+    }
+}
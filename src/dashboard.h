@@ -0,0 +1,104 @@
+/**
+ * @file dashboard.h
+ * @brief The monitor's screen: CPU, memory and process panels and the status line.
+ *
+ * Drawn with the retained fields of tui.h, so a frame only sends the text
+ * that changed since the previous one. Kept apart from resource_mon.c so
+ * benchmarks can render frames into a virtual screen.
+ *
+ * Each frame is timed in two phases, formatting the fields and the ncurses
+ * refresh; the overhead panel shows the previous frame's times next to the
+ * collector's per-source times and the monitor's own CPU and memory.
+ *
+ * When the sample carries a topology, per-thread usage is grouped one core
+ * per row with the core's frequency, under package/cluster headers. With
+ * disk rates, a Disk I/O panel under the memory panel lists the whole disks,
+ * and with interface rates a Network panel under it lists the interfaces.
+ * With cgroups, a Cgroups panel under those lists the busiest by the key
+ * chosen with 'c': CPU, memory or throttled periods.
+ * With pressure figures, the stall percentages follow the CPU usage.
+ * With interrupt rates, 'i' replaces the per-thread numbers with each CPU's
+ * usage, interrupt and softirq rates and busiest sources.
+ *
+ * Given a history of recent samples, sparklines follow the CPU and memory
+ * usage and 'g' turns the per-thread numbers into a threads x time heatmap.
+ * The graphs are retained by tui.c: each frame pushes only the columns
+ * recorded since the previous one.
+ *
+ * Given alert rules, an Alerts panel under the memory panel lists the
+ * firing alerts in reverse video.
+ *
+ * Given rolling window statistics, 'w' replaces the per-thread numbers with
+ * each CPU's min, mean, p95, p99 and max over the last 1, 5 or 15 minutes.
+ */
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include "collector.h"
+#include "history.h"
+#include "rules.h"
+#include "winstats.h"
+
+#define DISK_PANEL_ROWS 6 // Disks listed at most, so the process panel keeps its room
+#define NET_PANEL_ROWS 4  // Interfaces listed at most, likewise
+#define ALERT_PANEL_ROWS 4 // Firing alerts listed at most, likewise
+#define CGROUP_PANEL_ROWS 6 // Cgroups listed at most, likewise
+
+#define HISTORY_CAPACITY 600 // Samples kept for the graphs: 10 min at 1 s, 1 min at 10 Hz
+#define HISTORY_CPU 0        // Series recorded by record_dashboard_history()
+#define HISTORY_MEM 1
+#define HISTORY_THREADS 2    // First of one series per CPU
+#define HISTORY_SERIES(cpus) (HISTORY_THREADS + (cpus))
+
+/**
+ * @brief What the user chose to see, changed with keys.
+ */
+typedef struct {
+    ProcSortKey proc_sort; /**< Sort key named in the process panel title. */
+    CgroupSortKey cgroup_sort; /**< Order of the cgroup panel ('c'). */
+    int show_overhead;     /**< Show the monitor's own cost ('o'). */
+    int show_heatmap;      /**< Per-thread heatmap instead of numbers ('g'). */
+    const History *history; /**< Recent samples for the graphs, or NULL for none. */
+    const RuleSet *rules;   /**< Alert rules evaluated on every sample, or NULL for none. */
+    const WindowStats *stats; /**< Rolling statistics of WINSTATS_SERIES(num_cpus) series, or NULL. */
+    int show_stats;         /**< 0, or 1 + the window whose statistics replace the threads ('w'). */
+    int show_irqs;          /**< Per-CPU interrupt rates and top sources instead of the threads ('i'). */
+} DashboardView;
+
+/**
+ * @brief Time spent drawing one frame, in nanoseconds.
+ */
+typedef struct {
+    long format_ns;  /**< Formatting and comparing the fields. */
+    long refresh_ns; /**< ui_end_frame(): damaged cells and terminal output. */
+} FrameCost;
+
+/**
+ * @brief Draws one complete frame from a sample and updates the screen.
+ *
+ * @param cpu Static CPU details (model, cores, threads).
+ * @param sample Usage, memory and process figures to show.
+ * @param view Panels and sort key chosen by the user.
+ */
+void draw_dashboard(const CPUInfo *cpu, const Sample *sample, const DashboardView *view);
+
+/**
+ * @brief Cost of the last draw_dashboard() call.
+ */
+void get_frame_cost(FrameCost *cost);
+
+/**
+ * @brief Appends a sample to a history created with
+ * HISTORY_SERIES(num_cpus) series: CPU and memory usage, then every thread's
+ * usage, in percent. Record every sample, including those never drawn.
+ */
+void record_dashboard_history(History *history, const Sample *sample);
+
+/**
+ * @brief Frees the graphs kept between frames; the next frame rebuilds
+ * them from the history.
+ */
+void release_dashboard(void);
+
+#endif // DASHBOARD_H
@@ -0,0 +1,238 @@
+/**
+ * @file diskinfo_manip.c
+ * @brief Implementation of the /proc/diskstats sampler.
+ */
+
+#include "diskinfo_manip.h"
+#include <stdint.h>   // For uint32_t
+#include <stdio.h>    // For snprintf()
+#include <stdlib.h>   // For calloc(), free()
+#include <string.h>   // For strcmp(), memcpy()
+#include <sys/stat.h> // For stat()
+#include <time.h>     // For clock_gettime()
+
+#define DISK_KEY(major, minor) (((major) << 20) | (minor)) // Same packing as the kernel's dev_t
+
+// One line of /proc/diskstats as mapped by the last rebuild
+typedef struct {
+    unsigned long key;        // DISK_KEY(major, minor), all the fast path compares
+    char name[DISK_NAME_LEN];
+    unsigned char partition;
+    unsigned char fresh;      // Appeared in the last rebuild: no previous snapshot yet
+} DiskLine;
+
+struct DiskSampler {
+    ProcFile file;             // /proc/diskstats
+    int lines;                 // Lines in the map
+    DiskLine *line;
+    DiskStats *stats[2];       // Snapshots indexed like line; stats[cur] is the latest
+    int cur;
+    struct timespec when[2];   // CLOCK_MONOTONIC time of each snapshot
+    unsigned long rebuilds;
+};
+
+// A whole disk has a /sys/block entry, a partition does not; without sysfs
+// everything counts as a whole disk
+static int is_partition(const char *name) {
+    char rel[64 + DISK_NAME_LEN], path[PROC_PATH_MAX];
+    struct stat st;
+    if (stat(proc_path("/sys/block", path), &st) < 0)
+        return 0;
+    int len = snprintf(rel, sizeof(rel), "/sys/block/%s", name);
+    for (int i = 11; i < len; i++) // sysfs spells "cciss/c0d0" as "cciss!c0d0"
+        if (rel[i] == '/')
+            rel[i] = '!';
+    return stat(proc_path(rel, path), &st) < 0;
+}
+
+// Fast path: counters of every line into out, checking each line's
+// major:minor against the map. Returns 1 if the device list changed
+static int parse_disk_lines(const DiskSampler *s, DiskStats *out) {
+    const char *p = s->file.buf;
+    int line = 0;
+    while (*p) {
+        unsigned long major = scan_ulong(&p);
+        unsigned long minor = scan_ulong(&p);
+        if (line >= s->lines || s->line[line].key != DISK_KEY(major, minor))
+            return 1;
+        p = skip_blanks(p);
+        while (*p && *p != ' ' && *p != '\n') // Device name
+            p++;
+        DiskStats *d = &out[line];
+        d->reads = scan_ulong(&p);
+        d->read_merges = scan_ulong(&p);
+        d->read_sectors = scan_ulong(&p);
+        d->read_ms = scan_ulong(&p);
+        d->writes = scan_ulong(&p);
+        d->write_merges = scan_ulong(&p);
+        d->write_sectors = scan_ulong(&p);
+        d->write_ms = scan_ulong(&p);
+        d->in_flight = scan_ulong(&p);
+        d->io_ms = scan_ulong(&p);
+        d->weighted_ms = scan_ulong(&p);
+        p = next_line(p); // Discard and flush fields, if any
+        line++;
+    }
+    return line == s->lines ? 0 : 1;
+}
+
+// Slow path: map every line to a device by name. Devices found in the old
+// map keep their latest snapshot; new ones are marked fresh
+static int build_disk_map(DiskSampler *s) {
+    int n = 0;
+    for (const char *p = s->file.buf; *p; p = next_line(p))
+        n++;
+    DiskLine *line = calloc((size_t)n + 1, sizeof(*line));
+    DiskStats *stats0 = calloc((size_t)n + 1, sizeof(DiskStats));
+    DiskStats *stats1 = calloc((size_t)n + 1, sizeof(DiskStats));
+    if (line == NULL || stats0 == NULL || stats1 == NULL) {
+        free(line);
+        free(stats0);
+        free(stats1);
+        return -1;
+    }
+    DiskStats *latest = s->cur ? stats1 : stats0;
+
+    const char *p = s->file.buf;
+    for (int i = 0; i < n; i++, p = next_line(p)) {
+        unsigned long major = scan_ulong(&p);
+        unsigned long minor = scan_ulong(&p);
+        p = skip_blanks(p);
+        size_t len = 0;
+        while (p[len] && p[len] != ' ' && p[len] != '\n')
+            len++;
+        if (len >= DISK_NAME_LEN)
+            len = DISK_NAME_LEN - 1;
+        DiskLine *l = &line[i];
+        l->key = DISK_KEY(major, minor);
+        memcpy(l->name, p, len);
+        l->name[len] = '\0';
+        l->partition = (unsigned char)is_partition(l->name);
+        l->fresh = 1;
+        for (int j = 0; j < s->lines; j++) {
+            if (strcmp(s->line[j].name, l->name) == 0) {
+                latest[i] = s->stats[s->cur][j];
+                l->fresh = 0;
+                break;
+            }
+        }
+    }
+
+    free(s->line);
+    free(s->stats[0]);
+    free(s->stats[1]);
+    s->line = line;
+    s->stats[0] = stats0;
+    s->stats[1] = stats1;
+    s->lines = n;
+    s->rebuilds++;
+    return 0;
+}
+
+void calculate_disk_rates(const DiskStats *prev, const DiskStats *curr, double seconds, DiskDevice *dev) {
+    dev->read_iops = dev->write_iops = 0.0;
+    dev->read_mbps = dev->write_mbps = 0.0;
+    dev->read_await_ms = dev->write_await_ms = dev->await_ms = 0.0;
+    dev->queue = dev->util = 0.0;
+    if (seconds <= 0.0)
+        return;
+
+    // An I/O or sector count that went back belongs to a device re-created
+    // since prev: a replug matched by name, or a new device given the same
+    // major:minor. Its counters restarted from 0, so the interval has no rates.
+    if (curr->reads < prev->reads || curr->writes < prev->writes ||
+        curr->read_sectors < prev->read_sectors || curr->write_sectors < prev->write_sectors)
+        return;
+
+    // The kernel prints the four time fields as 32-bit values (%u), so they
+    // wrap at 2^32 and their deltas are taken modulo 2^32; at a queue depth
+    // of 32, weighted_ms wraps about every day and a half.
+    unsigned long reads = curr->reads - prev->reads;
+    unsigned long writes = curr->writes - prev->writes;
+    uint32_t read_ms = (uint32_t)(curr->read_ms - prev->read_ms);
+    uint32_t write_ms = (uint32_t)(curr->write_ms - prev->write_ms);
+    uint32_t io_ms = (uint32_t)(curr->io_ms - prev->io_ms);
+    uint32_t weighted_ms = (uint32_t)(curr->weighted_ms - prev->weighted_ms);
+    double elapsed_ms = seconds * 1000.0;
+
+    dev->read_iops = (double)reads / seconds;
+    dev->write_iops = (double)writes / seconds;
+    dev->read_mbps = (double)(curr->read_sectors - prev->read_sectors) * DISK_SECTOR_BYTES / 1e6 / seconds;
+    dev->write_mbps = (double)(curr->write_sectors - prev->write_sectors) * DISK_SECTOR_BYTES / 1e6 / seconds;
+    if (reads)
+        dev->read_await_ms = (double)read_ms / (double)reads;
+    if (writes)
+        dev->write_await_ms = (double)write_ms / (double)writes;
+    if (reads + writes)
+        dev->await_ms = ((double)read_ms + (double)write_ms) / (double)(reads + writes);
+    dev->queue = (double)weighted_ms / elapsed_ms;
+    dev->util = (double)io_ms * 100.0 / elapsed_ms;
+    if (dev->util > 100.0) // io_ms advances in jiffies, so a short interval can overshoot
+        dev->util = 100.0;
+}
+
+DiskSampler *create_disk_sampler(void) {
+    char path[PROC_PATH_MAX];
+    DiskSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    if (open_proc_file(&s->file, proc_path("/proc/diskstats", path), 0) < 0 ||
+        read_proc_file(&s->file) < 0 || build_disk_map(s) < 0 ||
+        parse_disk_lines(s, s->stats[s->cur]) != 0) {
+        destroy_disk_sampler(s);
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &s->when[s->cur]);
+    return s;
+}
+
+int sample_disk_info(DiskSampler *s, DiskInfo *info) {
+    if (read_proc_file(&s->file) < 0)
+        return -1;
+    int next = !s->cur;
+    clock_gettime(CLOCK_MONOTONIC, &s->when[next]);
+    if (parse_disk_lines(s, s->stats[next]) != 0) {
+        // A device came or went: map again, keeping the history of the others
+        if (build_disk_map(s) < 0 || parse_disk_lines(s, s->stats[next]) != 0)
+            return -1;
+        for (int i = 0; i < s->lines; i++)
+            if (s->line[i].fresh)
+                s->stats[s->cur][i] = s->stats[next][i];
+    }
+
+    const DiskStats *prev = s->stats[s->cur], *curr = s->stats[next];
+    double seconds = (double)(s->when[next].tv_sec - s->when[s->cur].tv_sec) +
+                     (double)(s->when[next].tv_nsec - s->when[s->cur].tv_nsec) / 1e9;
+    info->interval = seconds;
+    info->total = s->lines;
+    info->count = 0;
+    // Whole disks first, then partitions, each in file order
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < s->lines && info->count < DISK_MAX_DEVICES; i++) {
+            if (s->line[i].partition != pass)
+                continue;
+            DiskDevice *dev = &info->dev[info->count++];
+            memcpy(dev->name, s->line[i].name, DISK_NAME_LEN);
+            dev->partition = pass;
+            dev->ios = curr[i].reads + curr[i].writes;
+            dev->in_flight = curr[i].in_flight;
+            calculate_disk_rates(&prev[i], &curr[i], seconds, dev);
+        }
+    }
+    s->cur = next;
+    return 0;
+}
+
+unsigned long disk_map_rebuilds(const DiskSampler *s) {
+    return s->rebuilds;
+}
+
+void destroy_disk_sampler(DiskSampler *s) {
+    if (s == NULL)
+        return;
+    close_proc_file(&s->file);
+    free(s->line);
+    free(s->stats[0]);
+    free(s->stats[1]);
+    free(s);
+}
@@ -0,0 +1,119 @@
+/**
+ * @file diskinfo_manip.h
+ * @brief Block device throughput, latency and utilization from /proc/diskstats.
+ *
+ * Works like the CPU sampler: raw DiskStats counters are read through a
+ * persistent /proc/diskstats descriptor and calculate_disk_rates() turns two
+ * snapshots into per-device IOPS, MB/s, average latency and utilization.
+ *
+ * The file is parsed in one pass. The first read maps each line to a device
+ * slot by name; later reads only compare the major:minor numbers of each line
+ * with the cached map, so no device name is compared until a device appears
+ * or disappears (then the map is rebuilt and devices that stayed keep their
+ * history).
+ */
+
+#ifndef DISKINFO_MANIP_H
+#define DISKINFO_MANIP_H
+
+#include "procfile.h" // For the persistent /proc/diskstats reader
+
+#define DISK_NAME_LEN 32     // Longest device name kept, e.g. "nvme0n1p12"
+#define DISK_MAX_DEVICES 32  // Devices reported per sample (whole disks first)
+#define DISK_SECTOR_BYTES 512 // /proc/diskstats counts 512-byte sectors whatever the device
+
+/**
+ * @brief Raw counters of one /proc/diskstats line (fields 4 to 14).
+ *
+ * Times are in milliseconds. An I/O or sector counter only goes back when
+ * the device is re-created, so calculate_disk_rates() reads that as a reset.
+ * The kernel prints the four time fields (read_ms, write_ms, io_ms,
+ * weighted_ms) as 32-bit values, so their deltas are taken modulo 2^32 on
+ * every system.
+ */
+typedef struct {
+    unsigned long reads;         /**< Reads completed. */
+    unsigned long read_merges;   /**< Adjacent reads merged into one request. */
+    unsigned long read_sectors;  /**< Sectors read. */
+    unsigned long read_ms;       /**< Time spent by all reads, from queueing to completion. */
+    unsigned long writes;        /**< Writes completed. */
+    unsigned long write_merges;  /**< Adjacent writes merged into one request. */
+    unsigned long write_sectors; /**< Sectors written. */
+    unsigned long write_ms;      /**< Time spent by all writes. */
+    unsigned long in_flight;     /**< Requests in flight now (not a counter). */
+    unsigned long io_ms;         /**< Time with at least one request in flight. */
+    unsigned long weighted_ms;   /**< Time in flight summed over requests (queue depth x time). */
+} DiskStats;
+
+/**
+ * @brief Rates of one device over the last interval.
+ */
+typedef struct {
+    char name[DISK_NAME_LEN];  /**< Kernel name, e.g. "mmcblk0" or "sda1". */
+    int partition;             /**< 1 for a partition, 0 for a whole disk (no /sys/block entry vs one). */
+    unsigned long ios;         /**< Reads plus writes completed since boot. */
+    double read_iops;          /**< Reads completed per second. */
+    double write_iops;         /**< Writes completed per second. */
+    double read_mbps;          /**< MB (10^6 bytes) read per second. */
+    double write_mbps;         /**< MB written per second. */
+    double read_await_ms;      /**< Average time of a read, 0 without reads. */
+    double write_await_ms;     /**< Average time of a write, 0 without writes. */
+    double await_ms;           /**< Average time of any request, 0 without requests. */
+    double queue;              /**< Average requests in flight. */
+    double util;               /**< Percentage of the interval with a request in flight. */
+    unsigned long in_flight;   /**< Requests in flight at the sample. */
+} DiskDevice;
+
+/**
+ * @brief Every device of one sample.
+ */
+typedef struct {
+    int count;                         /**< Devices in dev (at most DISK_MAX_DEVICES). */
+    int total;                         /**< Lines of /proc/diskstats. */
+    double interval;                   /**< Seconds between the two snapshots behind the rates. */
+    DiskDevice dev[DISK_MAX_DEVICES];  /**< Whole disks in file order, then partitions. */
+} DiskInfo;
+
+/**
+ * @brief Opaque sampler: the open file, the line-to-device map and two snapshots.
+ */
+typedef struct DiskSampler DiskSampler;
+
+/**
+ * @brief Opens /proc/diskstats, maps its devices and takes the first
+ * snapshot, so the next sample_disk_info() already returns rates.
+ *
+ * @return DiskSampler* The sampler, or NULL on failure (errno is set).
+ */
+DiskSampler *create_disk_sampler(void);
+
+/**
+ * @brief Re-reads /proc/diskstats and fills the rates since the previous call.
+ *
+ * A device that just appeared reports 0 until its second sample.
+ *
+ * @return int 0 on success, -1 if the file could not be read or parsed.
+ */
+int sample_disk_info(DiskSampler *sampler, DiskInfo *info);
+
+/**
+ * @brief Rates of one device from two snapshots taken seconds apart.
+ *
+ * Only the rate members of dev are written. Everything is 0 if seconds is
+ * not positive, or if a read, write or sector count is lower in curr than in
+ * prev: the device was re-created in between (a USB disk replugged, a loop
+ * device set up again) and its counters restarted from 0.
+ */
+void calculate_disk_rates(const DiskStats *prev, const DiskStats *curr, double seconds, DiskDevice *dev);
+
+/**
+ * @brief Times the line-to-device map was built, 1 after create_disk_sampler().
+ */
+unsigned long disk_map_rebuilds(const DiskSampler *sampler);
+
+/**
+ * @brief Closes the file and frees the sampler. Accepts NULL.
+ */
+void destroy_disk_sampler(DiskSampler *sampler);
+
+#endif // DISKINFO_MANIP_H
@@ -0,0 +1,690 @@
+/**
+ * @file exporter.c
+ * @brief Implementation of the Prometheus exporter: pre-rendered responses
+ * and the HTTP server thread.
+ */
+
+#define _GNU_SOURCE      // For memmem(), accept4()
+#include "exporter.h"
+#include <errno.h>       // For errno
+#include <netdb.h>       // For getaddrinfo()
+#include <netinet/in.h>  // For struct sockaddr_in6
+#include <poll.h>        // For poll()
+#include <pthread.h>     // For the server thread
+#include <stdatomic.h>   // For the published buffer and its references
+#include <stddef.h>      // For offsetof()
+#include <stdint.h>      // For uint64_t
+#include <stdio.h>       // For snprintf()
+#include <stdlib.h>      // For calloc(), free()
+#include <string.h>      // For memcpy(), memmem()
+#include <strings.h>     // For strncasecmp()
+#include <sys/eventfd.h> // For the stop descriptor
+#include <sys/socket.h>  // For socket(), accept4(), send()
+#include <sys/stat.h>    // For lstat()
+#include <sys/un.h>      // For struct sockaddr_un
+#include <time.h>        // For clock_gettime()
+#include <unistd.h>      // For close(), unlink()
+
+#define EXPORTER_HEADER_MAX 160   // Room in front of the body for the status line and headers
+#define EXPORTER_FIXED_LEN 4096   // Body text outside the per-CPU lines
+#define EXPORTER_CPU_LEN 64       // One per-CPU line: name, label and "1.0000\n"
+#define EXPORTER_WINDOW_LEN 96   // One window line: name, three labels and "1.0000\n"
+#define EXPORTER_REQUEST_MAX 2048 // Request head kept per connection
+#define EXPORTER_BACKLOG 64
+#define THREAD_METRIC "resource_mon_cpu_thread_usage_ratio"
+#define WINDOW_METRIC "resource_mon_cpu_usage_window_ratio"
+
+// Memory gauges, in body order
+static const struct {
+    const char *name;
+    const char *help;
+    size_t offset;
+} mem_metrics[] = {
+    { "resource_mon_memory_total_bytes", "Usable RAM (MemTotal).", offsetof(MemInfo, mem_total) },
+    { "resource_mon_memory_available_bytes", "RAM available without swapping (MemAvailable).",
+      offsetof(MemInfo, mem_available) },
+    { "resource_mon_memory_free_bytes", "Unused RAM (MemFree).", offsetof(MemInfo, mem_free) },
+    { "resource_mon_memory_buffers_bytes", "Block device cache (Buffers).", offsetof(MemInfo, buffers) },
+    { "resource_mon_memory_cached_bytes", "Page cache (Cached).", offsetof(MemInfo, cached) },
+    { "resource_mon_swap_total_bytes", "Swap space (SwapTotal).", offsetof(MemInfo, swap_total) },
+    { "resource_mon_swap_free_bytes", "Unused swap space (SwapFree).", offsetof(MemInfo, swap_free) },
+};
+
+// Responses that do not depend on the sample
+static const char response_400[] = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char response_404[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 24\r\n\r\nOnly /metrics is served\n";
+static const char response_405[] = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\n\r\n";
+static const char response_431[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char response_503[] =
+    "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n";
+
+// One half of the double buffer
+typedef struct {
+    char *data;        // EXPORTER_HEADER_MAX bytes for the headers, then the body
+    size_t start, len; // The response is len bytes from data + start
+    atomic_int refs;   // Scrapes still sending it
+} ResponseBuffer;
+
+// One connection
+typedef struct {
+    int fd;              // -1 for a free slot
+    int close_after;     // Close once the current response is sent
+    size_t req_len;      // Bytes received and not yet answered
+    const char *out;     // Response being sent, NULL if none
+    size_t out_len, out_off;
+    int out_buf;         // Buffer whose reference is held, -1 for a fixed response
+    long long active_ns; // Last activity, to pick a connection to evict
+    char req[EXPORTER_REQUEST_MAX];
+} Client;
+
+struct Exporter {
+    int listen_fd;
+    int stop_fd;                 // eventfd written by destroy_exporter()
+    int num_cpus;
+    char unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)]; // Empty for TCP
+    ResponseBuffer buf[2];
+    atomic_int front;            // Published buffer, -1 before the first sample
+    char *cpu_prefix;            // THREAD_METRIC{cpu="N"} for every CPU, EXPORTER_CPU_LEN apart
+    unsigned char *cpu_prefix_len;
+    size_t cap;                  // Size of each response buffer
+    const WindowStats *stats;    // Window statistics to render, NULL for none
+    Client clients[EXPORTER_MAX_CLIENTS];
+    pthread_t thread;
+    int running;                 // 1 while the thread is joinable
+    atomic_ulong renders, busy, scrapes, errors;
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ------------------ Rendering ------------------ */
+
+static char *put_str(char *p, const char *s) {
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static char *put_u64(char *p, unsigned long long v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0)
+        *p++ = tmp[--n];
+    return p;
+}
+
+// v / 10^decimals with every decimal, e.g. (1234, 4) as "0.1234"
+static char *put_fixed(char *p, unsigned long long v, int decimals) {
+    unsigned long long scale = 1;
+    for (int i = 0; i < decimals; i++)
+        scale *= 10;
+    p = put_u64(p, v / scale);
+    *p++ = '.';
+    unsigned long long rest = v % scale;
+    for (int i = decimals; i > 0; i--) {
+        p[i - 1] = (char)('0' + rest % 10);
+        rest /= 10;
+    }
+    return p + decimals;
+}
+
+// Percentage as a ratio with four decimals, clamped to 0..1
+static char *put_ratio(char *p, double percent) {
+    unsigned long long v = !(percent > 0.0) ? 0 : percent >= 100.0 ? 10000 : (unsigned long long)(percent * 100.0 + 0.5);
+    return put_fixed(p, v, 4);
+}
+
+// "# HELP name help\n# TYPE name type\n"
+static char *put_family(char *p, const char *name, const char *type, const char *help) {
+    p = put_str(p, "# HELP ");
+    p = put_str(p, name);
+    *p++ = ' ';
+    p = put_str(p, help);
+    p = put_str(p, "\n# TYPE ");
+    p = put_str(p, name);
+    *p++ = ' ';
+    p = put_str(p, type);
+    *p++ = '\n';
+    return p;
+}
+
+// "name value\n" for an integer
+static char *put_sample_u64(char *p, const char *name, unsigned long long v) {
+    p = put_str(p, name);
+    *p++ = ' ';
+    p = put_u64(p, v);
+    *p++ = '\n';
+    return p;
+}
+
+// One line per CPU ("all" for the total), window and figure
+static char *render_windows(const Exporter *e, char *p) {
+    int series = window_stats_series(e->stats);
+    if (series > WINSTATS_SERIES(e->num_cpus))
+        series = WINSTATS_SERIES(e->num_cpus);
+    p = put_family(p, WINDOW_METRIC, "gauge",
+                   "Usage over the last 1, 5 and 15 minutes: min, mean, p95 and p99 of one-second means, and max.");
+    for (int s = 0; s < series; s++) {
+        for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+            WindowSummary summary;
+            get_window_summary(e->stats, s, w, &summary);
+            for (int f = 0; f < WINSTATS_FIGURES; f++) {
+                p = put_str(p, WINDOW_METRIC "{cpu=\"");
+                if (s == WINSTATS_CPU)
+                    p = put_str(p, "all");
+                else
+                    p = put_u64(p, (unsigned long long)(s - WINSTATS_THREADS));
+                p = put_str(p, "\",window=\"");
+                p = put_str(p, window_name(w));
+                p = put_str(p, "\",stat=\"");
+                p = put_str(p, window_figure_name(f));
+                p = put_str(p, "\"} ");
+                p = put_ratio(p, window_figure(&summary, f));
+                *p++ = '\n';
+            }
+        }
+    }
+    return p;
+}
+
+// Body in the Prometheus text format (version 0.0.4); returns its end
+static char *render_body(const Exporter *e, char *p, const Sample *s) {
+    p = put_family(p, "resource_mon_cpu_usage_ratio", "gauge", "Share of the last interval the CPUs were busy.");
+    p = put_str(p, "resource_mon_cpu_usage_ratio ");
+    p = put_ratio(p, s->cpu.usage);
+    *p++ = '\n';
+
+    p = put_family(p, THREAD_METRIC, "gauge", "Share of the last interval each CPU was busy.");
+    int cpus = s->cpu.num_cpus < e->num_cpus ? s->cpu.num_cpus : e->num_cpus;
+    for (int i = 0; i < cpus; i++) {
+        memcpy(p, e->cpu_prefix + (size_t)i * EXPORTER_CPU_LEN, e->cpu_prefix_len[i]);
+        p += e->cpu_prefix_len[i];
+        p = put_ratio(p, s->cpu.thread_usage[i]);
+        *p++ = '\n';
+    }
+    if (e->stats != NULL)
+        p = render_windows(e, p);
+
+    for (size_t i = 0; i < sizeof(mem_metrics) / sizeof(mem_metrics[0]); i++) {
+        unsigned long kb = *(const unsigned long *)((const char *)&s->mem + mem_metrics[i].offset);
+        p = put_family(p, mem_metrics[i].name, "gauge", mem_metrics[i].help);
+        p = put_sample_u64(p, mem_metrics[i].name, (unsigned long long)kb * 1024ULL);
+    }
+
+    p = put_family(p, "resource_mon_sample_interval_seconds", "gauge", "Measured time between the last two samples.");
+    p = put_str(p, "resource_mon_sample_interval_seconds ");
+    p = put_fixed(p, s->interval > 0.0 ? (unsigned long long)(s->interval * 1e6 + 0.5) : 0, 6);
+    *p++ = '\n';
+    p = put_family(p, "resource_mon_sample_jitter_seconds", "gauge", "Wake-up delay of the last sample.");
+    p = put_str(p, "resource_mon_sample_jitter_seconds ");
+    p = put_fixed(p, s->jitter_ns > 0 ? (unsigned long long)s->jitter_ns : 0, 9);
+    *p++ = '\n';
+    p = put_family(p, "resource_mon_sample_timestamp_seconds", "gauge", "Wall-clock time of the last sample.");
+    p = put_str(p, "resource_mon_sample_timestamp_seconds ");
+    p = put_fixed(p, (unsigned long long)s->wallclock.tv_sec * 1000ULL + (unsigned long long)s->wallclock.tv_nsec / 1000000ULL, 3);
+    *p++ = '\n';
+    p = put_family(p, "resource_mon_samples_total", "counter", "Samples taken.");
+    p = put_sample_u64(p, "resource_mon_samples_total", s->seq);
+    p = put_family(p, "resource_mon_samples_dropped_total", "counter", "Samples lost to a full sample ring.");
+    p = put_sample_u64(p, "resource_mon_samples_dropped_total", s->dropped);
+    return p;
+}
+
+// Body after the reserved room, then the headers right in front of it
+static void render_response(const Exporter *e, ResponseBuffer *b, const Sample *s) {
+    char *body = b->data + EXPORTER_HEADER_MAX;
+    size_t body_len = (size_t)(render_body(e, body, s) - body);
+    char head[EXPORTER_HEADER_MAX];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                            "Content-Length: %zu\r\n\r\n", body_len);
+    b->start = EXPORTER_HEADER_MAX - (size_t)head_len;
+    memcpy(b->data + b->start, head, (size_t)head_len);
+    b->len = (size_t)head_len + body_len;
+}
+
+void exporter_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters) {
+    (void)counters;
+    Exporter *e = ctx;
+    int back = atomic_load(&e->front) == 0 ? 1 : 0;
+    ResponseBuffer *b = &e->buf[back];
+    // A scrape that took a reference before the previous publish may still be sending it
+    if (atomic_load(&b->refs) > 0) {
+        atomic_fetch_add_explicit(&e->busy, 1, memory_order_relaxed);
+        return;
+    }
+    render_response(e, b, sample);
+    atomic_store(&e->front, back);
+    atomic_fetch_add_explicit(&e->renders, 1, memory_order_relaxed);
+}
+
+/*
+ * Reference the published buffer. The count is raised before front is
+ * checked again, so the sink either sees the reference or has already
+ * published the other half, which makes this retry.
+ */
+static int acquire_front(Exporter *e) {
+    for (;;) {
+        int i = atomic_load(&e->front);
+        if (i < 0)
+            return -1;
+        atomic_fetch_add(&e->buf[i].refs, 1);
+        if (atomic_load(&e->front) == i)
+            return i;
+        atomic_fetch_sub(&e->buf[i].refs, 1);
+    }
+}
+
+/* ------------------ Connections ------------------ */
+
+static void drop_client(Exporter *e, Client *c) {
+    if (c->out_buf >= 0)
+        atomic_fetch_sub(&e->buf[c->out_buf].refs, 1);
+    close(c->fd);
+    c->fd = -1;
+    c->out = NULL;
+    c->out_buf = -1;
+}
+
+// Send what is left of the current response: 1 when done, 0 if the socket is full, -1 if dropped
+static int send_response(Exporter *e, Client *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t sent = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            drop_client(e, c);
+            return -1;
+        }
+        c->out_off += (size_t)sent;
+    }
+    if (c->out_buf >= 0) {
+        atomic_fetch_sub(&e->buf[c->out_buf].refs, 1);
+        atomic_fetch_add_explicit(&e->scrapes, 1, memory_order_relaxed);
+    }
+    c->out = NULL;
+    c->out_buf = -1;
+    if (c->close_after) {
+        drop_client(e, c);
+        return -1;
+    }
+    return 1;
+}
+
+static void start_fixed_response(Exporter *e, Client *c, const char *text, size_t len) {
+    c->out = text;
+    c->out_len = len;
+    c->out_off = 0;
+    c->out_buf = -1;
+    atomic_fetch_add_explicit(&e->errors, 1, memory_order_relaxed);
+}
+
+// True if the head has a header name: ... with token in its value (case-insensitive)
+static int has_header_token(const char *head, size_t len, const char *name, const char *token) {
+    size_t name_len = strlen(name), token_len = strlen(token);
+    for (const char *p = head; p < head + len;) {
+        const char *eol = memmem(p, (size_t)(head + len - p), "\r\n", 2);
+        if (eol == NULL)
+            eol = head + len;
+        if ((size_t)(eol - p) > name_len && strncasecmp(p, name, name_len) == 0) {
+            for (const char *v = p + name_len; v + token_len <= eol; v++)
+                if (strncasecmp(v, token, token_len) == 0)
+                    return 1;
+        }
+        p = eol + 2;
+    }
+    return 0;
+}
+
+// Choose the response to the request head[0..len) (ending before its blank line)
+static void start_response(Exporter *e, Client *c, const char *head, size_t len) {
+    const char *line_end = memmem(head, len, "\r\n", 2);
+    size_t line_len = line_end != NULL ? (size_t)(line_end - head) : len;
+    const char *path = memchr(head, ' ', line_len);
+    const char *path_end = path != NULL ? memchr(path + 1, ' ', line_len - (size_t)(path + 1 - head)) : NULL;
+    if (path_end == NULL) {
+        c->close_after = 1;
+        start_fixed_response(e, c, response_400, sizeof(response_400) - 1);
+        return;
+    }
+    // HTTP/1.0 closes unless asked to keep alive; HTTP/1.1 keeps alive unless asked to close
+    if (strncmp(path_end, " HTTP/1.0", 9) == 0)
+        c->close_after = !has_header_token(head, len, "Connection:", "keep-alive");
+    else
+        c->close_after = has_header_token(head, len, "Connection:", "close");
+
+    path++;
+    size_t path_len = (size_t)(path_end - path);
+    const char *query = memchr(path, '?', path_len);
+    if (query != NULL)
+        path_len = (size_t)(query - path);
+    if (path - head != 4 || strncmp(head, "GET ", 4) != 0) {
+        start_fixed_response(e, c, response_405, sizeof(response_405) - 1);
+    } else if (path_len != 8 || strncmp(path, "/metrics", 8) != 0) {
+        start_fixed_response(e, c, response_404, sizeof(response_404) - 1);
+    } else {
+        int i = acquire_front(e);
+        if (i < 0) {
+            start_fixed_response(e, c, response_503, sizeof(response_503) - 1);
+        } else {
+            c->out = e->buf[i].data + e->buf[i].start; // Sent as rendered
+            c->out_len = e->buf[i].len;
+            c->out_off = 0;
+            c->out_buf = i;
+        }
+    }
+}
+
+// Answer every complete request received, in order, until one cannot be sent at once
+static void serve_requests(Exporter *e, Client *c) {
+    while (c->fd >= 0 && c->out == NULL) {
+        char *end = memmem(c->req, c->req_len, "\r\n\r\n", 4);
+        if (end == NULL) {
+            if (c->req_len == sizeof(c->req)) {
+                c->close_after = 1;
+                start_fixed_response(e, c, response_431, sizeof(response_431) - 1);
+                c->req_len = 0;
+                send_response(e, c);
+            }
+            return;
+        }
+        size_t used = (size_t)(end + 4 - c->req);
+        start_response(e, c, c->req, (size_t)(end - c->req));
+        memmove(c->req, c->req + used, c->req_len - used); // Pipelined requests stay queued
+        c->req_len -= used;
+        if (send_response(e, c) <= 0)
+            return;
+    }
+}
+
+static void serve_client(Exporter *e, Client *c, short revents) {
+    c->active_ns = now_ns();
+    if (revents & (POLLERR | POLLNVAL)) {
+        drop_client(e, c);
+        return;
+    }
+    if (c->out != NULL) {
+        if (send_response(e, c) > 0)
+            serve_requests(e, c);
+        return;
+    }
+    ssize_t got = recv(c->fd, c->req + c->req_len, sizeof(c->req) - c->req_len, 0);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        drop_client(e, c);
+        return;
+    }
+    if (got > 0) {
+        c->req_len += (size_t)got;
+        serve_requests(e, c);
+    }
+}
+
+// A free slot, or the least recently active connection that is not sending
+static Client *claim_client(Exporter *e) {
+    Client *idle = NULL;
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+        Client *c = &e->clients[i];
+        if (c->fd < 0)
+            return c;
+        if (c->out == NULL && (idle == NULL || c->active_ns < idle->active_ns))
+            idle = c;
+    }
+    if (idle != NULL)
+        drop_client(e, idle);
+    return idle;
+}
+
+static void accept_clients(Exporter *e) {
+    for (;;) {
+        int fd = accept4(e->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return; // EAGAIN, or out of descriptors until a connection closes
+        Client *c = claim_client(e);
+        if (c == NULL) {
+            close(fd);
+            atomic_fetch_add_explicit(&e->errors, 1, memory_order_relaxed);
+            continue;
+        }
+        c->fd = fd;
+        c->close_after = 0;
+        c->req_len = 0;
+        c->out = NULL;
+        c->out_buf = -1;
+        c->active_ns = now_ns();
+    }
+}
+
+static void *exporter_main(void *arg) {
+    Exporter *e = arg;
+    struct pollfd fds[2 + EXPORTER_MAX_CLIENTS];
+    int slot[2 + EXPORTER_MAX_CLIENTS];
+
+    for (;;) {
+        int n = 0;
+        fds[n++] = (struct pollfd){ .fd = e->stop_fd, .events = POLLIN };
+        fds[n++] = (struct pollfd){ .fd = e->listen_fd, .events = POLLIN };
+        for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+            const Client *c = &e->clients[i];
+            if (c->fd < 0)
+                continue;
+            slot[n] = i;
+            fds[n++] = (struct pollfd){ .fd = c->fd, .events = c->out != NULL ? POLLOUT : POLLIN };
+        }
+        if (poll(fds, (nfds_t)n, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[0].revents & POLLIN)
+            break;
+        for (int k = 2; k < n; k++)
+            if (fds[k].revents != 0)
+                serve_client(e, &e->clients[slot[k]], fds[k].revents);
+        if (fds[1].revents & POLLIN)
+            accept_clients(e);
+    }
+    return NULL;
+}
+
+/* ------------------ Listening socket ------------------ */
+
+static int listen_unix(Exporter *e, const char *path) {
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(sa.sun_path, path);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path); // Left behind by a previous run
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, EXPORTER_BACKLOG) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    strcpy(e->unix_path, path);
+    return fd;
+}
+
+// "PORT", ":PORT", "HOST:PORT" or "[V6]:PORT"
+static int listen_tcp(const char *addr) {
+    char host[256];
+    const char *port = addr;
+    const char *colon = strrchr(addr, ':');
+    host[0] = '\0';
+    if (colon != NULL) {
+        size_t len = (size_t)(colon - addr);
+        if (len >= 2 && addr[0] == '[' && addr[len - 1] == ']') {
+            addr++;
+            len -= 2;
+        }
+        if (len >= sizeof(host)) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(host, addr, len);
+        host[len] = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM,
+                              .ai_flags = AI_PASSIVE | AI_NUMERICSERV };
+    struct addrinfo *list;
+    if (*port == '\0' || getaddrinfo(host[0] ? host : NULL, port, &hints, &list) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = -1, saved = EADDRNOTAVAIL;
+    for (struct addrinfo *ai = list; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            saved = errno;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)); // Restart while old connections linger
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, EXPORTER_BACKLOG) < 0) {
+            saved = errno;
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    if (fd < 0)
+        errno = saved;
+    return fd;
+}
+
+/* ------------------ Lifecycle ------------------ */
+
+Exporter *create_exporter(const char *addr, int num_cpus) {
+    if (num_cpus <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    Exporter *e = calloc(1, sizeof(*e));
+    if (e == NULL)
+        return NULL;
+    e->listen_fd = -1;
+    e->num_cpus = num_cpus;
+    atomic_init(&e->front, -1);
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+        e->clients[i].fd = -1;
+        e->clients[i].out_buf = -1;
+    }
+
+    e->cap = EXPORTER_HEADER_MAX + EXPORTER_FIXED_LEN + (size_t)num_cpus * EXPORTER_CPU_LEN;
+    e->buf[0].data = malloc(e->cap);
+    e->buf[1].data = malloc(e->cap);
+    e->cpu_prefix = malloc((size_t)num_cpus * EXPORTER_CPU_LEN);
+    e->cpu_prefix_len = malloc((size_t)num_cpus);
+    e->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (e->buf[0].data == NULL || e->buf[1].data == NULL || e->cpu_prefix == NULL || e->cpu_prefix_len == NULL ||
+        e->stop_fd < 0) {
+        destroy_exporter(e);
+        return NULL;
+    }
+    for (int i = 0; i < num_cpus; i++)
+        e->cpu_prefix_len[i] = (unsigned char)snprintf(e->cpu_prefix + (size_t)i * EXPORTER_CPU_LEN,
+                                                       EXPORTER_CPU_LEN, THREAD_METRIC "{cpu=\"%d\"} ", i);
+
+    e->listen_fd = strchr(addr, '/') != NULL ? listen_unix(e, addr) : listen_tcp(addr);
+    if (e->listen_fd < 0) {
+        int saved = errno;
+        destroy_exporter(e);
+        errno = saved;
+        return NULL;
+    }
+    return e;
+}
+
+int set_exporter_stats(Exporter *e, const WindowStats *stats) {
+    if (e->stats == NULL && stats != NULL) {
+        // Its HELP and TYPE lines take less than two more lines
+        size_t lines = (size_t)WINSTATS_SERIES(e->num_cpus) * WINSTATS_WINDOWS * WINSTATS_FIGURES + 2;
+        size_t cap = e->cap + lines * EXPORTER_WINDOW_LEN;
+        for (int i = 0; i < 2; i++) {
+            char *data = realloc(e->buf[i].data, cap);
+            if (data == NULL)
+                return -1;
+            e->buf[i].data = data;
+        }
+        e->cap = cap;
+    }
+    e->stats = stats;
+    return 0;
+}
+
+int start_exporter(Exporter *e) {
+    if (e->running) {
+        errno = EBUSY;
+        return -1;
+    }
+    int rc = pthread_create(&e->thread, NULL, exporter_main, e);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    e->running = 1;
+    return 0;
+}
+
+int exporter_port(const Exporter *e) {
+    struct sockaddr_storage sa;
+    socklen_t len = sizeof(sa);
+    if (getsockname(e->listen_fd, (struct sockaddr *)&sa, &len) < 0)
+        return 0;
+    if (sa.ss_family == AF_INET)
+        return ntohs(((struct sockaddr_in *)&sa)->sin_port);
+    if (sa.ss_family == AF_INET6)
+        return ntohs(((struct sockaddr_in6 *)&sa)->sin6_port);
+    return 0;
+}
+
+void get_exporter_stats(const Exporter *e, ExporterStats *stats) {
+    stats->renders = atomic_load_explicit(&e->renders, memory_order_relaxed);
+    stats->busy = atomic_load_explicit(&e->busy, memory_order_relaxed);
+    stats->scrapes = atomic_load_explicit(&e->scrapes, memory_order_relaxed);
+    stats->errors = atomic_load_explicit(&e->errors, memory_order_relaxed);
+}
+
+void destroy_exporter(Exporter *e) {
+    if (e == NULL)
+        return;
+    if (e->running) {
+        uint64_t one = 1;
+        ssize_t unused = write(e->stop_fd, &one, sizeof(one)); // Wakes the poll() at once
+        (void)unused;
+        pthread_join(e->thread, NULL);
+    }
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++)
+        if (e->clients[i].fd >= 0)
+            drop_client(e, &e->clients[i]);
+    if (e->listen_fd >= 0)
+        close(e->listen_fd);
+    if (e->unix_path[0] != '\0')
+        unlink(e->unix_path);
+    if (e->stop_fd >= 0)
+        close(e->stop_fd);
+    free(e->buf[0].data);
+    free(e->buf[1].data);
+    free(e->cpu_prefix);
+    free(e->cpu_prefix_len);
+    free(e);
+}
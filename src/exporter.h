@@ -0,0 +1,99 @@
+/**
+ * @file exporter.h
+ * @brief Prometheus text exposition of the latest sample over HTTP, on a TCP
+ * port or a Unix socket.
+ *
+ * The exporter is a collector sink: on the sampling thread it renders the
+ * complete HTTP response (status line, headers and the metrics body) for
+ * every sample into the back half of a double buffer and publishes it. A
+ * server thread of its own answers each scrape by sending the published
+ * response as it is, with one send() on a non-blocking socket, so a scrape
+ * never formats anything and never touches the collector.
+ *
+ * Each half carries a count of the scrapes still sending it. A slow client
+ * can hold the back half; the sample is then not rendered (counted as busy)
+ * rather than making the sampling thread wait.
+ *
+ * With window statistics (set_exporter_stats()), the body also carries the
+ * min, mean, p95, p99 and max of the total and every CPU's usage over the
+ * last 1, 5 and 15 minutes, as resource_mon_cpu_usage_window_ratio with cpu,
+ * window and stat labels.
+ *
+ * Served paths: GET /metrics; anything else gets 404 or 405. Connections are
+ * kept alive (HTTP/1.1) unless the client asks otherwise.
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include "collector.h"
+#include "winstats.h"
+
+#define EXPORTER_MAX_CLIENTS 64 // Connections served at once; the least recently active idle one makes room
+
+/**
+ * @brief Counters of an exporter, for tests and the overhead figures.
+ */
+typedef struct {
+    unsigned long renders; /**< Samples rendered and published. */
+    unsigned long busy;    /**< Samples not rendered: the back half was still being sent. */
+    unsigned long scrapes; /**< Metrics responses sent completely. */
+    unsigned long errors;  /**< Requests answered with an error status or dropped. */
+} ExporterStats;
+
+/**
+ * @brief Opaque exporter: listening socket, response buffers and server thread.
+ */
+typedef struct Exporter Exporter;
+
+/**
+ * @brief Binds and listens on addr.
+ *
+ * @param addr "PORT" or ":PORT" for every address, "HOST:PORT" ("[::1]:PORT"
+ * for IPv6) or a Unix socket path (anything with a '/'). Port 0 picks a free one.
+ * @param num_cpus CPU slots of the samples to render.
+ * @return Exporter* The exporter, or NULL (errno is set).
+ */
+Exporter *create_exporter(const char *addr, int num_cpus);
+
+/**
+ * @brief Renders the window statistics of the total and every CPU with each
+ * sample. Call before start_exporter(); stats must be recorded on the
+ * sampling thread before exporter_sink() runs, e.g. by registering
+ * window_stats_sink() first.
+ *
+ * @return int 0 on success, -1 if out of memory.
+ */
+int set_exporter_stats(Exporter *exporter, const WindowStats *stats);
+
+/**
+ * @brief Starts the server thread. Before the first sample, scrapes get 503.
+ *
+ * @return int 0 on success, -1 on failure (errno is set).
+ */
+int start_exporter(Exporter *exporter);
+
+/**
+ * @brief CollectorSink: renders the sample and publishes it to the next scrapes.
+ *
+ * @param ctx The Exporter.
+ */
+void exporter_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief TCP port the exporter listens on (useful after port 0), 0 for a Unix socket.
+ */
+int exporter_port(const Exporter *exporter);
+
+/**
+ * @brief Copies the counters.
+ */
+void get_exporter_stats(const Exporter *exporter, ExporterStats *stats);
+
+/**
+ * @brief Stops the server thread, closes every connection and the socket
+ * (removing a Unix socket file) and frees the exporter. Accepts NULL.
+ */
+void destroy_exporter(Exporter *exporter);
+
+#endif // EXPORTER_H
@@ -0,0 +1,70 @@
+/**
+ * @file history.c
+ * @brief Implementation of the fixed-capacity sample history.
+ */
+
+#include "history.h"
+#include <stdlib.h> // For calloc(), free()
+
+struct History {
+    int series, capacity;
+    int head;             // Column written by the next push
+    int count;            // Columns held
+    unsigned long pushes; // Columns appended since creation
+    float values[];       // capacity columns of series values
+};
+
+History *create_history(int series, int capacity) {
+    if (series <= 0 || capacity <= 0)
+        return NULL;
+    History *h = calloc(1, sizeof(*h) + (size_t)series * (size_t)capacity * sizeof(float));
+    if (h == NULL)
+        return NULL;
+    h->series = series;
+    h->capacity = capacity;
+    return h;
+}
+
+float *push_history(History *h) {
+    float *column = h->values + (size_t)h->head * (size_t)h->series;
+    h->head = h->head + 1 == h->capacity ? 0 : h->head + 1;
+    if (h->count < h->capacity)
+        h->count++;
+    h->pushes++;
+    return column;
+}
+
+const float *history_column(const History *h, int age) {
+    if (age < 0 || age >= h->count)
+        return NULL;
+    int i = h->head - 1 - age;
+    if (i < 0)
+        i += h->capacity;
+    return h->values + (size_t)i * (size_t)h->series;
+}
+
+int read_history(const History *h, int series, float *out, int n) {
+    if (series < 0 || series >= h->series)
+        return 0;
+    if (n > h->count)
+        n = h->count;
+    for (int k = 0; k < n; k++)
+        out[k] = history_column(h, n - 1 - k)[series];
+    return n;
+}
+
+int history_count(const History *h) {
+    return h->count;
+}
+
+int history_series(const History *h) {
+    return h->series;
+}
+
+unsigned long history_pushes(const History *h) {
+    return h->pushes;
+}
+
+void destroy_history(History *h) {
+    free(h);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file history.h
+ * @brief Fixed-capacity history of recent samples, one column per sample.
+ *
+ * A History holds the last capacity samples of a fixed number of series
+ * (e.g. total CPU, memory and every thread's usage) in one block allocated
+ * up front. Each sample is one column of series floats; appending a column
+ * overwrites the oldest once the store is full, so recording never
+ * allocates. Readers address columns by age, 0 being the newest.
+ *
+ * Not synchronised: the thread that appends is the one that reads.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/**
+ * @brief Opaque history store.
+ */
+typedef struct History History;
+
+/**
+ * @brief Allocates a store for capacity columns of series values each.
+ *
+ * @return History* The empty store, or NULL if series or capacity is not
+ * positive or the allocation failed.
+ */
+History *create_history(int series, int capacity);
+
+/**
+ * @brief Appends a column, dropping the oldest when full, and returns it
+ * for the caller to fill. Its values are those of the dropped column (zeros
+ * until the store first wraps).
+ *
+ * @return float* The new column, series values long.
+ */
+float *push_history(History *history);
+
+/**
+ * @brief Column of the given age, 0 being the newest.
+ *
+ * @return const float* The column, or NULL if age is not below history_count().
+ */
+const float *history_column(const History *history, int age);
+
+/**
+ * @brief Copies the newest values of one series, oldest first.
+ *
+ * @param out Receives up to n values.
+ * @return int Number of values copied: n, or fewer while the store fills.
+ */
+int read_history(const History *history, int series, float *out, int n);
+
+/**
+ * @brief Number of columns held, up to the capacity.
+ */
+int history_count(const History *history);
+
+/**
+ * @brief Number of series per column.
+ */
+int history_series(const History *history);
+
+/**
+ * @brief Columns appended since creation. Consumers that remember it can
+ * tell how many columns are new since they last looked.
+ */
+unsigned long history_pushes(const History *history);
+
+/**
+ * @brief Frees the store. Accepts NULL.
+ */
+void destroy_history(History *history);
+
+#endif // HISTORY_H
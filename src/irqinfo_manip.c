@@ -0,0 +1,477 @@
+/**
+ * @file irqinfo_manip.c
+ * @brief Implementation of the interrupt and softirq sampler.
+ */
+
+#include "irqinfo_manip.h"
+#include <stdint.h> // For uint64_t
+#include <stdlib.h> // For calloc(), malloc(), free()
+#include <stddef.h> // For ptrdiff_t
+#include <string.h> // For memcmp(), memcpy(), strcmp(), strncmp()
+#include <time.h>   // For clock_gettime()
+
+#define IRQ_FIELD_LEN 11 // " %10u"
+
+static const char *const irq_files[IRQ_TABLES] = { "/proc/interrupts", "/proc/softirqs" };
+
+// One data line of a table as seen when the layout was built
+typedef struct {
+    char label[IRQ_LABEL_LEN]; // Text before ':', without the leading blanks
+    int label_len;
+    int row;                   // Row of the matrix, -1 for a line that is not per CPU (ERR, MIS)
+} IrqLine;
+
+typedef struct {
+    ProcFile file;       // fd -1 for a missing file
+    char *header;        // Header line the layout was built from, with its '\n'
+    size_t header_len;
+    int columns;         // CPU columns in the header
+    int fixed;           // 1 if every counter is an IRQ_FIELD_LEN field (scan_fixed_column())
+    int *column_cpu;     // CPU number of each column, -1 for a CPU not reported
+    int lines;           // Data lines in the layout (at most IRQ_MAX_ROWS)
+    int skipped;         // Data lines past IRQ_MAX_ROWS
+    IrqLine line[IRQ_MAX_ROWS];
+    int rows;            // Rows of the matrix
+    char (*name)[IRQ_NAME_LEN];
+    unsigned int *prev;  // rows x num_cpus counters of the previous read
+    unsigned int *curr;  // Same for the read in progress
+    float *rate;         // rows x num_cpus events per second
+    int available;
+} IrqTableState;
+
+struct IrqSampler {
+    int num_cpus;
+    IrqTableState table[IRQ_TABLES];
+    struct timespec when;   // CLOCK_MONOTONIC time of the previous read
+    unsigned long layout_changes;
+    int *top_row;           // num_cpus x IRQ_TOP_SOURCES rows ranked by sample_irq_info()
+};
+
+double calculate_irq_rate(unsigned int prev, unsigned int curr, double seconds) {
+    return seconds > 0.0 ? (double)(unsigned int)(curr - prev) / seconds : 0.0;
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/*
+ * One counter printed as " %10u", the format of every column of both files:
+ * a blank, then ten characters of leading blanks and digits. The last eight
+ * are checked and converted together in a 64-bit word. Returns -1 if the
+ * field is not in that format.
+ */
+static inline int64_t scan_fixed_column(const char *f) {
+    uint64_t x;
+    memcpy(&x, f + 3, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x); // First character in the low byte
+#endif
+    uint64_t lo = x & 0x0F0F0F0F0F0F0F0FULL;
+    uint64_t blank = ((~x & 0x1010101010101010ULL) >> 4) * 0xFF; // 0xFF for each blank
+    if (f[0] != ' ' || ((x & 0xF0F0F0F0F0F0F0F0ULL) | 0x1010101010101010ULL) != 0x3030303030303030ULL ||
+        ((lo + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0 || // A nibble above 9
+        (lo & blank) != 0 ||                                             // Not ' ' but 0x21..0x2F
+        (blank & (blank + 1)) != 0 || (blank >> 56) != 0)                // Blanks after a digit, or no digit
+        return -1;
+    uint64_t high = 0;
+    if (f[2] != ' ') {
+        unsigned int tens = f[1] == ' ' ? 0 : (unsigned int)(f[1] - '0'), units = (unsigned int)(f[2] - '0');
+        if (tens > 9 || units > 9 || blank != 0)
+            return -1;
+        high = tens * 10 + units;
+    } else if (f[1] != ' ') {
+        return -1;
+    }
+    lo = (lo * 10 + (lo >> 8)) & 0x00FF00FF00FF00FFULL;     // Pairs of digits
+    lo = (lo * 100 + (lo >> 16)) & 0x0000FFFF0000FFFFULL;   // Groups of four
+    lo = (lo * 10000 + (lo >> 32)) & 0x00000000FFFFFFFFULL; // Eight digits
+    return (int64_t)(high * 100000000ULL + lo);
+}
+
+// Last blank-separated word before the end of the line, "" if none
+static void copy_last_word(const char *p, char *out, size_t size) {
+    const char *end = p, *word = NULL;
+    while (*end && *end != '\n') {
+        if (*end != ' ' && *end != '\t' && (end == p || end[-1] == ' ' || end[-1] == '\t'))
+            word = end;
+        end++;
+    }
+    size_t len = word != NULL ? (size_t)(end - word) : 0;
+    while (len > 0 && (word[len - 1] == ' ' || word[len - 1] == '\t'))
+        len--;
+    if (len >= size)
+        len = size - 1;
+    if (len > 0)
+        memcpy(out, word, len);
+    out[len] = '\0';
+}
+
+/*
+ * Scan the numbers of every row with the cached layout. Returns 0, or -1 as
+ * soon as the text no longer matches the layout; prev is only replaced on
+ * success, so a rebuild can still map it.
+ */
+static int scan_irq_table(IrqTableState *t, int num_cpus, double seconds) {
+    const char *p = t->file.buf;
+    double inv = seconds > 0.0 ? 1.0 / seconds : 0.0;
+    if (t->file.len < t->header_len || memcmp(p, t->header, t->header_len) != 0)
+        return -1;
+    p += t->header_len;
+    for (int i = 0; i < t->lines; i++) {
+        const IrqLine *l = &t->line[i];
+        p = skip_blanks(p);
+        if (strncmp(p, l->label, (size_t)l->label_len) != 0 || p[l->label_len] != ':')
+            return -1;
+        p += l->label_len + 1;
+        if (l->row >= 0) {
+            size_t base = (size_t)l->row * num_cpus;
+            unsigned int *prev = t->prev + base, *curr = t->curr + base;
+            float *rate = t->rate + base;
+            if (t->fixed) {
+                if ((size_t)(p - t->file.buf) + (size_t)t->columns * IRQ_FIELD_LEN > t->file.len)
+                    return -1;
+                for (int c = 0; c < t->columns; c++, p += IRQ_FIELD_LEN) {
+                    int64_t value = scan_fixed_column(p);
+                    int cpu = t->column_cpu[c];
+                    if (value < 0)
+                        return -1;
+                    if (cpu >= 0) {
+                        rate[cpu] = (float)((unsigned int)((unsigned int)value - prev[cpu]) * inv);
+                        curr[cpu] = (unsigned int)value;
+                    }
+                }
+            } else {
+                for (int c = 0; c < t->columns; c++) {
+                    p = skip_blanks(p);
+                    if (!is_digit(*p))
+                        return -1;
+                    unsigned int value = (unsigned int)scan_ulong(&p);
+                    int cpu = t->column_cpu[c];
+                    if (cpu >= 0) {
+                        rate[cpu] = (float)((unsigned int)(value - prev[cpu]) * inv);
+                        curr[cpu] = value;
+                    }
+                }
+            }
+        }
+        p = next_line(p);
+    }
+    if (*p && t->skipped == 0) // A source was added at the end
+        return -1;
+    unsigned int *swap = t->prev;
+    t->prev = t->curr;
+    t->curr = swap;
+    return 0;
+}
+
+/*
+ * Build the layout of the text just read. Rows found in the old layout keep
+ * their previous counters; new rows and CPUs that had no column start from
+ * their first reading (rate 0 for this sample).
+ */
+static int build_irq_layout(IrqTableState *t, IrqTable table, int num_cpus, double seconds) {
+    const char *text = t->file.buf;
+    const char *eol = next_line(text);
+    size_t header_len = (size_t)(eol - text);
+    int columns = 0;
+    for (const char *p = text; p < eol; p++)
+        if (p[0] == 'C' && p[1] == 'P' && p[2] == 'U' && is_digit(p[3]))
+            columns++;
+    if (columns == 0 || *eol == '\0')
+        return -1;
+
+    int lines = 0, rows = 0, skipped = 0, fixed = 1;
+    unsigned int *prev = NULL, *curr = NULL;
+    float *rate = NULL;
+    char *matched = NULL;
+    IrqLine *line = malloc(sizeof(IrqLine) * IRQ_MAX_ROWS);
+    char (*name)[IRQ_NAME_LEN] = malloc(sizeof(*name) * IRQ_MAX_ROWS);
+    int *column_cpu = malloc(sizeof(int) * (size_t)columns);
+    char *header = malloc(header_len);
+    char *had_column = calloc((size_t)num_cpus, 1);
+    if (line == NULL || name == NULL || column_cpu == NULL || header == NULL || had_column == NULL)
+        goto fail;
+    memcpy(header, text, header_len);
+    columns = 0;
+    for (const char *p = text; p < eol; p++) {
+        if (p[0] == 'C' && p[1] == 'P' && p[2] == 'U' && is_digit(p[3])) {
+            p += 3;
+            unsigned long cpu = scan_ulong(&p);
+            column_cpu[columns++] = cpu < (unsigned long)num_cpus ? (int)cpu : -1;
+            p--;
+        }
+    }
+
+    for (const char *p = eol; *p; p = next_line(p)) {
+        const char *label = skip_blanks(p), *colon = label;
+        while (*colon && *colon != ':' && *colon != '\n')
+            colon++;
+        // Past the cap or an unexpected line, the rest of the table is left out
+        if (skipped > 0 || lines == IRQ_MAX_ROWS || *colon != ':' || colon == label ||
+            colon - label >= IRQ_LABEL_LEN) {
+            skipped++;
+            continue;
+        }
+        IrqLine *l = &line[lines++];
+        l->label_len = (int)(colon - label);
+        memcpy(l->label, label, (size_t)l->label_len);
+        l->label[l->label_len] = '\0';
+        l->row = -1;
+        const char *q = colon + 1, *fields = q;
+        int values = 0;
+        while (values < columns) {
+            q = skip_blanks(q);
+            if (!is_digit(*q))
+                break;
+            scan_ulong(&q);
+            values++;
+        }
+        // ERR and MIS are one machine-wide count, not a value per CPU
+        if (values < columns || strcmp(l->label, "ERR") == 0 || strcmp(l->label, "MIS") == 0)
+            continue;
+        l->row = rows;
+        // The fast path needs every counter in its own fixed-width field
+        for (int c = 0; c < columns && fixed; c++)
+            if (q - fields != (ptrdiff_t)columns * IRQ_FIELD_LEN || scan_fixed_column(fields + c * IRQ_FIELD_LEN) < 0)
+                fixed = 0;
+        // "24:  ...  IR-PCI-MSI 524288-edge  eth0-rx-0" is named by its action
+        name[rows][0] = '\0';
+        if (table == IRQ_HARD && is_digit(l->label[0]))
+            copy_last_word(q, name[rows], IRQ_NAME_LEN);
+        if (name[rows][0] == '\0')
+            copy_last_word(l->label, name[rows], IRQ_NAME_LEN);
+        rows++;
+    }
+
+    size_t cells = (size_t)(rows > 0 ? rows : 1) * num_cpus;
+    prev = calloc(cells, sizeof(unsigned int));
+    curr = calloc(cells, sizeof(unsigned int));
+    rate = calloc(cells, sizeof(float));
+    matched = calloc((size_t)(rows > 0 ? rows : 1), 1);
+    if (prev == NULL || curr == NULL || rate == NULL || matched == NULL)
+        goto fail;
+    for (int c = 0; c < t->columns; c++)
+        if (t->column_cpu[c] >= 0)
+            had_column[t->column_cpu[c]] = 1;
+    for (int i = 0; i < lines; i++) {
+        if (line[i].row < 0)
+            continue;
+        for (int j = 0; j < t->lines; j++) {
+            if (t->line[j].row >= 0 && strcmp(t->line[j].label, line[i].label) == 0) {
+                memcpy(prev + (size_t)line[i].row * num_cpus, t->prev + (size_t)t->line[j].row * num_cpus,
+                       sizeof(unsigned int) * num_cpus);
+                matched[line[i].row] = 1;
+                break;
+            }
+        }
+    }
+
+    free(t->header);
+    free(t->column_cpu);
+    free(t->name);
+    free(t->prev);
+    free(t->curr);
+    free(t->rate);
+    t->header = header;
+    t->header_len = header_len;
+    t->columns = columns;
+    t->fixed = fixed;
+    t->column_cpu = column_cpu;
+    memcpy(t->line, line, sizeof(IrqLine) * (size_t)lines);
+    t->lines = lines;
+    t->skipped = skipped;
+    t->rows = rows;
+    t->name = name;
+    t->prev = prev;
+    t->curr = curr;
+    t->rate = rate;
+    free(line);
+
+    // The text was read with this very layout, so the scan cannot fail
+    scan_irq_table(t, num_cpus, seconds);
+    for (int r = 0; r < rows; r++) {
+        float *row_rate = rate + (size_t)r * num_cpus;
+        for (int cpu = 0; cpu < num_cpus; cpu++)
+            if (!matched[r] || !had_column[cpu])
+                row_rate[cpu] = 0.0f;
+    }
+    free(matched);
+    free(had_column);
+    return 0;
+
+fail:
+    free(prev);
+    free(curr);
+    free(rate);
+    free(matched);
+    free(line);
+    free(name);
+    free(column_cpu);
+    free(header);
+    free(had_column);
+    return -1;
+}
+
+// Read one table and refresh its rates; -1 if it is missing or unreadable
+static int read_irq_table(IrqSampler *s, IrqTable table, double seconds) {
+    IrqTableState *t = &s->table[table];
+    t->available = 0;
+    if (t->file.fd < 0 || read_proc_file(&t->file) < 0)
+        return -1;
+    if (t->header == NULL || scan_irq_table(t, s->num_cpus, seconds) < 0) {
+        if (t->header != NULL)
+            s->layout_changes++;
+        if (build_irq_layout(t, table, s->num_cpus, seconds) < 0)
+            return -1;
+    }
+    t->available = 1;
+    return 0;
+}
+
+IrqSampler *create_irq_sampler(int num_cpus) {
+    char path[PROC_PATH_MAX];
+    if (num_cpus <= 0)
+        return NULL;
+    IrqSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->num_cpus = num_cpus;
+    s->top_row = malloc(sizeof(int) * (size_t)num_cpus * IRQ_TOP_SOURCES);
+    if (s->top_row == NULL) {
+        free(s);
+        return NULL;
+    }
+    for (int t = 0; t < IRQ_TABLES; t++) {
+        // Roughly one 11-character column per CPU on a few dozen rows
+        size_t cap = (size_t)num_cpus * 11 * 32 + 4096;
+        if (open_proc_file(&s->table[t].file, proc_path(irq_files[t], path), cap) < 0 ||
+            read_irq_table(s, (IrqTable)t, 0.0) < 0)
+            close_proc_file(&s->table[t].file);
+    }
+    s->layout_changes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &s->when);
+    return s;
+}
+
+int sample_irq_info(IrqSampler *s, IrqInfo *info) {
+    struct timespec now;
+    int n = s->num_cpus;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double)(now.tv_sec - s->when.tv_sec) + (double)(now.tv_nsec - s->when.tv_nsec) / 1e9;
+    s->when = now;
+    info->interval = seconds;
+    info->num_cpus = n;
+    info->available = 0;
+    info->sources = 0;
+    info->irq_ps = 0.0;
+    info->softirq_ps = 0.0;
+    for (int cpu = 0; cpu < n; cpu++) {
+        IrqCpu *c = &info->cpu[cpu];
+        c->irq_ps = 0.0;
+        c->softirq_ps = 0.0;
+        for (int k = 0; k < IRQ_TOP_SOURCES; k++) {
+            c->top[k].rate = 0.0;
+            c->top[k].name[0] = '\0';
+            s->top_row[cpu * IRQ_TOP_SOURCES + k] = -1;
+        }
+    }
+
+    // Sum and rank row by row, the order the matrix is laid out in
+    int base = 0;
+    for (int t = 0; t < IRQ_TABLES; t++) {
+        IrqTableState *table = &s->table[t];
+        if (read_irq_table(s, (IrqTable)t, seconds) < 0)
+            continue;
+        info->available = 1;
+        for (int r = 0; r < table->rows; r++) {
+            const float *rate = table->rate + (size_t)r * n;
+            for (int cpu = 0; cpu < n; cpu++) {
+                double v = rate[cpu];
+                if (v <= 0.0)
+                    continue;
+                IrqCpu *c = &info->cpu[cpu];
+                if (t == IRQ_HARD)
+                    c->irq_ps += v;
+                else
+                    c->softirq_ps += v;
+                if (v <= c->top[IRQ_TOP_SOURCES - 1].rate)
+                    continue;
+                int *top = s->top_row + cpu * IRQ_TOP_SOURCES;
+                int k = IRQ_TOP_SOURCES - 1;
+                for (; k > 0 && c->top[k - 1].rate < v; k--) {
+                    c->top[k].rate = c->top[k - 1].rate;
+                    top[k] = top[k - 1];
+                }
+                c->top[k].rate = v;
+                top[k] = base + r;
+            }
+        }
+        base += table->rows;
+    }
+    if (!info->available)
+        return -1;
+    info->sources = base;
+
+    for (int cpu = 0; cpu < n; cpu++) {
+        IrqCpu *c = &info->cpu[cpu];
+        info->irq_ps += c->irq_ps;
+        info->softirq_ps += c->softirq_ps;
+        for (int k = 0; k < IRQ_TOP_SOURCES && s->top_row[cpu * IRQ_TOP_SOURCES + k] >= 0; k++)
+            memcpy(c->top[k].name, irq_row_name(s, s->top_row[cpu * IRQ_TOP_SOURCES + k]), IRQ_NAME_LEN);
+    }
+    return base;
+}
+
+// Table and row of row i of the matrix
+static const IrqTableState *locate_irq_row(const IrqSampler *s, int *i) {
+    for (int t = 0; t < IRQ_TABLES; t++) {
+        if (*i < s->table[t].rows)
+            return &s->table[t];
+        *i -= s->table[t].rows;
+    }
+    return NULL;
+}
+
+int irq_row_count(const IrqSampler *s) {
+    return s->table[IRQ_HARD].rows + s->table[IRQ_SOFT].rows;
+}
+
+const char *irq_row_name(const IrqSampler *s, int i) {
+    const IrqTableState *t = locate_irq_row(s, &i);
+    return t != NULL ? t->name[i] : "?";
+}
+
+IrqTable irq_row_table(const IrqSampler *s, int i) {
+    return i < s->table[IRQ_HARD].rows ? IRQ_HARD : IRQ_SOFT;
+}
+
+const float *irq_row_rates(const IrqSampler *s, int i) {
+    const IrqTableState *t = locate_irq_row(s, &i);
+    return t != NULL ? t->rate + (size_t)i * s->num_cpus : NULL;
+}
+
+unsigned long irq_layout_changes(const IrqSampler *s) {
+    return s->layout_changes;
+}
+
+int irq_skipped_rows(const IrqSampler *s) {
+    return s->table[IRQ_HARD].skipped + s->table[IRQ_SOFT].skipped;
+}
+
+void destroy_irq_sampler(IrqSampler *s) {
+    if (s == NULL)
+        return;
+    for (int t = 0; t < IRQ_TABLES; t++) {
+        IrqTableState *table = &s->table[t];
+        close_proc_file(&table->file);
+        free(table->header);
+        free(table->column_cpu);
+        free(table->name);
+        free(table->prev);
+        free(table->curr);
+        free(table->rate);
+    }
+    free(s->top_row);
+    free(s);
+}
@@ -0,0 +1,137 @@
+/**
+ * @file irqinfo_manip.h
+ * @brief Per-CPU hardware interrupt and softirq rates from /proc/interrupts and /proc/softirqs.
+ *
+ * Both files are tables with one row per interrupt source and one column per
+ * CPU, so on a 512-CPU machine /proc/interrupts is tens of kilobytes of
+ * mostly digits. The sampler keeps one descriptor per file open and caches
+ * the layout of each table: the header line (which CPU every column is), and
+ * the label and value count of every row. A tick checks the header bytes and
+ * each row label against the cache and then only scans the numbers, column by
+ * column, straight into a row x CPU rate matrix; descriptions are not
+ * tokenized again. When the layout changes (a CPU goes offline and drops out
+ * of the /proc/interrupts header, a driver registers an IRQ) it is rebuilt
+ * once and rows keep their previous counts by label.
+ *
+ * The kernel prints the counters as 32-bit values, so a delta is taken modulo
+ * 2^32 and a counter that wrapped still gives the right rate. A tick costs one
+ * read_proc_file() per file (a pread() per page, and the empty one at the end)
+ * and no allocation while the layout is stable.
+ */
+
+#ifndef IRQINFO_MANIP_H
+#define IRQINFO_MANIP_H
+
+#include "procfile.h" // For the persistent /proc/interrupts and /proc/softirqs readers
+
+#define IRQ_MAX_ROWS 512   // Sources kept per table (the rest are counted as skipped)
+#define IRQ_LABEL_LEN 12   // Longest row label kept, e.g. "IRQ_POLL" or "1023"
+#define IRQ_NAME_LEN 16    // Longest source name kept, e.g. "eth0-rx-0"
+#define IRQ_TOP_SOURCES 3  // Busiest sources reported per CPU
+
+/**
+ * @brief The two tables of the sampler.
+ */
+typedef enum {
+    IRQ_HARD, // /proc/interrupts
+    IRQ_SOFT, // /proc/softirqs
+    IRQ_TABLES
+} IrqTable;
+
+/**
+ * @brief One interrupt source of a CPU and its rate.
+ */
+typedef struct {
+    char name[IRQ_NAME_LEN]; /**< Device or action of a numbered IRQ ("eth0-rx-0"), otherwise the row label ("LOC", "NET_RX"). */
+    double rate;             /**< Events per second on this CPU. */
+} IrqSource;
+
+/**
+ * @brief Interrupt load of one CPU.
+ */
+typedef struct {
+    double irq_ps;                     /**< Hardware interrupts per second (/proc/interrupts). */
+    double softirq_ps;                 /**< Softirqs raised per second (/proc/softirqs). */
+    IrqSource top[IRQ_TOP_SOURCES];    /**< Busiest sources of both tables, busiest first; rate 0 past the last one. */
+} IrqCpu;
+
+/**
+ * @brief Interrupt load of one sample.
+ */
+typedef struct {
+    int available;     /**< 1 if at least one of the two files was read. */
+    int num_cpus;      /**< Entries in cpu. */
+    int sources;       /**< Rows of both tables in the rate matrix. */
+    double interval;   /**< Seconds between the two reads behind the rates. */
+    double irq_ps;     /**< Hardware interrupts per second over all CPUs. */
+    double softirq_ps; /**< Softirqs per second over all CPUs. */
+    IrqCpu *cpu;       /**< Per-CPU load, num_cpus entries of caller-provided storage. */
+} IrqInfo;
+
+/**
+ * @brief Opaque sampler: the two files, their cached layouts and the rate matrix.
+ */
+typedef struct IrqSampler IrqSampler;
+
+/**
+ * @brief Opens both files, builds their layouts and takes the first reading.
+ *
+ * A missing file is not an error: that table stays empty.
+ *
+ * @param num_cpus CPUs to report; columns of higher CPUs are ignored.
+ * @return IrqSampler* The sampler, or NULL on bad arguments or allocation failure.
+ */
+IrqSampler *create_irq_sampler(int num_cpus);
+
+/**
+ * @brief Re-reads both tables, refreshes the rate matrix and fills the
+ * per-CPU totals and top sources since the previous call.
+ *
+ * @param info Output; info->cpu must point to num_cpus entries.
+ * @return int Number of sources in the matrix, or -1 if neither file could be read.
+ */
+int sample_irq_info(IrqSampler *sampler, IrqInfo *info);
+
+/**
+ * @brief Events per second for a 32-bit kernel counter moving from prev to
+ * curr, correct across one wrap of the counter.
+ */
+double calculate_irq_rate(unsigned int prev, unsigned int curr, double seconds);
+
+/**
+ * @brief Rows of the rate matrix: /proc/interrupts sources first, then softirqs.
+ */
+int irq_row_count(const IrqSampler *sampler);
+
+/**
+ * @brief Name of row i (see IrqSource.name).
+ */
+const char *irq_row_name(const IrqSampler *sampler, int i);
+
+/**
+ * @brief Table of row i.
+ */
+IrqTable irq_row_table(const IrqSampler *sampler, int i);
+
+/**
+ * @brief Rates of row i for the last sample, num_cpus entries indexed by CPU
+ * number (0 for a CPU without a column, e.g. offline).
+ */
+const float *irq_row_rates(const IrqSampler *sampler, int i);
+
+/**
+ * @brief Times a table layout was rebuilt after the first reading.
+ */
+unsigned long irq_layout_changes(const IrqSampler *sampler);
+
+/**
+ * @brief Rows dropped because a table had more than IRQ_MAX_ROWS sources.
+ */
+int irq_skipped_rows(const IrqSampler *sampler);
+
+/**
+ * @brief Closes the files and frees the sampler. Accepts NULL.
+ */
+void destroy_irq_sampler(IrqSampler *sampler);
+
+#endif // IRQINFO_MANIP_H
@@ -2,53 +2,165 @@
  * @file meminfo_manip.c
  * @brief Implementation of the memory information functions.
  *
- * This file reads memory data from /proc/meminfo and calculates
- * the total and used percentages of physical and swap memory.
- * It provides the implementation of the function declared in meminfo_manip.h.
+ * This file parses /proc/meminfo in a single pass into a numeric MemInfo
+ * snapshot. It provides the implementation of the functions declared in
+ * meminfo_manip.h.
  *
- * @author 
+ * @author
  * Alex
- * @version 1.1
+ * @version 2.0
  * @date 2025
  *
  */
 #include "meminfo_manip.h"
-#include <stdio.h>
+#include <fcntl.h>
 #include <string.h>
-#include <stdlib.h>
-
-char* get_memory_info() {
-    static char info[MEMINFO_STR_LEN];
-    FILE* file = fopen("/proc/meminfo", "r");
-    if (!file) {
-        snprintf(info, MEMINFO_STR_LEN, "Error al abrir /proc/meminfo");
-        return info;
+#include <unistd.h>
+
+// Return the member for a key when both its length and bytes match
+#define MEMINFO_KEY(name, member) \
+    if (len == sizeof(name) - 1 && memcmp(key, name, len) == 0) return &info->member
+
+/*
+ * Map a /proc/meminfo key to its MemInfo member.
+ * The switch on the first character leaves at most a handful of candidates.
+ */
+static unsigned long *lookup_field(MemInfo *info, const char *key, size_t len) {
+    switch (key[0]) {
+    case 'A':
+        MEMINFO_KEY("Active", active);
+        MEMINFO_KEY("Active(anon)", active_anon);
+        MEMINFO_KEY("Active(file)", active_file);
+        MEMINFO_KEY("AnonPages", anon_pages);
+        MEMINFO_KEY("AnonHugePages", anon_huge_pages);
+        break;
+    case 'B':
+        MEMINFO_KEY("Buffers", buffers);
+        break;
+    case 'C':
+        MEMINFO_KEY("Cached", cached);
+        MEMINFO_KEY("CommitLimit", commit_limit);
+        MEMINFO_KEY("Committed_AS", committed_as);
+        break;
+    case 'D':
+        MEMINFO_KEY("Dirty", dirty);
+        break;
+    case 'F':
+        MEMINFO_KEY("FileHugePages", file_huge_pages);
+        break;
+    case 'H':
+        MEMINFO_KEY("HugePages_Total", hugepages_total);
+        MEMINFO_KEY("HugePages_Free", hugepages_free);
+        MEMINFO_KEY("HugePages_Rsvd", hugepages_rsvd);
+        MEMINFO_KEY("HugePages_Surp", hugepages_surp);
+        MEMINFO_KEY("Hugepagesize", hugepage_size);
+        MEMINFO_KEY("Hugetlb", hugetlb);
+        break;
+    case 'I':
+        MEMINFO_KEY("Inactive", inactive);
+        MEMINFO_KEY("Inactive(anon)", inactive_anon);
+        MEMINFO_KEY("Inactive(file)", inactive_file);
+        break;
+    case 'K':
+        MEMINFO_KEY("KReclaimable", kreclaimable);
+        MEMINFO_KEY("KernelStack", kernel_stack);
+        break;
+    case 'M':
+        MEMINFO_KEY("MemTotal", mem_total);
+        MEMINFO_KEY("MemFree", mem_free);
+        MEMINFO_KEY("MemAvailable", mem_available);
+        MEMINFO_KEY("Mapped", mapped);
+        MEMINFO_KEY("Mlocked", mlocked);
+        break;
+    case 'P':
+        MEMINFO_KEY("PageTables", page_tables);
+        MEMINFO_KEY("Percpu", percpu);
+        break;
+    case 'S':
+        MEMINFO_KEY("SwapCached", swap_cached);
+        MEMINFO_KEY("SwapTotal", swap_total);
+        MEMINFO_KEY("SwapFree", swap_free);
+        MEMINFO_KEY("Shmem", shmem);
+        MEMINFO_KEY("ShmemHugePages", shmem_huge_pages);
+        MEMINFO_KEY("Slab", slab);
+        MEMINFO_KEY("SReclaimable", sreclaimable);
+        MEMINFO_KEY("SUnreclaim", sunreclaim);
+        break;
+    case 'U':
+        MEMINFO_KEY("Unevictable", unevictable);
+        break;
+    case 'V':
+        MEMINFO_KEY("VmallocTotal", vmalloc_total);
+        MEMINFO_KEY("VmallocUsed", vmalloc_used);
+        break;
+    case 'W':
+        MEMINFO_KEY("Writeback", writeback);
+        break;
+    case 'Z':
+        MEMINFO_KEY("Zswap", zswap);
+        MEMINFO_KEY("Zswapped", zswapped);
+        break;
     }
+    return NULL;
+}
+
+int parse_memory_info(const char *text, MemInfo *info) {
+    memset(info, 0, sizeof(*info));
+    int found = 0;
 
-    long mem_total_kb = 0, mem_free_kb = 0, buffers_kb = 0, cached_kb = 0;
-    long swap_total_kb = 0, swap_free_kb = 0;
-
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        if (sscanf(line, "MemTotal: %ld kB", &mem_total_kb) == 1) continue;
-        if (sscanf(line, "MemFree: %ld kB", &mem_free_kb) == 1) continue;
-        if (sscanf(line, "Buffers: %ld kB", &buffers_kb) == 1) continue;
-        if (sscanf(line, "Cached: %ld kB", &cached_kb) == 1) continue;
-        if (sscanf(line, "SwapTotal: %ld kB", &swap_total_kb) == 1) continue;
-        if (sscanf(line, "SwapFree: %ld kB", &swap_free_kb) == 1) continue;
+    const char *p = text;
+    while (*p) {
+        // Key runs up to the colon: "MemTotal:       16318264 kB"
+        const char *key = p;
+        while (*p && *p != ':' && *p != '\n')
+            p++;
+        if (*p == ':') {
+            unsigned long *field = lookup_field(info, key, (size_t)(p - key));
+            p++;
+            if (field != NULL) {
+                *field = scan_ulong(&p);
+                found++;
+            }
+        }
+        p = next_line(p);
     }
-    fclose(file);
+    return found;
+}
 
-    long mem_used_kb = mem_total_kb - mem_free_kb - buffers_kb - cached_kb;
-    float mem_usage_percent = mem_total_kb ? (mem_used_kb * 100.0f / mem_total_kb) : 0.0f;
+int read_memory_info(ProcFile *meminfo_file, MemInfo *info) {
+    if (read_proc_file(meminfo_file) < 0)
+        return -1;
+    parse_memory_info(meminfo_file->buf, info);
+    return 0;
+}
+
+int get_memory_info(MemInfo *info) {
+    char buf[MEMINFO_BUF_LEN];
+    char path[PROC_PATH_MAX];
+    int fd = open(proc_path("/proc/meminfo", path), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    count_proc_io(1, 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
 
-    long swap_used_kb = swap_total_kb - swap_free_kb;
-    float swap_usage_percent = swap_total_kb ? (swap_used_kb * 100.0f / swap_total_kb) : 0.0f;
+    buf[n] = '\0';
+    parse_memory_info(buf, info);
+    return 0;
+}
+
+unsigned long mem_used_kb(const MemInfo *info) {
+    if (info->mem_available > 0 && info->mem_available <= info->mem_total)
+        return info->mem_total - info->mem_available;
 
-    snprintf(info, MEMINFO_STR_LEN,
-             "Total physical memory: %ld MB \nUsage: %.2f%% \nTotal swap: %ld MB \nUsage: %.2f%%\n",
-             mem_total_kb / 1024, mem_usage_percent,
-             swap_total_kb / 1024, swap_usage_percent);
+    // Pre-3.14 kernels: approximate with free + buffers + page cache
+    unsigned long reclaimable = info->mem_free + info->buffers + info->cached;
+    return reclaimable < info->mem_total ? info->mem_total - reclaimable : 0;
+}
 
-    return info;
+unsigned long swap_used_kb(const MemInfo *info) {
+    return info->swap_free < info->swap_total ? info->swap_total - info->swap_free : 0;
 }
@@ -2,39 +2,120 @@
  * @file meminfo_manip.h
  * @brief Library to retrieve memory usage information from /proc/meminfo.
  *
- * This library provides a function to read the system's
- * physical and swap memory usage.
- * 
- * @author 
+ * This library fills a numeric MemInfo snapshot with the system's
+ * physical, swap, kernel and huge page memory counters. Formatting is left
+ * to the presentation layer.
+ *
+ * @author
  * Alex
- * @version 1.1
+ * @version 2.0
  * @date 2025
  */
 
 #ifndef MEMINFO_MANIP_H
 #define MEMINFO_MANIP_H
 
-/// Maximum length of the returned string with memory information
-#define MEMINFO_STR_LEN 256
+#include "procfile.h" // For the persistent /proc/meminfo reader
+
+/// Initial buffer size for /proc/meminfo (the file is about 1.5 kB)
+#define MEMINFO_BUF_LEN 4096
 
 /**
- * @brief Retrieves the system memory information.
- *
- * This function reads the /proc/meminfo file and calculates:
- * - Total physical memory (MB)
- * - Physical memory usage percentage
- * - Total swap memory (MB)
- * - Swap memory usage percentage
- *
- * @return const char* Pointer to a static string with the formatted information.
- * 
- * @note Example return:
- *       "Total physical memory: 11861 MB
- *        Usage: 19.48%
- *        Total swap: 4095 MB
- *        Usage: 0.00%"
+ * @brief Numeric snapshot of /proc/meminfo.
+ *
+ * All sizes are in kB as reported by the kernel. The HugePages_* members
+ * are page counts. Fields the running kernel does not report stay 0.
  */
-char* get_memory_info();
+typedef struct {
+    unsigned long mem_total;        /**< MemTotal: usable RAM. */
+    unsigned long mem_free;         /**< MemFree: completely unused RAM. */
+    unsigned long mem_available;    /**< MemAvailable: estimate of RAM available without swapping (3.14+). */
+    unsigned long buffers;          /**< Buffers: raw block device cache. */
+    unsigned long cached;           /**< Cached: page cache (excluding swap cache). */
+    unsigned long swap_cached;      /**< SwapCached: swapped out and back in, still in swap. */
+    unsigned long active;           /**< Active: recently used memory. */
+    unsigned long inactive;         /**< Inactive: reclaim candidates. */
+    unsigned long active_anon;      /**< Active(anon). */
+    unsigned long inactive_anon;    /**< Inactive(anon). */
+    unsigned long active_file;      /**< Active(file). */
+    unsigned long inactive_file;    /**< Inactive(file). */
+    unsigned long unevictable;      /**< Unevictable: memory that cannot be reclaimed. */
+    unsigned long mlocked;          /**< Mlocked: pages locked with mlock(). */
+    unsigned long swap_total;       /**< SwapTotal. */
+    unsigned long swap_free;        /**< SwapFree. */
+    unsigned long zswap;            /**< Zswap: compressed swap pool size. */
+    unsigned long zswapped;         /**< Zswapped: uncompressed size stored in zswap. */
+    unsigned long dirty;            /**< Dirty: waiting to be written back. */
+    unsigned long writeback;        /**< Writeback: being written back. */
+    unsigned long anon_pages;       /**< AnonPages: anonymous pages mapped in user space. */
+    unsigned long mapped;           /**< Mapped: files mapped with mmap(). */
+    unsigned long shmem;            /**< Shmem: shared memory and tmpfs. */
+    unsigned long kreclaimable;     /**< KReclaimable: reclaimable kernel allocations. */
+    unsigned long slab;             /**< Slab: in-kernel data structure cache. */
+    unsigned long sreclaimable;     /**< SReclaimable: reclaimable part of Slab. */
+    unsigned long sunreclaim;       /**< SUnreclaim: unreclaimable part of Slab. */
+    unsigned long kernel_stack;     /**< KernelStack. */
+    unsigned long page_tables;      /**< PageTables. */
+    unsigned long commit_limit;     /**< CommitLimit. */
+    unsigned long committed_as;     /**< Committed_AS: memory committed by allocations. */
+    unsigned long vmalloc_total;    /**< VmallocTotal. */
+    unsigned long vmalloc_used;     /**< VmallocUsed. */
+    unsigned long percpu;           /**< Percpu: per-CPU allocator. */
+    unsigned long anon_huge_pages;  /**< AnonHugePages: transparent huge pages. */
+    unsigned long shmem_huge_pages; /**< ShmemHugePages. */
+    unsigned long file_huge_pages;  /**< FileHugePages. */
+    unsigned long hugepages_total;  /**< HugePages_Total: pool size in pages. */
+    unsigned long hugepages_free;   /**< HugePages_Free: pages not yet allocated. */
+    unsigned long hugepages_rsvd;   /**< HugePages_Rsvd: reserved but not yet faulted. */
+    unsigned long hugepages_surp;   /**< HugePages_Surp: surplus pages. */
+    unsigned long hugepage_size;    /**< Hugepagesize. */
+    unsigned long hugetlb;          /**< Hugetlb: total memory used by huge pages of all sizes. */
+} MemInfo;
 
-#endif // MEMINFO_MANIP_H
+/**
+ * @brief Parses a /proc/meminfo text into a MemInfo in a single pass.
+ *
+ * Each key is matched with a switch on its first character followed by a
+ * length-checked comparison, so every line costs at most a few compares.
+ * Unknown keys are skipped.
+ *
+ * @param text NUL-terminated /proc/meminfo content.
+ * @param info Snapshot to fill (zeroed first).
+ * @return int Number of recognized fields.
+ */
+int parse_memory_info(const char *text, MemInfo *info);
+
+/**
+ * @brief Reads an opened /proc/meminfo ProcFile and parses it.
+ *
+ * @param meminfo_file ProcFile opened on /proc/meminfo (kept open by the caller).
+ * @param info Snapshot to fill.
+ * @return int 0 on success, -1 on read failure.
+ */
+int read_memory_info(ProcFile *meminfo_file, MemInfo *info);
 
+/**
+ * @brief One-shot reentrant read of /proc/meminfo.
+ *
+ * Opens, reads into a stack buffer and closes the file; it keeps no
+ * static state. Prefer read_memory_info() in sampling loops.
+ *
+ * @param info Snapshot to fill.
+ * @return int 0 on success, -1 if /proc/meminfo could not be read.
+ */
+int get_memory_info(MemInfo *info);
+
+/**
+ * @brief Memory in use, in kB: MemTotal - MemAvailable.
+ *
+ * Falls back to MemTotal - MemFree - Buffers - Cached on kernels without
+ * MemAvailable.
+ */
+unsigned long mem_used_kb(const MemInfo *info);
+
+/**
+ * @brief Swap in use, in kB: SwapTotal - SwapFree.
+ */
+unsigned long swap_used_kb(const MemInfo *info);
+
+#endif // MEMINFO_MANIP_H
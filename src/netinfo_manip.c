@@ -0,0 +1,196 @@
+/**
+ * @file netinfo_manip.c
+ * @brief Implementation of the /proc/net/dev sampler.
+ */
+
+#include "netinfo_manip.h"
+#include <stdlib.h> // For calloc(), free()
+#include <string.h> // For memcmp(), memcpy()
+#include <time.h>   // For clock_gettime()
+
+#define NET_HEADER_LINES 2 // "Inter-|   Receive ..." and " face |bytes ..."
+#define NET_WRAP_32 0x100000000ULL
+
+// One interface slot; stays put while the interface is listed
+typedef struct {
+    char name[NET_NAME_LEN];
+    unsigned char len;         // strlen(name), 0 for a free slot
+    unsigned char seen;        // Listed in the current read
+    NetStats last;             // Counters at the previous read
+    unsigned long long rx_total, tx_total; // Wrap-corrected bytes since the slot was taken
+} NetSlot;
+
+struct NetSampler {
+    ProcFile file;                 // /proc/net/dev
+    NetSlot slot[NET_MAX_IFACES];
+    signed char hint[NET_MAX_IFACES]; // Slot of each line in the previous read, -1 if none
+    struct timespec when;          // CLOCK_MONOTONIC time of the previous read
+    unsigned long changes;
+};
+
+unsigned long long net_counter_delta(unsigned long long prev, unsigned long long curr) {
+    if (curr >= prev)
+        return curr - prev;
+    if (prev < NET_WRAP_32)
+        return curr + (NET_WRAP_32 - prev); // 32-bit counter wrapped
+    return curr; // Reset
+}
+
+void calculate_net_rates(const NetStats *prev, const NetStats *curr, double seconds, NetIface *iface) {
+    iface->rx_bytes_ps = iface->tx_bytes_ps = 0.0;
+    iface->rx_packets_ps = iface->tx_packets_ps = 0.0;
+    iface->rx_drops_ps = iface->tx_drops_ps = 0.0;
+    iface->rx_errors_ps = iface->tx_errors_ps = 0.0;
+    if (seconds <= 0.0)
+        return;
+    iface->rx_bytes_ps = (double)net_counter_delta(prev->rx_bytes, curr->rx_bytes) / seconds;
+    iface->tx_bytes_ps = (double)net_counter_delta(prev->tx_bytes, curr->tx_bytes) / seconds;
+    iface->rx_packets_ps = (double)net_counter_delta(prev->rx_packets, curr->rx_packets) / seconds;
+    iface->tx_packets_ps = (double)net_counter_delta(prev->tx_packets, curr->tx_packets) / seconds;
+    iface->rx_drops_ps = (double)net_counter_delta(prev->rx_drops, curr->rx_drops) / seconds;
+    iface->tx_drops_ps = (double)net_counter_delta(prev->tx_drops, curr->tx_drops) / seconds;
+    iface->rx_errors_ps = (double)net_counter_delta(prev->rx_errors, curr->rx_errors) / seconds;
+    iface->tx_errors_ps = (double)net_counter_delta(prev->tx_errors, curr->tx_errors) / seconds;
+}
+
+// Slot holding the interface named name[0..len), or a newly taken free slot
+// (*fresh set); -1 when every slot is taken
+static int find_slot(NetSampler *s, int line, const char *name, size_t len, int *fresh) {
+    *fresh = 0;
+    if (line < NET_MAX_IFACES && s->hint[line] >= 0) {
+        NetSlot *h = &s->slot[(int)s->hint[line]];
+        if (h->len == len && memcmp(h->name, name, len) == 0)
+            return s->hint[line];
+    }
+    int free_slot = -1;
+    for (int i = 0; i < NET_MAX_IFACES; i++) {
+        if (s->slot[i].len == 0) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (s->slot[i].len == len && memcmp(s->slot[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    if (free_slot >= 0) {
+        NetSlot *n = &s->slot[free_slot];
+        memset(n, 0, sizeof(*n));
+        memcpy(n->name, name, len);
+        n->len = (unsigned char)len;
+        s->changes++;
+        *fresh = 1;
+    }
+    return free_slot;
+}
+
+// Parse every line, update the slots and, when info is given, the rates
+static void parse_net_lines(NetSampler *s, double seconds, NetInfo *info) {
+    const char *p = s->file.buf;
+    for (int i = 0; i < NET_HEADER_LINES; i++)
+        p = next_line(p);
+    int line = 0, count = 0;
+    for (; *p; p = next_line(p), line++) {
+        // "  eth0: 1234 ..." (older kernels glue a long counter to the colon)
+        p = skip_blanks(p);
+        const char *name = p;
+        while (*p && *p != ':' && *p != '\n')
+            p++;
+        if (*p != ':')
+            break;
+        size_t len = (size_t)(p - name);
+        p++;
+        if (len == 0 || len >= NET_NAME_LEN)
+            continue;
+        int fresh;
+        int k = find_slot(s, line, name, len, &fresh);
+        if (line < NET_MAX_IFACES)
+            s->hint[line] = (signed char)k;
+        if (k < 0)
+            continue; // More interfaces than slots
+
+        NetStats curr;
+        curr.rx_bytes = scan_ullong(&p);
+        curr.rx_packets = scan_ullong(&p);
+        curr.rx_errors = scan_ullong(&p);
+        curr.rx_drops = scan_ullong(&p);
+        for (int f = 0; f < 4; f++) // fifo, frame, compressed, multicast
+            scan_ullong(&p);
+        curr.tx_bytes = scan_ullong(&p);
+        curr.tx_packets = scan_ullong(&p);
+        curr.tx_errors = scan_ullong(&p);
+        curr.tx_drops = scan_ullong(&p);
+
+        NetSlot *slot = &s->slot[k];
+        slot->seen = 1;
+        if (fresh)
+            slot->last = curr; // No previous reading: rates 0 this time
+        slot->rx_total += net_counter_delta(slot->last.rx_bytes, curr.rx_bytes);
+        slot->tx_total += net_counter_delta(slot->last.tx_bytes, curr.tx_bytes);
+        if (info != NULL) {
+            NetIface *out = &info->iface[count++];
+            memcpy(out->name, slot->name, NET_NAME_LEN);
+            out->slot = k;
+            out->rx_total = slot->rx_total;
+            out->tx_total = slot->tx_total;
+            calculate_net_rates(&slot->last, &curr, seconds, out);
+        }
+        slot->last = curr;
+    }
+    for (int i = line; i < NET_MAX_IFACES; i++)
+        s->hint[i] = -1;
+    if (info != NULL) {
+        info->count = count;
+        info->total = line;
+    }
+}
+
+// Free the slots of interfaces that were not listed and clear the marks
+static void release_unseen_slots(NetSampler *s) {
+    for (int i = 0; i < NET_MAX_IFACES; i++) {
+        NetSlot *slot = &s->slot[i];
+        if (slot->len != 0 && !slot->seen) {
+            slot->len = 0;
+            s->changes++;
+        }
+        slot->seen = 0;
+    }
+}
+
+NetSampler *create_net_sampler(void) {
+    char path[PROC_PATH_MAX];
+    NetSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    memset(s->hint, -1, sizeof(s->hint));
+    if (open_proc_file(&s->file, proc_path("/proc/net/dev", path), 0) < 0 || read_proc_file(&s->file) < 0) {
+        destroy_net_sampler(s);
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &s->when);
+    parse_net_lines(s, 0.0, NULL);
+    release_unseen_slots(s);
+    return s;
+}
+
+int sample_net_info(NetSampler *s, NetInfo *info) {
+    if (read_proc_file(&s->file) < 0)
+        return -1;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double)(now.tv_sec - s->when.tv_sec) + (double)(now.tv_nsec - s->when.tv_nsec) / 1e9;
+    s->when = now;
+    info->interval = seconds;
+    parse_net_lines(s, seconds, info);
+    release_unseen_slots(s);
+    return 0;
+}
+
+unsigned long net_slot_changes(const NetSampler *s) {
+    return s->changes;
+}
+
+void destroy_net_sampler(NetSampler *s) {
+    if (s == NULL)
+        return;
+    close_proc_file(&s->file);
+    free(s);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file netinfo_manip.h
+ * @brief Network interface throughput, packet, drop and error rates from /proc/net/dev.
+ *
+ * /proc/net/dev is re-read with pread() through one persistent descriptor.
+ * Interfaces live in a fixed table of NET_MAX_IFACES slots: an interface
+ * keeps its slot (and its previous counters) for as long as it is listed, a
+ * new one takes a free slot and a vanished one frees its slot, so hotplug
+ * (USB modems, VPN tunnels, VLANs) never reallocates anything. Each line is
+ * first checked against the slot it held in the previous sample, so a stable
+ * interface list costs one short name comparison per line.
+ *
+ * Rates are taken over the CLOCK_MONOTONIC time between two reads. Counters
+ * are kept as 64-bit values; a counter that goes backwards from below 2^32
+ * is a 32-bit wrap (32-bit kernels and drivers with 32-bit statistics).
+ */
+
+#ifndef NETINFO_MANIP_H
+#define NETINFO_MANIP_H
+
+#include "procfile.h" // For the persistent /proc/net/dev reader
+
+#define NET_NAME_LEN 16   // IFNAMSIZ: longest interface name plus NUL
+#define NET_MAX_IFACES 32 // Slots; interfaces beyond them are counted but not sampled
+
+/**
+ * @brief Counters of one /proc/net/dev line that the monitor tracks.
+ */
+typedef struct {
+    unsigned long long rx_bytes;   /**< Bytes received. */
+    unsigned long long rx_packets; /**< Packets received. */
+    unsigned long long rx_errors;  /**< Receive errors (CRC, length, ...). */
+    unsigned long long rx_drops;   /**< Received packets dropped (no buffer, no protocol). */
+    unsigned long long tx_bytes;   /**< Bytes sent. */
+    unsigned long long tx_packets; /**< Packets sent. */
+    unsigned long long tx_errors;  /**< Transmit errors. */
+    unsigned long long tx_drops;   /**< Packets dropped before transmission (e.g. full queue). */
+} NetStats;
+
+/**
+ * @brief Rates of one interface over the last interval.
+ */
+typedef struct {
+    char name[NET_NAME_LEN];     /**< Interface name, e.g. "eth0". */
+    int slot;                    /**< Slot held in the sampler, stable while the interface is listed. */
+    unsigned long long rx_total; /**< Bytes received since the interface appeared. */
+    unsigned long long tx_total; /**< Bytes sent likewise. */
+    double rx_bytes_ps;          /**< Bytes received per second. */
+    double tx_bytes_ps;          /**< Bytes sent per second. */
+    double rx_packets_ps;        /**< Packets received per second. */
+    double tx_packets_ps;        /**< Packets sent per second. */
+    double rx_drops_ps;          /**< Received packets dropped per second. */
+    double tx_drops_ps;          /**< Packets dropped on transmit per second. */
+    double rx_errors_ps;         /**< Receive errors per second. */
+    double tx_errors_ps;         /**< Transmit errors per second. */
+} NetIface;
+
+/**
+ * @brief Every sampled interface of one sample, in /proc/net/dev order.
+ */
+typedef struct {
+    int count;                       /**< Interfaces in iface (at most NET_MAX_IFACES). */
+    int total;                       /**< Interfaces listed in /proc/net/dev. */
+    double interval;                 /**< Seconds between the two reads behind the rates. */
+    NetIface iface[NET_MAX_IFACES];
+} NetInfo;
+
+/**
+ * @brief Opaque sampler: the open file and the interface slots.
+ */
+typedef struct NetSampler NetSampler;
+
+/**
+ * @brief Opens /proc/net/dev and takes the first reading, so the next
+ * sample_net_info() already returns rates.
+ *
+ * @return NetSampler* The sampler, or NULL on failure (errno is set).
+ */
+NetSampler *create_net_sampler(void);
+
+/**
+ * @brief Re-reads /proc/net/dev and fills the rates since the previous call.
+ *
+ * An interface that just appeared reports 0 until its second sample.
+ *
+ * @return int 0 on success, -1 if the file could not be read.
+ */
+int sample_net_info(NetSampler *sampler, NetInfo *info);
+
+/**
+ * @brief Increase of a counter from prev to curr.
+ *
+ * A counter below 2^32 that went backwards wrapped at 32 bits; a larger one
+ * was reset (e.g. the driver was reloaded) and counts from 0.
+ */
+unsigned long long net_counter_delta(unsigned long long prev, unsigned long long curr);
+
+/**
+ * @brief Rates of one interface from two readings taken seconds apart.
+ *
+ * Only the rate members of iface are written. Everything is 0 if seconds is
+ * not positive.
+ */
+void calculate_net_rates(const NetStats *prev, const NetStats *curr, double seconds, NetIface *iface);
+
+/**
+ * @brief Interfaces that took or released a slot since the sampler was created
+ * (the ones found by create_net_sampler() included).
+ */
+unsigned long net_slot_changes(const NetSampler *sampler);
+
+/**
+ * @brief Closes the file and frees the sampler. Accepts NULL.
+ */
+void destroy_net_sampler(NetSampler *sampler);
+
+#endif // NETINFO_MANIP_H
@@ -0,0 +1,131 @@
+/**
+ * @file procfile.c
+ * @brief Implementation of the persistent-descriptor procfs reader.
+ */
+
+#include "procfile.h"
+#include <errno.h>  // For errno
+#include <fcntl.h>  // For open()
+#include <stdatomic.h> // For the I/O counters
+#include <stdio.h>  // For snprintf()
+#include <stdlib.h> // For malloc(), realloc(), free()
+#include <string.h> // For strlen(), memcpy()
+#include <unistd.h> // For pread(), close()
+
+static char proc_root[PROC_PATH_MAX]; // Prefix of every mapped path, "" for "/"
+static atomic_ulong io_opens, io_reads; // Totals of count_proc_io()
+
+// Relaxed: the counters are statistics, nothing is ordered by them
+void count_proc_io(unsigned long opens, unsigned long reads) {
+    if (opens)
+        atomic_fetch_add_explicit(&io_opens, opens, memory_order_relaxed);
+    if (reads)
+        atomic_fetch_add_explicit(&io_reads, reads, memory_order_relaxed);
+}
+
+void get_proc_io_counts(ProcIoCounts *counts) {
+    counts->opens = atomic_load_explicit(&io_opens, memory_order_relaxed);
+    counts->reads = atomic_load_explicit(&io_reads, memory_order_relaxed);
+}
+
+// Remember the root without its trailing slashes
+int set_proc_root(const char *root) {
+    size_t len = root != NULL ? strlen(root) : 0;
+    while (len > 0 && root[len - 1] == '/')
+        len--;
+    if (len >= sizeof(proc_root) / 2) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (len > 0)
+        memcpy(proc_root, root, len);
+    proc_root[len] = '\0';
+    return 0;
+}
+
+const char *get_proc_root(void) {
+    return proc_root[0] ? proc_root : "/";
+}
+
+// Prefix the root; paths are short constants so half the buffer is enough for it
+const char *proc_path(const char *path, char *buf) {
+    if (proc_root[0] == '\0')
+        return path;
+    snprintf(buf, PROC_PATH_MAX, "%s%s", proc_root, path);
+    return buf;
+}
+
+// Open the file once and allocate its buffer
+int open_proc_file(ProcFile *pf, const char *path, size_t initial_cap) {
+    pf->fd = -1;
+    pf->buf = NULL;
+    pf->cap = 0;
+    pf->len = 0;
+
+    if (initial_cap == 0)
+        initial_cap = PROCFILE_DEFAULT_CAP;
+
+    pf->buf = malloc(initial_cap);
+    if (pf->buf == NULL)
+        return -1;
+    pf->cap = initial_cap;
+    pf->buf[0] = '\0';
+
+    pf->fd = open(path, O_RDONLY | O_CLOEXEC);
+    count_proc_io(1, 0);
+    if (pf->fd < 0) {
+        int saved = errno;
+        free(pf->buf);
+        pf->buf = NULL;
+        pf->cap = 0;
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+// Read the whole file from offset 0, growing the buffer only when it is full
+ssize_t read_proc_file(ProcFile *pf) {
+    size_t len = 0;
+
+    for (;;) {
+        // Keep one byte for the terminating NUL
+        if (len + 1 >= pf->cap) {
+            char *grown = realloc(pf->buf, pf->cap * 2);
+            if (grown == NULL)
+                return -1;
+            pf->buf = grown;
+            pf->cap *= 2;
+        }
+
+        size_t want = pf->cap - 1 - len;
+        ssize_t n = pread(pf->fd, pf->buf + len, want, (off_t)len);
+        count_proc_io(0, 1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        // Only single_open() files (/proc/stat, /proc/meminfo) fill the whole
+        // request; an iterative seq_file (/proc/interrupts, /proc/net/dev,
+        // /proc/diskstats) returns about a page per call, so read until EOF
+        if (n == 0)
+            break;
+        len += (size_t)n;
+    }
+
+    pf->buf[len] = '\0';
+    pf->len = len;
+    return (ssize_t)len;
+}
+
+// Release the descriptor and the buffer
+void close_proc_file(ProcFile *pf) {
+    if (pf->fd >= 0)
+        close(pf->fd);
+    free(pf->buf);
+    pf->fd = -1;
+    pf->buf = NULL;
+    pf->cap = 0;
+    pf->len = 0;
+}
@@ -0,0 +1,468 @@
+/**
+ * @file procinfo_manip.c
+ * @brief Implementation of the per-process top-N table.
+ *
+ * /proc is enumerated with the raw getdents64 syscall into a buffer that is
+ * allocated once. Each pid maps to a slot in an open-addressing hash table
+ * that holds its cached /proc/[pid]/stat descriptor and the previous
+ * counters. Slots not seen in the current enumeration are evicted and their
+ * descriptors closed.
+ */
+
+#include "procinfo_manip.h"
+#include "procfile.h"       // For scan_ulong() and skip_blanks()
+#include <dirent.h>         // For opendir() on /proc/self/fd
+#include <errno.h>          // For errno
+#include <fcntl.h>          // For open(), openat()
+#include <stdio.h>          // For snprintf()
+#include <stdlib.h>         // For calloc(), free()
+#include <string.h>         // For memcpy(), memset()
+#include <sys/resource.h>   // For getrlimit()
+#include <sys/syscall.h>    // For SYS_getdents64
+#include <time.h>           // For clock_gettime()
+#include <unistd.h>         // For pread(), close(), syscall(), sysconf()
+
+#define DENTS_BUF_LEN 32768   // getdents64 batch size
+#define STAT_READ_LEN 1024    // /proc/[pid]/stat is a single short line
+#define INITIAL_SLOTS 1024    // Hash capacity, always a power of two
+#define FD_RESERVE 128        // Descriptors left for the rest of the program
+#define FD_CACHE_MAX 1024     // Largest default budget, however high the limit
+#define SLOT_EMPTY 0          // pid value of a never-used slot
+#define SLOT_DELETED -1       // pid value of a tombstone
+
+// Record layout returned by getdents64 (not exported by glibc headers)
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Cached state of one process
+typedef struct {
+    int pid;                       // SLOT_EMPTY, SLOT_DELETED or the pid
+    int fd;                        // Cached /proc/[pid]/stat descriptor or -1
+    unsigned int seen;             // Generation of the last enumeration that listed it
+    unsigned long long start_time; // Field 22, identifies the process across pid reuse
+    unsigned long long prev_ticks; // utime + stime at the previous sample
+    unsigned long prev_rss;        // RSS in pages at the previous sample
+} ProcSlot;
+
+struct ProcTable {
+    int proc_fd;          // Open /proc directory
+    char *dents;          // getdents64 buffer
+    ProcSlot *slots;      // Open-addressing table indexed by pid hash
+    unsigned int cap;     // Number of slots (power of two)
+    unsigned int used;    // Live slots
+    unsigned int deleted; // Tombstones
+    unsigned int generation;
+    int cached_fds;       // Descriptors currently cached
+    int max_cached_fds;   // Descriptor budget
+    long ticks_per_sec;   // USER_HZ
+    long page_kb;         // Page size in kB
+    struct timespec last; // Time of the previous sample
+    int has_last;         // 0 until the first sample
+};
+
+// Parsed fields of /proc/[pid]/stat
+typedef struct {
+    char comm[PROC_COMM_LEN];
+    char state;
+    unsigned long long ticks;
+    unsigned long long start_time;
+    unsigned long rss;
+} StatFields;
+
+static unsigned int hash_pid(int pid, unsigned int cap) {
+    return ((unsigned int)pid * 2654435761u) & (cap - 1); // Knuth multiplicative hash
+}
+
+// Find the slot of pid, or NULL
+static ProcSlot *find_slot(ProcTable *t, int pid) {
+    for (unsigned int i = hash_pid(pid, t->cap);; i = (i + 1) & (t->cap - 1)) {
+        if (t->slots[i].pid == pid)
+            return &t->slots[i];
+        if (t->slots[i].pid == SLOT_EMPTY)
+            return NULL;
+    }
+}
+
+// Insert pid without checking for duplicates; the table must have room
+static ProcSlot *insert_slot(ProcTable *t, int pid) {
+    unsigned int i = hash_pid(pid, t->cap);
+    while (t->slots[i].pid != SLOT_EMPTY && t->slots[i].pid != SLOT_DELETED)
+        i = (i + 1) & (t->cap - 1);
+    if (t->slots[i].pid == SLOT_DELETED)
+        t->deleted--;
+    t->used++;
+    memset(&t->slots[i], 0, sizeof(ProcSlot));
+    t->slots[i].pid = pid;
+    t->slots[i].fd = -1;
+    return &t->slots[i];
+}
+
+// Rehash into a table of new_cap slots, dropping tombstones
+static int resize_slots(ProcTable *t, unsigned int new_cap) {
+    ProcSlot *old = t->slots;
+    unsigned int old_cap = t->cap;
+
+    t->slots = calloc(new_cap, sizeof(ProcSlot));
+    if (t->slots == NULL) {
+        t->slots = old;
+        return -1;
+    }
+    t->cap = new_cap;
+    t->used = 0;
+    t->deleted = 0;
+
+    for (unsigned int i = 0; i < old_cap; i++) {
+        if (old[i].pid > 0) {
+            ProcSlot *s = insert_slot(t, old[i].pid);
+            *s = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+// Close the cached descriptor and turn the slot into a tombstone
+static void evict_slot(ProcTable *t, ProcSlot *s) {
+    if (s->fd >= 0) {
+        close(s->fd);
+        t->cached_fds--;
+    }
+    s->fd = -1;
+    s->pid = SLOT_DELETED;
+    t->used--;
+    t->deleted++;
+}
+
+// Parse "pid (comm) state ppid ..."; comm may contain spaces and parentheses
+static int parse_pid_stat(const char *buf, StatFields *out) {
+    const char *open_paren = strchr(buf, '(');
+    const char *close_paren = strrchr(buf, ')');
+    if (open_paren == NULL || close_paren == NULL || close_paren < open_paren)
+        return -1;
+
+    size_t len = (size_t)(close_paren - open_paren - 1);
+    if (len >= PROC_COMM_LEN)
+        len = PROC_COMM_LEN - 1;
+    memcpy(out->comm, open_paren + 1, len);
+    out->comm[len] = '\0';
+
+    const char *p = skip_blanks(close_paren + 1);
+    out->state = *p++; // Field 3
+
+    // Walk fields 4..24; some (priority, nice) can be negative, so skip them as text
+    unsigned long long utime = 0, stime = 0;
+    for (int field = 4; field <= 24; field++) {
+        p = skip_blanks(p);
+        if (*p == '\0' || *p == '\n')
+            return -1;
+        switch (field) {
+        case 14: utime = scan_ulong(&p); break;
+        case 15: stime = scan_ulong(&p); break;
+        case 22: out->start_time = scan_ulong(&p); break;
+        case 24: out->rss = scan_ulong(&p); break;
+        default:
+            while (*p && *p != ' ' && *p != '\n')
+                p++;
+            break;
+        }
+    }
+    out->ticks = utime + stime;
+    return 0;
+}
+
+// Close every cached descriptor and stop caching: the process ran out of them
+static void release_cached_fds(ProcTable *t) {
+    for (unsigned int i = 0; i < t->cap; i++) {
+        if (t->slots[i].pid > 0 && t->slots[i].fd >= 0) {
+            close(t->slots[i].fd);
+            t->slots[i].fd = -1;
+        }
+    }
+    t->cached_fds = 0;
+    t->max_cached_fds = 0;
+}
+
+/*
+ * Read /proc/[pid]/stat through the cached descriptor or a temporary one.
+ * Returns -1 if the process is gone, -2 if it could not be opened for lack
+ * of descriptors (it is kept and read again next time).
+ */
+static int read_pid_stat(ProcTable *t, ProcSlot *s, StatFields *out) {
+    char buf[STAT_READ_LEN];
+    ssize_t n = -1;
+
+    if (s->fd >= 0) {
+        n = pread(s->fd, buf, sizeof(buf) - 1, 0);
+        count_proc_io(0, 1);
+        if (n <= 0) {
+            // The task behind the descriptor is gone (ESRCH); the pid may have been reused
+            close(s->fd);
+            s->fd = -1;
+            t->cached_fds--;
+        }
+    }
+
+    if (s->fd < 0) {
+        char path[32];
+        snprintf(path, sizeof(path), "%d/stat", s->pid);
+        int fd = openat(t->proc_fd, path, O_RDONLY | O_CLOEXEC);
+        count_proc_io(1, 0);
+        if (fd < 0 && (errno == EMFILE || errno == ENFILE) && t->cached_fds > 0) {
+            // Our cache is what starves the program: give it back and read uncached
+            release_cached_fds(t);
+            fd = openat(t->proc_fd, path, O_RDONLY | O_CLOEXEC);
+            count_proc_io(1, 0);
+        }
+        if (fd < 0)
+            return errno == EMFILE || errno == ENFILE ? -2 : -1;
+        n = pread(fd, buf, sizeof(buf) - 1, 0);
+        count_proc_io(0, 1);
+        if (t->cached_fds < t->max_cached_fds) {
+            s->fd = fd;
+            t->cached_fds++;
+        } else {
+            close(fd);
+        }
+    }
+
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    return parse_pid_stat(buf, out);
+}
+
+// Ranking value of an entry
+static double sort_value(const ProcEntry *e, ProcSortKey key) {
+    return key == PROC_SORT_RSS ? (double)e->rss_kb : e->cpu_usage;
+}
+
+// Restore the min-heap property downwards from index i
+static void sift_down(ProcEntry *heap, int count, int i, ProcSortKey key) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < count && sort_value(&heap[left], key) < sort_value(&heap[smallest], key))
+            smallest = left;
+        if (right < count && sort_value(&heap[right], key) < sort_value(&heap[smallest], key))
+            smallest = right;
+        if (smallest == i)
+            return;
+        ProcEntry tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Restore the min-heap property upwards from index i
+static void sift_up(ProcEntry *heap, int i, ProcSortKey key) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (sort_value(&heap[parent], key) <= sort_value(&heap[i], key))
+            return;
+        ProcEntry tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+// Keep the n largest entries: the heap root is the smallest one kept
+static void heap_offer(ProcTop *top, int n, const ProcEntry *e, ProcSortKey key) {
+    if (top->count < n) {
+        top->entries[top->count] = *e;
+        sift_up(top->entries, top->count, key);
+        top->count++;
+    } else if (n > 0 && sort_value(e, key) > sort_value(&top->entries[0], key)) {
+        top->entries[0] = *e;
+        sift_down(top->entries, top->count, 0, key);
+    }
+}
+
+// Heap sort in place; popping the minimum to the end leaves a descending array
+static void heap_sort_descending(ProcTop *top, ProcSortKey key) {
+    for (int end = top->count - 1; end > 0; end--) {
+        ProcEntry tmp = top->entries[0];
+        top->entries[0] = top->entries[end];
+        top->entries[end] = tmp;
+        sift_down(top->entries, end, 0, key);
+    }
+}
+
+// Descriptors open in this process, or -1 if /proc/self/fd cannot be listed
+static int count_open_fds(void) {
+    DIR *dir = opendir("/proc/self/fd"); // The monitor's own, whatever the root
+    count_proc_io(1, 0);
+    if (dir == NULL)
+        return -1;
+    int count = -1; // The directory's own descriptor
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL) {
+        if (d->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+ProcTable *create_proc_table(int max_cached_fds) {
+    ProcTable *t = calloc(1, sizeof(*t));
+    if (t == NULL)
+        return NULL;
+
+    char path[PROC_PATH_MAX];
+    t->proc_fd = open(proc_path("/proc", path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    count_proc_io(1, 0);
+    t->dents = malloc(DENTS_BUF_LEN);
+    t->slots = calloc(INITIAL_SLOTS, sizeof(ProcSlot));
+    t->cap = INITIAL_SLOTS;
+    if (t->proc_fd < 0 || t->dents == NULL || t->slots == NULL) {
+        destroy_proc_table(t);
+        return NULL;
+    }
+
+    // Default budget: half of the descriptors RLIMIT_NOFILE leaves free after
+    // those already open and a reserve, so the samplers created later (one
+    // descriptor per cgroup file, thermal zone, recorder, exporter sockets)
+    // still find theirs
+    if (max_cached_fds <= 0) {
+        struct rlimit rl;
+        max_cached_fds = 0;
+        int open_fds = count_open_fds();
+        if (open_fds >= 0 && getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+            rlim_t used = (rlim_t)open_fds + FD_RESERVE;
+            rlim_t spare = rl.rlim_cur > used ? rl.rlim_cur - used : 0;
+            max_cached_fds = spare / 2 < FD_CACHE_MAX ? (int)(spare / 2) : FD_CACHE_MAX;
+        }
+    }
+    t->max_cached_fds = max_cached_fds;
+    t->ticks_per_sec = sysconf(_SC_CLK_TCK);
+    t->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    return t;
+}
+
+int sample_processes(ProcTable *t, ProcSortKey key, int n, ProcTop *top) {
+    if (n > PROC_TOP_MAX)
+        n = PROC_TOP_MAX;
+    top->count = 0;
+    top->total = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = t->has_last ? (now.tv_sec - t->last.tv_sec) + (now.tv_nsec - t->last.tv_nsec) / 1e9 : 0.0;
+    double ticks_to_percent = elapsed > 0.0 ? 100.0 / (elapsed * (double)t->ticks_per_sec) : 0.0;
+
+    t->generation++;
+    if (lseek(t->proc_fd, 0, SEEK_SET) < 0)
+        return -1;
+
+    for (;;) {
+        long bytes = syscall(SYS_getdents64, t->proc_fd, t->dents, DENTS_BUF_LEN);
+        count_proc_io(0, 1);
+        if (bytes < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (bytes == 0)
+            break;
+
+        for (long off = 0; off < bytes;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(t->dents + off);
+            off += d->d_reclen;
+
+            // Only numeric directory names are processes
+            const char *name = d->d_name;
+            if (*name < '1' || *name > '9')
+                continue;
+            unsigned long pid = scan_ulong(&name);
+            if (*name != '\0')
+                continue;
+
+            ProcSlot *s = find_slot(t, (int)pid);
+            int fresh = 0;
+            if (s == NULL) {
+                // Keep the load factor (live + tombstones) under 1/2
+                if ((t->used + t->deleted + 1) * 2 > t->cap &&
+                    resize_slots(t, t->used * 4 > t->cap ? t->cap * 2 : t->cap) < 0)
+                    continue;
+                s = insert_slot(t, (int)pid);
+                fresh = 1;
+            }
+
+            StatFields f;
+            int read = read_pid_stat(t, s, &f);
+            if (read == -2) {
+                s->seen = t->generation; // Still there, just not readable now
+                top->total++;
+                continue;
+            }
+            if (read < 0) {
+                evict_slot(t, s); // Exited between getdents64 and the read
+                continue;
+            }
+
+            // A different start time means the pid was reused: start a new baseline
+            if (!fresh && f.start_time != s->start_time)
+                fresh = 1;
+
+            ProcEntry e;
+            e.pid = (int)pid;
+            memcpy(e.comm, f.comm, sizeof(e.comm));
+            e.state = f.state;
+            e.rss_kb = f.rss * (unsigned long)t->page_kb;
+            if (fresh) {
+                e.cpu_usage = 0.0;
+                e.rss_delta_kb = 0;
+            } else {
+                e.cpu_usage = (double)(f.ticks - s->prev_ticks) * ticks_to_percent;
+                e.rss_delta_kb = ((long)f.rss - (long)s->prev_rss) * t->page_kb;
+            }
+
+            s->seen = t->generation;
+            s->start_time = f.start_time;
+            s->prev_ticks = f.ticks;
+            s->prev_rss = f.rss;
+
+            top->total++;
+            heap_offer(top, n, &e, key);
+        }
+    }
+
+    // Evict processes that were not listed this time
+    for (unsigned int i = 0; i < t->cap; i++) {
+        if (t->slots[i].pid > 0 && t->slots[i].seen != t->generation)
+            evict_slot(t, &t->slots[i]);
+    }
+
+    heap_sort_descending(top, key);
+    t->last = now;
+    t->has_last = 1;
+    return 0;
+}
+
+int proc_table_open_fds(const ProcTable *table) {
+    return table->cached_fds;
+}
+
+void destroy_proc_table(ProcTable *t) {
+    if (t == NULL)
+        return;
+    if (t->slots != NULL) {
+        for (unsigned int i = 0; i < t->cap; i++) {
+            if (t->slots[i].pid > 0 && t->slots[i].fd >= 0)
+                close(t->slots[i].fd);
+        }
+    }
+    if (t->proc_fd >= 0)
+        close(t->proc_fd);
+    free(t->slots);
+    free(t->dents);
+    free(t);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file procinfo_manip.h
+ * @brief Per-process CPU and memory table (top-N view).
+ *
+ * Enumerates /proc with getdents64, keeps a pid-keyed cache of open
+ * /proc/[pid]/stat descriptors and computes per-process CPU usage and RSS
+ * deltas between samples. Only the top N processes by the selected key are
+ * kept, using a bounded heap, so the cost per tick is O(P log N).
+ */
+
+#ifndef PROCINFO_MANIP_H
+#define PROCINFO_MANIP_H
+
+#define PROC_COMM_LEN 16 // Kernel TASK_COMM_LEN, including the NUL
+#define PROC_TOP_MAX 64  // Largest N accepted by sample_processes()
+
+/**
+ * @brief Key used to rank processes.
+ */
+typedef enum {
+    PROC_SORT_CPU, /**< CPU usage over the last interval. */
+    PROC_SORT_RSS, /**< Resident set size. */
+} ProcSortKey;
+
+/**
+ * @brief One process in the top-N view.
+ */
+typedef struct {
+    int pid;                   /**< Process id. */
+    char comm[PROC_COMM_LEN];  /**< Command name from /proc/[pid]/stat. */
+    char state;                /**< State letter (R, S, D, Z, ...). */
+    double cpu_usage;          /**< CPU usage in % of one CPU over the interval (can exceed 100 for multithreaded processes). */
+    unsigned long rss_kb;      /**< Resident set size in kB. */
+    long rss_delta_kb;         /**< RSS change since the previous sample in kB. */
+} ProcEntry;
+
+/**
+ * @brief Result of one sample: the top N processes, sorted descending by key.
+ */
+typedef struct {
+    int count;                        /**< Number of valid entries. */
+    int total;                        /**< Number of processes seen in this sample. */
+    ProcEntry entries[PROC_TOP_MAX];  /**< Ranked processes, entries[0] is the top one. */
+} ProcTop;
+
+/**
+ * @brief Opaque process table: pid cache, open descriptors and scan buffers.
+ */
+typedef struct ProcTable ProcTable;
+
+/**
+ * @brief Creates a process table.
+ *
+ * @param max_cached_fds Maximum number of /proc/[pid]/stat descriptors kept
+ *        open between samples (0 takes half of what RLIMIT_NOFILE leaves
+ *        after the descriptors already open and a reserve, at most 1024).
+ *        Processes beyond the budget are opened and closed on each sample;
+ *        running out of descriptors (EMFILE, ENFILE) closes the cached ones
+ *        and stops caching rather than dropping processes.
+ * @return ProcTable* The table, or NULL on failure.
+ */
+ProcTable *create_proc_table(int max_cached_fds);
+
+/**
+ * @brief Scans all processes and fills the top N by key.
+ *
+ * The first sample of a process only records its baseline, so its CPU
+ * usage is 0 until the next sample. Processes that exited are evicted and
+ * their descriptors closed; a reused pid is detected by its start time and
+ * gets a fresh baseline.
+ *
+ * @param table The process table.
+ * @param key Ranking key.
+ * @param n Number of entries wanted (clamped to PROC_TOP_MAX).
+ * @param top Output, sorted descending by key.
+ * @return int 0 on success, -1 if /proc could not be enumerated.
+ */
+int sample_processes(ProcTable *table, ProcSortKey key, int n, ProcTop *top);
+
+/**
+ * @brief Returns the number of /proc/[pid]/stat descriptors currently cached.
+ */
+int proc_table_open_fds(const ProcTable *table);
+
+/**
+ * @brief Closes every cached descriptor and frees the table. Accepts NULL.
+ */
+void destroy_proc_table(ProcTable *table);
+
+#endif // PROCINFO_MANIP_H
@@ -0,0 +1,193 @@
+/**
+ * @file psi_manip.c
+ * @brief Implementation of the PSI sampler and triggers.
+ */
+
+#include "psi_manip.h"
+#include <errno.h>       // For errno
+#include <fcntl.h>       // For open()
+#include <linux/magic.h> // For PROC_SUPER_MAGIC
+#include <stdio.h>       // For snprintf()
+#include <stdlib.h>      // For calloc(), free()
+#include <string.h>      // For strncmp()
+#include <sys/vfs.h>     // For fstatfs()
+#include <time.h>        // For clock_gettime()
+#include <unistd.h>      // For write(), close()
+
+static const char *const psi_names[PSI_RESOURCES] = { "cpu", "memory", "io" };
+
+struct PSISampler {
+    ProcFile file[PSI_RESOURCES]; // fd -1 for a missing file
+    PSIPressure last[PSI_RESOURCES];
+    struct timespec when;         // CLOCK_MONOTONIC time of the previous read
+    int triggers;
+    int trigger_fd[PSI_MAX_TRIGGERS];
+    PSIResource trigger_res[PSI_MAX_TRIGGERS];
+};
+
+const char *psi_resource_name(PSIResource res) {
+    return res >= 0 && res < PSI_RESOURCES ? psi_names[res] : "?";
+}
+
+// "12.34" as written by the kernel (two decimals), after optional blanks
+static double scan_percent(const char **p) {
+    double value = (double)scan_ulong(p);
+    if (**p == '.') {
+        const char *s = *p + 1;
+        double scale = 0.1;
+        while (*s >= '0' && *s <= '9') {
+            value += (*s - '0') * scale;
+            scale /= 10;
+            s++;
+        }
+        *p = s;
+    }
+    return value;
+}
+
+// "avg10=0.00 avg60=0.00 avg300=0.00 total=0", keys in any order
+static void parse_psi_fields(const char *p, PSILine *line) {
+    while (*p && *p != '\n') {
+        p = skip_blanks(p);
+        if (strncmp(p, "avg10=", 6) == 0) {
+            p += 6;
+            line->avg10 = scan_percent(&p);
+        } else if (strncmp(p, "avg60=", 6) == 0) {
+            p += 6;
+            line->avg60 = scan_percent(&p);
+        } else if (strncmp(p, "avg300=", 7) == 0) {
+            p += 7;
+            line->avg300 = scan_percent(&p);
+        } else if (strncmp(p, "total=", 6) == 0) {
+            p += 6;
+            line->total_us = scan_ullong(&p);
+        } else {
+            while (*p && *p != ' ' && *p != '\n') // Unknown field
+                p++;
+        }
+    }
+}
+
+int parse_psi_lines(const char *text, PSILine *some, PSILine *full) {
+    int found = 0;
+    memset(some, 0, sizeof(*some));
+    memset(full, 0, sizeof(*full));
+    for (const char *p = text; *p; p = next_line(p)) {
+        if (strncmp(p, "some ", 5) == 0) {
+            parse_psi_fields(p + 5, some);
+            found = 1;
+        } else if (strncmp(p, "full ", 5) == 0) {
+            parse_psi_fields(p + 5, full);
+        }
+    }
+    return found ? 0 : -1;
+}
+
+double calculate_psi_stall(unsigned long long prev_us, unsigned long long curr_us, double seconds) {
+    if (seconds <= 0.0 || curr_us <= prev_us)
+        return 0.0;
+    double pct = (double)(curr_us - prev_us) / (seconds * 1e4);
+    return pct > 100.0 ? 100.0 : pct;
+}
+
+// Read and parse one resource; -1 if it is missing or unreadable
+static int read_psi_file(PSISampler *s, int r, PSIPressure *out) {
+    out->available = 0;
+    if (s->file[r].fd < 0 || read_proc_file(&s->file[r]) < 0 ||
+        parse_psi_lines(s->file[r].buf, &out->some, &out->full) < 0)
+        return -1;
+    out->available = 1;
+    return 0;
+}
+
+PSISampler *create_psi_sampler(void) {
+    char rel[64], path[PROC_PATH_MAX];
+    PSISampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        snprintf(rel, sizeof(rel), "/proc/pressure/%s", psi_names[r]);
+        // A kernel booted with psi=0 has the files but fails every read
+        if (open_proc_file(&s->file[r], proc_path(rel, path), 256) < 0 ||
+            read_psi_file(s, r, &s->last[r]) < 0)
+            close_proc_file(&s->file[r]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &s->when);
+    return s;
+}
+
+int sample_psi_info(PSISampler *s, PSIInfo *info) {
+    struct timespec now;
+    int available = 0;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double)(now.tv_sec - s->when.tv_sec) + (double)(now.tv_nsec - s->when.tv_nsec) / 1e9;
+    s->when = now;
+    info->interval = seconds;
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        PSIPressure *p = &info->res[r];
+        if (read_psi_file(s, r, p) < 0) {
+            memset(p, 0, sizeof(*p));
+            continue;
+        }
+        p->some_pct = calculate_psi_stall(s->last[r].some.total_us, p->some.total_us, seconds);
+        p->full_pct = calculate_psi_stall(s->last[r].full.total_us, p->full.total_us, seconds);
+        s->last[r] = *p;
+        available++;
+    }
+    return available;
+}
+
+int add_psi_trigger(PSISampler *s, PSIResource res, int full, unsigned long stall_us, unsigned long window_us) {
+    char rel[64], path[PROC_PATH_MAX], spec[64];
+    if (res < 0 || res >= PSI_RESOURCES) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (s->triggers == PSI_MAX_TRIGGERS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    snprintf(rel, sizeof(rel), "/proc/pressure/%s", psi_names[res]);
+    int fd = open(proc_path(rel, path), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct statfs fs;
+    if (fstatfs(fd, &fs) < 0 || fs.f_type != PROC_SUPER_MAGIC) {
+        close(fd);
+        errno = ENOTSUP;
+        return -1;
+    }
+    // The kernel parses the string up to its terminating NUL
+    int len = snprintf(spec, sizeof(spec), "%s %lu %lu", full ? "full" : "some", stall_us, window_us);
+    if (write(fd, spec, (size_t)len + 1) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    s->trigger_fd[s->triggers] = fd;
+    s->trigger_res[s->triggers] = res;
+    return s->triggers++;
+}
+
+int psi_trigger_count(const PSISampler *s) {
+    return s->triggers;
+}
+
+int psi_trigger_fd(const PSISampler *s, int i) {
+    return s->trigger_fd[i];
+}
+
+PSIResource psi_trigger_resource(const PSISampler *s, int i) {
+    return s->trigger_res[i];
+}
+
+void destroy_psi_sampler(PSISampler *s) {
+    if (s == NULL)
+        return;
+    for (int r = 0; r < PSI_RESOURCES; r++)
+        close_proc_file(&s->file[r]);
+    for (int i = 0; i < s->triggers; i++)
+        close(s->trigger_fd[i]);
+    free(s);
+}
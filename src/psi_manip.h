@@ -0,0 +1,142 @@
+/**
+ * @file psi_manip.h
+ * @brief Pressure Stall Information (/proc/pressure/cpu, memory, io) and PSI triggers.
+ *
+ * CPU usage says how busy the CPUs were, not whether tasks waited for them.
+ * PSI reports the share of time in which some task ("some") or every
+ * non-idle task ("full") was stalled on a resource, as kernel averages over
+ * 10, 60 and 300 seconds and as a running total in microseconds. The sampler
+ * keeps one persistent descriptor per file and turns the totals into the
+ * stall percentage of each sampling interval.
+ *
+ * A PSI trigger is a separate descriptor on the same file that becomes
+ * ready (POLLPRI) as soon as the stall time within a window crosses a
+ * threshold, so a consumer can poll() it next to its other descriptors and
+ * react to a stall without waiting for the next tick.
+ *
+ * PSI needs Linux 4.20 with CONFIG_PSI; without it every resource is
+ * reported as unavailable. Unprivileged triggers need Linux 6.5 and a window
+ * that is a multiple of 2 seconds.
+ */
+
+#ifndef PSI_MANIP_H
+#define PSI_MANIP_H
+
+#include "procfile.h" // For the persistent /proc/pressure readers
+
+#define PSI_MAX_TRIGGERS 6          // Triggers per sampler
+#define PSI_MIN_WINDOW_US 500000UL  // Kernel limits of a trigger window
+#define PSI_MAX_WINDOW_US 10000000UL
+
+/**
+ * @brief Resources with a /proc/pressure file.
+ */
+typedef enum {
+    PSI_CPU,
+    PSI_MEMORY,
+    PSI_IO,
+    PSI_RESOURCES
+} PSIResource;
+
+/**
+ * @brief One "some" or "full" line of a pressure file.
+ */
+typedef struct {
+    double avg10;                /**< Percentage of time stalled, 10 s kernel average. */
+    double avg60;                /**< Likewise over 60 s. */
+    double avg300;               /**< Likewise over 300 s. */
+    unsigned long long total_us; /**< Microseconds stalled since boot. */
+} PSILine;
+
+/**
+ * @brief Pressure of one resource.
+ */
+typedef struct {
+    int available;   /**< 1 if the file exists and parsed. */
+    PSILine some;    /**< Some task stalled. */
+    PSILine full;    /**< Every non-idle task stalled (always 0 for the CPU outside cgroups). */
+    double some_pct; /**< Percentage of the last interval with some task stalled. */
+    double full_pct; /**< Percentage of the last interval with every task stalled. */
+} PSIPressure;
+
+/**
+ * @brief Pressure of every resource in one sample.
+ */
+typedef struct {
+    PSIPressure res[PSI_RESOURCES]; /**< Indexed by PSIResource. */
+    double interval;                /**< Seconds between the two reads behind the percentages. */
+    unsigned int woken;             /**< Bit 1 << PSIResource set for each resource whose trigger fired before this sample. */
+} PSIInfo;
+
+/**
+ * @brief Opaque sampler: the pressure files, their previous totals and the triggers.
+ */
+typedef struct PSISampler PSISampler;
+
+/**
+ * @brief Opens the pressure files that exist and takes the first reading.
+ *
+ * A kernel without PSI is not an error: every resource is unavailable.
+ *
+ * @return PSISampler* The sampler, or NULL if it could not be allocated.
+ */
+PSISampler *create_psi_sampler(void);
+
+/**
+ * @brief Re-reads every pressure file and fills the stall percentages since
+ * the previous call. woken is left to the caller.
+ *
+ * @return int Number of available resources.
+ */
+int sample_psi_info(PSISampler *sampler, PSIInfo *info);
+
+/**
+ * @brief Parses the "some" and "full" lines of a pressure file.
+ *
+ * @return int 0 if a "some" line was found (full stays zero without its line), -1 otherwise.
+ */
+int parse_psi_lines(const char *text, PSILine *some, PSILine *full);
+
+/**
+ * @brief Percentage of seconds covered by the stall total moving from prev_us
+ * to curr_us, capped at 100 (the kernel aggregates on its own clock).
+ */
+double calculate_psi_stall(unsigned long long prev_us, unsigned long long curr_us, double seconds);
+
+/**
+ * @brief Registers a trigger: its descriptor becomes ready with POLLPRI when
+ * the resource is stalled (some or full) for stall_us within window_us.
+ *
+ * Only on the real /proc: a trigger written to a fixture would overwrite it.
+ *
+ * @return int Index of the trigger, or -1 (errno is set, e.g. EPERM or EINVAL
+ * from the kernel, ENOTSUP outside procfs, ENOSPC past PSI_MAX_TRIGGERS).
+ */
+int add_psi_trigger(PSISampler *sampler, PSIResource res, int full, unsigned long stall_us, unsigned long window_us);
+
+/**
+ * @brief Number of registered triggers.
+ */
+int psi_trigger_count(const PSISampler *sampler);
+
+/**
+ * @brief Descriptor of trigger i, for poll() with POLLPRI.
+ */
+int psi_trigger_fd(const PSISampler *sampler, int i);
+
+/**
+ * @brief Resource of trigger i.
+ */
+PSIResource psi_trigger_resource(const PSISampler *sampler, int i);
+
+/**
+ * @brief Short name of a resource: "cpu", "memory" or "io".
+ */
+const char *psi_resource_name(PSIResource res);
+
+/**
+ * @brief Closes the files and triggers and frees the sampler. Accepts NULL.
+ */
+void destroy_psi_sampler(PSISampler *sampler);
+
+#endif // PSI_MANIP_H
@@ -0,0 +1,511 @@
+/**
+ * @file recorder.c
+ * @brief Implementation of the delta/varint recording writer and mmap reader.
+ */
+
+#include "recorder.h"
+#include <errno.h>    // For errno
+#include <fcntl.h>    // For open()
+#include <stdlib.h>   // For calloc(), realloc(), free()
+#include <string.h>   // For memcpy(), memset()
+#include <sys/mman.h> // For mmap()
+#include <sys/stat.h> // For fstat()
+#include <unistd.h>   // For write(), close()
+
+#define REC_KEYFRAME 'K'
+#define REC_DELTA 'D'
+#define VARINT_MAX 10 // Bytes of the longest 64-bit varint
+
+/* ------------------ Varint coding ------------------ */
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// Decode a varint from [*p, end); returns -1 if it runs past end
+static inline int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    uint64_t result = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static long long wallclock_us(const Sample *s) {
+    return (long long)s->wallclock.tv_sec * 1000000LL + s->wallclock.tv_nsec / 1000;
+}
+
+/* ------------------ Writer ------------------ */
+
+struct Recorder {
+    int fd;
+    RecordingHeader header;
+    size_t count;                 // Counters per sample
+    unsigned long long *prev;     // Values of the previous sample
+    unsigned long long *curr;     // Values of the sample being recorded
+    long long prev_time_us;
+    int since_keyframe;           // Samples since the last keyframe
+
+    uint8_t *block;               // Records not yet written
+    size_t block_len, block_cap;
+    size_t record_max;            // Longest possible record
+    unsigned long long offset;    // File offset of block[0]
+
+    RecordingIndexEntry *index;   // One entry per keyframe
+    size_t index_count, index_cap;
+
+    unsigned long samples;
+    int failed;                   // A write failed; stop recording
+};
+
+// Write len bytes (one write() unless the kernel takes less)
+static int write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int flush_block(Recorder *r) {
+    if (r->block_len == 0)
+        return 0;
+    if (write_all(r->fd, r->block, r->block_len) < 0)
+        return -1;
+    r->offset += r->block_len;
+    r->block_len = 0;
+    return 0;
+}
+
+Recorder *create_recorder(const char *path, int cpu_slots, long interval_ms, int keyframe_interval) {
+    Recorder *r = calloc(1, sizeof(*r));
+    if (r == NULL)
+        return NULL;
+
+    memcpy(r->header.magic, RECORDING_MAGIC, sizeof(r->header.magic));
+    r->header.version = RECORDING_VERSION;
+    r->header.cpu_slots = (uint32_t)cpu_slots;
+    r->header.mem_words = (uint32_t)RECORDING_MEM_WORDS;
+    r->header.interval_us = (uint32_t)(interval_ms * 1000);
+    r->header.keyframe_interval = (uint32_t)(keyframe_interval > 0 ? keyframe_interval : RECORDING_DEFAULT_KEYFRAME);
+
+    r->count = (size_t)cpu_slots * CPU_STAT_FIELDS + RECORDING_MEM_WORDS;
+    // Type, length and time, then a bitmap and a varint per counter
+    r->record_max = 1 + VARINT_MAX + VARINT_MAX + (r->count + 7) / 8 + r->count * VARINT_MAX;
+    r->block_cap = r->record_max * r->header.keyframe_interval;
+    r->prev = calloc(r->count, sizeof(*r->prev));
+    r->curr = calloc(r->count, sizeof(*r->curr));
+    r->block = malloc(r->block_cap);
+    r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (r->prev == NULL || r->curr == NULL || r->block == NULL || r->fd < 0 ||
+        write_all(r->fd, &r->header, sizeof(r->header)) < 0) {
+        int saved = errno;
+        if (r->fd >= 0)
+            close(r->fd);
+        free(r->prev);
+        free(r->curr);
+        free(r->block);
+        free(r);
+        errno = saved;
+        return NULL;
+    }
+    r->offset = sizeof(r->header);
+    return r;
+}
+
+// Gather the sample's values in recording order: CPU fields, then MemInfo
+static void gather_values(Recorder *r, const Sample *s, const CPUStatsStore *counters) {
+    size_t slots = r->header.cpu_slots, k = 0;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        for (size_t i = 0; i < slots; i++)
+            r->curr[k++] = i < (size_t)counters->count ? counters->field[f][i] : 0;
+    }
+    const unsigned long *mem = (const unsigned long *)&s->mem;
+    for (size_t i = 0; i < RECORDING_MEM_WORDS; i++)
+        r->curr[k++] = mem[i];
+}
+
+// Add an index entry for a keyframe at file offset offset. A keyframe earlier
+// than the last entry (the wall clock stepped back) is left out of the index,
+// which stays sorted for the binary search; seeks decode through it instead.
+static int add_index_entry(Recorder *r, long long time_us, unsigned long long offset) {
+    if (r->index_count > 0 && time_us < r->index[r->index_count - 1].time_us)
+        return 0;
+    if (r->index_count == r->index_cap) {
+        size_t cap = r->index_cap ? r->index_cap * 2 : 256;
+        RecordingIndexEntry *grown = realloc(r->index, cap * sizeof(*grown));
+        if (grown == NULL)
+            return -1;
+        r->index = grown;
+        r->index_cap = cap;
+    }
+    r->index[r->index_count].time_us = time_us;
+    r->index[r->index_count].offset = offset;
+    r->index_count++;
+    return 0;
+}
+
+int record_sample(Recorder *r, const Sample *s, const CPUStatsStore *counters) {
+    if (r->failed)
+        return -1;
+    gather_values(r, s, counters);
+    long long time_us = wallclock_us(s);
+
+    // A keyframe starts a new block: write the previous one in one go
+    int keyframe = r->samples == 0 || r->since_keyframe >= (int)r->header.keyframe_interval;
+    if (keyframe) {
+        if (flush_block(r) < 0 || add_index_entry(r, time_us, r->offset + r->block_len) < 0) {
+            r->failed = 1;
+            return -1;
+        }
+        r->since_keyframe = 0;
+    }
+
+    // Payload goes after room for the type and the longest length varint
+    uint8_t *record = r->block + r->block_len;
+    uint8_t *payload = record + 1 + VARINT_MAX;
+    uint8_t *p = payload;
+    if (keyframe) {
+        p = put_varint(p, (uint64_t)time_us);
+        for (size_t i = 0; i < r->count; i++)
+            p = put_varint(p, r->curr[i]);
+    } else {
+        p = put_varint(p, zigzag(time_us - r->prev_time_us - r->header.interval_us));
+        uint8_t *bitmap = p;
+        size_t bitmap_len = (r->count + 7) / 8;
+        memset(bitmap, 0, bitmap_len);
+        p += bitmap_len;
+        for (size_t i = 0; i < r->count; i++) {
+            if (r->curr[i] == r->prev[i])
+                continue;
+            bitmap[i >> 3] |= (uint8_t)(1u << (i & 7));
+            p = put_varint(p, zigzag((int64_t)(r->curr[i] - r->prev[i])));
+        }
+    }
+
+    // Close the gap left for the header now that the payload length is known
+    size_t payload_len = (size_t)(p - payload);
+    uint8_t head[1 + VARINT_MAX];
+    head[0] = keyframe ? REC_KEYFRAME : REC_DELTA;
+    size_t head_len = (size_t)(put_varint(head + 1, payload_len) - head);
+    memmove(record + head_len, payload, payload_len);
+    memcpy(record, head, head_len);
+    r->block_len += head_len + payload_len;
+
+    unsigned long long *tmp = r->prev;
+    r->prev = r->curr;
+    r->curr = tmp;
+    r->prev_time_us = time_us;
+    r->since_keyframe++;
+    r->samples++;
+    return 0;
+}
+
+void recorder_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters) {
+    record_sample(ctx, sample, counters);
+}
+
+void get_recorder_stats(const Recorder *r, unsigned long long *bytes, unsigned long *samples) {
+    *bytes = r->offset + r->block_len;
+    *samples = r->samples;
+}
+
+int close_recorder(Recorder *r) {
+    if (r == NULL)
+        return 0;
+    int rc = 0;
+    if (!r->failed) {
+        RecordingTrailer trailer = { .index_count = r->index_count };
+        memcpy(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+        if (flush_block(r) < 0) {
+            rc = -1;
+        } else {
+            trailer.index_offset = r->offset;
+            if (write_all(r->fd, r->index, r->index_count * sizeof(*r->index)) < 0 ||
+                write_all(r->fd, &trailer, sizeof(trailer)) < 0)
+                rc = -1;
+        }
+    } else {
+        rc = -1;
+    }
+    if (close(r->fd) < 0)
+        rc = -1;
+    free(r->prev);
+    free(r->curr);
+    free(r->block);
+    free(r->index);
+    free(r);
+    return rc;
+}
+
+/* ------------------ Reader ------------------ */
+
+struct RecordingReader {
+    const uint8_t *base;               // Mapped file
+    size_t size;
+    const uint8_t *data_end;           // End of the records (start of the index)
+    RecordingHeader header;
+    size_t count;                      // Counters per sample
+
+    const RecordingIndexEntry *index;  // Keyframe index (owned_index)
+    RecordingIndexEntry *owned_index;  // Copied from the footer, or rebuilt by scanning
+    size_t index_count;
+
+    const uint8_t *pos;                // Next record to decode
+    unsigned long long *values;        // Decoded values of the current sample
+    long long time_us;
+    int have_state;                    // values/time_us hold a decoded sample
+    int pending;                       // Current sample was decoded by seek and not returned yet
+};
+
+// Split the record at *p; returns -1 if it is truncated
+static int next_record(const uint8_t **p, const uint8_t *end, uint8_t *type,
+                       const uint8_t **payload, size_t *len) {
+    if (*p >= end)
+        return -1;
+    *type = *(*p)++;
+    uint64_t n;
+    if (get_varint(p, end, &n) < 0 || n > (uint64_t)(end - *p))
+        return -1;
+    *payload = *p;
+    *len = (size_t)n;
+    *p += n;
+    return 0;
+}
+
+// Scan every record of a recording without index (e.g. after a crash)
+static int rebuild_index(RecordingReader *rd) {
+    size_t cap = 0;
+    const uint8_t *p = rd->base + sizeof(RecordingHeader);
+    const uint8_t *last_good = p;
+    uint8_t type;
+    const uint8_t *payload;
+    size_t len;
+    while (next_record(&p, rd->base + rd->size, &type, &payload, &len) == 0) {
+        if (type != REC_KEYFRAME && type != REC_DELTA)
+            break;
+        if (type == REC_KEYFRAME) {
+            uint64_t time_us;
+            const uint8_t *q = payload;
+            if (get_varint(&q, payload + len, &time_us) < 0)
+                break;
+            // Same rule as the writer: keep the index sorted
+            if (rd->index_count > 0 && (int64_t)time_us < rd->owned_index[rd->index_count - 1].time_us) {
+                last_good = p;
+                continue;
+            }
+            if (rd->index_count == cap) {
+                cap = cap ? cap * 2 : 256;
+                RecordingIndexEntry *grown = realloc(rd->owned_index, cap * sizeof(*grown));
+                if (grown == NULL)
+                    return -1;
+                rd->owned_index = grown;
+            }
+            rd->owned_index[rd->index_count].time_us = (int64_t)time_us;
+            rd->owned_index[rd->index_count].offset = (uint64_t)(last_good - rd->base);
+            rd->index_count++;
+        }
+        last_good = p;
+    }
+    rd->data_end = last_good; // A truncated last record is ignored
+    rd->index = rd->owned_index;
+    return 0;
+}
+
+RecordingReader *open_recording(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RecordingHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    RecordingReader *rd = calloc(1, sizeof(*rd));
+    if (rd == NULL) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    rd->base = map;
+    rd->size = (size_t)st.st_size;
+    memcpy(&rd->header, rd->base, sizeof(rd->header));
+    if (memcmp(rd->header.magic, RECORDING_MAGIC, sizeof(rd->header.magic)) != 0 ||
+        rd->header.version != RECORDING_VERSION || rd->header.mem_words != RECORDING_MEM_WORDS) {
+        close_recording(rd);
+        errno = EINVAL;
+        return NULL;
+    }
+    rd->count = (size_t)rd->header.cpu_slots * CPU_STAT_FIELDS + rd->header.mem_words;
+    rd->values = calloc(rd->count, sizeof(*rd->values));
+    if (rd->values == NULL) {
+        close_recording(rd);
+        return NULL;
+    }
+
+    // Use the index written on close when the trailer is intact
+    RecordingTrailer trailer;
+    int indexed = 0;
+    if (rd->size >= sizeof(RecordingHeader) + sizeof(trailer)) {
+        memcpy(&trailer, rd->base + rd->size - sizeof(trailer), sizeof(trailer));
+        size_t index_bytes = trailer.index_count * sizeof(RecordingIndexEntry);
+        indexed = memcmp(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+                  trailer.index_offset >= sizeof(RecordingHeader) &&
+                  trailer.index_offset + index_bytes + sizeof(trailer) == rd->size;
+        if (indexed) {
+            // Records have no alignment, so the index is copied out of the mapping
+            rd->owned_index = malloc(index_bytes ? index_bytes : 1);
+            if (rd->owned_index == NULL) {
+                close_recording(rd);
+                return NULL;
+            }
+            memcpy(rd->owned_index, rd->base + trailer.index_offset, index_bytes);
+            rd->index = rd->owned_index;
+            rd->index_count = trailer.index_count;
+            rd->data_end = rd->base + trailer.index_offset;
+        }
+    }
+    if (!indexed && rebuild_index(rd) < 0) {
+        close_recording(rd);
+        return NULL;
+    }
+    rd->pos = rd->base + sizeof(RecordingHeader);
+    return rd;
+}
+
+const RecordingHeader *recording_header(const RecordingReader *rd) {
+    return &rd->header;
+}
+
+size_t recording_keyframes(const RecordingReader *rd) {
+    return rd->index_count;
+}
+
+// Decode the record at rd->pos into the reader's state; 1 ok, 0 end, -1 corrupt
+static int decode_next(RecordingReader *rd) {
+    if (rd->pos >= rd->data_end)
+        return 0;
+    uint8_t type;
+    const uint8_t *payload;
+    size_t len;
+    if (next_record(&rd->pos, rd->data_end, &type, &payload, &len) < 0)
+        return -1;
+    const uint8_t *p = payload, *end = payload + len;
+    uint64_t v;
+
+    if (type == REC_KEYFRAME) {
+        if (get_varint(&p, end, &v) < 0)
+            return -1;
+        rd->time_us = (long long)v;
+        for (size_t i = 0; i < rd->count; i++) {
+            if (get_varint(&p, end, &v) < 0)
+                return -1;
+            rd->values[i] = v;
+        }
+    } else if (type == REC_DELTA && rd->have_state) {
+        if (get_varint(&p, end, &v) < 0)
+            return -1;
+        rd->time_us += rd->header.interval_us + unzigzag(v);
+        const uint8_t *bitmap = p;
+        size_t bitmap_len = (rd->count + 7) / 8;
+        if (bitmap_len > (size_t)(end - p))
+            return -1;
+        p += bitmap_len;
+        for (size_t byte = 0; byte < bitmap_len; byte++) {
+            // Skip unchanged counters eight at a time
+            for (unsigned int bits = bitmap[byte]; bits != 0; bits &= bits - 1) {
+                size_t i = byte * 8 + (size_t)__builtin_ctz(bits);
+                if (i >= rd->count || get_varint(&p, end, &v) < 0)
+                    return -1;
+                rd->values[i] += (unsigned long long)unzigzag(v);
+            }
+        }
+    } else {
+        return -1; // Unknown type, or a delta without a keyframe before it
+    }
+    rd->have_state = 1;
+    return 1;
+}
+
+int seek_recording(RecordingReader *rd, long long time_us) {
+    if (rd->index_count == 0)
+        return -1;
+    // Last keyframe at or before time_us (the first one if time_us is earlier)
+    size_t lo = 0, hi = rd->index_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rd->index[mid].time_us <= time_us)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    rd->pos = rd->base + rd->index[lo].offset;
+    rd->have_state = 0;
+    rd->pending = 0;
+
+    int rc;
+    while ((rc = decode_next(rd)) == 1) {
+        if (rd->time_us >= time_us) {
+            rd->pending = 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int read_recording(RecordingReader *rd, RecordedSample *out) {
+    if (rd->pending) {
+        rd->pending = 0;
+    } else {
+        int rc = decode_next(rd);
+        if (rc <= 0)
+            return rc;
+    }
+    out->time_us = rd->time_us;
+    out->cpu_slots = (int)rd->header.cpu_slots;
+    out->counters = rd->values;
+    unsigned long *mem = (unsigned long *)&out->mem;
+    const unsigned long long *mem_values = rd->values + (size_t)rd->header.cpu_slots * CPU_STAT_FIELDS;
+    for (size_t i = 0; i < RECORDING_MEM_WORDS; i++)
+        mem[i] = (unsigned long)mem_values[i];
+    return 1;
+}
+
+void close_recording(RecordingReader *rd) {
+    if (rd == NULL)
+        return;
+    munmap((void *)rd->base, rd->size);
+    free(rd->owned_index);
+    free(rd->values);
+    free(rd);
+}
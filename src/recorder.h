@@ -0,0 +1,165 @@
+/**
+ * @file recorder.h
+ * @brief Compact on-disk recording of raw CPU counters and meminfo values.
+ *
+ * Each sample stores every /proc/stat counter (all CPU slots, all fields) and
+ * every MemInfo value. Most samples are delta records: the timestamp as the
+ * zigzag varint of its distance from the nominal interval, a bitmap of the
+ * counters that changed and one zigzag varint per changed counter. Every
+ * keyframe_interval samples a keyframe stores absolute values, so decoding
+ * can start there. Records are buffered per keyframe block and written with
+ * one write() per block, which keeps flash writes few and large.
+ *
+ * File layout:
+ *  - RecordingHeader;
+ *  - records: u8 type ('K' or 'D'), varint payload length, payload;
+ *  - on close, an index of (time, offset) per keyframe followed by a
+ *    RecordingTrailer. A recording cut short by a crash has no index; the
+ *    reader rebuilds it by scanning the records.
+ *
+ * The reader mmap()s the file, finds a timestamp by binary search over the
+ * keyframe index and decodes records only when they are read. Times are wall
+ * clock, so a keyframe earlier than the one before it (the clock was stepped
+ * back) is left out of the index, written or rebuilt, to keep it sorted.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "collector.h"
+#include <stddef.h> // For size_t
+#include <stdint.h> // For the file layout
+
+#define RECORDING_MAGIC "RMREC01"  // Header magic (8 bytes with the terminator)
+#define RECORDING_INDEX_MAGIC "RMIDX01"
+#define RECORDING_VERSION 1
+#define RECORDING_DEFAULT_KEYFRAME 64 // Samples per keyframe block
+
+/* Number of unsigned long values recorded from MemInfo */
+#define RECORDING_MEM_WORDS (sizeof(MemInfo) / sizeof(unsigned long))
+
+/**
+ * @brief File header.
+ */
+typedef struct {
+    char magic[8];              /**< RECORDING_MAGIC. */
+    uint32_t version;           /**< RECORDING_VERSION. */
+    uint32_t cpu_slots;         /**< CPU store slots per sample (aggregate + CPUs). */
+    uint32_t mem_words;         /**< MemInfo values per sample. */
+    uint32_t interval_us;       /**< Nominal sampling interval. */
+    uint32_t keyframe_interval; /**< Samples per keyframe block. */
+    uint32_t reserved;
+} RecordingHeader;
+
+/**
+ * @brief Index entry: one per keyframe.
+ */
+typedef struct {
+    int64_t time_us; /**< Wall-clock time of the keyframe, never below the previous entry's. */
+    uint64_t offset; /**< File offset of the keyframe record. */
+} RecordingIndexEntry;
+
+/**
+ * @brief Last bytes of a closed recording.
+ */
+typedef struct {
+    uint64_t index_offset; /**< File offset of the first RecordingIndexEntry. */
+    uint64_t index_count;  /**< Number of entries. */
+    char magic[8];         /**< RECORDING_INDEX_MAGIC. */
+} RecordingTrailer;
+
+/**
+ * @brief Opaque writer.
+ */
+typedef struct Recorder Recorder;
+
+/**
+ * @brief Opaque mmap-based reader.
+ */
+typedef struct RecordingReader RecordingReader;
+
+/**
+ * @brief One decoded sample.
+ */
+typedef struct {
+    long long time_us;                  /**< Wall-clock time in microseconds. */
+    int cpu_slots;                      /**< Slots per field (slot 0 is the aggregate). */
+    const unsigned long long *counters; /**< counters[field * cpu_slots + slot]; valid until the next read. */
+    MemInfo mem;                        /**< Memory values. */
+} RecordedSample;
+
+/**
+ * @brief Creates (truncates) a recording.
+ *
+ * @param cpu_slots Slots of the CPUStatsStore that will be recorded.
+ * @param interval_ms Nominal sampling interval.
+ * @param keyframe_interval Samples per keyframe (0 for RECORDING_DEFAULT_KEYFRAME).
+ * @return Recorder* The writer, or NULL on failure (errno is set).
+ */
+Recorder *create_recorder(const char *path, int cpu_slots, long interval_ms, int keyframe_interval);
+
+/**
+ * @brief Appends one sample.
+ *
+ * @return int 0 on success, -1 on a write error (errno is set).
+ */
+int record_sample(Recorder *recorder, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief CollectorSink adapter for record_sample(); ctx is the Recorder.
+ */
+void recorder_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief Bytes written so far (header and flushed blocks), and samples recorded.
+ */
+void get_recorder_stats(const Recorder *recorder, unsigned long long *bytes, unsigned long *samples);
+
+/**
+ * @brief Flushes the last block, writes the index and closes the file. Accepts NULL.
+ *
+ * @return int 0 on success, -1 if a write failed.
+ */
+int close_recorder(Recorder *recorder);
+
+/**
+ * @brief Maps a recording and loads (or rebuilds) its keyframe index.
+ *
+ * @return RecordingReader* The reader positioned at the first sample, or NULL on failure.
+ */
+RecordingReader *open_recording(const char *path);
+
+/**
+ * @brief Header of the open recording.
+ */
+const RecordingHeader *recording_header(const RecordingReader *reader);
+
+/**
+ * @brief Number of keyframes in the index.
+ */
+size_t recording_keyframes(const RecordingReader *reader);
+
+/**
+ * @brief Positions the reader on the first sample at or after time_us.
+ *
+ * Binary search over the keyframe index, then at most keyframe_interval
+ * records are decoded (more after the wall clock was stepped back, from the
+ * last keyframe the index kept).
+ *
+ * @return int 0 on success, -1 if no sample is that late.
+ */
+int seek_recording(RecordingReader *reader, long long time_us);
+
+/**
+ * @brief Decodes the next sample.
+ *
+ * @return int 1 if a sample was read, 0 at the end, -1 on a corrupt record.
+ */
+int read_recording(RecordingReader *reader, RecordedSample *sample);
+
+/**
+ * @brief Unmaps the recording and frees the reader. Accepts NULL.
+ */
+void close_recording(RecordingReader *reader);
+
+#endif // RECORDER_H
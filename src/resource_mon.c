@@ -3,108 +3,682 @@
  * @author David, Leandro
  * @brief Main application file for resource monitoring TUI.
  * Initializes the TUI and displays CPU and Memory information
- * in a continuous loop, including per-thread CPU usage.
+ * in a continuous loop, including per-thread CPU usage. Sampling runs
+ * on the collector thread; this thread waits in poll() on the keyboard,
+ * the collector's sample event and SIGWINCH, and renders.
+ *
+ * With --batch no terminal is used: every sample is streamed as CSV, JSON
+ * Lines or binary records. Built with -DNO_TUI only the batch mode is
+ * compiled and the program does not link against ncurses.
+ *
+ * In both modes --record also appends the raw counters of every sample to a
+ * compact recording (see recorder.h), written from the collector thread.
+ *
+ * The monitor also measures itself (selfinfo_manip.h and the per-source
+ * times of every sample): shown in the TUI with 'o' or --overhead, added to
+ * the batch output with --overhead.
+ *
+ * The TUI records every sample, drawn or not, into a fixed-size history
+ * behind the CPU and memory sparklines and the per-thread heatmap ('g').
+ *
+ * With --listen the monitor runs as a headless daemon serving the newest
+ * sample to Prometheus scrapes (see exporter.h) on a TCP port or Unix socket.
+ *
+ * In every mode --shm also publishes each sample to a shared-memory segment
+ * (see snapshot.h) that local agents read without touching /proc.
+ *
+ * With --rules every sample is checked against alert rules (see rules.h) on
+ * this thread: firing alerts are highlighted in the TUI, listed in the batch
+ * output and logged by the exporter daemon, and --alert-hook runs a command
+ * whenever one fires or clears.
+ *
+ * The TUI keeps rolling 1, 5 and 15 minute statistics of every CPU (see
+ * winstats.h), shown with 'w'; --stats adds them to the batch output and
+ * the exporter's metrics.
+ *
+ * The TUI also lists the cgroups of the unified hierarchy (see
+ * cgroupinfo_manip.h) by CPU, memory or throttling, cycled with 'c'.
+ *
+ * With 'i' the thread panel shows each CPU's interrupt and softirq rates
+ * and its busiest interrupt sources (see irqinfo_manip.h) instead.
  */
 
 #include "cpuinfo_manip.h"
 #include "meminfo_manip.h"
-#include <string.h> // Para usar strtok and strncpy
+#include "procinfo_manip.h"
+#include "collector.h"
+#include "batch.h"
+#include "recorder.h"
+#include "exporter.h"
+#include "snapshot.h"
+#include "rules.h"
+#include "winstats.h"
+#ifndef NO_TUI
 #include "tui.h"     // Include the TUI header
-#include <unistd.h> // For sleep()
+#include "dashboard.h"
+#endif
+#include <errno.h>        // For errno
+#include <fcntl.h>        // For open()
+#include <getopt.h>       // For getopt_long()
+#include <poll.h>         // For the event loop
+#include <signal.h>       // For SIGWINCH, SIGINT, SIGTERM
+#include <stdio.h>        // For perror()
+#include <stdlib.h>       // For strtol()
+#include <sys/signalfd.h> // For signalfd()
+#include <unistd.h>       // For read(), close()
 
-int main() {
+#define SAMPLE_INTERVAL_MS 1000 // Default collector period
+#define PSI_WINDOW_US 2000000UL  // Trigger window: 2 s is accepted from unprivileged users
 
-    ui_init();
-    ui_set_nodelay(true);
-    CPUInfo cpu; // Create CPU info structure
-    get_cpu_info(&cpu); // Get static CPU information once
+// Command line options
+typedef struct {
+    long interval_ms;     // Sampling interval
+    int batch;            // Stream samples instead of drawing
+    BatchFormat format;   // Batch output format
+    const char *output;   // Batch output file, NULL for stdout
+    unsigned long count;  // Batch sample limit, 0 for no limit
+    const char *record;   // Recording file, NULL for none
+    const char *listen;   // Exporter address, NULL to not serve
+    const char *shm;      // Shared-memory segment name, NULL to not publish
+    const char *root;     // Directory holding proc/ and sys/, NULL for /
+    const char *rules;    // Alert rule file, NULL for none
+    const char *hook;     // Command run when an alert fires or clears, NULL for none
+    int overhead;         // Report the monitor's own cost
+    int stats;            // Export rolling window statistics
+    long psi_trigger_ms;  // TUI: stall per PSI_WINDOW_US that wakes the collector, 0 for none
+} MonOptions;
 
-    // Buffer for formatting display strings
-    char display_buffer[256];
-    // Buffer for a copy of memory info string because strtok modifies it
-    char meminfo_copy[MEMINFO_STR_LEN];
-    int max_rows, max_cols; // Variables to store terminal dimensions
+// Print command line help
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-i MS] [-r FILE] [-O] [--stats] [--root DIR] [--psi-trigger MS] [--shm NAME] [--rules FILE [--alert-hook CMD]] [--batch [-f csv|jsonl|bin] [-o FILE] [-n COUNT]] [-l ADDR]\n"
+            "  -i, --interval MS   sampling interval in milliseconds (default %d, minimum %d)\n"
+            "  -r, --record FILE   also record the raw counters of every sample to FILE\n"
+            "  -O, --overhead      show (TUI) or export (batch) the monitor's own CPU, RSS, syscalls and times\n"
+            "      --stats         export (batch, exporter) 1/5/15 min min, mean, p95, p99 and max CPU usage\n"
+            "      --root DIR      read proc/ and sys/ under DIR instead of / (e.g. a fixture)\n"
+            "      --shm NAME      also publish every sample to shared memory NAME (e.g. " SNAPSHOT_DEFAULT_NAME ")\n"
+            "      --rules FILE    check every sample against the alert rules in FILE\n"
+            "      --alert-hook CMD  run CMD with /bin/sh when an alert fires or clears\n"
+            "      --psi-trigger MS  TUI: sample at once when cpu, memory or io is stalled MS ms within 2 s\n"
+            "  -b, --batch         headless: stream samples instead of drawing the TUI\n"
+            "  -f, --format FMT    batch output format: csv (default), jsonl or bin\n"
+            "  -o, --output FILE   batch output file (default: stdout)\n"
+            "  -n, --count COUNT   batch: stop after COUNT samples (default: until SIGINT/SIGTERM)\n"
+            "  -l, --listen ADDR   headless: serve Prometheus metrics on [HOST:]PORT or a Unix socket path\n"
+            "  -h, --help          show this help\n",
+            prog, SAMPLE_INTERVAL_MS, COLLECTOR_MIN_INTERVAL_MS);
+}
 
-    get_cpu_usage(&cpu); // Prime the CPU stats (first call might return 0)
+// Parse the command line; returns 1 after --help, -1 and prints usage on bad input
+static int parse_args(int argc, char *argv[], MonOptions *opts) {
+    static const struct option options[] = {
+        { "interval", required_argument, NULL, 'i' },
+        { "batch", no_argument, NULL, 'b' },
+        { "format", required_argument, NULL, 'f' },
+        { "output", required_argument, NULL, 'o' },
+        { "count", required_argument, NULL, 'n' },
+        { "record", required_argument, NULL, 'r' },
+        { "listen", required_argument, NULL, 'l' },
+        { "root", required_argument, NULL, 'R' },
+        { "shm", required_argument, NULL, 'S' },
+        { "rules", required_argument, NULL, 'A' },
+        { "alert-hook", required_argument, NULL, 'H' },
+        { "overhead", no_argument, NULL, 'O' },
+        { "stats", no_argument, NULL, 'W' },
+        { "psi-trigger", required_argument, NULL, 'P' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:bf:o:n:r:l:Oh", options, NULL)) != -1) {
+        char *end;
+        switch (opt) {
+        case 'i':
+            opts->interval_ms = strtol(optarg, &end, 10);
+            if (*end != '\0' || opts->interval_ms < COLLECTOR_MIN_INTERVAL_MS) {
+                fprintf(stderr, "Invalid interval: %s\n", optarg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'b':
+            opts->batch = 1;
+            break;
+        case 'f':
+            if (parse_batch_format(optarg, &opts->format) < 0) {
+                fprintf(stderr, "Unknown format: %s\n", optarg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'o':
+            opts->output = optarg;
+            break;
+        case 'n':
+            opts->count = strtoul(optarg, &end, 10);
+            if (*end != '\0' || opts->count == 0) {
+                fprintf(stderr, "Invalid count: %s\n", optarg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'r':
+            opts->record = optarg;
+            break;
+        case 'l':
+            opts->listen = optarg;
+            break;
+        case 'R':
+            opts->root = optarg;
+            break;
+        case 'S':
+            opts->shm = optarg;
+            break;
+        case 'A':
+            opts->rules = optarg;
+            break;
+        case 'H':
+            opts->hook = optarg;
+            break;
+        case 'O':
+            opts->overhead = 1;
+            break;
+        case 'W':
+            opts->stats = 1;
+            break;
+        case 'P':
+            opts->psi_trigger_ms = strtol(optarg, &end, 10);
+            if (*end != '\0' || opts->psi_trigger_ms <= 0 ||
+                opts->psi_trigger_ms * 1000L > (long)PSI_WINDOW_US) {
+                fprintf(stderr, "Invalid PSI trigger: %s\n", optarg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 1;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if (opts->batch && opts->listen != NULL) {
+        fprintf(stderr, "--batch and --listen cannot be combined\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (opts->hook != NULL && opts->rules == NULL) {
+        fprintf(stderr, "--alert-hook needs --rules\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
 
-    while (1) {
-        sleep(1); // Wait for 1 second for CPU usage delta calculation
+// Open the --record file and register it as a collector sink (before start)
+static int attach_recorder(const MonOptions *opts, Collector *collector, const CPUInfo *cpu,
+                           Recorder **recorder) {
+    *recorder = NULL;
+    if (opts->record == NULL)
+        return 0;
+    *recorder = create_recorder(opts->record, cpu->num_cpus + 1, opts->interval_ms, 0);
+    if (*recorder == NULL) {
+        perror(opts->record);
+        return -1;
+    }
+    return add_collector_sink(collector, recorder_sink, *recorder);
+}
 
-        // Check for exit *after* sleeping but *before* processing
-        if (ui_exit())
-            break;
+// Create the --shm segment and register it as a collector sink (before start)
+static int attach_snapshot(const MonOptions *opts, Collector *collector, const CPUInfo *cpu,
+                           SnapshotWriter **snapshot) {
+    *snapshot = NULL;
+    if (opts->shm == NULL)
+        return 0;
+    *snapshot = create_snapshot_writer(opts->shm, cpu->num_cpus);
+    if (*snapshot == NULL) {
+        perror(opts->shm);
+        return -1;
+    }
+    return add_collector_sink(collector, snapshot_sink, *snapshot);
+}
 
-        get_cpu_usage(&cpu); // Update CPU usage (aggregate and per-thread)
-        char* meminfo_original = get_memory_info(); // Get current memory info
-        ui_get_dims(&max_rows, &max_cols); // *** CORRECTED: Get dimensions ***
+// Compile the --rules file and set the --alert-hook command
+static int load_alert_rules(const MonOptions *opts, const CPUInfo *cpu, RuleSet **rules) {
+    *rules = NULL;
+    if (opts->rules == NULL)
+        return 0;
+    char err[256];
+    *rules = load_rules(opts->rules, cpu->num_cpus, err, sizeof(err));
+    if (*rules == NULL) {
+        fprintf(stderr, "%s\n", err);
+        return -1;
+    }
+    if (opts->hook != NULL && set_rule_hook(*rules, opts->hook) < 0) {
+        perror(opts->hook);
+        return -1;
+    }
+    return 0;
+}
 
-        ui_clear();
+/*
+ * Headless mode: write every sample (not just the newest) until COUNT
+ * samples, SIGINT/SIGTERM or a write error. No terminal is touched.
+ */
+static int run_batch(const MonOptions *opts) {
+    // Signals are read from a signalfd; block them before the collector starts
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    signal(SIGPIPE, SIG_IGN); // A closed reader shows up as EPIPE
+    int signal_fd = signalfd(-1, &stop_signals, SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
+        return 1;
+    }
 
-        // --- CPU Information ---
-        tui_coord_t current_pos = tui_get_relative_coord(0.05f, 0.05f);
+    int out_fd = STDOUT_FILENO;
+    if (opts->output != NULL) {
+        out_fd = open(opts->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0) {
+            perror(opts->output);
+            close(signal_fd);
+            return 1;
+        }
+    }
 
-        tui_draw_text(current_pos, "--- CPU Information ---");
-        current_pos.row++;
-        current_pos.row++;
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    BatchWriter *writer = create_batch_writer(out_fd, opts->format, cpu.num_cpus,
+                                              opts->overhead ? BATCH_OVERHEAD : 0);
+    Collector *collector = create_collector(&cpu, opts->interval_ms, opts->overhead ? COLLECTOR_SELF : 0);
+    Recorder *recorder = NULL;
+    SnapshotWriter *snapshot = NULL;
+    RuleSet *rules = NULL;
+    WindowStats *stats = opts->stats ? create_window_stats(WINSTATS_SERIES(cpu.num_cpus)) : NULL;
+    int status = 1;
+    if (load_alert_rules(opts, &cpu, &rules) < 0)
+        goto out;
+    if (writer == NULL || collector == NULL || (opts->stats && stats == NULL) ||
+        set_batch_rules(writer, rules) < 0 || set_batch_stats(writer, stats) < 0 ||
+        attach_recorder(opts, collector, &cpu, &recorder) < 0 ||
+        attach_snapshot(opts, collector, &cpu, &snapshot) < 0 || write_batch_header(writer) < 0 ||
+        start_collector(collector) < 0) {
+        perror("Error starting the batch writer");
+        goto out;
+    }
 
-        snprintf(display_buffer, sizeof(display_buffer), "Model: %s", cpu.name);
-        tui_draw_text(current_pos, display_buffer);
-        current_pos.row++;
+    enum { FD_SAMPLE, FD_SIGNAL };
+    struct pollfd fds[2] = {
+        [FD_SAMPLE] = { .fd = collector_event_fd(collector), .events = POLLIN },
+        [FD_SIGNAL] = { .fd = signal_fd, .events = POLLIN },
+    };
+    unsigned long written = 0;
+    status = 0;
+    while (opts->count == 0 || written < opts->count) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            status = 1;
+            break;
+        }
+        if (fds[FD_SIGNAL].revents & POLLIN)
+            break;
+        if (!(fds[FD_SAMPLE].revents & POLLIN))
+            continue;
 
-        snprintf(display_buffer, sizeof(display_buffer), "Cores: %d", cpu.cores);
-        tui_draw_text(current_pos, display_buffer);
-        current_pos.row++;
+        collector_clear_event(collector);
+        const Sample *sample;
+        while ((opts->count == 0 || written < opts->count) &&
+               (sample = collector_peek(collector)) != NULL) {
+            if (rules != NULL)
+                evaluate_rules(rules, sample);
+            if (stats != NULL)
+                record_window_stats(stats, sample);
+            int rc = write_batch_sample(writer, sample);
+            collector_release(collector);
+            if (rc < 0) {
+                if (errno != EPIPE)
+                    perror("Error writing sample");
+                status = errno == EPIPE ? 0 : 1;
+                goto out;
+            }
+            written++;
+        }
+    }
 
-        snprintf(display_buffer, sizeof(display_buffer), "Threads: %d", cpu.threads);
-        tui_draw_text(current_pos, display_buffer);
-        current_pos.row++;
+out:
+    destroy_collector(collector); // Joins the thread that feeds the recorder
+    destroy_snapshot_writer(snapshot);
+    if (close_recorder(recorder) < 0 && status == 0) {
+        perror(opts->record);
+        status = 1;
+    }
+    destroy_batch_writer(writer);
+    destroy_rules(rules);
+    destroy_window_stats(stats);
+    free_cpu_info(&cpu);
+    if (out_fd != STDOUT_FILENO)
+        close(out_fd);
+    close(signal_fd);
+    return status;
+}
 
-        snprintf(display_buffer, sizeof(display_buffer), "Usage: %.2f%%", cpu.usage);
-        tui_draw_text(current_pos, display_buffer);
-        current_pos.row++;
+// Log the alerts that fired or cleared with the last evaluation
+static void log_alert_events(const RuleSet *rules) {
+    int count;
+    const RuleEvent *events = rule_events(rules, &count);
+    for (int i = 0; i < count; i++) {
+        char label[RULES_LABEL_LEN];
+        format_alert_label(rules, events[i].rule, events[i].instance, label, sizeof(label));
+        fprintf(stderr, "alert %s: %s (%.2f)\n", events[i].firing ? "firing" : "cleared", label, events[i].value);
+    }
+}
 
-        // --- Thread Usage ---
-        current_pos.row += 2;
-        tui_draw_text(current_pos, "--- Thread Usage ---");
-        current_pos.row++;
-        current_pos.row++;
+/*
+ * Exporter mode: serve the newest sample until SIGINT/SIGTERM. Responses
+ * are rendered on the collector thread and sent by the exporter's own
+ * thread; this one drains the sample ring, checks the alert rules and
+ * waits for a signal.
+ */
+static int run_serve(const MonOptions *opts) {
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    int signal_fd = signalfd(-1, &stop_signals, SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
+        return 1;
+    }
 
-        for (int i = 0; i < cpu.threads; i++) {
-            // *** CORRECTED: Use max_rows for boundary check ***
-            if (current_pos.row >= max_rows - 1) { // -1 leaves one line margin
-                tui_draw_text(current_pos, "..."); // Indicate more threads exist
-                break; // Stop drawing threads if we hit the bottom
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    Exporter *exporter = create_exporter(opts->listen, cpu.num_cpus);
+    if (exporter == NULL) {
+        perror(opts->listen);
+        free_cpu_info(&cpu);
+        close(signal_fd);
+        return 1;
+    }
+    Collector *collector = create_collector(&cpu, opts->interval_ms, 0);
+    Recorder *recorder = NULL;
+    SnapshotWriter *snapshot = NULL;
+    RuleSet *rules = NULL;
+    WindowStats *stats = NULL;
+    int status = 1;
+    if (load_alert_rules(opts, &cpu, &rules) < 0)
+        goto out;
+    if (opts->stats && collector != NULL) {
+        // Recorded on the collector thread, before the exporter renders them
+        stats = create_window_stats(WINSTATS_SERIES(cpu.num_cpus));
+        if (stats == NULL || add_collector_sink(collector, window_stats_sink, stats) < 0 ||
+            set_exporter_stats(exporter, stats) < 0) {
+            perror("Error allocating the window statistics");
+            goto out;
+        }
+    }
+    if (collector == NULL || add_collector_sink(collector, exporter_sink, exporter) < 0 ||
+        attach_recorder(opts, collector, &cpu, &recorder) < 0 ||
+        attach_snapshot(opts, collector, &cpu, &snapshot) < 0 || start_exporter(exporter) < 0 ||
+        start_collector(collector) < 0) {
+        perror("Error starting the exporter");
+        goto out;
+    }
+    if (exporter_port(exporter) != 0)
+        fprintf(stderr, "Serving metrics on port %d\n", exporter_port(exporter));
+
+    enum { FD_SAMPLE, FD_SIGNAL };
+    struct pollfd fds[2] = {
+        [FD_SAMPLE] = { .fd = collector_event_fd(collector), .events = POLLIN },
+        [FD_SIGNAL] = { .fd = signal_fd, .events = POLLIN },
+    };
+    status = 0;
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            status = 1;
+            break;
+        }
+        if (fds[FD_SIGNAL].revents & POLLIN)
+            break;
+        if (fds[FD_SAMPLE].revents & POLLIN) {
+            // Samples are already served by the sink; keep the ring from counting drops
+            collector_clear_event(collector);
+            const Sample *sample;
+            while ((sample = collector_peek(collector)) != NULL) {
+                if (rules != NULL && evaluate_rules(rules, sample) > 0)
+                    log_alert_events(rules);
+                collector_release(collector);
             }
-            snprintf(display_buffer, sizeof(display_buffer), "Thread %2d: %6.2f%%", i, cpu.thread_usage[i]);
-            tui_draw_text(current_pos, display_buffer);
-            current_pos.row++;
         }
+    }
 
-        // --- Memory Information ---
-        // Position memory info to the right (e.g., 50% across)
-        tui_coord_t mem_pos = tui_get_relative_coord(0.05f, 0.50f);
+out:
+    destroy_collector(collector); // Joins the thread that feeds the exporter and the recorder
+    destroy_exporter(exporter);
+    destroy_snapshot_writer(snapshot);
+    destroy_rules(rules);
+    destroy_window_stats(stats);
+    if (close_recorder(recorder) < 0 && status == 0) {
+        perror(opts->record);
+        status = 1;
+    }
+    free_cpu_info(&cpu);
+    close(signal_fd);
+    return status;
+}
 
-        tui_draw_text(mem_pos, "--- Memory Information ---");
-        mem_pos.row++;
-        mem_pos.row++;
+#ifndef NO_TUI
+// Register the --psi-trigger thresholds on every resource (before start)
+static int attach_psi_triggers(const MonOptions *opts, Collector *collector) {
+    if (opts->psi_trigger_ms == 0)
+        return 0;
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        if (add_collector_psi_trigger(collector, (PSIResource)r, 0, (unsigned long)opts->psi_trigger_ms * 1000UL,
+                                      PSI_WINDOW_US) < 0) {
+            perror("PSI trigger");
+            return -1;
+        }
+    }
+    return 0;
+}
 
-        strncpy(meminfo_copy, meminfo_original, MEMINFO_STR_LEN - 1);
-        meminfo_copy[MEMINFO_STR_LEN - 1] = '\0';
+// Add a sample to the history and the window statistics and check it
+// against the rules once: the sample on screen is peeked again when newer
+// ones arrive
+static void record_new_sample(History *history, WindowStats *stats, RuleSet *rules, const Sample *sample,
+                              unsigned long *recorded_seq) {
+    if (sample->seq <= *recorded_seq)
+        return;
+    record_dashboard_history(history, sample);
+    record_window_stats(stats, sample);
+    if (rules != NULL)
+        evaluate_rules(rules, sample);
+    *recorded_seq = sample->seq;
+}
+
+/*
+ * Interactive mode: draw the newest sample whenever one arrives, handle keys
+ * as soon as they are typed and follow terminal resizes.
+ */
+static int run_tui(const MonOptions *opts) {
+    // SIGWINCH is read from a signalfd; block it before any thread starts
+    // so every thread inherits the mask
+    sigset_t winch;
+    sigemptyset(&winch);
+    sigaddset(&winch, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &winch, NULL);
+    int winch_fd = signalfd(-1, &winch, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    CPUInfo cpu; // Create CPU info structure
+    get_cpu_info(&cpu); // Get static CPU information once
 
-        char *line = strtok(meminfo_copy, "\n");
-        // *** CORRECTED: Use max_rows for boundary check ***
-        while (line != NULL && mem_pos.row < max_rows - 1) {
-            if (*line != '\0') {
-                tui_draw_text(mem_pos, line);
-                mem_pos.row++;
+    // Sampling runs on its own thread; this thread only renders. The self
+    // source is cheap (two preads) and lets 'o' show the panel at any time
+    Collector *collector = create_collector(&cpu, opts->interval_ms,
+                                           COLLECTOR_PROCESSES | COLLECTOR_SELF | COLLECTOR_TOPOLOGY |
+                                           COLLECTOR_THERMAL | COLLECTOR_DISKS | COLLECTOR_NET | COLLECTOR_PSI |
+                                           COLLECTOR_CGROUPS | COLLECTOR_IRQS);
+    Recorder *recorder = NULL;
+    SnapshotWriter *snapshot = NULL;
+    RuleSet *rules = NULL;
+    History *history = create_history(HISTORY_SERIES(cpu.num_cpus), HISTORY_CAPACITY);
+    WindowStats *stats = create_window_stats(WINSTATS_SERIES(cpu.num_cpus));
+    if (load_alert_rules(opts, &cpu, &rules) < 0) {
+        destroy_collector(collector);
+        destroy_rules(rules);
+        destroy_history(history);
+        destroy_window_stats(stats);
+        free_cpu_info(&cpu);
+        return 1;
+    }
+    if (winch_fd < 0 || collector == NULL || history == NULL || stats == NULL ||
+        attach_recorder(opts, collector, &cpu, &recorder) < 0 ||
+        attach_snapshot(opts, collector, &cpu, &snapshot) < 0 ||
+        attach_psi_triggers(opts, collector) < 0 || start_collector(collector) < 0) {
+        perror("Error starting the collector");
+        destroy_collector(collector);
+        destroy_snapshot_writer(snapshot);
+        close_recorder(recorder);
+        destroy_rules(rules);
+        destroy_history(history);
+        destroy_window_stats(stats);
+        free_cpu_info(&cpu);
+        return 1;
+    }
+    DashboardView view = { .proc_sort = PROC_SORT_CPU, .show_overhead = opts->overhead, .history = history,
+                           .rules = rules, .stats = stats };
+
+    ui_init();
+    ui_set_nodelay(true);
+
+    // Wait on keyboard, new samples and terminal resizes together
+    enum { FD_INPUT, FD_SAMPLE, FD_WINCH };
+    struct pollfd fds[3] = {
+        [FD_INPUT] = { .fd = STDIN_FILENO, .events = POLLIN },
+        [FD_SAMPLE] = { .fd = collector_event_fd(collector), .events = POLLIN },
+        [FD_WINCH] = { .fd = winch_fd, .events = POLLIN },
+    };
+    const Sample *sample = NULL; // Latest sample, held until a newer one arrives
+    unsigned long recorded_seq = 0; // Last sample added to the history
+    int running = 1;
+
+    while (running) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        int redraw = 0;
+
+        // Check for exit and commands
+        if (fds[FD_INPUT].revents & (POLLIN | POLLHUP)) {
+            int key;
+            while ((key = ui_get_key()) != ERR) {
+                if (key == 'q' || key == 'Q') {
+                    running = 0;
+                    break;
+                }
+                if (key == 's' || key == 'S') {
+                    view.proc_sort = view.proc_sort == PROC_SORT_CPU ? PROC_SORT_RSS : PROC_SORT_CPU;
+                    set_collector_proc_sort(collector, view.proc_sort);
+                    redraw = 1;
+                }
+                if (key == 'o' || key == 'O') {
+                    view.show_overhead = !view.show_overhead;
+                    redraw = 1;
+                }
+                if (key == 'g' || key == 'G') {
+                    view.show_heatmap = !view.show_heatmap;
+                    redraw = 1;
+                }
+                if (key == 'w' || key == 'W') { // Off, 1, 5, 15 minutes
+                    view.show_stats = (view.show_stats + 1) % (WINSTATS_WINDOWS + 1);
+                    redraw = 1;
+                }
+                if (key == 'i' || key == 'I') {
+                    view.show_irqs = !view.show_irqs;
+                    redraw = 1;
+                }
+                if (key == 'c' || key == 'C') {
+                    view.cgroup_sort = (CgroupSortKey)((view.cgroup_sort + 1) % CGROUP_SORT_KEYS);
+                    redraw = 1;
+                }
             }
-            line = strtok(NULL, "\n");
+            if (fds[FD_INPUT].revents & POLLHUP)
+                running = 0;
         }
 
-        ui_refresh(); // Update the screen
-        // sleep(1); // Moved to the top of the loop
+        if (fds[FD_WINCH].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            while (read(winch_fd, &info, sizeof(info)) == sizeof(info))
+                ;
+            ui_resize();
+            redraw = 1;
+        }
+
+        // Only the newest pending sample is drawn; older ones are skipped
+        // but still recorded, so the graphs have no gaps
+        if (fds[FD_SAMPLE].revents & POLLIN) {
+            collector_clear_event(collector);
+            while (collector_pending(collector) > 1) {
+                record_new_sample(history, stats, rules, collector_peek(collector), &recorded_seq);
+                collector_release(collector);
+            }
+            sample = collector_peek(collector);
+            if (sample != NULL)
+                record_new_sample(history, stats, rules, sample, &recorded_seq);
+            redraw = 1;
+        }
+
+        if (running && redraw && sample != NULL)
+            draw_dashboard(&cpu, sample, &view);
     }
 
+    release_dashboard();
     ui_cleanup();
-    return 0;
-}
\ No newline at end of file
+    destroy_collector(collector);
+    destroy_snapshot_writer(snapshot);
+    destroy_rules(rules);
+    destroy_history(history);
+    destroy_window_stats(stats);
+    int status = 0;
+    if (close_recorder(recorder) < 0) {
+        perror(opts->record);
+        status = 1;
+    }
+    close(winch_fd);
+    free_cpu_info(&cpu);
+    return status;
+}
+#endif // NO_TUI
+
+int main(int argc, char *argv[]) {
+
+    MonOptions opts = { .interval_ms = SAMPLE_INTERVAL_MS, .format = BATCH_CSV };
+    int args = parse_args(argc, argv, &opts);
+    if (args != 0)
+        return args < 0 ? 2 : 0;
+    if (set_proc_root(opts.root) < 0) {
+        perror(opts.root);
+        return 2;
+    }
+
+    if (opts.batch)
+        return run_batch(&opts);
+    if (opts.listen != NULL)
+        return run_serve(&opts);
+#ifdef NO_TUI
+    fprintf(stderr, "%s: built without the TUI, use --batch or --listen\n", argv[0]);
+    return 2;
+#else
+    return run_tui(&opts);
+#endif
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ring.h
+ * @brief Single-producer/single-consumer lock-free ring of slot indices.
+ *
+ * The ring only hands out indices; the caller owns an array of
+ * `capacity` preallocated slots. The producer fills slot
+ * ring_write_slot() and publishes it with ring_commit_write(); the consumer
+ * reads slot ring_read_slot() and frees it with ring_release_read(). Head
+ * and tail live on separate cache lines and are only written by their own
+ * side, so no lock or compare-and-swap is needed.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h> // For atomic_size_t and explicit memory orders
+#include <stddef.h>    // For size_t
+
+#define RING_CACHE_LINE 64 // Keeps producer and consumer counters apart
+
+/**
+ * @brief Ring state. Capacity must be a power of two.
+ */
+typedef struct {
+    _Alignas(RING_CACHE_LINE) atomic_size_t head; /**< Written only by the producer: next slot to fill. */
+    _Alignas(RING_CACHE_LINE) atomic_size_t tail; /**< Written only by the consumer: next slot to read. */
+    _Alignas(RING_CACHE_LINE) size_t capacity;    /**< Number of slots (power of two). */
+} SpscRing;
+
+/* Initialize an empty ring of capacity slots (power of two) */
+static inline void init_spsc_ring(SpscRing *ring, size_t capacity) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->capacity = capacity;
+}
+
+/* Producer: index of the slot to fill, or -1 when the ring is full */
+static inline long ring_write_slot(SpscRing *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == ring->capacity)
+        return -1;
+    return (long)(head & (ring->capacity - 1));
+}
+
+/* Producer: publish the slot returned by ring_write_slot() */
+static inline void ring_commit_write(SpscRing *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Consumer: index of the oldest published slot, or -1 when the ring is empty */
+static inline long ring_read_slot(SpscRing *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail)
+        return -1;
+    return (long)(tail & (ring->capacity - 1));
+}
+
+/* Consumer: hand the slot returned by ring_read_slot() back to the producer */
+static inline void ring_release_read(SpscRing *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/* Either side: number of published, unread slots (a snapshot) */
+static inline size_t ring_count(SpscRing *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+#endif // RING_H
@@ -0,0 +1,755 @@
+/**
+ * @file rules.c
+ * @brief Implementation of the alert rules: compiler, evaluator and hooks.
+ */
+
+#include "rules.h"
+#include <ctype.h>   // For isspace()
+#include <errno.h>   // For errno
+#include <fcntl.h>   // For O_RDONLY
+#include <math.h>    // For exp(), NAN
+#include <spawn.h>   // For posix_spawn()
+#include <stdarg.h>  // For the error messages
+#include <stdio.h>   // For snprintf()
+#include <stdlib.h>  // For calloc(), strtod()
+#include <string.h>  // For strcmp(), strerror()
+#include <sys/wait.h> // For waitpid()
+
+#define NSEC_PER_SEC 1000000000LL
+#define RULES_MAX_FILE (1 << 20) // Largest rule file read
+#define RULES_MAX_TOKENS 12      // NAME: METRIC rising OP VALUE for D clear V, with room for mistakes
+#define RULES_ENV_LEN 128        // One RESOURCE_MON_* variable
+
+extern char **environ;
+
+// Comparison of a rule
+enum { OP_GT, OP_GE, OP_LT, OP_LE };
+
+// Rate units; a rate rule smooths with a time constant of one unit
+enum { UNIT_S, UNIT_MIN, UNIT_H, UNITS };
+static const double unit_seconds[UNITS] = { 1.0, 60.0, 3600.0 };
+
+// Metrics computed once per sample; cpu.thread values come from the sample
+enum {
+    METRIC_CPU_USAGE,
+    METRIC_MEM_USED_PCT,
+    METRIC_MEM_AVAILABLE_MB,
+    METRIC_SWAP_USED_PCT,
+    METRIC_PSI_CPU_SOME,
+    METRIC_PSI_MEMORY_SOME,
+    METRIC_PSI_MEMORY_FULL,
+    METRIC_PSI_IO_SOME,
+    METRIC_PSI_IO_FULL,
+    METRIC_TEMP_C,
+    METRIC_DISK_UTIL,
+    METRIC_JITTER_MS,
+    METRIC_SCALARS,
+    METRIC_THREAD = METRIC_SCALARS,
+};
+
+static const char *const metric_names[METRIC_SCALARS] = {
+    "cpu.usage",     "mem.used_pct", "mem.available_mb", "swap.used_pct",  "psi.cpu.some",      "psi.memory.some",
+    "psi.memory.full", "psi.io.some", "psi.io.full",     "thermal.temp_c", "disk.util",         "sample.jitter_ms",
+};
+
+// One compiled rule; the text lives apart so evaluation stays on dense data
+typedef struct {
+    unsigned char metric;
+    unsigned char op;
+    signed char rate;   // 0 for a level, 1 rising, -1 falling
+    unsigned char unit; // Rate unit
+    int cpu;            // cpu.thread[N], -1 for every CPU
+    int first;          // First state
+    int instances;      // States (CPUs for cpu.thread[*], otherwise 1)
+    int active;         // States pending or firing: 0 lets a per-CPU rule be skipped
+    double threshold;
+    double clear;
+    long long for_ns;
+} Rule;
+
+// One alert: a rule on one CPU, or a scalar rule
+typedef struct {
+    long long since_ns; // Condition holds since
+    double value;       // Value (or rate) at the last evaluation
+    double average;     // Exponential average behind a rate
+    unsigned char pending; // Condition holds (also while firing)
+    unsigned char firing;
+    unsigned char primed;  // average holds a value
+} AlertState;
+
+struct RuleSet {
+    Rule *rules;
+    char (*names)[RULES_NAME_LEN];
+    int count;
+    AlertState *states;
+    int state_count;
+    int num_cpus;
+    int per_cpu;            // Some rule covers every CPU: compute the extremes
+    int firing;
+    long long last_ns;      // Time of the previous sample, 0 before the first
+    RuleEvent events[RULES_MAX_EVENTS];
+    int event_count;
+    RuleStats stats;
+
+    char *hook;             // Command, NULL for none
+    char **envp;            // The environment plus the three variables below
+    char env_alert[RULES_ENV_LEN], env_state[RULES_ENV_LEN], env_value[RULES_ENV_LEN];
+    posix_spawn_file_actions_t actions; // stdin and stdout on /dev/null
+    pid_t hooks[RULES_MAX_HOOKS];
+    int hook_count;
+};
+
+/* ------------------ Compiler ------------------ */
+
+static void set_error(char *err, size_t len, const char *fmt, ...) {
+    if (err == NULL || len == 0)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(err, len, fmt, ap);
+    va_end(ap);
+}
+
+static int is_op_char(char c) {
+    return c == '<' || c == '>' || c == '=';
+}
+
+/*
+ * Split a line into tokens copied to scratch (twice the line length plus
+ * one): words, and operators even when they touch a word ("cpu.usage>90").
+ * Returns the number of tokens, -1 if too many.
+ */
+static int tokenize(const char *line, char *tokens[RULES_MAX_TOKENS], char *scratch) {
+    int n = 0;
+    const char *p = line;
+    char *out = scratch;
+    while (*p != '\0') {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        if (n == RULES_MAX_TOKENS)
+            return -1;
+        tokens[n++] = out;
+        if (is_op_char(*p)) {
+            while (is_op_char(*p))
+                *out++ = *p++;
+        } else {
+            while (*p != '\0' && !isspace((unsigned char)*p) && !is_op_char(*p))
+                *out++ = *p++;
+        }
+        *out++ = '\0';
+    }
+    return n;
+}
+
+static int parse_op(const char *s) {
+    if (strcmp(s, ">") == 0)
+        return OP_GT;
+    if (strcmp(s, ">=") == 0)
+        return OP_GE;
+    if (strcmp(s, "<") == 0)
+        return OP_LT;
+    if (strcmp(s, "<=") == 0)
+        return OP_LE;
+    return -1;
+}
+
+static const char *const unit_names[UNITS] = { "s", "min", "h" };
+
+// Metric index and CPU (-1 for every CPU, or for a scalar); -1 if unknown
+static int parse_metric(const char *s, int num_cpus, int *cpu) {
+    *cpu = -1;
+    for (int m = 0; m < METRIC_SCALARS; m++)
+        if (strcmp(s, metric_names[m]) == 0)
+            return m;
+    const char *prefix = "cpu.thread[";
+    size_t len = strlen(prefix);
+    if (strncmp(s, prefix, len) != 0)
+        return -1;
+    s += len;
+    if (strcmp(s, "*]") == 0)
+        return METRIC_THREAD;
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (end == s || strcmp(end, "]") != 0 || n < 0 || n >= num_cpus)
+        return -1;
+    *cpu = (int)n;
+    return METRIC_THREAD;
+}
+
+// "10s", "500ms", "2m", "2min", "1h" to nanoseconds; -1 if malformed
+static long long parse_duration(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v < 0)
+        return -1;
+    double scale;
+    if (strcmp(end, "ms") == 0)
+        scale = 1e6;
+    else if (strcmp(end, "s") == 0)
+        scale = 1e9;
+    else if (strcmp(end, "m") == 0 || strcmp(end, "min") == 0)
+        scale = 60e9;
+    else if (strcmp(end, "h") == 0)
+        scale = 3600e9;
+    else
+        return -1;
+    return (long long)(v * scale);
+}
+
+static int parse_number(const char *s, double *v) {
+    char *end;
+    *v = strtod(s, &end);
+    return end != s && *end == '\0' && isfinite(*v) ? 0 : -1;
+}
+
+static int valid_name(const char *s, size_t len) {
+    if (len == 0 || len >= RULES_NAME_LEN)
+        return 0;
+    for (size_t i = 0; i < len; i++)
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_' && s[i] != '-' && s[i] != '.')
+            return 0;
+    return 1;
+}
+
+// Append s to the normalized text of an unnamed rule
+static void append_text(char *text, const char *s) {
+    size_t used = strlen(text);
+    snprintf(text + used, RULES_NAME_LEN - used, "%s%s", used ? " " : "", s);
+}
+
+/*
+ * Compile one line into rule and name, with scratch room for its tokens.
+ * Returns 1 for a rule, 0 for a blank or comment line and -1 with err set
+ * on a syntax error.
+ */
+static int compile_line(char *line, char *scratch, int num_cpus, Rule *rule, char *name, char *err,
+                        size_t err_len) {
+    char *hash = strchr(line, '#');
+    if (hash != NULL)
+        *hash = '\0';
+    char *tokens[RULES_MAX_TOKENS];
+    int n = tokenize(line, tokens, scratch);
+    if (n == 0)
+        return 0;
+    if (n < 0) {
+        set_error(err, err_len, "too many words");
+        return -1;
+    }
+
+    memset(rule, 0, sizeof(*rule));
+    name[0] = '\0';
+    int t = 0;
+    size_t len = strlen(tokens[0]);
+    if (len > 0 && tokens[0][len - 1] == ':') {
+        if (!valid_name(tokens[0], len - 1)) {
+            set_error(err, err_len, "invalid rule name '%s'", tokens[0]);
+            return -1;
+        }
+        memcpy(name, tokens[0], len - 1);
+        name[len - 1] = '\0';
+        t++;
+    }
+    int named = name[0] != '\0';
+    char text[RULES_NAME_LEN] = "";
+
+    if (t == n) {
+        set_error(err, err_len, "missing metric");
+        return -1;
+    }
+    int metric = parse_metric(tokens[t], num_cpus, &rule->cpu);
+    if (metric < 0) {
+        set_error(err, err_len, "unknown metric '%s'", tokens[t]);
+        return -1;
+    }
+    rule->metric = (unsigned char)metric;
+    append_text(text, tokens[t++]);
+
+    if (t < n && (strcmp(tokens[t], "rising") == 0 || strcmp(tokens[t], "falling") == 0)) {
+        rule->rate = tokens[t][0] == 'r' ? 1 : -1;
+        append_text(text, tokens[t++]);
+    }
+
+    int op = t < n ? parse_op(tokens[t]) : -1;
+    if (op < 0) {
+        set_error(err, err_len, "expected >, >=, < or <= after the metric");
+        return -1;
+    }
+    rule->op = (unsigned char)op;
+    append_text(text, tokens[t++]);
+
+    if (t == n) {
+        set_error(err, err_len, "missing threshold");
+        return -1;
+    }
+    char *slash = strchr(tokens[t], '/');
+    if ((slash != NULL) != (rule->rate != 0)) {
+        set_error(err, err_len, rule->rate ? "a rate needs a unit, e.g. 5/min" : "unexpected '/' in '%s'",
+                  tokens[t]);
+        return -1;
+    }
+    if (slash != NULL) {
+        *slash = '\0';
+        int u;
+        for (u = 0; u < UNITS && strcmp(slash + 1, unit_names[u]) != 0; u++)
+            ;
+        if (u == UNITS) {
+            set_error(err, err_len, "unknown rate unit '%s' (s, min or h)", slash + 1);
+            return -1;
+        }
+        rule->unit = (unsigned char)u;
+    }
+    if (parse_number(tokens[t], &rule->threshold) < 0) {
+        set_error(err, err_len, "invalid threshold '%s'", tokens[t]);
+        return -1;
+    }
+    append_text(text, tokens[t]);
+    if (slash != NULL) {
+        *slash = '/';
+        size_t used = strlen(text);
+        snprintf(text + used, RULES_NAME_LEN - used, "/%s", unit_names[rule->unit]);
+    }
+    t++;
+
+    // Default clear value: RULES_HYSTERESIS of the threshold on the quiet side
+    double band = fabs(rule->threshold) * RULES_HYSTERESIS;
+    int above = rule->op == OP_GT || rule->op == OP_GE;
+    rule->clear = above ? rule->threshold - band : rule->threshold + band;
+    int have_for = 0, have_clear = 0;
+    while (t < n) {
+        const char *key = tokens[t++];
+        if (t == n) {
+            set_error(err, err_len, "'%s' needs a value", key);
+            return -1;
+        }
+        if (strcmp(key, "for") == 0 && !have_for) {
+            if ((rule->for_ns = parse_duration(tokens[t])) < 0) {
+                set_error(err, err_len, "invalid duration '%s'", tokens[t]);
+                return -1;
+            }
+            have_for = 1;
+        } else if (strcmp(key, "clear") == 0 && !have_clear) {
+            if (parse_number(tokens[t], &rule->clear) < 0) {
+                set_error(err, err_len, "invalid clear value '%s'", tokens[t]);
+                return -1;
+            }
+            if (above ? rule->clear > rule->threshold : rule->clear < rule->threshold) {
+                set_error(err, err_len, "clear value %s is on the firing side of the threshold", tokens[t]);
+                return -1;
+            }
+            have_clear = 1;
+        } else {
+            set_error(err, err_len, "unexpected '%s'", key);
+            return -1;
+        }
+        append_text(text, key);
+        append_text(text, tokens[t++]);
+    }
+    if (!named)
+        memcpy(name, text, RULES_NAME_LEN);
+    return 1;
+}
+
+RuleSet *compile_rules(const char *text, int num_cpus, char *err, size_t err_len) {
+    if (num_cpus <= 0) {
+        set_error(err, err_len, "no CPU");
+        errno = EINVAL;
+        return NULL;
+    }
+    RuleSet *rs = calloc(1, sizeof(*rs));
+    char *copy = strdup(text);
+    char *scratch = malloc(2 * strlen(text) + 1);
+    if (rs == NULL || copy == NULL || scratch == NULL) {
+        free(rs);
+        free(copy);
+        free(scratch);
+        set_error(err, err_len, "%s", strerror(ENOMEM));
+        return NULL;
+    }
+    rs->num_cpus = num_cpus;
+
+    int cap = 0, line_no = 0;
+    char *line = copy;
+    while (line != NULL) {
+        char *next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        line_no++;
+        if (rs->count == cap) {
+            cap = cap ? cap * 2 : 16;
+            Rule *rules = realloc(rs->rules, (size_t)cap * sizeof(*rules));
+            if (rules != NULL)
+                rs->rules = rules;
+            char(*names)[RULES_NAME_LEN] = realloc(rs->names, (size_t)cap * sizeof(*names));
+            if (names != NULL)
+                rs->names = names;
+            if (rules == NULL || names == NULL) {
+                set_error(err, err_len, "%s", strerror(ENOMEM));
+                goto fail;
+            }
+        }
+        char reason[128];
+        int rc = compile_line(line, scratch, num_cpus, &rs->rules[rs->count], rs->names[rs->count], reason,
+                              sizeof(reason));
+        if (rc < 0) {
+            set_error(err, err_len, "line %d: %s", line_no, reason);
+            errno = EINVAL;
+            goto fail;
+        }
+        rs->count += rc;
+        line = next;
+    }
+
+    // One state per alert, laid out in rule order
+    for (int i = 0; i < rs->count; i++) {
+        Rule *r = &rs->rules[i];
+        r->first = rs->state_count;
+        r->instances = r->metric == METRIC_THREAD && r->cpu < 0 ? num_cpus : 1;
+        rs->per_cpu |= r->metric == METRIC_THREAD && r->cpu < 0;
+        rs->state_count += r->instances;
+    }
+    rs->states = calloc((size_t)rs->state_count + 1, sizeof(*rs->states));
+    if (rs->states == NULL) {
+        set_error(err, err_len, "%s", strerror(ENOMEM));
+        goto fail;
+    }
+    free(copy);
+    free(scratch);
+    return rs;
+
+fail:
+    free(copy);
+    free(scratch);
+    destroy_rules(rs);
+    return NULL;
+}
+
+RuleSet *load_rules(const char *path, int num_cpus, char *err, size_t err_len) {
+    FILE *f = fopen(path, "re");
+    if (f == NULL) {
+        set_error(err, err_len, "%s: %s", path, strerror(errno));
+        return NULL;
+    }
+    char *text = malloc(RULES_MAX_FILE + 1);
+    size_t len = text != NULL ? fread(text, 1, RULES_MAX_FILE + 1, f) : 0;
+    int failed = text == NULL || ferror(f);
+    fclose(f);
+    if (failed || len > RULES_MAX_FILE) {
+        set_error(err, err_len, "%s: %s", path, failed ? strerror(text ? EIO : ENOMEM) : "file too large");
+        free(text);
+        return NULL;
+    }
+    text[len] = '\0';
+    char reason[160];
+    RuleSet *rs = compile_rules(text, num_cpus, reason, sizeof(reason));
+    free(text);
+    if (rs == NULL) {
+        // "line N: why" becomes "PATH:N: why"
+        int line;
+        const char *why = strchr(reason, ':');
+        if (sscanf(reason, "line %d:", &line) == 1 && why != NULL)
+            set_error(err, err_len, "%s:%d:%s", path, line, why + 1);
+        else
+            set_error(err, err_len, "%s: %s", path, reason);
+    }
+    return rs;
+}
+
+/* ------------------ Hooks ------------------ */
+
+int set_rule_hook(RuleSet *rs, const char *command) {
+    int env_count = 0;
+    while (environ[env_count] != NULL)
+        env_count++;
+    char *hook = strdup(command);
+    char **envp = calloc((size_t)env_count + 4, sizeof(*envp));
+    if (hook == NULL || envp == NULL) {
+        free(hook);
+        free(envp);
+        return -1;
+    }
+    // The environment is copied once; the three variables are rewritten per event
+    int n = 0;
+    for (int i = 0; i < env_count; i++)
+        if (strncmp(environ[i], "RESOURCE_MON_", 13) != 0)
+            envp[n++] = environ[i];
+    envp[n++] = rs->env_alert;
+    envp[n++] = rs->env_state;
+    envp[n++] = rs->env_value;
+
+    if (rs->hook != NULL)
+        posix_spawn_file_actions_destroy(&rs->actions);
+    free(rs->hook);
+    free(rs->envp);
+    rs->hook = hook;
+    rs->envp = envp;
+    posix_spawn_file_actions_init(&rs->actions);
+    posix_spawn_file_actions_addopen(&rs->actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&rs->actions, 1, "/dev/null", O_WRONLY, 0);
+    return 0;
+}
+
+// Forget hooks that have exited
+static void reap_hooks(RuleSet *rs) {
+    for (int i = 0; i < rs->hook_count;) {
+        if (waitpid(rs->hooks[i], NULL, WNOHANG) != 0)
+            rs->hooks[i] = rs->hooks[--rs->hook_count];
+        else
+            i++;
+    }
+}
+
+static void start_hook(RuleSet *rs, const RuleEvent *e) {
+    if (rs->hook_count == RULES_MAX_HOOKS) {
+        rs->stats.hooks_skipped++;
+        return;
+    }
+    char label[RULES_LABEL_LEN];
+    format_alert_label(rs, e->rule, e->instance, label, sizeof(label));
+    snprintf(rs->env_alert, sizeof(rs->env_alert), "RESOURCE_MON_ALERT=%s", label);
+    snprintf(rs->env_state, sizeof(rs->env_state), "RESOURCE_MON_STATE=%s", e->firing ? "firing" : "cleared");
+    snprintf(rs->env_value, sizeof(rs->env_value), "RESOURCE_MON_VALUE=%.2f", e->value);
+    char *argv[] = { "sh", "-c", rs->hook, NULL };
+    pid_t pid;
+    if (posix_spawn(&pid, "/bin/sh", &rs->actions, NULL, argv, rs->envp) != 0) {
+        rs->stats.hooks_skipped++;
+        return;
+    }
+    rs->hooks[rs->hook_count++] = pid;
+    rs->stats.hooks++;
+}
+
+/* ------------------ Evaluator ------------------ */
+
+static double percent_of(double part, double whole) {
+    return whole > 0 ? part * 100.0 / whole : 0.0;
+}
+
+static double psi_value(const PSIInfo *psi, PSIResource res, int full) {
+    const PSIPressure *p = &psi->res[res];
+    return p->available ? (full ? p->full_pct : p->some_pct) : NAN;
+}
+
+// Every scalar metric of the sample; NAN where the sample has no figure
+static void compute_metrics(const Sample *s, double *v) {
+    v[METRIC_CPU_USAGE] = s->cpu.usage;
+    v[METRIC_MEM_USED_PCT] =
+        s->mem.mem_total ? percent_of((double)mem_used_kb(&s->mem), (double)s->mem.mem_total) : NAN;
+    v[METRIC_MEM_AVAILABLE_MB] = s->mem.mem_total ? s->mem.mem_available / 1024.0 : NAN;
+    v[METRIC_SWAP_USED_PCT] = percent_of((double)swap_used_kb(&s->mem), (double)s->mem.swap_total);
+    v[METRIC_PSI_CPU_SOME] = psi_value(&s->psi, PSI_CPU, 0);
+    v[METRIC_PSI_MEMORY_SOME] = psi_value(&s->psi, PSI_MEMORY, 0);
+    v[METRIC_PSI_MEMORY_FULL] = psi_value(&s->psi, PSI_MEMORY, 1);
+    v[METRIC_PSI_IO_SOME] = psi_value(&s->psi, PSI_IO, 0);
+    v[METRIC_PSI_IO_FULL] = psi_value(&s->psi, PSI_IO, 1);
+    v[METRIC_TEMP_C] = s->thermal.zone_count > 0 && s->thermal.hottest >= 0
+                           ? s->thermal.zones[s->thermal.hottest].temp_mc / 1000.0
+                           : NAN;
+    double util = NAN;
+    for (int d = 0; d < s->disks.count; d++)
+        if (!(s->disks.dev[d].util <= util))
+            util = s->disks.dev[d].util;
+    v[METRIC_DISK_UTIL] = util;
+    v[METRIC_JITTER_MS] = s->jitter_ns / 1e6;
+}
+
+static int holds(int op, double x, double threshold) {
+    switch (op) {
+    case OP_GT:
+        return x > threshold;
+    case OP_GE:
+        return x >= threshold;
+    case OP_LT:
+        return x < threshold;
+    default:
+        return x <= threshold;
+    }
+}
+
+static void add_event(RuleSet *rs, const Rule *r, int instance, int firing, double value) {
+    if (firing)
+        rs->stats.fired++;
+    else
+        rs->stats.cleared++;
+    if (rs->event_count == RULES_MAX_EVENTS) {
+        rs->stats.events_lost++;
+        return;
+    }
+    RuleEvent *e = &rs->events[rs->event_count++];
+    e->rule = (int)(r - rs->rules);
+    e->instance = instance;
+    e->firing = firing;
+    e->value = value;
+}
+
+// Advance one alert with the value (or rate) x of this sample
+static void step(RuleSet *rs, Rule *r, int instance, AlertState *st, double x, long long now) {
+    st->value = x;
+    if (st->firing) {
+        if (!holds(r->op, x, r->clear)) {
+            st->firing = 0;
+            st->pending = 0;
+            r->active--;
+            rs->firing--;
+            add_event(rs, r, instance, 0, x);
+        }
+        return;
+    }
+    if (!holds(r->op, x, r->threshold)) {
+        if (st->pending) {
+            st->pending = 0;
+            r->active--;
+        }
+        return;
+    }
+    if (!st->pending) {
+        st->pending = 1;
+        st->since_ns = now;
+        r->active++;
+    }
+    if (now - st->since_ns >= r->for_ns) {
+        st->firing = 1;
+        rs->firing++;
+        add_event(rs, r, instance, 1, x);
+    }
+}
+
+/*
+ * Rate of a value from its exponential average: gain turns the lag of the
+ * average behind the value into units per rate unit. The first value only
+ * primes the average.
+ */
+static double rate_of(AlertState *st, double v, double alpha, double gain) {
+    if (!st->primed) {
+        st->primed = 1;
+        st->average = v;
+        return 0.0;
+    }
+    st->average += alpha * (v - st->average);
+    return (v - st->average) * gain;
+}
+
+int evaluate_rules(RuleSet *rs, const Sample *s) {
+    if (rs->hook_count > 0)
+        reap_hooks(rs);
+    rs->event_count = 0;
+    rs->stats.evaluations++;
+    long long now = (long long)s->timestamp.tv_sec * NSEC_PER_SEC + s->timestamp.tv_nsec;
+
+    double values[METRIC_SCALARS];
+    compute_metrics(s, values);
+    const double *threads = s->cpu.thread_usage;
+    int cpus = s->cpu.num_cpus < rs->num_cpus ? s->cpu.num_cpus : rs->num_cpus;
+    double busiest = -INFINITY, idlest = INFINITY;
+    if (rs->per_cpu) {
+        for (int i = 0; i < cpus; i++) {
+            busiest = threads[i] > busiest ? threads[i] : busiest;
+            idlest = threads[i] < idlest ? threads[i] : idlest;
+        }
+    }
+
+    // Smoothing factor and lag-to-rate gain of each unit for this interval
+    double alpha[UNITS], gain[UNITS];
+    double dt = rs->last_ns ? (now - rs->last_ns) / 1e9 : 0.0;
+    for (int u = 0; u < UNITS; u++) {
+        alpha[u] = dt > 0 ? 1.0 - exp(-dt / unit_seconds[u]) : 0.0;
+        gain[u] = dt > 0 ? alpha[u] * unit_seconds[u] / ((1.0 - alpha[u]) * dt) : 0.0;
+    }
+    int rates = dt > 0 || rs->last_ns == 0; // A repeated timestamp leaves the rates alone
+    rs->last_ns = now;
+
+    for (int i = 0; i < rs->count; i++) {
+        Rule *r = &rs->rules[i];
+        AlertState *st = &rs->states[r->first];
+        if (r->metric != METRIC_THREAD || r->cpu >= 0) {
+            double v = r->metric == METRIC_THREAD ? (r->cpu < cpus ? threads[r->cpu] : NAN) : values[r->metric];
+            if (isnan(v) || (r->rate && !rates))
+                continue;
+            if (r->rate)
+                v = r->rate * rate_of(st, v, alpha[r->unit], gain[r->unit]);
+            step(rs, r, 0, st, v, now);
+            continue;
+        }
+
+        // Every CPU: a level no CPU reaches changes nothing when no alert is pending
+        if (!r->rate) {
+            double extreme = r->op == OP_GT || r->op == OP_GE ? busiest : idlest;
+            if (r->active == 0 && !holds(r->op, extreme, r->threshold))
+                continue;
+            for (int k = 0; k < cpus; k++)
+                step(rs, r, k, &st[k], threads[k], now);
+        } else if (rates) {
+            for (int k = 0; k < cpus; k++)
+                step(rs, r, k, &st[k], r->rate * rate_of(&st[k], threads[k], alpha[r->unit], gain[r->unit]), now);
+        }
+    }
+
+    if (rs->hook != NULL)
+        for (int e = 0; e < rs->event_count; e++)
+            start_hook(rs, &rs->events[e]);
+    return rs->event_count;
+}
+
+/* ------------------ Queries ------------------ */
+
+const RuleEvent *rule_events(const RuleSet *rs, int *count) {
+    *count = rs->event_count;
+    return rs->events;
+}
+
+int rules_firing(const RuleSet *rs) {
+    return rs->firing;
+}
+
+int list_firing_alerts(const RuleSet *rs, RuleAlert *alerts, int max) {
+    int n = 0;
+    for (int i = 0; i < rs->count && n < max; i++) {
+        const Rule *r = &rs->rules[i];
+        if (r->active == 0)
+            continue;
+        for (int k = 0; k < r->instances && n < max; k++) {
+            const AlertState *st = &rs->states[r->first + k];
+            if (!st->firing)
+                continue;
+            alerts[n].rule = i;
+            alerts[n].instance = k;
+            alerts[n].value = st->value;
+            alerts[n].since_ns = st->since_ns;
+            n++;
+        }
+    }
+    return n;
+}
+
+int rule_count(const RuleSet *rs) {
+    return rs->count;
+}
+
+const char *rule_name(const RuleSet *rs, int rule) {
+    return rs->names[rule];
+}
+
+int format_alert_label(const RuleSet *rs, int rule, int instance, char *buf, size_t len) {
+    const Rule *r = &rs->rules[rule];
+    int n = r->instances > 1 ? snprintf(buf, len, "%s (cpu%d)", rs->names[rule], instance)
+                             : snprintf(buf, len, "%s", rs->names[rule]);
+    return n < (int)len ? n : (int)len - 1;
+}
+
+void get_rule_stats(const RuleSet *rs, RuleStats *stats) {
+    *stats = rs->stats;
+}
+
+void destroy_rules(RuleSet *rs) {
+    if (rs == NULL)
+        return;
+    if (rs->hook != NULL)
+        posix_spawn_file_actions_destroy(&rs->actions);
+    free(rs->hook);
+    free(rs->envp);
+    free(rs->states);
+    free(rs->names);
+    free(rs->rules);
+    free(rs);
+}
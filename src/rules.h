@@ -0,0 +1,170 @@
+/**
+ * @file rules.h
+ * @brief Threshold and rate-of-change alert rules evaluated on every sample.
+ *
+ * A rule file holds one rule per line ('#' starts a comment):
+ *
+ *     [NAME:] METRIC [rising|falling] OP VALUE[/UNIT] [for DURATION] [clear VALUE]
+ *
+ * e.g. "hot_thread: cpu.thread[*] > 95 for 10s" or
+ * "mem.used_pct rising > 5/min". OP is >, >=, < or <=; DURATION is a number
+ * followed by ms, s, m (or min) or h. A rate rule compares how fast the
+ * metric moves, in VALUE per UNIT (s, min or h), with the same operators.
+ *
+ * Metrics (percentages unless noted):
+ *  - cpu.usage, cpu.thread[N] and cpu.thread[*] (one alert per CPU);
+ *  - mem.used_pct, mem.available_mb (MB), swap.used_pct;
+ *  - psi.cpu.some, psi.memory.some, psi.memory.full, psi.io.some,
+ *    psi.io.full (share of the last interval stalled);
+ *  - thermal.temp_c (hottest zone, degrees Celsius), disk.util (busiest
+ *    device), sample.jitter_ms (ms).
+ * A metric the sample does not carry (no PSI, no thermal zone) leaves its
+ * rules as they are.
+ *
+ * The text is compiled once into a flat array of rules and a flat array of
+ * per-instance states; evaluate_rules() computes every metric once per
+ * sample and runs through both arrays without allocating. A rule over every
+ * CPU that is quiet on all of them is skipped after one comparison with the
+ * busiest (or idlest) CPU.
+ *
+ * An alert fires once its condition has held for DURATION (at once without
+ * "for") and clears only when the value crosses back past the clear value,
+ * which defaults to RULES_HYSTERESIS of the threshold on the quiet side, so a
+ * value hovering at the threshold does not flap. A rate is derived from how
+ * far the value leads its exponential average with a time constant of one
+ * UNIT, scaled so that a steady ramp reads exactly its slope: no window of
+ * past values is kept, and a single spike decays instead of dropping out
+ * of a window at once.
+ *
+ * Every state change is kept as a RuleEvent; with set_rule_hook() each one
+ * also starts a shell command (posix_spawn(), never waited for on the
+ * evaluation path) with the alert in its environment.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include "collector.h"
+#include <stddef.h> // For size_t
+
+#define RULES_NAME_LEN 64     // Longest rule name (the rule text when unnamed)
+#define RULES_LABEL_LEN 80    // Name plus " (cpuNNNN)"
+#define RULES_MAX_EVENTS 64   // State changes kept per evaluation; further ones are counted
+#define RULES_MAX_HOOKS 4     // Hook commands running at once; further events are skipped
+#define RULES_HYSTERESIS 0.05 // Default clear band, as a fraction of the threshold
+
+/**
+ * @brief A state change of one alert during the last evaluation.
+ */
+typedef struct {
+    int rule;     /**< Index of the rule in file order. */
+    int instance; /**< CPU for cpu.thread[*] rules, otherwise 0. */
+    int firing;   /**< 1 if the alert fired, 0 if it cleared. */
+    double value; /**< Value (or rate) that caused the change. */
+} RuleEvent;
+
+/**
+ * @brief A firing alert, for display.
+ */
+typedef struct {
+    int rule;
+    int instance;
+    double value;        /**< Value (or rate) at the last evaluation. */
+    long long since_ns;  /**< CLOCK_MONOTONIC time the condition started to hold. */
+} RuleAlert;
+
+/**
+ * @brief Counters since the rules were compiled.
+ */
+typedef struct {
+    unsigned long evaluations; /**< Samples evaluated. */
+    unsigned long fired;       /**< Alerts fired. */
+    unsigned long cleared;     /**< Alerts cleared. */
+    unsigned long events_lost; /**< State changes beyond RULES_MAX_EVENTS in one sample. */
+    unsigned long hooks;       /**< Hook commands started. */
+    unsigned long hooks_skipped; /**< Events without a hook: RULES_MAX_HOOKS running or spawn failed. */
+} RuleStats;
+
+/**
+ * @brief Opaque compiled rule set with its alert states.
+ */
+typedef struct RuleSet RuleSet;
+
+/**
+ * @brief Compiles rule text for samples of num_cpus CPUs.
+ *
+ * @param err Receives "line N: reason" on failure (may be NULL).
+ * @return RuleSet* The rules, or NULL on a syntax error or out of memory.
+ */
+RuleSet *compile_rules(const char *text, int num_cpus, char *err, size_t err_len);
+
+/**
+ * @brief Reads and compiles a rule file.
+ *
+ * @param err Receives "PATH: reason" or "PATH:N: reason" on failure (may be NULL).
+ * @return RuleSet* The rules, or NULL on failure.
+ */
+RuleSet *load_rules(const char *path, int num_cpus, char *err, size_t err_len);
+
+/**
+ * @brief Runs command with /bin/sh -c for every alert that fires or clears,
+ * with RESOURCE_MON_ALERT (the label), RESOURCE_MON_STATE ("firing" or
+ * "cleared") and RESOURCE_MON_VALUE in its environment.
+ *
+ * @return int 0 on success, -1 if out of memory.
+ */
+int set_rule_hook(RuleSet *rules, const char *command);
+
+/**
+ * @brief Evaluates every rule against a sample; samples must come in order.
+ *
+ * @return int Number of alerts that fired or cleared (see rule_events()).
+ */
+int evaluate_rules(RuleSet *rules, const Sample *sample);
+
+/**
+ * @brief State changes of the last evaluate_rules() call.
+ */
+const RuleEvent *rule_events(const RuleSet *rules, int *count);
+
+/**
+ * @brief Number of alerts firing now.
+ */
+int rules_firing(const RuleSet *rules);
+
+/**
+ * @brief Lists up to max firing alerts in rule order.
+ *
+ * @return int Number of alerts stored.
+ */
+int list_firing_alerts(const RuleSet *rules, RuleAlert *alerts, int max);
+
+/**
+ * @brief Number of rules compiled.
+ */
+int rule_count(const RuleSet *rules);
+
+/**
+ * @brief Name of a rule: its NAME, or its normalized text when unnamed.
+ */
+const char *rule_name(const RuleSet *rules, int rule);
+
+/**
+ * @brief Writes the label of one alert: the rule name, followed by
+ * " (cpuN)" for a rule over every CPU.
+ *
+ * @return int Length of the label (truncated to len - 1).
+ */
+int format_alert_label(const RuleSet *rules, int rule, int instance, char *buf, size_t len);
+
+/**
+ * @brief Copies the counters.
+ */
+void get_rule_stats(const RuleSet *rules, RuleStats *stats);
+
+/**
+ * @brief Frees the rules; running hooks are not waited for. Accepts NULL.
+ */
+void destroy_rules(RuleSet *rules);
+
+#endif // RULES_H
@@ -0,0 +1,124 @@
+/**
+ * @file selfinfo_manip.c
+ * @brief Implementation of the monitor's self-usage sampler.
+ */
+
+#include "selfinfo_manip.h"
+#include <stdlib.h> // For calloc(), free()
+#include <string.h> // For strncmp(), strrchr()
+#include <time.h>   // For clock_gettime()
+#include <unistd.h> // For sysconf()
+
+#define SELF_STAT_LEN 1024   // /proc/self/stat is one short line
+#define SELF_STATUS_LEN 4096 // /proc/self/status is about 1.5 kB
+
+struct SelfSampler {
+    ProcFile stat_file;   // /proc/self/stat
+    ProcFile status_file; // /proc/self/status
+    long ms_per_tick;     // 1000 / USER_HZ
+    struct timespec last_wall, last_cpu; // CLOCK_MONOTONIC and CLOCK_PROCESS_CPUTIME_ID
+    ProcIoCounts last_io;
+};
+
+static long long timespec_ns(const struct timespec *ts) {
+    return (long long)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+// Fields 10..20 of "pid (comm) state ppid ..."; comm may contain ')'
+static int parse_self_stat(const char *buf, long ms_per_tick, SelfInfo *info) {
+    const char *p = strrchr(buf, ')');
+    if (p == NULL)
+        return -1;
+    p = skip_blanks(p + 1);
+    for (int field = 3; field <= 20; field++) {
+        p = skip_blanks(p);
+        if (*p == '\0' || *p == '\n')
+            return -1;
+        switch (field) {
+        case 10: info->min_faults = scan_ulong(&p); break;
+        case 12: info->maj_faults = scan_ulong(&p); break;
+        case 14: info->utime_ms = scan_ulong(&p) * (unsigned long)ms_per_tick; break;
+        case 15: info->stime_ms = scan_ulong(&p) * (unsigned long)ms_per_tick; break;
+        case 20: info->threads = (int)scan_ulong(&p); break;
+        default: // Includes negative fields (priority, nice)
+            while (*p && *p != ' ' && *p != '\n')
+                p++;
+            break;
+        }
+    }
+    return 0;
+}
+
+// "Key:\tvalue kB" lines of /proc/self/status
+static void parse_self_status(const char *p, SelfInfo *info) {
+    info->rss_kb = 0;
+    info->hwm_kb = 0;
+    info->ctxt_switches = 0;
+    for (; *p; p = next_line(p)) {
+        if (strncmp(p, "VmRSS:", 6) == 0) {
+            p += 6;
+            info->rss_kb = scan_ulong(&p);
+        } else if (strncmp(p, "VmHWM:", 6) == 0) {
+            p += 6;
+            info->hwm_kb = scan_ulong(&p);
+        } else if (strncmp(p, "voluntary_ctxt_switches:", 24) == 0) {
+            p += 24;
+            info->ctxt_switches += scan_ulong(&p);
+        } else if (strncmp(p, "nonvoluntary_ctxt_switches:", 27) == 0) {
+            p += 27;
+            info->ctxt_switches += scan_ulong(&p);
+        }
+    }
+}
+
+SelfSampler *create_self_sampler(void) {
+    SelfSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->status_file.fd = -1;
+    // Always the real /proc: the monitor itself never runs inside a fixture
+    if (open_proc_file(&s->stat_file, "/proc/self/stat", SELF_STAT_LEN) < 0 ||
+        open_proc_file(&s->status_file, "/proc/self/status", SELF_STATUS_LEN) < 0) {
+        destroy_self_sampler(s);
+        return NULL;
+    }
+    long hz = sysconf(_SC_CLK_TCK);
+    s->ms_per_tick = hz > 0 ? 1000 / hz : 10;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_wall);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &s->last_cpu);
+    get_proc_io_counts(&s->last_io);
+    return s;
+}
+
+int sample_self_info(SelfSampler *s, SelfInfo *info) {
+    if (read_proc_file(&s->stat_file) < 0 || parse_self_stat(s->stat_file.buf, s->ms_per_tick, info) < 0)
+        return -1;
+    if (read_proc_file(&s->status_file) < 0)
+        return -1;
+    parse_self_status(s->status_file.buf, info);
+
+    struct timespec wall, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    long long wall_ns = timespec_ns(&wall) - timespec_ns(&s->last_wall);
+    long long cpu_ns = timespec_ns(&cpu) - timespec_ns(&s->last_cpu);
+    info->cpu_usage = wall_ns > 0 ? (double)cpu_ns * 100.0 / (double)wall_ns : 0.0;
+    info->cpu_us = (unsigned long)(timespec_ns(&cpu) / 1000);
+    s->last_wall = wall;
+    s->last_cpu = cpu;
+
+    // Includes this call's own two reads
+    get_proc_io_counts(&info->io);
+    info->io_delta.opens = info->io.opens - s->last_io.opens;
+    info->io_delta.reads = info->io.reads - s->last_io.reads;
+    s->last_io = info->io;
+    return 0;
+}
+
+void destroy_self_sampler(SelfSampler *s) {
+    if (s == NULL)
+        return;
+    close_proc_file(&s->stat_file);
+    close_proc_file(&s->status_file);
+    free(s);
+}
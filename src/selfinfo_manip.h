@@ -0,0 +1,62 @@
+/**
+ * @file selfinfo_manip.h
+ * @brief The monitor's own cost: CPU, memory and procfs system calls.
+ *
+ * Reads /proc/self/stat and /proc/self/status through persistent
+ * descriptors and the procfs I/O counters of procfile.h. CPU usage comes
+ * from CLOCK_PROCESS_CPUTIME_ID, whose nanosecond resolution shows the
+ * sub-millisecond cost of a tick that the 10 ms jiffies of /proc/self/stat
+ * would round to 0.
+ *
+ * /proc/self always names the running monitor: these files are read from
+ * the real /proc even when set_proc_root() points the collectors elsewhere.
+ */
+
+#ifndef SELFINFO_MANIP_H
+#define SELFINFO_MANIP_H
+
+#include "procfile.h" // For ProcFile and ProcIoCounts
+
+/**
+ * @brief One snapshot of the monitor's resource usage (all threads).
+ */
+typedef struct {
+    double cpu_usage;          /**< CPU used since the previous sample, % of one CPU. */
+    unsigned long cpu_us;      /**< CPU time since the program started, in microseconds. */
+    unsigned long utime_ms;    /**< User time from /proc/self/stat. */
+    unsigned long stime_ms;    /**< System time from /proc/self/stat. */
+    unsigned long min_faults;  /**< Minor page faults. */
+    unsigned long maj_faults;  /**< Major page faults. */
+    int threads;               /**< Number of threads. */
+    unsigned long rss_kb;      /**< VmRSS: resident set size. */
+    unsigned long hwm_kb;      /**< VmHWM: peak resident set size. */
+    unsigned long ctxt_switches; /**< Voluntary plus involuntary context switches. */
+    ProcIoCounts io;           /**< procfs/sysfs opens and reads since the program started. */
+    ProcIoCounts io_delta;     /**< Same, since the previous sample. */
+} SelfInfo;
+
+/**
+ * @brief Opaque sampler: open /proc/self files and the previous snapshot.
+ */
+typedef struct SelfSampler SelfSampler;
+
+/**
+ * @brief Opens /proc/self/stat and /proc/self/status and takes a baseline.
+ *
+ * @return SelfSampler* The sampler, or NULL on failure (errno is set).
+ */
+SelfSampler *create_self_sampler(void);
+
+/**
+ * @brief Fills info with the current usage and the deltas since the previous call.
+ *
+ * @return int 0 on success, -1 if a file could not be read.
+ */
+int sample_self_info(SelfSampler *sampler, SelfInfo *info);
+
+/**
+ * @brief Closes the files and frees the sampler. Accepts NULL.
+ */
+void destroy_self_sampler(SelfSampler *sampler);
+
+#endif // SELFINFO_MANIP_H
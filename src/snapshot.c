@@ -0,0 +1,251 @@
+/**
+ * @file snapshot.c
+ * @brief Implementation of the shared-memory snapshot publisher and reader.
+ */
+
+#include "snapshot.h"
+#include <errno.h>    // For errno
+#include <fcntl.h>    // For O_* constants
+#include <stdlib.h>   // For calloc(), free()
+#include <string.h>   // For memcpy(), memset()
+#include <sys/mman.h> // For shm_open(), mmap()
+#include <sys/stat.h> // For fstat()
+#include <unistd.h>   // For ftruncate(), close()
+
+#define SNAPSHOT_ALIGN 64 // Copies start on their own cache line
+
+// The layout is shared with other processes and other builds
+_Static_assert(sizeof(SnapshotHeader) == SNAPSHOT_ALIGN, "SnapshotHeader must stay 64 bytes");
+_Static_assert(sizeof(SnapshotRecord) == 128, "SnapshotRecord must stay 128 bytes");
+
+struct SnapshotWriter {
+    char *name;
+    SnapshotHeader *header; // The mapping
+    size_t size;
+    char *copy[2];          // The two records
+    size_t record_size;
+};
+
+struct SnapshotReader {
+    const SnapshotHeader *header; // The mapping
+    size_t size;
+    const char *copy[2];
+    SnapshotRecord *record;       // Private copy handed to the caller
+    size_t record_size;
+    unsigned int last_seq;        // Version counter of the private copy
+    int have_record;
+    unsigned long retries;
+};
+
+// Bytes of one record for num_cpus thread values and cpu_slots counter slots
+static size_t record_bytes(uint32_t num_cpus, uint32_t cpu_slots) {
+    size_t bytes = sizeof(SnapshotRecord) + num_cpus * sizeof(double) +
+                   (size_t)CPU_STAT_FIELDS * cpu_slots * sizeof(uint64_t);
+    return (bytes + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+/* ------------------ Publisher ------------------ */
+
+SnapshotWriter *create_snapshot_writer(const char *name, int num_cpus) {
+    if (num_cpus <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    SnapshotWriter *w = calloc(1, sizeof(*w));
+    if (w == NULL)
+        return NULL;
+    w->name = strdup(name);
+    w->record_size = record_bytes((uint32_t)num_cpus, (uint32_t)num_cpus + 1);
+    w->size = sizeof(SnapshotHeader) + 2 * w->record_size;
+    if (w->name == NULL) {
+        free(w);
+        return NULL;
+    }
+
+    // A fresh segment: readers still mapping an old one keep it until they reopen
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)w->size) < 0 ||
+        (w->header = mmap(NULL, w->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        int saved = errno;
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        free(w->name);
+        free(w);
+        errno = saved;
+        return NULL;
+    }
+    close(fd); // The mapping keeps the segment
+
+    SnapshotHeader *h = w->header; // Zero-filled by ftruncate()
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic));
+    h->version = SNAPSHOT_VERSION;
+    h->header_size = sizeof(SnapshotHeader);
+    h->record_size = (uint32_t)w->record_size;
+    h->num_cpus = (uint32_t)num_cpus;
+    h->cpu_slots = (uint32_t)num_cpus + 1;
+    h->cpu_fields = CPU_STAT_FIELDS;
+    h->pid = (int32_t)getpid();
+    for (int i = 0; i < 2; i++) {
+        w->copy[i] = (char *)h + sizeof(SnapshotHeader) + (size_t)i * w->record_size;
+        SnapshotRecord *r = (SnapshotRecord *)w->copy[i];
+        r->num_cpus = h->num_cpus;
+        r->cpu_slots = h->cpu_slots;
+    }
+    return w;
+}
+
+// Fill a record from the sample; slots the sample does not have stay zero
+static void fill_record(const SnapshotHeader *h, SnapshotRecord *r, const Sample *s,
+                        const CPUStatsStore *counters) {
+    r->seq = s->seq;
+    r->time_ns = (int64_t)s->wallclock.tv_sec * 1000000000LL + s->wallclock.tv_nsec;
+    r->monotonic_ns = (int64_t)s->timestamp.tv_sec * 1000000000LL + s->timestamp.tv_nsec;
+    r->interval_ns = (int64_t)(s->interval * 1e9);
+    r->jitter_ns = s->jitter_ns;
+    r->dropped = s->dropped;
+    r->cpu_usage = s->cpu.usage;
+    r->mem_total_kb = s->mem.mem_total;
+    r->mem_free_kb = s->mem.mem_free;
+    r->mem_available_kb = s->mem.mem_available;
+    r->buffers_kb = s->mem.buffers;
+    r->cached_kb = s->mem.cached;
+    r->swap_total_kb = s->mem.swap_total;
+    r->swap_free_kb = s->mem.swap_free;
+
+    double *usage = (double *)snapshot_thread_usage(r);
+    uint32_t cpus = s->cpu.num_cpus < 0 ? 0 : (uint32_t)s->cpu.num_cpus;
+    if (cpus > h->num_cpus)
+        cpus = h->num_cpus;
+    memcpy(usage, s->cpu.thread_usage, cpus * sizeof(double));
+    memset(usage + cpus, 0, (h->num_cpus - cpus) * sizeof(double));
+
+    uint64_t *out = (uint64_t *)snapshot_counters(r);
+    uint32_t slots = counters == NULL || counters->count < 0 ? 0 : (uint32_t)counters->count;
+    if (slots > h->cpu_slots)
+        slots = h->cpu_slots;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        uint64_t *row = out + (size_t)f * h->cpu_slots;
+        for (uint32_t i = 0; i < slots; i++)
+            row[i] = counters->field[f][i];
+        memset(row + slots, 0, (h->cpu_slots - slots) * sizeof(uint64_t));
+    }
+}
+
+void publish_snapshot(SnapshotWriter *w, const Sample *sample, const CPUStatsStore *counters) {
+    SnapshotHeader *h = w->header;
+    unsigned int seq = atomic_load_explicit(&h->seq, memory_order_relaxed);
+    // Odd: readers switch to copy 1 (also ordered after the previous copy 1 update)
+    atomic_store_explicit(&h->seq, seq + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release); // ... before any store to copy 0
+    fill_record(h, (SnapshotRecord *)w->copy[0], sample, counters);
+    // Even: readers switch back to the new copy 0; copy 1 catches up
+    atomic_store_explicit(&h->seq, seq + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(w->copy[1], w->copy[0], w->record_size);
+}
+
+void snapshot_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters) {
+    publish_snapshot(ctx, sample, counters);
+}
+
+void destroy_snapshot_writer(SnapshotWriter *w) {
+    if (w == NULL)
+        return;
+    atomic_store_explicit(&w->header->closed, 1, memory_order_release);
+    shm_unlink(w->name);
+    munmap(w->header, w->size);
+    free(w->name);
+    free(w);
+}
+
+/* ------------------ Reader ------------------ */
+
+SnapshotReader *open_snapshot(const char *name) {
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    SnapshotReader *r = calloc(1, sizeof(*r));
+    if (r == NULL || fstat(fd, &st) < 0) {
+        int saved = errno;
+        free(r);
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    r->size = (size_t)st.st_size;
+    const SnapshotHeader *h = NULL;
+    if (r->size >= sizeof(SnapshotHeader))
+        h = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == NULL || h == MAP_FAILED) {
+        free(r);
+        errno = h == NULL ? EPROTO : errno;
+        return NULL;
+    }
+    r->header = h;
+
+    // Everything the accessors rely on must hold before any record is read
+    size_t record = record_bytes(h->num_cpus, h->cpu_slots);
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->version != SNAPSHOT_VERSION ||
+        h->header_size < sizeof(SnapshotHeader) || h->cpu_fields != CPU_STAT_FIELDS ||
+        h->record_size < record || h->header_size + 2 * (size_t)h->record_size > r->size ||
+        (r->record = malloc(h->record_size)) == NULL) {
+        close_snapshot(r);
+        errno = EPROTO;
+        return NULL;
+    }
+    r->record_size = h->record_size;
+    r->copy[0] = (const char *)h + h->header_size;
+    r->copy[1] = r->copy[0] + r->record_size;
+    return r;
+}
+
+const SnapshotHeader *snapshot_header(const SnapshotReader *r) {
+    return r->header;
+}
+
+int read_snapshot(SnapshotReader *r, const SnapshotRecord **record) {
+    *record = r->record;
+    for (;;) {
+        if (atomic_load_explicit(&r->header->closed, memory_order_acquire)) {
+            errno = ESTALE;
+            return -1;
+        }
+        unsigned int seq = atomic_load_explicit(&r->header->seq, memory_order_acquire);
+        if (r->have_record && seq == r->last_seq)
+            return 0;
+        memcpy(r->record, r->copy[seq & 1], r->record_size);
+        atomic_thread_fence(memory_order_acquire); // The copy is complete before the counter is checked
+        if (atomic_load_explicit(&r->header->seq, memory_order_relaxed) != seq) {
+            r->retries++;
+            continue;
+        }
+        // Counters and sizes come from the validated header, not the copied record
+        r->record->num_cpus = r->header->num_cpus;
+        r->record->cpu_slots = r->header->cpu_slots;
+        if (r->record->seq == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        r->last_seq = seq;
+        r->have_record = 1;
+        return 1;
+    }
+}
+
+unsigned long snapshot_retries(const SnapshotReader *r) {
+    return r->retries;
+}
+
+void close_snapshot(SnapshotReader *r) {
+    if (r == NULL)
+        return;
+    if (r->header != NULL)
+        munmap((void *)r->header, r->size);
+    free(r->record);
+    free(r);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file snapshot.h
+ * @brief Publication of the newest sample in POSIX shared memory, and the
+ * client library that reads it.
+ *
+ * The monitor registers snapshot_sink() on its collector; every sample is
+ * then written to a shared-memory segment (shm_open()) that any number of
+ * local agents map read-only. Readers never touch /proc and never make a
+ * system call per read; the publisher does not know about them.
+ *
+ * Segment layout:
+ *  - SnapshotHeader (64 bytes), with the version counter;
+ *  - two copies of the record, record_size bytes each: SnapshotRecord,
+ *    then num_cpus doubles of per-thread usage, then the raw /proc/stat
+ *    counters as uint64_t counters[field * cpu_slots + slot].
+ *
+ * The version counter is a latched seqlock: the publisher makes it odd,
+ * rewrites copy 0, makes it even and then brings copy 1 up to date. A
+ * reader copies the record selected by the low bit of the counter it read
+ * and keeps it if the counter has not moved meanwhile, so it never waits
+ * for a publish in progress and only retries when a whole publish
+ * overlapped its copy. A torn record is never returned.
+ *
+ * When the publisher exits it marks the segment closed and unlinks it;
+ * readers then get ESTALE and may open the name again later.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "collector.h"
+#include <stdatomic.h> // For the shared version counter
+#include <stdint.h>    // For the segment layout
+
+#define SNAPSHOT_MAGIC "RMSHM01" // Header magic (8 bytes with the terminator)
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_DEFAULT_NAME "/resource_mon"
+
+/**
+ * @brief Start of the segment.
+ */
+typedef struct {
+    char magic[8];         /**< SNAPSHOT_MAGIC. */
+    uint32_t version;      /**< SNAPSHOT_VERSION; readers refuse other layouts. */
+    uint32_t header_size;  /**< Offset of the first copy. */
+    uint32_t record_size;  /**< Bytes of each copy. */
+    uint32_t num_cpus;     /**< Per-thread usage values per record. */
+    uint32_t cpu_slots;    /**< Counter slots per field (slot 0 is the aggregate). */
+    uint32_t cpu_fields;   /**< Counter fields (CPU_STAT_FIELDS). */
+    int32_t pid;           /**< Publishing process. */
+    atomic_uint seq;       /**< Version counter: odd while copy 0 is rewritten. */
+    atomic_uint closed;    /**< Set when the publisher has exited. */
+    uint32_t reserved[5];
+} SnapshotHeader;
+
+/**
+ * @brief Fixed part of a record.
+ */
+typedef struct {
+    uint64_t seq;              /**< Sample number (starts at 1; 0 until the first publish). */
+    int64_t time_ns;           /**< CLOCK_REALTIME of the sample. */
+    int64_t monotonic_ns;      /**< CLOCK_MONOTONIC of the sample. */
+    int64_t interval_ns;       /**< Measured time since the previous sample. */
+    int64_t jitter_ns;         /**< Wake-up delay of the sample. */
+    uint64_t dropped;          /**< Samples the monitor's own ring dropped. */
+    double cpu_usage;          /**< Aggregate CPU usage in percent. */
+    uint64_t mem_total_kb;     /**< MemTotal. */
+    uint64_t mem_free_kb;      /**< MemFree. */
+    uint64_t mem_available_kb; /**< MemAvailable. */
+    uint64_t buffers_kb;       /**< Buffers. */
+    uint64_t cached_kb;        /**< Cached. */
+    uint64_t swap_total_kb;    /**< SwapTotal. */
+    uint64_t swap_free_kb;     /**< SwapFree. */
+    uint32_t num_cpus;         /**< Copied from the header, for the accessors. */
+    uint32_t cpu_slots;
+    uint64_t reserved;
+} SnapshotRecord;
+
+/**
+ * @brief Opaque publisher.
+ */
+typedef struct SnapshotWriter SnapshotWriter;
+
+/**
+ * @brief Opaque reader (client library).
+ */
+typedef struct SnapshotReader SnapshotReader;
+
+/**
+ * @brief Creates the segment, replacing any segment of the same name
+ * (readers of the old one see it closed only if its publisher closed it).
+ *
+ * @param name shm_open() name, e.g. SNAPSHOT_DEFAULT_NAME.
+ * @param num_cpus CPU slots of the samples to publish.
+ * @return SnapshotWriter* The publisher, or NULL on failure (errno is set).
+ */
+SnapshotWriter *create_snapshot_writer(const char *name, int num_cpus);
+
+/**
+ * @brief Publishes one sample. counters may be NULL (the counters are zeroed).
+ */
+void publish_snapshot(SnapshotWriter *writer, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief CollectorSink adapter for publish_snapshot(); ctx is the SnapshotWriter.
+ */
+void snapshot_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief Marks the segment closed, unlinks it and frees the publisher. Accepts NULL.
+ */
+void destroy_snapshot_writer(SnapshotWriter *writer);
+
+/**
+ * @brief Maps a published segment read-only and checks its layout.
+ *
+ * @return SnapshotReader* The reader, or NULL (errno is set: ENOENT when no
+ * monitor publishes under name, EPROTO for another layout version).
+ */
+SnapshotReader *open_snapshot(const char *name);
+
+/**
+ * @brief Header of the mapped segment.
+ */
+const SnapshotHeader *snapshot_header(const SnapshotReader *reader);
+
+/**
+ * @brief Copies the newest record into the reader's buffer.
+ *
+ * No system call, no allocation. The copy is skipped when nothing was
+ * published since the previous read.
+ *
+ * @param record Receives the reader's copy, valid until the next read.
+ * @return int 1 if a newer record was copied, 0 if none was published since
+ * the previous read (record is the previous copy), -1 with errno EAGAIN
+ * before the first sample or ESTALE once the publisher has exited.
+ */
+int read_snapshot(SnapshotReader *reader, const SnapshotRecord **record);
+
+/**
+ * @brief Copies that were discarded because a publish overlapped them.
+ */
+unsigned long snapshot_retries(const SnapshotReader *reader);
+
+/**
+ * @brief Unmaps the segment and frees the reader. Accepts NULL.
+ */
+void close_snapshot(SnapshotReader *reader);
+
+/**
+ * @brief num_cpus per-thread usage percentages of a record.
+ */
+static inline const double *snapshot_thread_usage(const SnapshotRecord *record) {
+    return (const double *)(record + 1);
+}
+
+/**
+ * @brief Raw counters of a record: counters[field * cpu_slots + slot], with
+ * fields in CPU_USER .. CPU_GUEST_NICE order.
+ */
+static inline const uint64_t *snapshot_counters(const SnapshotRecord *record) {
+    return (const uint64_t *)(snapshot_thread_usage(record) + record->num_cpus);
+}
+
+#endif // SNAPSHOT_H
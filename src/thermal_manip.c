@@ -0,0 +1,281 @@
+/**
+ * @file thermal_manip.c
+ * @brief Implementation of the thermal zone and throttle counter sampler.
+ */
+
+#include "thermal_manip.h"
+#include "topology_manip.h" // For one counter per core and per package
+#include <dirent.h>         // For opendir(), readdir()
+#include <fcntl.h>          // For open()
+#include <stdio.h>          // For snprintf()
+#include <stdlib.h>         // For calloc(), qsort(), free()
+#include <string.h>         // For strcmp(), strncmp()
+#include <unistd.h>         // For pread(), close()
+
+#define THERMAL_DIR "/sys/class/thermal"
+#define CPU_DIR "/sys/devices/system/cpu"
+#define MAX_TRIPS 16      // Trip points looked at per zone
+#define MAX_SCANNED 256   // thermal_zoneN entries sorted before keeping THERMAL_MAX_ZONES
+#define ATTR_LEN 32       // "105000\n", "passive\n" and the like
+
+struct ThermalSampler {
+    int zone_count;
+    ThermalZone zones[THERMAL_MAX_ZONES]; // Last good reading of each zone
+    int zone_fd[THERMAL_MAX_ZONES];       // thermal_zoneN/temp
+    int counter_count;                    // Core counters first, then package counters
+    int core_counters;
+    int *counter_fd;
+    unsigned long *last_count;            // Previous value of each counter
+    int num_cpus;
+    double *last_usage;                   // [0] aggregate, [i + 1] CPU i, of the previous sample
+    int primed;                           // 1 once last_usage holds a sample
+    unsigned long throttled_frames;
+};
+
+// Reads a small attribute into buf (NUL terminated, newline stripped); -1 if missing
+static int read_attr(const char *rel, char *buf, size_t len) {
+    char path[PROC_PATH_MAX];
+    int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+    count_proc_io(1, 0);
+    if (fd < 0)
+        return -1;
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    close(fd);
+    count_proc_io(0, 1);
+    if (n <= 0)
+        return -1;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+        n--;
+    buf[n] = '\0';
+    return 0;
+}
+
+// Signed decimal, as temperatures below 0 C are reported negative
+static long parse_long(const char *p) {
+    int negative = (*p == '-');
+    if (negative)
+        p++;
+    long value = (long)scan_ulong(&p);
+    return negative ? -value : value;
+}
+
+// One pread() of an open attribute; -1 on a read error (some sensors fail transiently)
+static int read_open_attr(int fd, char *buf, size_t len) {
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    count_proc_io(0, 1);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Lowest passive trip point; fans ("active") do not slow the CPU down
+static long read_trip_point(int zone) {
+    long passive = 0, other = 0;
+    for (int k = 0; k < MAX_TRIPS; k++) {
+        char rel[96], type[ATTR_LEN], temp[ATTR_LEN];
+        snprintf(rel, sizeof(rel), THERMAL_DIR "/thermal_zone%d/trip_point_%d_type", zone, k);
+        if (read_attr(rel, type, sizeof(type)) < 0)
+            break;
+        snprintf(rel, sizeof(rel), THERMAL_DIR "/thermal_zone%d/trip_point_%d_temp", zone, k);
+        if (read_attr(rel, temp, sizeof(temp)) < 0)
+            continue;
+        long mc = parse_long(temp);
+        if (mc <= 0) // Disabled trip
+            continue;
+        if (strcmp(type, "passive") == 0) {
+            if (passive == 0 || mc < passive)
+                passive = mc;
+        } else if (strcmp(type, "active") != 0) {
+            if (other == 0 || mc < other)
+                other = mc;
+        }
+    }
+    return passive ? passive : other;
+}
+
+// thermal_zoneN directories in index order, temp files opened
+static void discover_zones(ThermalSampler *s) {
+    char path[PROC_PATH_MAX];
+    DIR *dir = opendir(proc_path(THERMAL_DIR, path));
+    count_proc_io(1, 0);
+    if (dir == NULL)
+        return;
+    count_proc_io(0, 1);
+    int found[MAX_SCANNED], count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < MAX_SCANNED) {
+        const char *p = entry->d_name;
+        if (strncmp(p, "thermal_zone", 12) == 0 && p[12] >= '0' && p[12] <= '9') {
+            p += 12;
+            found[count++] = (int)scan_ulong(&p);
+        }
+    }
+    closedir(dir);
+    qsort(found, (size_t)count, sizeof(found[0]), compare_ints);
+
+    for (int i = 0; i < count && s->zone_count < THERMAL_MAX_ZONES; i++) {
+        char rel[96];
+        snprintf(rel, sizeof(rel), THERMAL_DIR "/thermal_zone%d/temp", found[i]);
+        int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+        count_proc_io(1, 0);
+        if (fd < 0)
+            continue;
+        ThermalZone *z = &s->zones[s->zone_count];
+        snprintf(rel, sizeof(rel), THERMAL_DIR "/thermal_zone%d/type", found[i]);
+        if (read_attr(rel, z->type, sizeof(z->type)) < 0)
+            snprintf(z->type, sizeof(z->type), "zone%d", found[i]);
+        z->index = found[i];
+        z->trip_mc = read_trip_point(found[i]);
+        s->zone_fd[s->zone_count++] = fd;
+    }
+}
+
+// Opens cpuN/thermal_throttle/<name> as the next counter
+static void open_counter(ThermalSampler *s, int cpu, const char *name) {
+    char rel[96], path[PROC_PATH_MAX];
+    snprintf(rel, sizeof(rel), CPU_DIR "/cpu%d/thermal_throttle/%s", cpu, name);
+    int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+    count_proc_io(1, 0);
+    if (fd >= 0)
+        s->counter_fd[s->counter_count++] = fd;
+}
+
+// One core counter per physical core and one package counter per package
+static int discover_counters(ThermalSampler *s) {
+    CPUTopology *topo = discover_cpu_topology(s->num_cpus);
+    if (topo == NULL)
+        return -1;
+    // At most one of each per online CPU
+    s->counter_fd = calloc((size_t)topo->online * 2, sizeof(int));
+    s->last_count = calloc((size_t)topo->online * 2, sizeof(unsigned long));
+    if (s->counter_fd == NULL || s->last_count == NULL) {
+        destroy_cpu_topology(topo);
+        return -1;
+    }
+    for (int i = 0; i < topo->online; i++) {
+        const CPUTopoEntry *e = &topo->cpu[topo->order[i]];
+        if (i == 0 || e->core_index != topo->cpu[topo->order[i - 1]].core_index)
+            open_counter(s, topo->order[i], "core_throttle_count");
+    }
+    s->core_counters = s->counter_count;
+    for (int i = 0; i < topo->online; i++) {
+        const CPUTopoEntry *e = &topo->cpu[topo->order[i]];
+        if (i == 0 || e->package != topo->cpu[topo->order[i - 1]].package)
+            open_counter(s, topo->order[i], "package_throttle_count");
+    }
+    destroy_cpu_topology(topo);
+
+    // Baseline, so the first sample reports new events only
+    for (int i = 0; i < s->counter_count; i++) {
+        char buf[ATTR_LEN];
+        const char *p = buf;
+        if (read_open_attr(s->counter_fd[i], buf, sizeof(buf)) == 0)
+            s->last_count[i] = scan_ulong(&p);
+    }
+    return 0;
+}
+
+ThermalSampler *create_thermal_sampler(int num_cpus) {
+    ThermalSampler *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->num_cpus = num_cpus;
+    s->last_usage = calloc((size_t)num_cpus + 1, sizeof(double));
+    if (s->last_usage == NULL || discover_counters(s) < 0) {
+        destroy_thermal_sampler(s);
+        return NULL;
+    }
+    discover_zones(s);
+    return s;
+}
+
+// Usage fell by THERMAL_DROP_PCT overall, or on a quarter of the CPUs
+static int correlate_usage(ThermalSampler *s, const CPUInfo *cpu, ThermalInfo *info) {
+    int n = cpu->num_cpus < s->num_cpus ? cpu->num_cpus : s->num_cpus;
+    double drop = s->last_usage[0] - cpu->usage;
+    info->usage_drop = s->primed && drop > 0.0 ? drop : 0.0;
+    info->dropped_threads = 0;
+    for (int i = 0; i < n; i++) {
+        if (s->primed && s->last_usage[i + 1] - cpu->thread_usage[i] >= THERMAL_DROP_PCT)
+            info->dropped_threads++;
+        s->last_usage[i + 1] = cpu->thread_usage[i];
+    }
+    s->last_usage[0] = cpu->usage;
+    s->primed = 1;
+    return info->usage_drop >= THERMAL_DROP_PCT || (n > 0 && info->dropped_threads * 4 >= n);
+}
+
+int sample_thermal_info(ThermalSampler *s, const CPUInfo *cpu, ThermalInfo *info) {
+    int status = 0;
+    char buf[ATTR_LEN];
+    info->flags = 0;
+
+    info->zone_count = s->zone_count;
+    info->hottest = -1;
+    for (int z = 0; z < s->zone_count; z++) {
+        // On a read error the zone keeps its last good temperature
+        if (read_open_attr(s->zone_fd[z], buf, sizeof(buf)) == 0)
+            s->zones[z].temp_mc = parse_long(buf);
+        else
+            status = -1;
+        const ThermalZone *zone = &s->zones[z];
+        info->zones[z] = *zone;
+        if (info->hottest < 0 || zone->temp_mc > info->zones[info->hottest].temp_mc)
+            info->hottest = z;
+        if (zone->trip_mc > 0 && zone->temp_mc >= zone->trip_mc)
+            info->flags |= THERMAL_AT_TRIP;
+    }
+
+    info->core_throttles = 0;
+    info->package_throttles = 0;
+    info->throttle_total = 0;
+    for (int i = 0; i < s->counter_count; i++) {
+        unsigned long value = s->last_count[i];
+        const char *p = buf;
+        if (read_open_attr(s->counter_fd[i], buf, sizeof(buf)) == 0)
+            value = scan_ulong(&p);
+        else
+            status = -1;
+        unsigned long delta = value >= s->last_count[i] ? value - s->last_count[i] : 0;
+        if (i < s->core_counters)
+            info->core_throttles += delta;
+        else
+            info->package_throttles += delta;
+        info->throttle_total += value;
+        s->last_count[i] = value;
+    }
+    if (info->core_throttles + info->package_throttles > 0)
+        info->flags |= THERMAL_THROTTLE_EVENT;
+
+    if (correlate_usage(s, cpu, info))
+        info->flags |= THERMAL_USAGE_DROP;
+    if ((info->flags & THERMAL_AT_TRIP) && (info->flags & (THERMAL_THROTTLE_EVENT | THERMAL_USAGE_DROP))) {
+        info->flags |= THERMAL_THROTTLED;
+        s->throttled_frames++;
+    }
+    info->throttled_frames = s->throttled_frames;
+    return status;
+}
+
+int thermal_counter_count(const ThermalSampler *s) {
+    return s->counter_count;
+}
+
+void destroy_thermal_sampler(ThermalSampler *s) {
+    if (s == NULL)
+        return;
+    for (int z = 0; z < s->zone_count; z++)
+        close(s->zone_fd[z]);
+    for (int i = 0; i < s->counter_count; i++)
+        close(s->counter_fd[i]);
+    free(s->counter_fd);
+    free(s->last_count);
+    free(s->last_usage);
+    free(s);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file thermal_manip.h
+ * @brief Thermal zones, CPU throttle counters and throttled-frame detection.
+ *
+ * Discovers /sys/class/thermal/thermal_zone* (type and trip points are read
+ * once) and the thermal_throttle counters of /sys/devices/system/cpu/cpuN,
+ * keeping one descriptor per zone temperature and per counter open. The
+ * counters are read for one thread per core and one CPU per package, so
+ * SMT siblings are not counted twice. A tick costs one pread() per zone and
+ * per counter and no allocation.
+ *
+ * Each sample is correlated with the CPU usage of the same tick: a frame is
+ * flagged THERMAL_THROTTLED when a zone is at its trip point and either a
+ * throttle counter went up or usage dropped since the previous sample, which
+ * on a passively cooled board is how lost performance shows up.
+ */
+
+#ifndef THERMAL_MANIP_H
+#define THERMAL_MANIP_H
+
+#include "cpuinfo_manip.h" // For CPUInfo
+
+#define THERMAL_MAX_ZONES 16  // Zones sampled (the rest are ignored)
+#define THERMAL_TYPE_LEN 24   // Longest zone type kept, e.g. "x86_pkg_temp"
+#define THERMAL_DROP_PCT 10.0 // Fall of usage, in percentage points, that counts as a drop
+
+/* ThermalInfo.flags */
+#define THERMAL_AT_TRIP 0x1        // A zone is at or above its trip point
+#define THERMAL_THROTTLE_EVENT 0x2 // A throttle counter went up since the previous sample
+#define THERMAL_USAGE_DROP 0x4     // Aggregate or per-thread usage dropped by THERMAL_DROP_PCT or more
+#define THERMAL_THROTTLED 0x8      // At trip, and a throttle event or a usage drop: performance lost to heat
+
+/**
+ * @brief One thermal zone.
+ */
+typedef struct {
+    char type[THERMAL_TYPE_LEN]; /**< Zone type, e.g. "cpu-thermal" or "x86_pkg_temp". */
+    int index;                   /**< N of thermal_zoneN. */
+    long temp_mc;                /**< Temperature in millidegrees Celsius. */
+    long trip_mc;                /**< Lowest passive trip point (or lowest non-active one), 0 if none. */
+} ThermalZone;
+
+/**
+ * @brief Thermal state of one sample.
+ */
+typedef struct {
+    int zone_count;                        /**< Zones found (0 without /sys/class/thermal). */
+    ThermalZone zones[THERMAL_MAX_ZONES];  /**< Zones in index order. */
+    int hottest;                           /**< Zone with the highest temperature, -1 if none. */
+    unsigned long core_throttles;          /**< core_throttle_count increase since the previous sample. */
+    unsigned long package_throttles;       /**< package_throttle_count increase since the previous sample. */
+    unsigned long throttle_total;          /**< Both counters summed over all cores and packages. */
+    double usage_drop;                     /**< Fall of aggregate usage in points (0 if it rose). */
+    int dropped_threads;                   /**< CPUs whose usage fell by THERMAL_DROP_PCT or more. */
+    unsigned long throttled_frames;        /**< THERMAL_THROTTLED samples so far. */
+    int flags;                             /**< THERMAL_* bits. */
+} ThermalInfo;
+
+/**
+ * @brief Opaque sampler: open zone and counter files and the previous usage.
+ */
+typedef struct ThermalSampler ThermalSampler;
+
+/**
+ * @brief Discovers the zones and throttle counters and opens them.
+ *
+ * A machine without thermal zones or counters gets an empty sampler.
+ *
+ * @param num_cpus CPU slots of CPUInfo (sizes the per-thread usage history).
+ * @return ThermalSampler* The sampler, or NULL if out of memory.
+ */
+ThermalSampler *create_thermal_sampler(int num_cpus);
+
+/**
+ * @brief Reads every zone and counter and correlates them with cpu's usage.
+ *
+ * @param cpu Usage of the same tick (from sample_cpu_usage()).
+ * @return int 0 on success, -1 if a file could not be read (the others are still filled).
+ */
+int sample_thermal_info(ThermalSampler *sampler, const CPUInfo *cpu, ThermalInfo *info);
+
+/**
+ * @brief Number of throttle counter files read per sample.
+ */
+int thermal_counter_count(const ThermalSampler *sampler);
+
+/**
+ * @brief Closes the files and frees the sampler. Accepts NULL.
+ */
+void destroy_thermal_sampler(ThermalSampler *sampler);
+
+#endif // THERMAL_MANIP_H
@@ -0,0 +1,305 @@
+/**
+ * @file topology_manip.c
+ * @brief Implementation of sysfs CPU topology discovery and frequency sampling.
+ */
+
+#include "topology_manip.h"
+#include <dirent.h>   // For opendir(), readdir()
+#include <fcntl.h>    // For open()
+#include <stdio.h>    // For snprintf()
+#include <stdlib.h>   // For calloc(), qsort(), free()
+#include <string.h>   // For strlen(), memcmp(), strncmp()
+#include <sys/stat.h> // For fstat()
+#include <unistd.h>   // For pread(), close()
+
+#define CPU_DIR "/sys/devices/system/cpu"
+#define FREQ_LEN 32 // "4800000\n" and then some
+
+// Sort key of one online CPU
+typedef struct {
+    int package, cluster, core, cpu;
+} TopoKey;
+
+static int compare_keys(const void *a, const void *b) {
+    const TopoKey *x = a, *y = b;
+    if (x->package != y->package)
+        return x->package < y->package ? -1 : 1;
+    if (x->cluster != y->cluster)
+        return x->cluster < y->cluster ? -1 : 1;
+    if (x->core != y->core)
+        return x->core < y->core ? -1 : 1;
+    return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+// Reads one small decimal sysfs attribute; -1 if missing or not a number
+static int read_sysfs_int(int cpu, const char *attr) {
+    char rel[96], path[PROC_PATH_MAX], buf[FREQ_LEN];
+    snprintf(rel, sizeof(rel), CPU_DIR "/cpu%d/%s", cpu, attr);
+    int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+    count_proc_io(1, 0);
+    if (fd < 0)
+        return -1;
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+    count_proc_io(0, 1);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    const char *p = buf;
+    int negative = (*p == '-');
+    if (negative)
+        p++;
+    if (*p < '0' || *p > '9')
+        return -1;
+    long value = (long)scan_ulong(&p);
+    return negative ? -1 : (int)value; // cluster_id is -1 on some kernels
+}
+
+// NUMA node of a CPU from its "nodeM" link; -1 without NUMA
+static int read_cpu_node(int cpu) {
+    char rel[64], path[PROC_PATH_MAX];
+    snprintf(rel, sizeof(rel), CPU_DIR "/cpu%d", cpu);
+    DIR *dir = opendir(proc_path(rel, path));
+    count_proc_io(1, 0);
+    if (dir == NULL)
+        return -1;
+    count_proc_io(0, 1); // One getdents64() holds a cpuN directory
+    int node = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *p = entry->d_name;
+        if (strncmp(p, "node", 4) == 0 && p[4] >= '0' && p[4] <= '9') {
+            p += 4;
+            node = (int)scan_ulong(&p);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// Length of the mask text without the trailing newline
+static size_t mask_length(const char *buf) {
+    size_t len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+        len--;
+    return len;
+}
+
+// Marks the CPUs of a mask such as "0-3,6,8-11" that are below num_cpus and
+// counts the others in topo->untracked
+static int mark_online(CPUTopology *topo, const char *p) {
+    int online = 0;
+    while (*p >= '0' && *p <= '9') {
+        unsigned long first = scan_ulong(&p), last = first;
+        if (*p == '-') {
+            p++;
+            last = scan_ulong(&p);
+        }
+        unsigned long slots = (unsigned long)topo->num_cpus;
+        if (last >= slots)
+            topo->untracked += (int)(last - (first > slots ? first : slots) + 1);
+        for (unsigned long cpu = first; cpu <= last && cpu < slots; cpu++) {
+            if (!topo->cpu[cpu].online)
+                online++;
+            topo->cpu[cpu].online = 1;
+        }
+        if (*p == ',')
+            p++;
+    }
+    return online;
+}
+
+// Counts and dense indices from the sorted keys
+static void index_topology(CPUTopology *topo, const TopoKey *keys, int count) {
+    int max_node = -1, run = 0;
+    for (int i = 0; i < count; i++) {
+        const TopoKey *k = &keys[i], *prev = i > 0 ? &keys[i - 1] : NULL;
+        CPUTopoEntry *e = &topo->cpu[k->cpu];
+        if (prev == NULL || k->package != prev->package)
+            topo->packages++;
+        if (prev == NULL || k->package != prev->package || k->cluster != prev->cluster)
+            topo->clusters++;
+        // core_id is only unique within a cluster on arm64
+        if (prev == NULL || k->package != prev->package || k->cluster != prev->cluster || k->core != prev->core) {
+            topo->cores++;
+            run = 0;
+        }
+        if (++run > topo->smt)
+            topo->smt = run;
+        e->core_index = topo->cores - 1;
+        e->cluster_index = topo->clusters - 1;
+        if (e->node > max_node)
+            max_node = e->node;
+        topo->order[i] = k->cpu;
+    }
+    topo->nodes = max_node + 1 > 0 ? max_node + 1 : 1;
+}
+
+CPUTopology *discover_cpu_topology(int num_cpus) {
+    CPUTopology *topo = calloc(1, sizeof(*topo));
+    TopoKey *keys = calloc((size_t)num_cpus, sizeof(*keys));
+    if (topo == NULL || keys == NULL)
+        goto fail;
+    topo->num_cpus = num_cpus;
+    topo->cpu = calloc((size_t)num_cpus, sizeof(*topo->cpu));
+    topo->order = calloc((size_t)num_cpus, sizeof(*topo->order));
+    if (topo->cpu == NULL || topo->order == NULL)
+        goto fail;
+
+    ProcFile online;
+    char path[PROC_PATH_MAX];
+    if (open_proc_file(&online, proc_path(CPU_DIR "/online", path), 0) == 0 && read_proc_file(&online) > 0) {
+        size_t len = mask_length(online.buf);
+        topo->mask = strndup(online.buf, len);
+        topo->online = mark_online(topo, online.buf);
+    }
+    close_proc_file(&online);
+    if (topo->online == 0) { // No sysfs: every slot is online
+        for (int cpu = 0; cpu < num_cpus; cpu++)
+            topo->cpu[cpu].online = 1;
+        topo->online = num_cpus;
+    }
+    if (topo->mask == NULL && (topo->mask = strdup("")) == NULL)
+        goto fail;
+
+    // The topology directory exists for every online CPU, or for none
+    topo->from_sysfs = 1;
+    int count = 0;
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        CPUTopoEntry *e = &topo->cpu[cpu];
+        e->freq_slot = -1;
+        if (!e->online) {
+            e->package = e->core = e->cluster = e->node = -1;
+            e->core_index = e->cluster_index = -1;
+            continue;
+        }
+        e->package = topo->from_sysfs ? read_sysfs_int(cpu, "topology/physical_package_id") : -1;
+        e->core = topo->from_sysfs ? read_sysfs_int(cpu, "topology/core_id") : -1;
+        if (e->package < 0 || e->core < 0) {
+            topo->from_sysfs = 0;
+            e->package = 0;
+            e->core = cpu;
+            e->cluster = -1;
+        } else {
+            e->cluster = read_sysfs_int(cpu, "topology/cluster_id");
+        }
+        e->node = read_cpu_node(cpu);
+        keys[count++] = (TopoKey){ e->package, e->cluster, e->core, cpu };
+    }
+    if (!topo->from_sysfs) { // Mixed answers are not trusted: one core per CPU
+        for (int i = 0; i < count; i++) {
+            CPUTopoEntry *e = &topo->cpu[keys[i].cpu];
+            e->package = 0;
+            e->core = keys[i].cpu;
+            e->cluster = -1;
+            keys[i] = (TopoKey){ 0, -1, keys[i].cpu, keys[i].cpu };
+        }
+    }
+
+    qsort(keys, (size_t)count, sizeof(*keys), compare_keys);
+    index_topology(topo, keys, count);
+    free(keys);
+    return topo;
+
+fail:
+    free(keys);
+    destroy_cpu_topology(topo);
+    return NULL;
+}
+
+int open_cpu_freq(CPUTopology *topo) {
+    if (topo->freq_fd == NULL) {
+        topo->freq_fd = calloc((size_t)topo->num_cpus * 2, sizeof(int));
+        if (topo->freq_fd == NULL)
+            return 0;
+        topo->freq_cpu = topo->freq_fd + topo->num_cpus;
+    }
+    // Identity of each opened file, to share one descriptor per cpufreq policy
+    struct stat *ids = calloc((size_t)topo->num_cpus, sizeof(*ids));
+    if (ids == NULL)
+        return 0;
+
+    for (int cpu = 0; cpu < topo->num_cpus; cpu++) {
+        CPUTopoEntry *e = &topo->cpu[cpu];
+        if (!e->online || e->freq_slot >= 0)
+            continue;
+        char rel[96], path[PROC_PATH_MAX];
+        snprintf(rel, sizeof(rel), CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", cpu);
+        int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+        count_proc_io(1, 0);
+        if (fd < 0)
+            continue;
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            continue;
+        }
+        int slot = 0;
+        while (slot < topo->freq_count && (ids[slot].st_dev != st.st_dev || ids[slot].st_ino != st.st_ino))
+            slot++;
+        if (slot < topo->freq_count) {
+            close(fd); // Same policy as an earlier CPU
+        } else {
+            ids[slot] = st;
+            topo->freq_fd[slot] = fd;
+            topo->freq_cpu[slot] = cpu;
+            topo->freq_count++;
+        }
+        e->freq_slot = slot;
+    }
+    free(ids);
+    return topo->freq_count;
+}
+
+int read_cpu_freq(const CPUTopology *topo, unsigned int *khz) {
+    int status = 0;
+    // One read per file, into the slot of its first CPU
+    for (int slot = 0; slot < topo->freq_count; slot++) {
+        char buf[FREQ_LEN];
+        ssize_t n = pread(topo->freq_fd[slot], buf, sizeof(buf) - 1, 0);
+        unsigned int value = 0;
+        if (n > 0) {
+            buf[n] = '\0';
+            const char *p = buf;
+            value = (unsigned int)scan_ulong(&p);
+        } else {
+            status = -1;
+        }
+        khz[topo->freq_cpu[slot]] = value;
+    }
+    count_proc_io(0, (unsigned long)topo->freq_count);
+
+    for (int cpu = 0; cpu < topo->num_cpus; cpu++) {
+        int slot = topo->cpu[cpu].freq_slot;
+        if (slot < 0)
+            khz[cpu] = 0;
+        else if (topo->freq_cpu[slot] != cpu)
+            khz[cpu] = khz[topo->freq_cpu[slot]];
+    }
+    return status;
+}
+
+int open_cpu_online(ProcFile *online_file) {
+    char path[PROC_PATH_MAX];
+    return open_proc_file(online_file, proc_path(CPU_DIR "/online", path), 0);
+}
+
+int topology_is_current(const CPUTopology *topo, ProcFile *online_file) {
+    if (read_proc_file(online_file) < 0)
+        return -1;
+    size_t len = mask_length(online_file->buf);
+    return len == strlen(topo->mask) && memcmp(online_file->buf, topo->mask, len) == 0;
+}
+
+void destroy_cpu_topology(CPUTopology *topo) {
+    if (topo == NULL)
+        return;
+    for (int slot = 0; slot < topo->freq_count; slot++)
+        close(topo->freq_fd[slot]);
+    free(topo->freq_fd);
+    free(topo->order);
+    free(topo->cpu);
+    free(topo->mask);
+    free(topo);
+}
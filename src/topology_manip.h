@@ -0,0 +1,104 @@
+/**
+ * @file topology_manip.h
+ * @brief CPU topology from sysfs and per-CPU frequency sampling.
+ *
+ * Packages, cores, clusters and SMT siblings come from
+ * /sys/devices/system/cpu/cpuN/topology and NUMA nodes from the cpuN/nodeM
+ * links, which are right on big.LITTLE and multi-socket machines where the
+ * "cpu cores"/"siblings" lines of /proc/cpuinfo are missing or per package.
+ *
+ * Discovery walks one directory per CPU, so it is done once and cached: a
+ * CPUTopology records the online mask it was built from, and one read of
+ * /sys/devices/system/cpu/online per tick tells whether a hotplug event made
+ * it stale. The current frequency of every online CPU is read each tick
+ * through persistent descriptors on cpufreq/scaling_cur_freq; CPUs that share
+ * a cpufreq policy share the file, which is read once.
+ */
+
+#ifndef TOPOLOGY_MANIP_H
+#define TOPOLOGY_MANIP_H
+
+#include "procfile.h" // For the persistent readers
+
+/**
+ * @brief Placement of one logical CPU.
+ */
+typedef struct {
+    int online;        /**< 1 if the CPU is in the online mask. */
+    int package;       /**< physical_package_id (socket). */
+    int core;          /**< core_id, unique within the package. */
+    int cluster;       /**< cluster_id, -1 where the kernel does not report clusters. */
+    int node;          /**< NUMA node, -1 without NUMA. */
+    int core_index;    /**< Dense index of the (package, core) pair, 0 .. cores - 1. */
+    int cluster_index; /**< Dense index of the (package, cluster) pair, 0 .. clusters - 1. */
+    int freq_slot;     /**< Index of the frequency file read for this CPU, -1 if none. */
+} CPUTopoEntry;
+
+/**
+ * @brief Immutable snapshot of the machine's CPU layout.
+ */
+typedef struct {
+    int num_cpus;      /**< CPU slots described (CPUInfo.num_cpus). */
+    int online;        /**< Online CPUs below num_cpus. */
+    int untracked;     /**< Online CPUs at or above num_cpus, left out of every count (0 when num_cpus is count_cpu_slots()). */
+    int packages;      /**< Physical packages (sockets). */
+    int cores;         /**< Physical cores over all packages. */
+    int clusters;      /**< Clusters over all packages (packages when not reported). */
+    int nodes;         /**< NUMA nodes (1 without NUMA). */
+    int smt;           /**< Most threads on one core. */
+    int from_sysfs;    /**< 0 if sysfs had no topology and every CPU was made its own core. */
+    CPUTopoEntry *cpu; /**< num_cpus entries, indexed by CPU number. */
+    int *order;        /**< The online CPUs sorted by package, cluster, core and number. */
+    int freq_count;    /**< Frequency files opened by open_cpu_freq(). */
+    int *freq_fd;      /**< Their descriptors. */
+    int *freq_cpu;     /**< First CPU that reads each file. */
+    char *mask;        /**< Online mask the snapshot was built from, without the newline. */
+} CPUTopology;
+
+/**
+ * @brief Reads the topology of the online CPUs below num_cpus.
+ *
+ * Size num_cpus with count_cpu_slots() so that every CPU that can come online
+ * has a slot; online CPUs beyond it are only counted in untracked.
+ *
+ * @return CPUTopology* A new snapshot, or NULL if out of memory.
+ */
+CPUTopology *discover_cpu_topology(int num_cpus);
+
+/**
+ * @brief Opens cpufreq/scaling_cur_freq of every online CPU, one descriptor
+ * per distinct file. CPUs without cpufreq read as 0 kHz.
+ *
+ * @return int Number of files opened (0 without cpufreq).
+ */
+int open_cpu_freq(CPUTopology *topo);
+
+/**
+ * @brief Current frequency of every CPU slot in kHz (0 if offline or unknown).
+ *
+ * @param khz Array of topo->num_cpus values.
+ * @return int 0 on success, -1 if a file could not be read.
+ */
+int read_cpu_freq(const CPUTopology *topo, unsigned int *khz);
+
+/**
+ * @brief Opens /sys/devices/system/cpu/online for topology_is_current().
+ *
+ * @return int 0 on success, -1 on failure (errno is set).
+ */
+int open_cpu_online(ProcFile *online_file);
+
+/**
+ * @brief Re-reads the online mask (one read_proc_file()) and compares it with the
+ * mask the snapshot was built from.
+ *
+ * @return int 1 if the snapshot is still valid, 0 after a hotplug event, -1 on a read error.
+ */
+int topology_is_current(const CPUTopology *topo, ProcFile *online_file);
+
+/**
+ * @brief Closes the frequency files and frees the snapshot. Accepts NULL.
+ */
+void destroy_cpu_topology(CPUTopology *topo);
+
+#endif // TOPOLOGY_MANIP_H
@@ -3,27 +3,147 @@
  * @author David
  */
 
+#define NCURSES_WIDECHAR 1 // Wide-character calls of ncursesw for the graph glyphs
+
 #include <ncurses.h> // Added: Ncurses library header
 #include <stdbool.h> // Added: Standard boolean types
+#include <langinfo.h>  // For nl_langinfo()
+#include <locale.h>    // For setlocale()
+#include <stdio.h>     // For fopen()
+#include <string.h>    // For strncmp(), memcpy()
+#include <sys/ioctl.h> // For TIOCGWINSZ
+#include <unistd.h>    // For STDOUT_FILENO
 #include "tui.h"     // Added: Include its own header
 
+/*
+ * Retained field: text last drawn at (row, col). Fields that keep their
+ * text between frames are not touched, so ncurses has nothing to diff.
+ */
+typedef struct {
+    int row, col;
+    int len;        // Length of text currently on screen
+    int blank_len;  // Cells to blank before redrawing (old extent), 0 if none
+    bool seen;      // Drawn during the current frame
+    bool dirty;     // Text or attributes changed during the current frame
+    attr_t attr;    // Attributes the text is drawn with (A_NORMAL for plain)
+    char text[TUI_FIELD_MAX];
+} tui_field_t;
+
+static int screen_rows, screen_cols;  // Cached until ui_init() or ui_resize()
+static tui_field_t *fields;           // Retained fields, in drawing order
+static int field_count, field_cap;
+static int field_cursor;              // Where the next lookup starts
+static tui_frame_stats_t frame_stats; // Counters of the last finished frame
+static SCREEN *virtual_screen;        // Set by ui_init_virtual()
+static FILE *virtual_out, *virtual_in;
+
+#define TUI_GRAPH_MAX 16 // Graphs placed in one frame
+
+struct tui_graph {
+    tui_graph_style_t style;
+    int rows, width;
+    int head;             // Ring slot of the next column
+    unsigned long pushes; // Columns pushed since creation
+    unsigned long shown;  // pushes when the graph was last written
+    wchar_t *cells;       // rows rings of 2 * width glyphs; slot i is kept at i and i + width
+};
+
+/*
+ * Screen area of a graph placed in a frame. graph is NULL once the graph
+ * is destroyed; the area is still erased by the next ui_end_frame().
+ */
+typedef struct {
+    tui_graph_t *graph;
+    int row, col, rows, cols;
+    bool dirty; // Must be written in ui_end_frame()
+} tui_graph_area_t;
+
+static tui_graph_area_t graph_areas[TUI_GRAPH_MAX];      // Placed in the current frame
+static tui_graph_area_t prev_graph_areas[TUI_GRAPH_MAX]; // On screen since the previous frame
+static int graph_count, prev_graph_count;
+
+// Lowest to highest level; UTF-8 blocks replace them in ui_init()
+static const wchar_t *spark_glyphs = L" _.-=+*#", *heat_glyphs = L" .:*#";
+static int spark_levels = 8, heat_levels = 5;
+
+// Forget every retained field; the next frame redraws everything
+static void reset_fields(void) {
+    field_count = 0;
+    field_cursor = 0;
+    graph_count = prev_graph_count = 0;
+}
+
+// Use block glyphs when the terminal's locale is UTF-8
+static void choose_glyphs(void) {
+    setlocale(LC_CTYPE, ""); // ncursesw encodes wide characters for LC_CTYPE
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") == 0) {
+        spark_glyphs = L" \u2581\u2582\u2583\u2584\u2585\u2586\u2587\u2588";
+        spark_levels = 9;
+        heat_glyphs = L" \u2591\u2592\u2593\u2588";
+        heat_levels = 5;
+    }
+}
+
+// Re-read the terminal size from ncurses
+static void cache_dims(void) {
+    getmaxyx(stdscr, screen_rows, screen_cols);
+}
+
 /* Initialize ncurses mode and terminal settings */
 void ui_init(void) {
+    choose_glyphs();
     initscr();           // Start ncurses mode
     cbreak();            // Make characters available immediately
     noecho();            // Disable echoing of typed characters
     curs_set(0);         // Hide the cursor
     keypad(stdscr, TRUE);// Enable arrow keys and function keys
+    cache_dims();
+    reset_fields();
+}
+
+/* Same screen without a terminal: output goes to /dev/null */
+int ui_init_virtual(int rows, int cols) {
+    choose_glyphs();
+    virtual_out = fopen("/dev/null", "w");
+    virtual_in = fopen("/dev/null", "r");
+    if (virtual_out != NULL && virtual_in != NULL)
+        virtual_screen = newterm("xterm", virtual_out, virtual_in);
+    if (virtual_screen == NULL) {
+        if (virtual_out != NULL)
+            fclose(virtual_out);
+        if (virtual_in != NULL)
+            fclose(virtual_in);
+        virtual_out = virtual_in = NULL;
+        return -1;
+    }
+    set_term(virtual_screen);
+    resizeterm(rows, cols);
+    curs_set(0);
+    cache_dims();
+    reset_fields();
+    return 0;
 }
 
 /* Restore terminal configuration */
 void ui_cleanup(void) {
     endwin();
+    if (virtual_screen != NULL) {
+        delscreen(virtual_screen);
+        fclose(virtual_out);
+        fclose(virtual_in);
+        virtual_screen = NULL;
+        virtual_out = virtual_in = NULL;
+    }
+    free(fields);
+    fields = NULL;
+    field_cap = 0;
+    reset_fields();
 }
 
 /* Clear the screen (buffer) */
 void ui_clear(void) {
     erase();
+    reset_fields();
 }
 
 /* Update the terminal display with the buffer contents */
@@ -42,9 +162,24 @@ int ui_exit(void) {
     return (ch == 'q' || ch == 'Q') ? 1 : 0; // Check for 'q' or 'Q'
 }
 
+/* Retrieve a single key press; returns ERR when none is pending in non-blocking mode */
+int ui_get_key(void) {
+    return getch();
+}
+
+/* Adopt the terminal's new size after a SIGWINCH delivered outside ncurses */
+void ui_resize(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0)
+        resizeterm(ws.ws_row, ws.ws_col);
+    cache_dims();
+    ui_clear(); // Layout depends on the size: redraw every field
+}
+
 /* Get the current dimensions of the terminal window */
 void ui_get_dims(int *rows, int *cols) {
-    getmaxyx(stdscr, *rows, *cols);
+    *rows = screen_rows;
+    *cols = screen_cols;
 }
 
 /* ------------------ Coordinate System Functions ------------------ */
@@ -83,4 +218,283 @@ tui_coord_t tui_clamp_coord(tui_coord_t coord) {
 void tui_draw_text(tui_coord_t pt, const char *text) {
     tui_coord_t safe_pt = tui_clamp_coord(pt);
     mvprintw(safe_pt.row, safe_pt.col, "%s", text);
-}
\ No newline at end of file
+}
+
+/* ------------------ Retained Field Functions ------------------ */
+
+/* Start a frame: every retained field is unseen until drawn again */
+void ui_begin_frame(void) {
+    for (int i = 0; i < field_count; i++) {
+        fields[i].seen = false;
+        fields[i].dirty = false;
+        fields[i].blank_len = 0;
+    }
+    field_cursor = 0;
+    graph_count = 0;
+    memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+/*
+ * Find the field at (row, col). Frames draw fields in the same order, so the
+ * search starts where the previous lookup ended and is usually one compare.
+ */
+static tui_field_t *find_field(int row, int col) {
+    for (int n = 0; n < field_count; n++) {
+        int i = (field_cursor + n) % field_count;
+        if (fields[i].row == row && fields[i].col == col) {
+            field_cursor = i + 1;
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Append a new, empty field; NULL if out of memory
+static tui_field_t *add_field(int row, int col) {
+    if (field_count == field_cap) {
+        int cap = field_cap ? field_cap * 2 : 64;
+        tui_field_t *grown = realloc(fields, (size_t)cap * sizeof(*grown));
+        if (grown == NULL)
+            return NULL;
+        fields = grown;
+        field_cap = cap;
+    }
+    tui_field_t *f = &fields[field_count++];
+    memset(f, 0, sizeof(*f));
+    f->row = row;
+    f->col = col;
+    field_cursor = field_count;
+    return f;
+}
+
+/* Record text for the field at pt; it reaches the screen in ui_end_frame() only if it changed */
+void tui_draw_field(tui_coord_t pt, const char *text) {
+    tui_draw_field_attr(pt, text, A_NORMAL);
+}
+
+/* Likewise with attributes, e.g. A_REVERSE for an alert; a change of attributes redraws the field */
+void tui_draw_field_attr(tui_coord_t pt, const char *text, attr_t attr) {
+    tui_coord_t safe_pt = tui_clamp_coord(pt);
+    tui_field_t *f = find_field(safe_pt.row, safe_pt.col);
+    if (f == NULL && (f = add_field(safe_pt.row, safe_pt.col)) == NULL)
+        return;
+
+    // Clip to the line so a field never wraps onto the next row
+    int len = (int)strnlen(text, TUI_FIELD_MAX - 1);
+    if (len > screen_cols - safe_pt.col)
+        len = screen_cols - safe_pt.col;
+
+    f->seen = true;
+    frame_stats.fields++;
+    if (len == f->len && attr == f->attr && strncmp(f->text, text, (size_t)len) == 0)
+        return; // Unchanged: nothing to send
+
+    f->blank_len = f->len;
+    f->dirty = true;
+    f->attr = attr;
+    memcpy(f->text, text, (size_t)len);
+    f->text[len] = '\0';
+    f->len = len;
+}
+
+// True if the field overlaps cells [col, col + len) of row
+static bool field_overlaps(const tui_field_t *f, int row, int col, int len) {
+    return f->row == row && f->col < col + len && col < f->col + f->len;
+}
+
+// True if cells [col, col + len) of row fall inside the area
+static bool area_overlaps(const tui_graph_area_t *a, int row, int col, int len) {
+    return row >= a->row && row < a->row + a->rows && a->col < col + len && col < a->col + a->cols;
+}
+
+// True if two graph areas share a cell
+static bool areas_overlap(const tui_graph_area_t *a, const tui_graph_area_t *b) {
+    return a->row < b->row + b->rows && b->row < a->row + a->rows &&
+           a->col < b->col + b->cols && b->col < a->col + a->cols;
+}
+
+// Index of the area of the same graph at the same place and size in list, -1 if none
+static int find_graph_area(const tui_graph_area_t *list, int count, const tui_graph_area_t *a) {
+    for (int i = 0; i < count; i++) {
+        const tui_graph_area_t *b = &list[i];
+        if (b->graph == a->graph && b->row == a->row && b->col == a->col && b->rows == a->rows && b->cols == a->cols)
+            return i;
+    }
+    return -1;
+}
+
+// Blank a graph area left behind and have the fields it ran over rewritten
+static void blank_graph_area(const tui_graph_area_t *a) {
+    for (int r = 0; r < a->rows; r++) {
+        mvhline(a->row + r, a->col, ' ', a->cols);
+        for (int j = 0; j < field_count; j++) {
+            tui_field_t *f = &fields[j];
+            if (f->seen && field_overlaps(f, a->row + r, a->col, a->cols))
+                f->dirty = true;
+        }
+    }
+    frame_stats.cells += a->rows * a->cols;
+}
+
+// Write the newest a->cols columns of the visible rows
+static void write_graph(const tui_graph_area_t *a) {
+    tui_graph_t *g = a->graph;
+    for (int r = 0; r < a->rows; r++) {
+        const wchar_t *ring = g->cells + (size_t)r * 2 * (size_t)g->width;
+        mvaddnwstr(a->row + r, a->col, ring + g->head + (g->width - a->cols), a->cols);
+    }
+    g->shown = g->pushes;
+    frame_stats.graphs++;
+    frame_stats.cells += a->rows * a->cols;
+}
+
+/*
+ * Finish a frame: blank the old extent of changed and vanished fields and
+ * graphs, write changed text, restore unchanged neighbours a blank ran over,
+ * write the graphs that scrolled, moved or were blanked, then refresh.
+ */
+void ui_end_frame(void) {
+    for (int k = 0; k < graph_count; k++) {
+        tui_graph_area_t *a = &graph_areas[k];
+        a->dirty = a->graph->shown != a->graph->pushes || find_graph_area(prev_graph_areas, prev_graph_count, a) < 0;
+    }
+    for (int i = 0; i < prev_graph_count; i++) {
+        const tui_graph_area_t *old = &prev_graph_areas[i];
+        if (find_graph_area(graph_areas, graph_count, old) >= 0)
+            continue; // Still in place
+        blank_graph_area(old);
+        for (int k = 0; k < graph_count; k++)
+            if (areas_overlap(&graph_areas[k], old))
+                graph_areas[k].dirty = true;
+    }
+
+    for (int i = 0; i < field_count; i++) {
+        tui_field_t *f = &fields[i];
+        int blank = f->seen ? f->blank_len : f->len;
+        if (blank == 0)
+            continue;
+        mvhline(f->row, f->col, ' ', blank);
+        frame_stats.cells += blank;
+        for (int j = 0; j < field_count; j++) {
+            tui_field_t *other = &fields[j];
+            if (j != i && other->seen && field_overlaps(other, f->row, f->col, blank))
+                other->dirty = true; // Rewritten below; ncurses sends nothing if it matches
+        }
+        for (int k = 0; k < graph_count; k++)
+            if (area_overlaps(&graph_areas[k], f->row, f->col, blank))
+                graph_areas[k].dirty = true;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < field_count; i++) {
+        tui_field_t *f = &fields[i];
+        if (!f->seen)
+            continue; // Vanished field, already blanked
+        if (f->dirty) {
+            if (f->attr != A_NORMAL)
+                attrset(f->attr);
+            mvaddnstr(f->row, f->col, f->text, f->len);
+            if (f->attr != A_NORMAL)
+                attrset(A_NORMAL);
+            frame_stats.redrawn++;
+            frame_stats.cells += f->len;
+        }
+        fields[kept++] = *f;
+    }
+    field_count = kept;
+    field_cursor = 0;
+
+    for (int k = 0; k < graph_count; k++)
+        if (graph_areas[k].dirty)
+            write_graph(&graph_areas[k]);
+    memcpy(prev_graph_areas, graph_areas, (size_t)graph_count * sizeof(graph_areas[0]));
+    prev_graph_count = graph_count;
+    refresh();
+}
+
+/* Counters of the last finished frame */
+void ui_get_frame_stats(tui_frame_stats_t *stats) {
+    *stats = frame_stats;
+}
+
+/* ------------------ Retained Graph Functions ------------------ */
+
+/* Blank graph of rows x width cells */
+tui_graph_t *tui_create_graph(tui_graph_style_t style, int rows, int width) {
+    if (rows <= 0 || width <= 0)
+        return NULL;
+    tui_graph_t *g = calloc(1, sizeof(*g));
+    if (g == NULL)
+        return NULL;
+    g->cells = malloc((size_t)rows * 2 * (size_t)width * sizeof(wchar_t));
+    if (g->cells == NULL) {
+        free(g);
+        return NULL;
+    }
+    for (size_t i = 0; i < (size_t)rows * 2 * (size_t)width; i++)
+        g->cells[i] = L' ';
+    g->style = style;
+    g->rows = rows;
+    g->width = width;
+    return g;
+}
+
+/* Append one column: one glyph per row ring, written at both of its copies */
+void tui_push_graph(tui_graph_t *g, const float *values) {
+    int levels;
+    const wchar_t *glyphs = tui_graph_glyphs(g->style, &levels);
+    for (int r = 0; r < g->rows; r++) {
+        // Round up from a quarter level, so a lightly loaded row is not blank
+        float v = values[r];
+        int level = v <= 0.0f ? 0 : v >= 1.0f ? levels - 1 : (int)(v * (float)(levels - 1) + 0.75f);
+        wchar_t *ring = g->cells + (size_t)r * 2 * (size_t)g->width;
+        ring[g->head] = ring[g->head + g->width] = glyphs[level];
+    }
+    g->head = g->head + 1 == g->width ? 0 : g->head + 1;
+    g->pushes++;
+}
+
+/* Place the graph for this frame; ui_end_frame() decides whether to write it */
+void tui_draw_graph(tui_coord_t pt, tui_graph_t *g) {
+    if (graph_count == TUI_GRAPH_MAX)
+        return;
+    tui_coord_t safe_pt = tui_clamp_coord(pt);
+    tui_graph_area_t *a = &graph_areas[graph_count++];
+    a->graph = g;
+    a->row = safe_pt.row;
+    a->col = safe_pt.col;
+    a->rows = g->rows < screen_rows - safe_pt.row ? g->rows : screen_rows - safe_pt.row;
+    a->cols = g->width < screen_cols - safe_pt.col ? g->width : screen_cols - safe_pt.col;
+    a->dirty = false;
+}
+
+int tui_graph_rows(const tui_graph_t *g) {
+    return g->rows;
+}
+
+int tui_graph_width(const tui_graph_t *g) {
+    return g->width;
+}
+
+/* Glyph set of a style for the current locale */
+const wchar_t *tui_graph_glyphs(tui_graph_style_t style, int *levels) {
+    *levels = style == TUI_SPARKLINE ? spark_levels : heat_levels;
+    return style == TUI_SPARKLINE ? spark_glyphs : heat_glyphs;
+}
+
+/* Free the graph; an on-screen area keeps a NULL graph until erased */
+void tui_destroy_graph(tui_graph_t *g) {
+    if (g == NULL)
+        return;
+    for (int i = 0; i < prev_graph_count; i++)
+        if (prev_graph_areas[i].graph == g)
+            prev_graph_areas[i].graph = NULL;
+    for (int k = 0; k < graph_count; k++) {
+        if (graph_areas[k].graph == g) { // Placed this frame, then destroyed: drop it
+            graph_areas[k] = graph_areas[--graph_count];
+            k--;
+        }
+    }
+    free(g->cells);
+    free(g);
+}
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
+#include <wchar.h>
 
 /* 
  * A structure to hold terminal coordinates.
@@ -28,13 +29,44 @@ typedef struct{
     float y;
 }display_ax_t;
 
+#define TUI_FIELD_MAX 256 // Longest text kept for a retained field
+
+/*
+ * Work done by the last ui_begin_frame()/ui_end_frame() pair.
+ */
+typedef struct {
+    int fields;  // Fields drawn during the frame
+    int redrawn; // Fields whose text changed and was written to the screen
+    int cells;   // Cells written (text plus blanking)
+    int graphs;  // Graphs written because they were pushed, moved or damaged
+} tui_frame_stats_t;
+
+/*
+ * How a graph turns a value between 0.0 and 1.0 into a cell: a sparkline
+ * uses eighth blocks, a heatmap shades (ASCII stand-ins outside UTF-8 locales).
+ */
+typedef enum {
+    TUI_SPARKLINE,
+    TUI_HEATMAP
+} tui_graph_style_t;
+
+/*
+ * Retained graph: rows x width cells scrolling left as columns are pushed.
+ * Each row keeps its glyphs in a ring stored twice over, so a push writes
+ * one cell per row and the visible window is always one contiguous run.
+ */
+typedef struct tui_graph tui_graph_t;
+
 /* TUI initialization and control functions */
 void ui_init(void);
+int ui_init_virtual(int rows, int cols); // Screen of rows x cols drawn to /dev/null (benchmarks); 0 or -1
 void ui_cleanup(void);
 void ui_clear(void);
 void ui_refresh(void);
 void ui_set_nodelay(bool enabled);
 int ui_exit(void);
+int ui_get_key(void);
+void ui_resize(void);
 void ui_get_dims(int *rows, int *cols);
 
 /* Coordinate system helper functions */
@@ -65,4 +97,97 @@ tui_coord_t tui_clamp_coord(tui_coord_t coord);
  */
 void tui_draw_text(tui_coord_t pt, const char *text);
 
+/* Retained (damage-tracked) drawing */
+
+/**
+ * @brief Starts a retained frame. Every field drawn during the previous frame
+ * is marked unseen.
+ */
+void ui_begin_frame(void);
+
+/**
+ * @brief Draws a retained text field at the specified coordinate.
+ * The text is compared with what the field showed in the previous frame and
+ * only reaches the screen if it changed. Fields are identified by their
+ * (clamped) coordinate; text is clipped at the right edge instead of wrapping.
+ *
+ * @param pt The coordinate where the field starts.
+ * @param text The text string to display.
+ */
+void tui_draw_field(tui_coord_t pt, const char *text);
+
+/**
+ * @brief Draws a retained text field with attributes (e.g. A_REVERSE | A_BOLD).
+ * A field whose attributes change is redrawn even if its text did not.
+ *
+ * @param pt The coordinate where the field starts.
+ * @param text The text string to display.
+ * @param attr ncurses attributes, A_NORMAL for plain text.
+ */
+void tui_draw_field_attr(tui_coord_t pt, const char *text, attr_t attr);
+
+/**
+ * @brief Ends a retained frame: erases fields that were not drawn again,
+ * writes changed ones and refreshes the screen.
+ */
+void ui_end_frame(void);
+
+/**
+ * @brief Gets the counters of the last finished frame.
+ *
+ * @param stats Filled with the number of fields, redrawn fields and cells written.
+ */
+void ui_get_frame_stats(tui_frame_stats_t *stats);
+
+/* Retained graphs */
+
+/**
+ * @brief Allocates a blank graph; nothing is allocated afterwards.
+ *
+ * @param style Glyphs used for the cells.
+ * @param rows Rows, one per series.
+ * @param width Columns kept, the newest at the right.
+ * @return tui_graph_t* The graph, or NULL if a size is not positive or the allocation failed.
+ */
+tui_graph_t *tui_create_graph(tui_graph_style_t style, int rows, int width);
+
+/**
+ * @brief Scrolls every row one column left and appends one value per row.
+ * Values are clamped to 0.0 .. 1.0.
+ *
+ * @param values rows values.
+ */
+void tui_push_graph(tui_graph_t *graph, const float *values);
+
+/**
+ * @brief Places the graph at pt for the current frame. ui_end_frame()
+ * writes it only if columns were pushed since it was last written, it moved
+ * or a field blanked part of it; a graph not drawn again is erased. Rows and
+ * columns past the screen edges are clipped, keeping the newest columns.
+ */
+void tui_draw_graph(tui_coord_t pt, tui_graph_t *graph);
+
+/**
+ * @brief Number of rows of the graph.
+ */
+int tui_graph_rows(const tui_graph_t *graph);
+
+/**
+ * @brief Number of columns of the graph.
+ */
+int tui_graph_width(const tui_graph_t *graph);
+
+/**
+ * @brief Glyphs of a style from the lowest to the highest level, as chosen
+ * by ui_init() for the locale.
+ *
+ * @param levels Set to the number of glyphs.
+ */
+const wchar_t *tui_graph_glyphs(tui_graph_style_t style, int *levels);
+
+/**
+ * @brief Frees the graph; if it is on screen, the next ui_end_frame() erases it. Accepts NULL.
+ */
+void tui_destroy_graph(tui_graph_t *graph);
+
 #endif // TUI_H
\ No newline at end of file
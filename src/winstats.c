@@ -0,0 +1,309 @@
+/**
+ * @file winstats.c
+ * @brief Implementation of the rolling window statistics: a ring of
+ * one-second slots, per-window histograms and min/max deques.
+ */
+
+#include "winstats.h"
+#include <stdint.h> // For uint16_t, uint32_t
+#include <stdlib.h> // For calloc(), free()
+#include <string.h> // For memset()
+
+#define SLOT_MAX_SAMPLES 327 // Samples summed per slot: 327 * 200 fits a uint16_t
+
+static const int window_slots[WINSTATS_WINDOWS] = { 60, 300, 900 };
+static const char *const window_names[WINSTATS_WINDOWS] = { "1m", "5m", "15m" };
+static const char *const figure_names[WINSTATS_FIGURES] = { "min", "mean", "p95", "p99", "max" };
+
+// One series in one slot of the ring, in bins (half points)
+typedef struct {
+    uint8_t min, max;
+    uint16_t sum;
+} SlotValue;
+
+// Slot means of one series over one window
+typedef struct {
+    uint16_t bins[WINSTATS_BINS];
+    uint16_t groups[WINSTATS_GROUPS]; // Sum of each run of WINSTATS_GROUP bins
+    uint32_t sum;                     // Sum of every sample of the window, in bins
+} Histogram;
+
+// Ring positions of decreasing maxima (increasing minima), oldest first
+typedef struct {
+    uint16_t head, len;
+    uint16_t slot[WINSTATS_SLOTS];
+} Deque;
+
+typedef struct {
+    Histogram hist[WINSTATS_WINDOWS];
+    Deque min, max;
+} SeriesStats;
+
+struct WindowStats {
+    int series;
+    long long slot;                          // Slot of the newest sample, -1 before the first
+    unsigned long samples[WINSTATS_WINDOWS]; // Samples per window
+    int filled[WINSTATS_WINDOWS];            // Slots holding a sample per window
+    uint16_t count[WINSTATS_SLOTS];          // Samples summed in each slot, 0 for none
+    SeriesStats *stats;                      // series entries
+    SlotValue *ring;                         // WINSTATS_SLOTS rows of series values
+    float *values;                           // Row filled by record_window_stats()
+};
+
+size_t window_stats_size(int series) {
+    return sizeof(WindowStats) +
+           (size_t)series * (sizeof(SeriesStats) + WINSTATS_SLOTS * sizeof(SlotValue) + sizeof(float));
+}
+
+WindowStats *create_window_stats(int series) {
+    if (series <= 0)
+        return NULL;
+    WindowStats *ws = calloc(1, sizeof(*ws));
+    if (ws == NULL)
+        return NULL;
+    ws->series = series;
+    ws->slot = -1;
+    ws->stats = calloc((size_t)series, sizeof(SeriesStats));
+    ws->ring = calloc((size_t)series * WINSTATS_SLOTS, sizeof(SlotValue));
+    ws->values = calloc((size_t)series, sizeof(float));
+    if (ws->stats == NULL || ws->ring == NULL || ws->values == NULL) {
+        destroy_window_stats(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+// Mean of a slot's samples as a bin, rounded
+static int slot_mean(const SlotValue *v, int count) {
+    return (2 * v->sum + count) / (2 * count);
+}
+
+static void hist_add(Histogram *h, int bin) {
+    h->bins[bin]++;
+    h->groups[bin / WINSTATS_GROUP]++;
+}
+
+static void hist_remove(Histogram *h, int bin) {
+    h->bins[bin]--;
+    h->groups[bin / WINSTATS_GROUP]--;
+}
+
+static const SlotValue *ring_value(const WindowStats *ws, int slot, int series) {
+    return &ws->ring[(size_t)slot * (size_t)ws->series + (size_t)series];
+}
+
+// Push a ring slot whose max (is_max) or min just changed
+static void deque_push(Deque *q, const WindowStats *ws, int series, int slot, int is_max) {
+    int v = is_max ? ring_value(ws, slot, series)->max : ring_value(ws, slot, series)->min;
+    while (q->len > 0) {
+        const SlotValue *back = ring_value(ws, q->slot[(q->head + q->len - 1) % WINSTATS_SLOTS], series);
+        if (is_max ? back->max > v : back->min < v)
+            break;
+        q->len--;
+    }
+    q->slot[(q->head + q->len) % WINSTATS_SLOTS] = (uint16_t)slot;
+    q->len++;
+}
+
+// Drop the deque's oldest entry if it is the ring slot about to be reused
+static void deque_expire(Deque *q, int slot) {
+    if (q->len > 0 && q->slot[q->head] == slot) {
+        q->head = (uint16_t)((q->head + 1) % WINSTATS_SLOTS);
+        q->len--;
+    }
+}
+
+static void reset_window_stats(WindowStats *ws) {
+    memset(ws->samples, 0, sizeof(ws->samples));
+    memset(ws->filled, 0, sizeof(ws->filled));
+    memset(ws->count, 0, sizeof(ws->count));
+    memset(ws->stats, 0, (size_t)ws->series * sizeof(SeriesStats));
+}
+
+/*
+ * Move the newest slot to slot: every slot passed over leaves each window
+ * it has aged out of, and its ring entry is emptied for reuse.
+ */
+static void advance_window_stats(WindowStats *ws, long long slot) {
+    if (ws->slot < 0 || slot - ws->slot >= WINSTATS_SLOTS) {
+        reset_window_stats(ws);
+        ws->slot = slot;
+        return;
+    }
+    for (long long t = ws->slot + 1; t <= slot; t++) {
+        for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+            // Slots are CLOCK_MONOTONIC seconds: nothing has aged out in the
+            // first window after boot, and the index would be negative
+            if (t < window_slots[w])
+                continue;
+            int old = (int)((t - window_slots[w]) % WINSTATS_SLOTS);
+            int count = ws->count[old];
+            if (count == 0)
+                continue;
+            const SlotValue *row = ring_value(ws, old, 0);
+            for (int s = 0; s < ws->series; s++) {
+                Histogram *h = &ws->stats[s].hist[w];
+                hist_remove(h, slot_mean(&row[s], count));
+                h->sum -= row[s].sum;
+            }
+            ws->samples[w] -= (unsigned long)count;
+            ws->filled[w]--;
+        }
+        int reused = (int)(t % WINSTATS_SLOTS);
+        ws->count[reused] = 0;
+        for (int s = 0; s < ws->series; s++) {
+            deque_expire(&ws->stats[s].min, reused);
+            deque_expire(&ws->stats[s].max, reused);
+        }
+    }
+    ws->slot = slot;
+}
+
+void push_window_stats(WindowStats *ws, long long time_ns, const float *values) {
+    long long slot = time_ns / WINSTATS_SLOT_NS;
+    if (slot > ws->slot)
+        advance_window_stats(ws, slot);
+    int i = (int)(ws->slot % WINSTATS_SLOTS);
+    int before = ws->count[i];
+    int summed = before < SLOT_MAX_SAMPLES; // A full slot only tracks its extremes
+    int after = before + summed;
+    SlotValue *row = &ws->ring[(size_t)i * (size_t)ws->series];
+
+    for (int s = 0; s < ws->series; s++) {
+        float v = values[s];
+        int bin = !(v > 0.0f) ? 0 : v >= 100.0f ? WINSTATS_BINS - 1 : (int)(v * 2.0f + 0.5f);
+        SlotValue *e = &row[s];
+        SeriesStats *st = &ws->stats[s];
+        if (before == 0) {
+            e->min = e->max = (uint8_t)bin;
+            e->sum = (uint16_t)bin;
+            for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+                hist_add(&st->hist[w], bin);
+                st->hist[w].sum += (uint32_t)bin;
+            }
+            deque_push(&st->min, ws, s, i, 0);
+            deque_push(&st->max, ws, s, i, 1);
+            continue;
+        }
+        if (summed) {
+            int old_mean = slot_mean(e, before);
+            e->sum = (uint16_t)(e->sum + bin);
+            int new_mean = slot_mean(e, after);
+            for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+                if (new_mean != old_mean) {
+                    hist_remove(&st->hist[w], old_mean);
+                    hist_add(&st->hist[w], new_mean);
+                }
+                st->hist[w].sum += (uint32_t)bin;
+            }
+        }
+        if (bin < e->min) {
+            e->min = (uint8_t)bin;
+            deque_push(&st->min, ws, s, i, 0);
+        }
+        if (bin > e->max) {
+            e->max = (uint8_t)bin;
+            deque_push(&st->max, ws, s, i, 1);
+        }
+    }
+
+    ws->count[i] = (uint16_t)after;
+    for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+        ws->samples[w] += (unsigned long)summed;
+        ws->filled[w] += before == 0;
+    }
+}
+
+void record_window_stats(WindowStats *ws, const Sample *s) {
+    ws->values[WINSTATS_CPU] = (float)s->cpu.usage;
+    for (int i = 0; i < ws->series - WINSTATS_THREADS; i++)
+        ws->values[WINSTATS_THREADS + i] = i < s->cpu.num_cpus ? (float)s->cpu.thread_usage[i] : 0.0f;
+    push_window_stats(ws, (long long)s->timestamp.tv_sec * 1000000000LL + s->timestamp.tv_nsec, ws->values);
+}
+
+void window_stats_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters) {
+    (void)counters;
+    record_window_stats(ctx, sample);
+}
+
+// Extreme of a window: the oldest deque entry no older than the window
+static int deque_extreme(const WindowStats *ws, const Deque *q, int series, int window, int is_max) {
+    int newest = (int)(ws->slot % WINSTATS_SLOTS);
+    int lo = 0, hi = q->len - 1; // The newest slot is always the last entry
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int age = (newest - q->slot[(q->head + mid) % WINSTATS_SLOTS] + WINSTATS_SLOTS) % WINSTATS_SLOTS;
+        if (age < window_slots[window])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    const SlotValue *v = ring_value(ws, q->slot[(q->head + lo) % WINSTATS_SLOTS], series);
+    return is_max ? v->max : v->min;
+}
+
+// Bin of the rank-th smallest slot mean (1-based): whole groups first, then bins
+static int hist_rank(const Histogram *h, int rank) {
+    int g = 0, seen = 0;
+    while (g < WINSTATS_GROUPS - 1 && seen + h->groups[g] < rank)
+        seen += h->groups[g++];
+    int bin = g * WINSTATS_GROUP;
+    while (bin < WINSTATS_BINS - 1 && seen + h->bins[bin] < rank)
+        seen += h->bins[bin++];
+    return bin;
+}
+
+double window_percentile(const WindowStats *ws, int series, int window, double share) {
+    int n = ws->filled[window];
+    if (n == 0)
+        return 0.0;
+    int rank = (int)(share * n);
+    if (rank < share * n - 1e-9) // Round up, but not 0.95 * 60 to 58
+        rank++;
+    rank = rank < 1 ? 1 : rank > n ? n : rank;
+    return hist_rank(&ws->stats[series].hist[window], rank) / 2.0;
+}
+
+void get_window_summary(const WindowStats *ws, int series, int window, WindowSummary *out) {
+    memset(out, 0, sizeof(*out));
+    if (ws->slot < 0 || ws->filled[window] == 0)
+        return;
+    const SeriesStats *st = &ws->stats[series];
+    out->samples = ws->samples[window];
+    out->seconds = ws->filled[window];
+    out->min = deque_extreme(ws, &st->min, series, window, 0) / 2.0;
+    out->max = deque_extreme(ws, &st->max, series, window, 1) / 2.0;
+    out->mean = st->hist[window].sum / 2.0 / (double)ws->samples[window];
+    out->p95 = window_percentile(ws, series, window, 0.95);
+    out->p99 = window_percentile(ws, series, window, 0.99);
+}
+
+double window_figure(const WindowSummary *s, int figure) {
+    const double figures[WINSTATS_FIGURES] = { s->min, s->mean, s->p95, s->p99, s->max };
+    return figures[figure];
+}
+
+const char *window_figure_name(int figure) {
+    return figure_names[figure];
+}
+
+const char *window_name(int window) {
+    return window_names[window];
+}
+
+int window_seconds(int window) {
+    return window_slots[window] * (int)(WINSTATS_SLOT_NS / 1000000000LL);
+}
+
+int window_stats_series(const WindowStats *ws) {
+    return ws->series;
+}
+
+void destroy_window_stats(WindowStats *ws) {
+    if (ws == NULL)
+        return;
+    free(ws->stats);
+    free(ws->ring);
+    free(ws->values);
+    free(ws);
+}
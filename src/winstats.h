@@ -0,0 +1,139 @@
+/**
+ * @file winstats.h
+ * @brief Rolling 1, 5 and 15 minute statistics (min, mean, p95, p99, max)
+ * of percentages, per CPU, updated in O(1) per sample.
+ *
+ * Time is cut into one-second slots. A ring of the last WINSTATS_SLOTS slots
+ * (15 min) keeps, for every series, the minimum, maximum and sum of the
+ * slot's samples; the three windows are its newest 60, 300 and 900 slots.
+ * Each window has, per series, a histogram of its slot means in 0.5-point
+ * bins, grouped by WINSTATS_GROUP so that a percentile is found in at most
+ * WINSTATS_GROUPS + WINSTATS_GROUP steps. One monotonic deque per series for
+ * the minimum and one for the maximum serve all three windows: a window's
+ * extreme is the oldest deque entry inside it.
+ *
+ * A sample adds to the histograms and deques of its slot; each slot that
+ * leaves a window is subtracted from that window's histogram, and a ring
+ * entry is reused only once it has left all of them. Nothing is allocated
+ * after create_window_stats(), and the memory is fixed by the number of
+ * series: window_stats_size() bytes, about 8.5 kB per series (8.7 MB for
+ * 1024 CPUs and their total).
+ *
+ * Minimum, maximum and mean cover every sample. Percentiles are of the
+ * one-second means, so they are exact at intervals of a second or more and
+ * read one-second utilisation at shorter ones. Values are kept at a
+ * resolution of 0.5 points, clamped to 0..100.
+ *
+ * Not synchronised: the thread that records is the one that reads.
+ */
+
+#ifndef WINSTATS_H
+#define WINSTATS_H
+
+#include "collector.h"
+#include <stddef.h> // For size_t
+
+#define WINSTATS_WINDOWS 3            // 1, 5 and 15 minutes
+#define WINSTATS_SLOTS 900            // One-second slots of the longest window
+#define WINSTATS_SLOT_NS 1000000000LL // Length of a slot
+#define WINSTATS_BINS 201             // 0, 0.5, ... 100 percent
+#define WINSTATS_GROUP 16             // Bins per group of the two-level histogram
+#define WINSTATS_GROUPS ((WINSTATS_BINS + WINSTATS_GROUP - 1) / WINSTATS_GROUP)
+#define WINSTATS_FIGURES 5            // min, mean, p95, p99, max
+
+#define WINSTATS_CPU 0                     // Series recorded by record_window_stats()
+#define WINSTATS_THREADS 1                 // First of one series per CPU
+#define WINSTATS_SERIES(cpus) (WINSTATS_THREADS + (cpus))
+
+/**
+ * @brief Figures of one series over one window, in percent.
+ */
+typedef struct {
+    unsigned long samples; /**< Samples in the window, 0 before the first. */
+    int seconds;           /**< One-second slots of the window holding a sample. */
+    double min, mean, p95, p99, max;
+} WindowSummary;
+
+/**
+ * @brief Opaque statistics of a fixed number of series.
+ */
+typedef struct WindowStats WindowStats;
+
+/**
+ * @brief Allocates empty statistics for series values per sample.
+ *
+ * @return WindowStats* The statistics, or NULL if series is not positive or
+ * the allocation failed.
+ */
+WindowStats *create_window_stats(int series);
+
+/**
+ * @brief Bytes allocated by create_window_stats(series).
+ */
+size_t window_stats_size(int series);
+
+/**
+ * @brief Adds one value per series (percent) taken at time_ns
+ * (CLOCK_MONOTONIC). Times must not go back; a gap of 15 min or more starts
+ * the statistics afresh.
+ */
+void push_window_stats(WindowStats *stats, long long time_ns, const float *values);
+
+/**
+ * @brief Adds a sample to statistics created with WINSTATS_SERIES(num_cpus)
+ * series: the CPU usage, then every thread's usage.
+ */
+void record_window_stats(WindowStats *stats, const Sample *sample);
+
+/**
+ * @brief CollectorSink calling record_window_stats(), for sinks registered
+ * after it that read the statistics on the sampling thread.
+ *
+ * @param ctx The WindowStats.
+ */
+void window_stats_sink(void *ctx, const Sample *sample, const CPUStatsStore *counters);
+
+/**
+ * @brief Figures of one series over window 0 (1 min), 1 (5 min) or 2 (15 min)
+ * ending at the newest sample. All zero before the first sample.
+ */
+void get_window_summary(const WindowStats *stats, int series, int window, WindowSummary *summary);
+
+/**
+ * @brief The value below which share (0..1) of the window's one-second
+ * means fall (nearest rank), 0 before the first sample.
+ */
+double window_percentile(const WindowStats *stats, int series, int window, double share);
+
+/**
+ * @brief Figure of a summary by index, in WindowSummary order: 0 min,
+ * 1 mean, 2 p95, 3 p99, 4 max.
+ */
+double window_figure(const WindowSummary *summary, int figure);
+
+/**
+ * @brief "min", "mean", "p95", "p99" or "max".
+ */
+const char *window_figure_name(int figure);
+
+/**
+ * @brief "1m", "5m" or "15m".
+ */
+const char *window_name(int window);
+
+/**
+ * @brief Length of a window in seconds.
+ */
+int window_seconds(int window);
+
+/**
+ * @brief Number of series.
+ */
+int window_stats_series(const WindowStats *stats);
+
+/**
+ * @brief Frees the statistics. Accepts NULL.
+ */
+void destroy_window_stats(WindowStats *stats);
+
+#endif // WINSTATS_H
@@ -0,0 +1,347 @@
+/**
+ * @file batch_test.c
+ * @brief Tests for the CSV, JSON Lines and binary sample writers.
+ */
+
+#include <assert.h>
+#include "../../src/batch.h"
+
+#include <errno.h>        // For ENOMEM
+#include <fcntl.h>        // For open()
+#include <stdio.h>        // For printf
+#include <stdlib.h>       // For realloc()
+#include <string.h>       // For strcmp(), memcpy()
+#include <sys/resource.h> // For getrusage()
+#include <unistd.h>       // For pipe(), read()
+
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static int fail_realloc; // Makes the next realloc() fail, as out of memory would
+
+void *realloc(void *ptr, size_t size) {
+    if (fail_realloc) {
+        fail_realloc = 0;
+        errno = ENOMEM;
+        return NULL;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+// A sample with known values on two CPU slots
+static void fill_sample(Sample *s, double *threads) {
+    memset(s, 0, sizeof(*s));
+    s->seq = 7;
+    s->wallclock.tv_sec = 1700000000;
+    s->wallclock.tv_nsec = 5;
+    s->interval = 0.01;
+    s->jitter_ns = 1500;
+    s->dropped = 2;
+    s->cpu.num_cpus = 2;
+    s->cpu.usage = 12.346;
+    s->cpu.thread_usage = threads;
+    threads[0] = 0.0;
+    threads[1] = 100.0;
+    s->mem.mem_total = 2048;
+    s->mem.mem_available = 1024;
+    s->mem.slab = 9;
+}
+
+// Test the CSV header and line
+void test_csv() {
+    printf("=== Test CSV ===\n");
+    int fds[2];
+    assert(pipe(fds) == 0);
+    BatchWriter *w = create_batch_writer(fds[1], BATCH_CSV, 2, 0);
+    assert(w != NULL);
+
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    assert(write_batch_header(w) == 0);
+    assert(write_batch_sample(w, &s) == 0);
+
+    char buf[1024];
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    assert(n > 0);
+    buf[n] = '\0';
+    printf("%s", buf);
+    assert(strcmp(buf,
+                  "seq,time_ns,interval_us,jitter_ns,dropped,cpu,mem_total_kb,mem_free_kb,"
+                  "mem_available_kb,buffers_kb,cached_kb,swap_total_kb,swap_free_kb,dirty_kb,"
+                  "writeback_kb,shmem_kb,slab_kb,cpu0,cpu1\n"
+                  "7,1700000000000000005,10000,1500,2,12.35,2048,0,1024,0,0,0,0,0,0,0,9,0.00,100.00\n") == 0);
+
+    destroy_batch_writer(w);
+    close(fds[0]);
+    close(fds[1]);
+    printf("Test CSV passed!\n\n");
+}
+
+// Test the JSON Lines object
+void test_jsonl() {
+    printf("=== Test JSON Lines ===\n");
+    BatchWriter *w = create_batch_writer(-1, BATCH_JSONL, 2, 0);
+    assert(w != NULL);
+
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    const char *data;
+    size_t len = format_batch_sample(w, &s, &data);
+    printf("%.*s", (int)len, data);
+    assert(len > 0 && data[len - 1] == '\n');
+    const char *prefix = "{\"seq\":7,\"time_ns\":1700000000000000005,\"interval_us\":10000,";
+    assert(strncmp(data, prefix, strlen(prefix)) == 0);
+    assert(strstr(data, "\"mem\":{\"mem_total_kb\":2048,") != NULL);
+    assert(strstr(data, ",\"threads\":[0.00,100.00]}\n") != NULL);
+
+    destroy_batch_writer(w);
+    printf("Test JSON Lines passed!\n\n");
+}
+
+// Test the binary header and record layout
+void test_binary() {
+    printf("=== Test binary records ===\n");
+    int fds[2];
+    assert(pipe(fds) == 0);
+    BatchWriter *w = create_batch_writer(fds[1], BATCH_BINARY, 2, 0);
+    assert(w != NULL);
+
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    assert(write_batch_header(w) == 0);
+    assert(write_batch_sample(w, &s) == 0);
+
+    char buf[1024];
+    ssize_t n = read(fds[0], buf, sizeof(buf));
+    assert(n == (ssize_t)(sizeof(BatchBinHeader) + batch_record_size(2)));
+
+    BatchBinHeader header;
+    memcpy(&header, buf, sizeof(header));
+    assert(memcmp(header.magic, BATCH_BIN_MAGIC, 4) == 0);
+    assert(header.version == BATCH_BIN_VERSION && header.num_cpus == 2);
+    assert(header.record_size == batch_record_size(2) && header.mem_fields == BATCH_MEM_FIELDS);
+
+    const char *r = buf + sizeof(header);
+    uint64_t seq, mem_total;
+    int64_t time_ns;
+    uint32_t interval_us;
+    uint16_t cpu, cpu1;
+    memcpy(&seq, r, 8);
+    memcpy(&time_ns, r + 8, 8);
+    memcpy(&interval_us, r + 16, 4);
+    memcpy(&cpu, r + 28, 2);
+    memcpy(&mem_total, r + 32, 8);
+    memcpy(&cpu1, r + 32 + 8 * BATCH_MEM_FIELDS + 2, 2);
+    assert(seq == 7 && time_ns == 1700000000000000005LL && interval_us == 10000);
+    assert(cpu == 1235 && mem_total == 2048 && cpu1 == 10000);
+    printf("Record size for 2 CPUs: %zu bytes\n", batch_record_size(2));
+
+    destroy_batch_writer(w);
+    close(fds[0]);
+    close(fds[1]);
+    printf("Test binary records passed!\n\n");
+}
+
+// Test the alert column, array and count of every format
+void test_alerts() {
+    printf("=== Test alerts ===\n");
+    RuleSet *rules = compile_rules("hot: cpu.thread[*] > 95\ncpu.usage > 10\nmem.used_pct > 90\n", 2, NULL, 0);
+    assert(rules != NULL);
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    assert(evaluate_rules(rules, &s) == 2);
+
+    BatchWriter *w = create_batch_writer(-1, BATCH_CSV, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_rules(w, rules) == 0);
+    const char *data;
+    size_t len = format_batch_sample(w, &s, &data);
+    printf("%.*s", (int)len, data);
+    assert(len > 0 && strstr(data, ",100.00,hot (cpu1);cpu.usage > 10\n") != NULL);
+    destroy_batch_writer(w);
+
+    w = create_batch_writer(-1, BATCH_JSONL, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_rules(w, rules) == 0);
+    len = format_batch_sample(w, &s, &data);
+    printf("%.*s", (int)len, data);
+    assert(strstr(data, "[0.00,100.00],\"alerts\":[\"hot (cpu1)\",\"cpu.usage > 10\"]}\n") != NULL);
+    destroy_batch_writer(w);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    w = create_batch_writer(fds[1], BATCH_BINARY, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_rules(w, rules) == 0);
+    assert(write_batch_header(w) == 0 && write_batch_sample(w, &s) == 0);
+    char buf[1024];
+    ssize_t n = read(fds[0], buf, sizeof(buf));
+    BatchBinHeader header;
+    memcpy(&header, buf, sizeof(header));
+    assert(header.record_size == batch_record_size(2) + 4 && n == (ssize_t)(sizeof(header) + header.record_size));
+    uint32_t firing;
+    memcpy(&firing, buf + n - 4, 4);
+    assert(firing == 2);
+    destroy_batch_writer(w);
+    close(fds[0]);
+    close(fds[1]);
+
+    // Nothing firing: an empty column and an empty array
+    s.cpu.usage = 5.0;
+    threads[1] = 0.0;
+    evaluate_rules(rules, &s);
+    w = create_batch_writer(-1, BATCH_CSV, 2, 0);
+    assert(set_batch_rules(w, rules) == 0);
+    len = format_batch_sample(w, &s, &data);
+    assert(len > 7 && memcmp(data + len - 7, ",0.00,\n", 7) == 0);
+    destroy_batch_writer(w);
+    destroy_rules(rules);
+    printf("Test alerts passed!\n\n");
+}
+
+// Test the CPU window statistics in all three formats
+void test_windows() {
+    printf("=== Test window statistics ===\n");
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    WindowStats *stats = create_window_stats(WINSTATS_SERIES(2));
+    assert(stats != NULL);
+    for (int k = 0; k < 120; k++) { // Two minutes alternating between 20% and 60%
+        s.timestamp.tv_sec = 1000 + k;
+        s.cpu.usage = k % 2 ? 60.0 : 20.0;
+        record_window_stats(stats, &s);
+    }
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    BatchWriter *w = create_batch_writer(fds[1], BATCH_CSV, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_stats(w, stats) == 0);
+    assert(write_batch_header(w) == 0 && write_batch_sample(w, &s) == 0);
+    char buf[2048];
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    assert(n > 0);
+    buf[n] = '\0';
+    printf("%s", buf);
+    assert(strstr(buf, ",cpu1,cpu_1m_min,cpu_1m_mean,cpu_1m_p95,cpu_1m_p99,cpu_1m_max,cpu_5m_min,") != NULL);
+    assert(strstr(buf, ",cpu_15m_max\n") != NULL);
+    assert(strstr(buf, ",100.00,20.00,40.00,60.00,60.00,60.00,20.00,40.00,60.00,60.00,60.00,20.00,") != NULL);
+    destroy_batch_writer(w);
+
+    w = create_batch_writer(-1, BATCH_JSONL, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_stats(w, stats) == 0);
+    const char *data;
+    size_t len = format_batch_sample(w, &s, &data);
+    printf("%.*s", (int)len, data);
+    assert(strstr(data, "[0.00,100.00],\"windows\":{\"1m\":{\"min\":20.00,\"mean\":40.00,\"p95\":60.00,"
+                        "\"p99\":60.00,\"max\":60.00},\"5m\":{") != NULL);
+    assert(strstr(data, "\"max\":60.00}}}\n") != NULL);
+    destroy_batch_writer(w);
+
+    w = create_batch_writer(fds[1], BATCH_BINARY, 2, 0);
+    assert(w != NULL);
+    assert(set_batch_stats(w, stats) == 0);
+    assert(write_batch_header(w) == 0 && write_batch_sample(w, &s) == 0);
+    n = read(fds[0], buf, sizeof(buf));
+    BatchBinHeader header;
+    memcpy(&header, buf, sizeof(header));
+    assert(header.record_size == batch_record_size(2) + 2 * BATCH_WINDOW_FIELDS + 2);
+    assert(n == (ssize_t)(sizeof(header) + header.record_size));
+    uint16_t figures[BATCH_WINDOW_FIELDS];
+    memcpy(figures, buf + sizeof(header) + batch_record_size(2), sizeof(figures));
+    assert(figures[0] == 2000 && figures[1] == 4000 && figures[4] == 6000 && figures[BATCH_WINDOW_FIELDS - 1] == 6000);
+    destroy_batch_writer(w);
+    close(fds[0]);
+    close(fds[1]);
+    destroy_window_stats(stats);
+    printf("Test window statistics passed!\n\n");
+}
+
+// A line buffer that cannot grow is an error, not a silently missing column
+void test_out_of_memory() {
+    printf("=== Test alerts and windows out of memory ===\n");
+    RuleSet *rules = compile_rules("cpu.usage > 10\n", 2, NULL, 0);
+    WindowStats *stats = create_window_stats(WINSTATS_SERIES(2));
+    assert(rules != NULL && stats != NULL);
+    Sample s;
+    double threads[2];
+    fill_sample(&s, threads);
+    evaluate_rules(rules, &s);
+    record_window_stats(stats, &s);
+
+    BatchWriter *w = create_batch_writer(-1, BATCH_CSV, 2, 0);
+    assert(w != NULL);
+    fail_realloc = 1;
+    assert(set_batch_rules(w, rules) < 0 && errno == ENOMEM);
+    fail_realloc = 1;
+    assert(set_batch_stats(w, stats) < 0 && errno == ENOMEM);
+    const char *data;
+    size_t len = format_batch_sample(w, &s, &data); // Still a plain writer
+    assert(len > 0 && strstr(data, "cpu.usage") == NULL && memcmp(data + len - 8, ",100.00\n", 8) == 0);
+
+    assert(set_batch_rules(w, rules) == 0 && set_batch_stats(w, stats) == 0);
+    len = format_batch_sample(w, &s, &data);
+    assert(len > 0 && strstr(data, ",cpu.usage > 10\n") != NULL);
+    destroy_batch_writer(w);
+    destroy_window_stats(stats);
+    destroy_rules(rules);
+    printf("Test alerts and windows out of memory passed!\n\n");
+}
+
+static double cpu_seconds(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// Stream 100 Hz samples to /dev/null and report the process CPU time
+void test_live_100hz() {
+    printf("=== Test 100 Hz batch stream ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    int fd = open("/dev/null", O_WRONLY);
+    assert(fd >= 0);
+    BatchWriter *w = create_batch_writer(fd, BATCH_CSV, cpu.num_cpus, 0);
+    Collector *c = create_collector(&cpu, 10, 0);
+    assert(w != NULL && c != NULL);
+
+    double start = cpu_seconds();
+    assert(start_collector(c) == 0);
+    int written = 0;
+    while (written < 100) {
+        const Sample *s = collector_peek(c);
+        if (s == NULL) {
+            usleep(2000);
+            continue;
+        }
+        assert(write_batch_sample(w, s) == 0);
+        collector_release(c);
+        written++;
+    }
+    stop_collector(c);
+    double used = cpu_seconds() - start;
+    printf("100 samples of %d CPUs: %.3f ms CPU per sample (%.2f%% of one core at 100 Hz)\n",
+           cpu.num_cpus, used * 10.0, used * 100.0);
+
+    destroy_collector(c);
+    destroy_batch_writer(w);
+    close(fd);
+    free_cpu_info(&cpu);
+    printf("Test 100 Hz batch stream passed!\n\n");
+}
+
+int main() {
+    test_csv();
+    test_jsonl();
+    test_binary();
+    test_alerts();
+    test_windows();
+    test_out_of_memory();
+    test_live_100hz();
+    return 0;
+}
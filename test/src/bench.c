@@ -0,0 +1,819 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks of every collector and of the render path.
+ *
+ * Usage: bench [--cpus N] [--samples N] [--compare OLD.jsonl [--threshold PCT]]
+ *
+ * Each case reports the median and p99 time per operation and the system
+ * calls and heap allocations per operation, as one JSON object per line on
+ * stdout; a readable table goes to stderr. --cpus runs against a synthetic
+ * tree of N CPUs (proc_fixture.h) instead of the live /proc, so results do
+ * not depend on the build box. --compare reads an earlier run and exits with
+ * status 1 if a median got more than PCT percent slower (default 10).
+ *
+ * Times are taken over batches of operations of about BATCH_NS each, so the
+ * clock read does not dominate the fast cases. System calls are counted in a
+ * forked child stopped at every system call entry with ptrace(); heap
+ * allocations by interposing malloc(), calloc() and realloc() (glibc).
+ */
+
+#include <assert.h>
+#include "proc_fixture.h"
+#include "../../src/dashboard.h"
+#include "../../src/exporter.h"
+#include "../../src/rules.h"
+#include "../../src/selfinfo_manip.h"
+#include "../../src/snapshot.h"
+#include "../../src/thermal_manip.h"
+#include "../../src/topology_manip.h"
+#include "../../src/tui.h"
+#include "../../src/winstats.h"
+
+#include <getopt.h>     // For getopt_long()
+#include <signal.h>     // For raise()
+#include <stdio.h>      // For printf, fopen()
+#include <stdlib.h>     // For qsort()
+#include <string.h>     // For strstr(), strncmp()
+#include <sys/ptrace.h> // For PTRACE_SYSCALL
+#include <sys/wait.h>   // For waitpid()
+#include <time.h>       // For clock_gettime()
+#include <unistd.h>     // For fork()
+
+#define DEFAULT_SAMPLES 1000 // Timed batches per case
+#define BATCH_NS 2000.0      // Target duration of one batch
+#define COUNTED_OPS 20       // Operations run under ptrace and the allocation counter
+#define SCREEN_ROWS 50
+#define SCREEN_COLS 132
+#define HEATMAP_CPUS 256     // Threads of the heatmap frame
+#define RULES_CPUS 128       // Threads of the rule evaluation samples
+#define RULES_COUNT 1000     // Rules of the evaluation case
+
+/* ------------------ Allocation counter ------------------ */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long alloc_count; // The benchmark is single-threaded
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+/* ------------------ Cases ------------------ */
+
+typedef struct {
+    const char *name;
+    int (*setup)(void); // 0 on success
+    void (*op)(void);
+    void (*teardown)(void);
+} BenchCase;
+
+static int num_cpus;
+static ProcFile stat_file, meminfo_file;
+static CPUStatsStore stores[2];
+static CPUStats slot_stats[2];
+static CPUSampler *sampler;
+static CPUInfo info;
+static double *usage;
+static ProcTable *proc_table;
+static ProcTop top;
+static SelfSampler *self_sampler;
+static CPUTopology *topology;
+static ProcFile online_file;
+static unsigned int *freq_khz;
+static ThermalSampler *thermal;
+static DiskSampler *disk_sampler;
+static NetSampler *net_sampler;
+static PSISampler *psi_sampler;
+static CgroupSampler *cgroup_sampler;
+static IrqSampler *irq_sampler;
+static IrqCpu *irq_cpus;
+static CPUInfo thermal_cpu;
+static Sample frames[2];
+static DashboardView view = { .proc_sort = PROC_SORT_CPU, .show_overhead = 1 };
+static History *history;
+static Exporter *exporter;
+static SnapshotWriter *snapshot;
+static RuleSet *rules;
+static WindowStats *window_stats;
+static CPUStatsStore snapshot_counters_store;
+static unsigned long op_count;
+static volatile double sink; // Keeps results of pure functions alive
+
+static void nothing(void) {
+}
+
+static void op_get_cpu_info(void) {
+    CPUInfo tmp;
+    get_cpu_info(&tmp);
+    free_cpu_info(&tmp);
+}
+
+static int setup_stat(void) {
+    char path[PROC_PATH_MAX];
+    if (open_proc_file(&stat_file, proc_path("/proc/stat", path), (size_t)(num_cpus + 1) * STAT_LINE_LEN) < 0 ||
+        init_cpu_stats_store(&stores[0], num_cpus + 1) < 0 || init_cpu_stats_store(&stores[1], num_cpus + 1) < 0)
+        return -1;
+    usage = calloc((size_t)num_cpus + 1, sizeof(double));
+    if (usage == NULL || read_cpu_stats_all(&stat_file, &stores[0]) < 0 ||
+        read_cpu_stats_all(&stat_file, &stores[1]) < 0)
+        return -1;
+    // Scalar snapshots of the aggregate, with some progress between them
+    unsigned long *fields[2][CPU_STAT_FIELDS];
+    for (int s = 0; s < 2; s++) {
+        for (int f = 0; f < CPU_STAT_FIELDS; f++)
+            fields[s][f] = &stores[s].field[f][0];
+        slot_stats[s] = (CPUStats){ *fields[s][CPU_USER] + 50 * s, *fields[s][CPU_NICE], *fields[s][CPU_SYSTEM],
+                                    *fields[s][CPU_IDLE] + 50 * s, *fields[s][CPU_IOWAIT], *fields[s][CPU_IRQ],
+                                    *fields[s][CPU_SOFTIRQ], *fields[s][CPU_STEAL], *fields[s][CPU_GUEST],
+                                    *fields[s][CPU_GUEST_NICE] };
+    }
+    return 0;
+}
+
+static void teardown_stat(void) {
+    close_proc_file(&stat_file);
+    free_cpu_stats_store(&stores[0]);
+    free_cpu_stats_store(&stores[1]);
+    free(usage);
+    usage = NULL;
+}
+
+static void op_read_cpu_stats_all(void) {
+    read_cpu_stats_all(&stat_file, &stores[op_count++ & 1]);
+}
+
+static void op_read_proc_file(void) {
+    read_proc_file(&stat_file);
+}
+
+// The reader read_cpu_stats_all() replaced: fopen() on every tick, fgets()
+// and sscanf() per line, fclose(). Kept as the reference its figures are
+// measured against.
+static void op_read_cpu_stats_stdio(void) {
+    char path[PROC_PATH_MAX], line[256];
+    FILE *file = fopen(proc_path("/proc/stat", path), "r");
+    if (file == NULL)
+        return;
+    int cpu_index;
+    CPUStats s = { 0 };
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "cpu ", 4) == 0) {
+            sscanf(line + 3, " %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", &s.user, &s.nice, &s.system, &s.idle,
+                   &s.iowait, &s.irq, &s.softirq, &s.steal, &s.guest, &s.guest_nice);
+        } else if (sscanf(line, "cpu%d ", &cpu_index) == 1) {
+            const char *p = line + 3;
+            while (*p >= '0' && *p <= '9')
+                p++;
+            sscanf(p, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", &s.user, &s.nice, &s.system, &s.idle,
+                   &s.iowait, &s.irq, &s.softirq, &s.steal, &s.guest, &s.guest_nice);
+        } else if (strncmp(line, "cpu", 3) != 0) {
+            break;
+        }
+        sink = (double)s.user;
+    }
+    fclose(file);
+}
+
+static void op_calculate_cpu_usage(void) {
+    sink = calculate_cpu_usage(&slot_stats[0], &slot_stats[1]);
+}
+
+static void op_calculate_cpu_usage_all(void) {
+    calculate_cpu_usage_all(&stores[0], &stores[1], 0, num_cpus + 1, usage);
+}
+
+static int setup_sampler(void) {
+    info.num_cpus = num_cpus;
+    info.thread_usage = calloc((size_t)num_cpus, sizeof(double));
+    sampler = create_cpu_sampler(num_cpus);
+    return info.thread_usage != NULL && sampler != NULL ? 0 : -1;
+}
+
+static void teardown_sampler(void) {
+    destroy_cpu_sampler(sampler);
+    sampler = NULL;
+    free_cpu_info(&info);
+}
+
+static void op_sample_cpu_usage(void) {
+    sample_cpu_usage(sampler, &info);
+}
+
+static void op_get_memory_info(void) {
+    MemInfo mem;
+    get_memory_info(&mem);
+}
+
+static int setup_meminfo(void) {
+    char path[PROC_PATH_MAX];
+    return open_proc_file(&meminfo_file, proc_path("/proc/meminfo", path), MEMINFO_BUF_LEN);
+}
+
+static void teardown_meminfo(void) {
+    close_proc_file(&meminfo_file);
+}
+
+static void op_read_memory_info(void) {
+    MemInfo mem;
+    read_memory_info(&meminfo_file, &mem);
+}
+
+static int setup_processes(void) {
+    proc_table = create_proc_table(0);
+    return proc_table != NULL && sample_processes(proc_table, PROC_SORT_CPU, 20, &top) == 0 ? 0 : -1;
+}
+
+static void teardown_processes(void) {
+    destroy_proc_table(proc_table);
+    proc_table = NULL;
+}
+
+static void op_sample_processes(void) {
+    sample_processes(proc_table, PROC_SORT_CPU, 20, &top);
+}
+
+static void op_discover_cpu_topology(void) {
+    destroy_cpu_topology(discover_cpu_topology(num_cpus));
+}
+
+// The collector's steady state: one hotplug check, then the frequencies
+static int setup_topology(void) {
+    topology = discover_cpu_topology(num_cpus);
+    freq_khz = calloc((size_t)num_cpus, sizeof(*freq_khz));
+    if (topology == NULL || freq_khz == NULL || open_cpu_online(&online_file) < 0)
+        return -1;
+    open_cpu_freq(topology);
+    return 0;
+}
+
+static void teardown_topology(void) {
+    close_proc_file(&online_file);
+    destroy_cpu_topology(topology);
+    topology = NULL;
+    free(freq_khz);
+    freq_khz = NULL;
+}
+
+static void op_sample_cpu_topology(void) {
+    if (topology_is_current(topology, &online_file) == 1)
+        read_cpu_freq(topology, freq_khz);
+}
+
+static int setup_disks(void) {
+    disk_sampler = create_disk_sampler();
+    return disk_sampler != NULL ? 0 : -1;
+}
+
+static void teardown_disks(void) {
+    destroy_disk_sampler(disk_sampler);
+    disk_sampler = NULL;
+}
+
+static void op_sample_disk_info(void) {
+    DiskInfo disks;
+    sample_disk_info(disk_sampler, &disks);
+}
+
+static int setup_net(void) {
+    net_sampler = create_net_sampler();
+    return net_sampler != NULL ? 0 : -1;
+}
+
+static void teardown_net(void) {
+    destroy_net_sampler(net_sampler);
+    net_sampler = NULL;
+}
+
+static void op_sample_net_info(void) {
+    NetInfo net;
+    sample_net_info(net_sampler, &net);
+}
+
+static int setup_psi(void) {
+    psi_sampler = create_psi_sampler();
+    return psi_sampler != NULL ? 0 : -1;
+}
+
+static void teardown_psi(void) {
+    destroy_psi_sampler(psi_sampler);
+    psi_sampler = NULL;
+}
+
+static void op_sample_psi_info(void) {
+    PSIInfo psi;
+    sample_psi_info(psi_sampler, &psi);
+}
+
+static int setup_cgroups(void) {
+    cgroup_sampler = create_cgroup_sampler();
+    return cgroup_sampler != NULL ? 0 : -1;
+}
+
+static void teardown_cgroups(void) {
+    destroy_cgroup_sampler(cgroup_sampler);
+    cgroup_sampler = NULL;
+}
+
+static void op_sample_cgroup_info(void) {
+    CgroupInfo cgroups;
+    sample_cgroup_info(cgroup_sampler, &cgroups);
+}
+
+static int setup_irqs(void) {
+    irq_sampler = create_irq_sampler(num_cpus);
+    irq_cpus = calloc((size_t)num_cpus, sizeof(IrqCpu));
+    return irq_sampler != NULL && irq_cpus != NULL ? 0 : -1;
+}
+
+static void teardown_irqs(void) {
+    destroy_irq_sampler(irq_sampler);
+    irq_sampler = NULL;
+    free(irq_cpus);
+    irq_cpus = NULL;
+}
+
+static void op_sample_irq_info(void) {
+    IrqInfo irqs = { .cpu = irq_cpus };
+    sample_irq_info(irq_sampler, &irqs);
+}
+
+// Usage is fixed: the case measures the zone and counter reads
+static int setup_thermal(void) {
+    thermal = create_thermal_sampler(num_cpus);
+    thermal_cpu.num_cpus = num_cpus;
+    thermal_cpu.thread_usage = calloc((size_t)num_cpus, sizeof(double));
+    return thermal != NULL && thermal_cpu.thread_usage != NULL ? 0 : -1;
+}
+
+static void teardown_thermal(void) {
+    destroy_thermal_sampler(thermal);
+    thermal = NULL;
+    free(thermal_cpu.thread_usage);
+    thermal_cpu.thread_usage = NULL;
+}
+
+static void op_sample_thermal_info(void) {
+    ThermalInfo t;
+    sample_thermal_info(thermal, &thermal_cpu, &t);
+}
+
+// Two different samples so every frame changes the figures on screen; with
+// cpus, that many threads without a topology, drawn as a heatmap
+static int setup_frames(int cpus) {
+    get_cpu_info(&info);
+    if (setup_topology() < 0)
+        return -1;
+    if (cpus > 0)
+        info.num_cpus = cpus;
+    for (int s = 0; s < 2; s++) {
+        Sample *f = &frames[s];
+        memset(f, 0, sizeof(*f));
+        f->seq = (unsigned long)s;
+        f->interval = 1.0;
+        f->cpu = info;
+        f->cpu.usage = 10.0 + s;
+        f->cpu.thread_usage = calloc((size_t)info.num_cpus, sizeof(double));
+        if (f->cpu.thread_usage == NULL)
+            return -1;
+        for (int i = 0; i < info.num_cpus; i++)
+            f->cpu.thread_usage[i] = (double)((i * 7 + s * 13) % 100);
+        f->topology = cpus > 0 ? NULL : topology;
+        f->freq_khz = freq_khz;
+        f->thermal.zone_count = 1;
+        f->thermal.hottest = 0;
+        snprintf(f->thermal.zones[0].type, sizeof(f->thermal.zones[0].type), "cpu-thermal");
+        f->thermal.zones[0].temp_mc = 70000 + s * 500;
+        f->thermal.zones[0].trip_mc = 85000;
+        f->disks.count = 2;
+        for (int d = 0; d < 2; d++) {
+            DiskDevice *dev = &f->disks.dev[d];
+            snprintf(dev->name, sizeof(dev->name), d ? "sda" : "mmcblk0");
+            dev->ios = 1000;
+            dev->read_iops = 100.0 + s + d;
+            dev->write_mbps = 1.5 * (s + 1);
+            dev->await_ms = 4.0;
+            dev->util = 30.0 + s;
+        }
+        for (int r = 0; r < PSI_RESOURCES; r++) {
+            f->psi.res[r].available = 1;
+            f->psi.res[r].some_pct = 2.5 * r + s;
+            f->psi.res[r].some.avg10 = 2.0 * r;
+        }
+        f->net.count = 2;
+        for (int k = 0; k < 2; k++) {
+            NetIface *n = &f->net.iface[k];
+            snprintf(n->name, sizeof(n->name), k ? "wlan0" : "eth0");
+            n->rx_bytes_ps = 1e6 * (k + 1) + s * 1000;
+            n->tx_bytes_ps = 2e5 + s * 100;
+            n->rx_packets_ps = 900.0 + s;
+            n->tx_packets_ps = 300.0;
+        }
+        f->cgroups.available = 1;
+        f->cgroups.count = 3;
+        for (int k = 0; k < 3; k++) {
+            CgroupEntry *e = &f->cgroups.group[k];
+            snprintf(e->name, sizeof(e->name), k == 2 ? "user.slice" : k ? "system.slice/docker-web.scope" : "system.slice");
+            e->flags = CGROUP_HAS_MEMORY | CGROUP_HAS_PRESSURE | (k == 1 ? CGROUP_HAS_LIMIT : 0);
+            e->cpu_pct = 40.0 * k + s;
+            e->throttled_pct = k == 1 ? 20.0 + s : 0.0;
+            e->memory_bytes = (100ULL << 20) * (unsigned long long)(k + 1);
+        }
+        get_memory_info(&f->mem);
+        f->mem.mem_available -= (unsigned long)s * 4096;
+        f->procs.count = 20;
+        f->procs.total = 300 + s;
+        for (int i = 0; i < 20; i++) {
+            ProcEntry *e = &f->procs.entries[i];
+            e->pid = 1000 + i;
+            snprintf(e->comm, sizeof(e->comm), "proc%d", i);
+            e->state = 'S';
+            e->cpu_usage = (double)((i + s) % 20);
+            e->rss_kb = 10000UL * (unsigned long)(i + 1);
+        }
+    }
+    history = create_history(HISTORY_SERIES(info.num_cpus), HISTORY_CAPACITY);
+    if (history == NULL || ui_init_virtual(SCREEN_ROWS, SCREEN_COLS) < 0)
+        return -1;
+    view.history = history;
+    view.show_heatmap = cpus > 0;
+    for (int i = 0; i < HISTORY_CAPACITY; i++) // Graphs start full
+        record_dashboard_history(history, &frames[i & 1]);
+    draw_dashboard(&info, &frames[0], &view);
+    return 0;
+}
+
+static int setup_frame(void) {
+    return setup_frames(0);
+}
+
+static int setup_heatmap(void) {
+    return setup_frames(HEATMAP_CPUS);
+}
+
+static int setup_self(void) {
+    self_sampler = create_self_sampler();
+    return self_sampler != NULL ? 0 : -1;
+}
+
+static void teardown_self(void) {
+    destroy_self_sampler(self_sampler);
+    self_sampler = NULL;
+}
+
+static void op_sample_self_info(void) {
+    SelfInfo self;
+    sample_self_info(self_sampler, &self);
+}
+
+static void teardown_frame(void) {
+    release_dashboard();
+    ui_cleanup();
+    destroy_history(history);
+    history = NULL;
+    view.history = NULL;
+    for (int s = 0; s < 2; s++)
+        free(frames[s].cpu.thread_usage);
+    teardown_topology();
+    free_cpu_info(&info);
+}
+
+// Every frame records one sample, so every graph scrolls one column
+static void op_draw_dashboard(void) {
+    const Sample *s = &frames[++op_count & 1];
+    record_dashboard_history(history, s);
+    draw_dashboard(&info, s, &view);
+}
+
+// The heatmap's samples, rendered to the exporter's back buffer
+static int setup_exporter(void) {
+    if (setup_frames(HEATMAP_CPUS) < 0)
+        return -1;
+    exporter = create_exporter("127.0.0.1:0", HEATMAP_CPUS);
+    return exporter != NULL ? 0 : -1;
+}
+
+static void teardown_exporter(void) {
+    destroy_exporter(exporter);
+    exporter = NULL;
+    teardown_frame();
+}
+
+static void op_exporter_sink(void) {
+    exporter_sink(exporter, &frames[++op_count & 1], NULL);
+}
+
+// The heatmap's samples and a full counter store, published to shared memory
+static int setup_snapshot(void) {
+    if (setup_frames(HEATMAP_CPUS) < 0)
+        return -1;
+    char name[64];
+    snprintf(name, sizeof(name), "/resource_mon_bench.%d", (int)getpid());
+    snapshot = create_snapshot_writer(name, HEATMAP_CPUS);
+    unsigned long *all = calloc((size_t)CPU_STAT_FIELDS * (HEATMAP_CPUS + 1), sizeof(unsigned long));
+    snapshot_counters_store.count = HEATMAP_CPUS + 1;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++)
+        snapshot_counters_store.field[f] = all + (size_t)f * (HEATMAP_CPUS + 1);
+    return snapshot != NULL && all != NULL ? 0 : -1;
+}
+
+static void teardown_snapshot(void) {
+    destroy_snapshot_writer(snapshot);
+    snapshot = NULL;
+    free(snapshot_counters_store.field[0]);
+    teardown_frame();
+}
+
+static void op_publish_snapshot(void) {
+    publish_snapshot(snapshot, &frames[++op_count & 1], &snapshot_counters_store);
+}
+
+// A thousand rules of every kind, a tenth of them over every CPU
+static int setup_rules(void) {
+    if (setup_frames(RULES_CPUS) < 0)
+        return -1;
+    static const char *const kinds[] = {
+        "cpu.thread[*] > 99.5 for 10s",    "cpu.thread[%d] > 50",
+        "cpu.usage > %d",                  "mem.used_pct > %d for 30s",
+        "mem.used_pct rising > %d/min",    "psi.io.some > %d",
+        "thermal.temp_c > 1%02d clear 60", "disk.util rising > %d/s",
+        "sample.jitter_ms > %d",           "cpu.thread[%d] falling > 20/s",
+    };
+    int n = sizeof(kinds) / sizeof(kinds[0]);
+    char *text = malloc((size_t)RULES_COUNT * 64);
+    if (text == NULL)
+        return -1;
+    size_t len = 0;
+    for (int r = 0; r < RULES_COUNT; r++) {
+        len += (size_t)snprintf(text + len, 64, "rule%d: ", r);
+        len += (size_t)snprintf(text + len, 48, kinds[r % n], r % RULES_CPUS);
+        text[len++] = '\n';
+    }
+    text[len] = '\0';
+    rules = compile_rules(text, RULES_CPUS, NULL, 0);
+    free(text);
+    return rules != NULL ? 0 : -1;
+}
+
+static void teardown_rules(void) {
+    destroy_rules(rules);
+    rules = NULL;
+    teardown_frame();
+}
+
+// Samples a second apart, alternating between the two frames
+static void op_evaluate_rules(void) {
+    Sample *f = &frames[++op_count & 1];
+    f->timestamp.tv_sec = (time_t)op_count;
+    evaluate_rules(rules, f);
+}
+
+// The heatmap's samples, a second apart, into 1, 5 and 15 minute windows
+static int setup_window_stats(void) {
+    if (setup_frames(HEATMAP_CPUS) < 0)
+        return -1;
+    window_stats = create_window_stats(WINSTATS_SERIES(HEATMAP_CPUS));
+    return window_stats != NULL ? 0 : -1;
+}
+
+static void teardown_window_stats(void) {
+    destroy_window_stats(window_stats);
+    window_stats = NULL;
+    teardown_frame();
+}
+
+static void op_record_window_stats(void) {
+    Sample *f = &frames[++op_count & 1];
+    f->timestamp.tv_sec = (time_t)op_count;
+    record_window_stats(window_stats, f);
+}
+
+static const BenchCase cases[] = {
+    { "get_cpu_info", NULL, op_get_cpu_info, NULL },
+    { "read_proc_file", setup_stat, op_read_proc_file, teardown_stat },
+    { "read_cpu_stats_all", setup_stat, op_read_cpu_stats_all, teardown_stat },
+    { "read_cpu_stats_stdio", NULL, op_read_cpu_stats_stdio, NULL },
+    { "calculate_cpu_usage", setup_stat, op_calculate_cpu_usage, teardown_stat },
+    { "calculate_cpu_usage_all", setup_stat, op_calculate_cpu_usage_all, teardown_stat },
+    { "sample_cpu_usage", setup_sampler, op_sample_cpu_usage, teardown_sampler },
+    { "get_memory_info", NULL, op_get_memory_info, NULL },
+    { "read_memory_info", setup_meminfo, op_read_memory_info, teardown_meminfo },
+    { "sample_processes", setup_processes, op_sample_processes, teardown_processes },
+    { "sample_self_info", setup_self, op_sample_self_info, teardown_self },
+    { "discover_cpu_topology", NULL, op_discover_cpu_topology, NULL },
+    { "sample_cpu_topology", setup_topology, op_sample_cpu_topology, teardown_topology },
+    { "sample_thermal_info", setup_thermal, op_sample_thermal_info, teardown_thermal },
+    { "sample_disk_info", setup_disks, op_sample_disk_info, teardown_disks },
+    { "sample_net_info", setup_net, op_sample_net_info, teardown_net },
+    { "sample_psi_info", setup_psi, op_sample_psi_info, teardown_psi },
+    { "sample_cgroup_info", setup_cgroups, op_sample_cgroup_info, teardown_cgroups },
+    { "sample_irq_info", setup_irqs, op_sample_irq_info, teardown_irqs },
+    { "draw_dashboard", setup_frame, op_draw_dashboard, teardown_frame },
+    { "draw_dashboard_heatmap", setup_heatmap, op_draw_dashboard, teardown_frame },
+    { "exporter_sink", setup_exporter, op_exporter_sink, teardown_exporter },
+    { "publish_snapshot", setup_snapshot, op_publish_snapshot, teardown_snapshot },
+    { "evaluate_rules", setup_rules, op_evaluate_rules, teardown_rules },
+    { "record_window_stats", setup_window_stats, op_record_window_stats, teardown_window_stats },
+};
+
+/* ------------------ Measurement ------------------ */
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median and p99 of the per-operation time over samples batches
+static void time_case(const BenchCase *bc, int samples, int *batch, double *median, double *p99) {
+    // Size batches from a short warm-up
+    int warm = 0;
+    double start = now_ns(), elapsed;
+    do {
+        bc->op();
+        warm++;
+    } while ((elapsed = now_ns() - start) < 1e6 && warm < 100000);
+    double mean = elapsed / warm;
+    *batch = mean >= BATCH_NS ? 1 : (int)(BATCH_NS / mean);
+
+    double *per_op = malloc((size_t)samples * sizeof(double));
+    assert(per_op != NULL);
+    for (int s = 0; s < samples; s++) {
+        double t0 = now_ns();
+        for (int k = 0; k < *batch; k++)
+            bc->op();
+        per_op[s] = (now_ns() - t0) / *batch;
+    }
+    qsort(per_op, (size_t)samples, sizeof(double), compare_double);
+    *median = per_op[samples / 2];
+    *p99 = per_op[(int)(samples * 0.99)];
+    free(per_op);
+}
+
+// Syscall entries between the two markers of a traced child running ops operations
+static long traced_syscalls(const BenchCase *bc, int ops) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP); // Wait for the tracer
+        if (bc->setup != NULL && bc->setup() < 0)
+            _exit(1);
+        raise(SIGSTOP); // Start marker
+        for (int i = 0; i < ops; i++)
+            bc->op();
+        raise(SIGSTOP); // End marker
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+    long count = 0;
+    int markers = 0, in_syscall = 0;
+    for (;;) {
+        if (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) < 0)
+            return -1;
+        if (waitpid(pid, &status, 0) < 0 || WIFEXITED(status) || WIFSIGNALED(status))
+            break;
+        int sig = WSTOPSIG(status);
+        if (sig == (SIGTRAP | 0x80)) {
+            in_syscall = !in_syscall;
+            if (in_syscall && markers == 1)
+                count++;
+        } else if (sig == SIGSTOP && ++markers == 2) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+    }
+    return markers == 2 ? count : -1;
+}
+
+/* ------------------ Comparison ------------------ */
+
+// Median of name at the same CPU count in an earlier run, or a negative value
+static double old_median(const char *path, const char *name, int cpus) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return -1.0;
+    char line[512], key[128];
+    double median = -1.0;
+    snprintf(key, sizeof(key), "\"bench\":\"%s\",\"cpus\":%d,", name, cpus);
+    while (fgets(line, sizeof(line), f)) {
+        const char *m = strstr(line, "\"median_ns\":");
+        if (strstr(line, key) != NULL && m != NULL) {
+            median = strtod(m + strlen("\"median_ns\":"), NULL);
+            break;
+        }
+    }
+    fclose(f);
+    return median;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        { "cpus", required_argument, NULL, 'c' },
+        { "samples", required_argument, NULL, 's' },
+        { "compare", required_argument, NULL, 'C' },
+        { "threshold", required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 },
+    };
+    int fixture_cpus = 0, samples = DEFAULT_SAMPLES;
+    const char *compare = NULL;
+    double threshold = 10.0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'c': fixture_cpus = atoi(optarg); break;
+        case 's': samples = atoi(optarg); break;
+        case 'C': compare = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [--cpus N] [--samples N] [--compare OLD.jsonl [--threshold PCT]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 100)
+        samples = 100;
+
+    ProcFixture fx;
+    if (fixture_cpus > 0) {
+        assert(create_proc_fixture(&fx, fixture_cpus, 1) == 0);
+        assert(add_proc_fixture_disks(&fx) == 0 && add_proc_fixture_net(&fx) == 0);
+        assert(add_proc_fixture_pressure(&fx) == 0 && add_proc_fixture_cgroups(&fx) == 0);
+        assert(add_proc_fixture_irqs(&fx) == 0 && add_proc_fixture_thermal(&fx) == 0);
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(set_proc_root(fx.root) == 0);
+    }
+    num_cpus = count_cpu_slots();
+
+    // Fixed cost of the markers themselves
+    const BenchCase empty = { "empty", NULL, nothing, NULL };
+    long baseline = traced_syscalls(&empty, 0);
+
+    fprintf(stderr, "%-24s %10s %10s %10s %10s\n", "bench", "median ns", "p99 ns", "syscalls", "allocs");
+    int regressions = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const BenchCase *bc = &cases[i];
+        if (bc->setup != NULL && bc->setup() < 0) {
+            fprintf(stderr, "%-24s setup failed, skipped\n", bc->name);
+            continue;
+        }
+        op_count = 0;
+        int batch;
+        double median, p99;
+        time_case(bc, samples, &batch, &median, &p99);
+
+        unsigned long allocs = alloc_count;
+        for (int k = 0; k < COUNTED_OPS; k++)
+            bc->op();
+        double allocs_per_op = (double)(alloc_count - allocs) / COUNTED_OPS;
+        if (bc->teardown != NULL)
+            bc->teardown();
+
+        long traced = traced_syscalls(bc, COUNTED_OPS);
+        double syscalls_per_op = traced >= 0 && baseline >= 0 ? (double)(traced - baseline) / COUNTED_OPS : -1.0;
+
+        printf("{\"bench\":\"%s\",\"cpus\":%d,\"source\":\"%s\",\"samples\":%d,\"batch\":%d,"
+               "\"median_ns\":%.1f,\"p99_ns\":%.1f,\"syscalls_per_op\":%.2f,\"allocs_per_op\":%.2f}\n",
+               bc->name, num_cpus, fixture_cpus > 0 ? "fixture" : "live", samples, batch, median, p99,
+               syscalls_per_op, allocs_per_op);
+        fprintf(stderr, "%-24s %10.1f %10.1f %10.2f %10.2f", bc->name, median, p99, syscalls_per_op, allocs_per_op);
+
+        if (compare != NULL) {
+            double old = old_median(compare, bc->name, num_cpus);
+            if (old > 0) {
+                double change = (median - old) * 100.0 / old;
+                int slower = change > threshold;
+                regressions += slower;
+                fprintf(stderr, "  %+6.1f%%%s", change, slower ? "  REGRESSION" : "");
+            }
+        }
+        fprintf(stderr, "\n");
+        fflush(stdout);
+    }
+
+    if (fixture_cpus > 0) {
+        set_proc_root(NULL);
+        destroy_proc_fixture(&fx);
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/**
+ * @file cgroupinfo_test.c
+ * @brief Tests for the cgroup file parsers, the per-cgroup rates and the
+ * slots taken and released through inotify.
+ */
+
+#include <assert.h>
+#include "../../src/cgroupinfo_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>    // For printf
+#include <string.h>   // For strcmp()
+#include <sys/stat.h> // For mkdir()
+#include <unistd.h>   // For unlink(), rmdir()
+
+// Fixture index of a reported cgroup
+static int fixture_cgroup(const ProcFixture *fx, const char *name) {
+    for (int i = 0; i < FIXTURE_CGROUPS; i++)
+        if (strcmp(fx->cgroup_name[i], name) == 0)
+            return i;
+    return -1;
+}
+
+// Entry of info for a fixture cgroup, NULL if it is not reported
+static const CgroupEntry *find_entry(const CgroupInfo *info, const char *name) {
+    for (int k = 0; k < info->count; k++)
+        if (strcmp(info->group[k].name, name) == 0)
+            return &info->group[k];
+    return NULL;
+}
+
+// Keys are matched whole, in any order, among keys the monitor ignores
+void test_parse_keys() {
+    printf("=== Test cgroup key parsing ===\n");
+    static const char *const keys[] = { "file", "anon", "oom_kill", "missing" };
+    unsigned long long values[4] = { 0, 0, 0, 77 };
+    const char *text = "anon_thp 4096\nfile_mapped 12\nanon 1048576\nfile 2097152\n"
+                       "oom 3\noom_kill 2\noom_group_kill 9\n";
+    assert(parse_cgroup_keys(text, keys, 4, values) == 3);
+    assert(values[0] == 2097152 && values[1] == 1048576 && values[2] == 2);
+    assert(values[3] == 77); // Left alone
+    assert(parse_cgroup_keys("", keys, 4, values) == 0);
+    assert(parse_cgroup_keys("\nfile 5", keys, 1, values) == 1 && values[0] == 5); // No final newline
+    printf("Test cgroup key parsing passed!\n\n");
+}
+
+// Usage, throttling, pressure and memory events over two seconds
+void test_rates() {
+    printf("=== Test cgroup rates ===\n");
+    CgroupStats prev = { .usage_usec = 1000000, .user_usec = 600000, .system_usec = 400000,
+                         .nr_periods = 100, .nr_throttled = 10, .throttled_usec = 5000,
+                         .high_events = 4, .max_events = 1, .some_usec = 100 };
+    CgroupStats curr = prev;
+    curr.usage_usec += 3000000; // 1.5 CPUs
+    curr.user_usec += 2000000;
+    curr.system_usec += 1000000;
+    curr.nr_periods += 20;
+    curr.nr_throttled += 5;
+    curr.throttled_usec += 400000;
+    curr.high_events += 6;
+    curr.max_events += 2;
+    curr.some_usec += 500000;
+    CgroupEntry e;
+    calculate_cgroup_rates(&prev, &curr, 2.0, &e);
+    assert(close_to(e.cpu_pct, 150.0) && close_to(e.user_pct, 100.0) && close_to(e.system_pct, 50.0));
+    assert(close_to(e.throttled_pct, 25.0) && close_to(e.throttled_ms_ps, 200.0));
+    assert(close_to(e.pressure_pct, 25.0) && close_to(e.memory_events_ps, 4.0));
+
+    // Counters that went back (a recreated cgroup) and no enforcement period
+    curr = prev;
+    curr.usage_usec = 10;
+    curr.nr_throttled = 0;
+    calculate_cgroup_rates(&prev, &curr, 1.0, &e);
+    assert(e.cpu_pct == 0.0 && e.throttled_pct == 0.0 && e.pressure_pct == 0.0);
+    calculate_cgroup_rates(&prev, &prev, 0.0, &e);
+    assert(e.cpu_pct == 0.0 && e.memory_events_ps == 0.0);
+    printf("Test cgroup rates passed!\n\n");
+}
+
+// Largest first, slot order on ties, for every key
+void test_rank() {
+    printf("=== Test cgroup ranking ===\n");
+    CgroupInfo info;
+    memset(&info, 0, sizeof(info));
+    info.count = 4;
+    const double cpu[4] = { 20.0, 90.0, 20.0, 5.0 };
+    const unsigned long long mem[4] = { 300, 100, 400, 200 };
+    const double thr[4] = { 0.0, 50.0, 0.0, 75.0 };
+    for (int i = 0; i < 4; i++) {
+        info.group[i].cpu_pct = cpu[i];
+        info.group[i].memory_bytes = mem[i];
+        info.group[i].throttled_pct = thr[i];
+    }
+    int order[4];
+    rank_cgroups(&info, CGROUP_SORT_CPU, order);
+    assert(order[0] == 1 && order[1] == 0 && order[2] == 2 && order[3] == 3);
+    rank_cgroups(&info, CGROUP_SORT_MEMORY, order);
+    assert(order[0] == 2 && order[1] == 0 && order[2] == 3 && order[3] == 1);
+    rank_cgroups(&info, CGROUP_SORT_THROTTLED, order);
+    assert(order[0] == 3 && order[1] == 1 && order[2] == 0 && order[3] == 2);
+    assert(strcmp(cgroup_sort_name(CGROUP_SORT_MEMORY), "memory") == 0);
+    printf("Test cgroup ranking passed!\n\n");
+}
+
+// Rates follow the fixture's counters with two preads per file (the second
+// finds the end), one inotify read and no open or directory scan per sample
+void test_fixture_cgroups() {
+    printf("=== Test cgroups on a fixture ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 4, 23) == 0);
+    assert(add_proc_fixture_cgroups(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    CgroupSampler *s = create_cgroup_sampler();
+    assert(s != NULL);
+    assert(cgroup_slot_changes(s) == FIXTURE_CGROUPS);
+    unsigned long scans = cgroup_scans(s);
+    assert(scans == 1 + FIXTURE_CGROUPS); // The root, then every cgroup
+
+    CgroupInfo info;
+    for (int tick = 0; tick < 10; tick++) {
+        CgroupStats before[FIXTURE_CGROUPS];
+        memcpy(before, fx.cgroup, sizeof(before));
+        assert(advance_proc_fixture(&fx) == 0);
+
+        ProcIoCounts io0, io1;
+        get_proc_io_counts(&io0);
+        assert(sample_cgroup_info(s, &info) == FIXTURE_CGROUPS);
+        get_proc_io_counts(&io1);
+        // cpu.stat and cpu.pressure everywhere, three memory files where the
+        // controller is on (user.slice), each read to its end, and the inotify descriptor
+        assert(io1.opens == io0.opens && io1.reads == io0.reads + 2 * (3 * 5 + 2) + 1);
+
+        assert(info.available && info.count == FIXTURE_CGROUPS && info.skipped == 0 && info.interval > 0.0);
+        for (int k = 0; k < info.count; k++) {
+            const CgroupEntry *e = &info.group[k];
+            int i = fixture_cgroup(&fx, e->name);
+            assert(i >= 0 && e->slot >= 0 && e->depth == (strchr(e->name, '/') ? 2 : 1));
+            const CgroupStats *b = &before[i], *c = &fx.cgroup[i];
+            double seconds = info.interval;
+            assert(close_to(e->cpu_pct, (double)(c->usage_usec - b->usage_usec) / seconds / 1e4));
+            assert(close_to(e->user_pct, (double)(c->user_usec - b->user_usec) / seconds / 1e4));
+            assert(close_to(e->throttled_ms_ps, (double)(c->throttled_usec - b->throttled_usec) / 1e3 / seconds));
+            assert(close_to(e->pressure_pct, calculate_psi_stall(b->some_usec, c->some_usec, seconds)));
+            if (c->nr_periods > b->nr_periods)
+                assert(close_to(e->throttled_pct,
+                                (double)(c->nr_throttled - b->nr_throttled) * 100.0 / (double)(c->nr_periods - b->nr_periods)));
+            else
+                assert(e->throttled_pct == 0.0);
+            assert(e->flags & CGROUP_HAS_PRESSURE);
+            if (e->flags & CGROUP_HAS_MEMORY) {
+                assert(e->memory_bytes == c->memory_current && e->anon_bytes == c->anon && e->file_bytes == c->file);
+                assert(close_to(e->memory_events_ps, (double)(c->high_events - b->high_events) / seconds));
+            }
+        }
+    }
+    assert(cgroup_scans(s) == scans && cgroup_slot_changes(s) == FIXTURE_CGROUPS);
+
+    // Controllers enabled per cgroup decide the figures present
+    const CgroupEntry *web = find_entry(&info, "system.slice/docker-web.scope");
+    const CgroupEntry *sshd = find_entry(&info, "system.slice/sshd.service");
+    const CgroupEntry *user = find_entry(&info, "user.slice");
+    assert(web != NULL && sshd != NULL && user != NULL);
+    assert((web->flags & CGROUP_HAS_LIMIT) && (web->flags & CGROUP_HAS_MEMORY) && web->oom_kills == 1);
+    assert(!(sshd->flags & CGROUP_HAS_LIMIT) && (sshd->flags & CGROUP_HAS_MEMORY));
+    assert(!(user->flags & CGROUP_HAS_MEMORY) && user->memory_bytes == 0);
+    assert(web->cpu_pct > 0.0);
+    printf("%s: %.1f%% CPU, %.1f%% of periods throttled, %.1f MB over %.3f ms\n", web->name, web->cpu_pct,
+           web->throttled_pct, web->memory_bytes / 1048576.0, info.interval * 1e3);
+
+    destroy_cgroup_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test cgroups on a fixture passed!\n\n");
+}
+
+// A cgroup removed and created again frees and retakes a slot; a new subtree
+// is walked once and only it is scanned
+void test_create_remove() {
+    printf("=== Test cgroup create and remove ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 5) == 0);
+    assert(add_proc_fixture_cgroups(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    CgroupSampler *s = create_cgroup_sampler();
+    assert(s != NULL);
+    CgroupInfo info;
+    unsigned long scans = cgroup_scans(s);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(set_proc_fixture_cgroup(&fx, 0, 0) < 0); // Children still there
+    assert(set_proc_fixture_cgroup(&fx, 2, 0) == 0); // The container stops
+    assert(sample_cgroup_info(s, &info) == FIXTURE_CGROUPS - 1);
+    assert(cgroup_slot_changes(s) == FIXTURE_CGROUPS + 1 && cgroup_scans(s) == scans);
+    assert(find_entry(&info, "system.slice/docker-web.scope") == NULL);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(set_proc_fixture_cgroup(&fx, 2, 1) == 0); // and starts again
+    assert(sample_cgroup_info(s, &info) == FIXTURE_CGROUPS);
+    assert(cgroup_slot_changes(s) == FIXTURE_CGROUPS + 2 && cgroup_scans(s) == scans + 1);
+    const CgroupEntry *web = find_entry(&info, "system.slice/docker-web.scope");
+    assert(web != NULL && web->cpu_pct == 0.0 && web->depth == 2); // No previous reading
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_cgroup_info(s, &info) == FIXTURE_CGROUPS);
+    web = find_entry(&info, "system.slice/docker-web.scope");
+    assert(web != NULL && web->cpu_pct > 0.0);
+
+    // A new slice with a cgroup already inside: both are found from one event
+    char path[PROC_PATH_MAX];
+    const char *const made[] = { "/sys/fs/cgroup/test.slice", "/sys/fs/cgroup/test.slice/job.scope" };
+    for (int d = 0; d < 2; d++) {
+        snprintf(path, sizeof(path), "%s%s", fx.root, made[d]);
+        assert(mkdir(path, 0755) == 0);
+        snprintf(path, sizeof(path), "%s%s/cpu.stat", fx.root, made[d]);
+        FILE *f = fopen(path, "w");
+        assert(f != NULL);
+        fprintf(f, "usage_usec %d\nuser_usec 0\nsystem_usec 0\n", 1000 * (d + 1));
+        fclose(f);
+    }
+    assert(sample_cgroup_info(s, &info) == FIXTURE_CGROUPS + 2);
+    assert(cgroup_slot_changes(s) == FIXTURE_CGROUPS + 4 && cgroup_scans(s) == scans + 3);
+    const CgroupEntry *job = find_entry(&info, "test.slice/job.scope");
+    assert(job != NULL && job->depth == 2 && job->flags == 0);
+
+    // Removing the slice (its child first, as rmdir requires) releases both
+    for (int d = 1; d >= 0; d--) {
+        snprintf(path, sizeof(path), "%s%s/cpu.stat", fx.root, made[d]);
+        assert(unlink(path) == 0);
+        snprintf(path, sizeof(path), "%s%s", fx.root, made[d]);
+        assert(rmdir(path) == 0);
+    }
+    assert(set_proc_fixture_cgroup(&fx, 1, 0) == 0);
+    assert(set_proc_fixture_cgroup(&fx, 2, 0) == 0);
+    assert(set_proc_fixture_cgroup(&fx, 0, 0) == 0);
+    assert(sample_cgroup_info(s, &info) == 1 && strcmp(info.group[0].name, "user.slice") == 0);
+    assert(cgroup_slot_changes(s) == FIXTURE_CGROUPS + 9);
+    assert(set_proc_fixture_cgroup(&fx, 1, 1) < 0); // Its slice is gone
+    assert(set_proc_fixture_cgroup(&fx, FIXTURE_CGROUPS, 1) < 0);
+
+    destroy_cgroup_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test cgroup create and remove passed!\n\n");
+}
+
+// Without a unified hierarchy nothing is available and nothing fails
+void test_unavailable() {
+    printf("=== Test cgroup v2 unavailable ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 9) == 0);
+    assert(add_proc_fixture_cgroups(&fx) == 0);
+    char path[PROC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/sys/fs/cgroup/cgroup.controllers", fx.root);
+    assert(unlink(path) == 0); // A v1-only system: no v2 root
+    assert(set_proc_root(fx.root) == 0);
+    CgroupSampler *s = create_cgroup_sampler();
+    assert(s != NULL);
+    CgroupInfo info;
+    assert(sample_cgroup_info(s, &info) == 0 && !info.available && info.count == 0);
+    assert(cgroup_slot_changes(s) == 0 && cgroup_scans(s) == 0);
+    destroy_cgroup_sampler(s);
+    destroy_cgroup_sampler(NULL);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test cgroup v2 unavailable passed!\n\n");
+}
+
+int main() {
+    test_parse_keys();
+    test_rates();
+    test_rank();
+    test_fixture_cgroups();
+    test_create_remove();
+    test_unavailable();
+    return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file collector_test.c
+ * @brief Tests for the SPSC ring and the collector thread.
+ */
+
+#include <assert.h>
+#include "../../src/collector.h"
+#include "../../src/ring.h"
+
+#include <errno.h>   // For errno
+#include <poll.h>    // For waiting on the sample event
+#include <pthread.h> // For the ring stress test
+#include <sched.h>   // For sched_yield()
+#include <stdio.h>   // For printf
+#include <stdlib.h>  // For qsort()
+#include <string.h>  // For strerror()
+#include <unistd.h>  // For usleep()
+
+#define RING_ITEMS 200000
+
+// Test the index ring on its own: order, full and empty conditions
+void test_ring_basic() {
+    printf("=== Test SpscRing basics ===\n");
+    SpscRing ring;
+    init_spsc_ring(&ring, 4);
+
+    assert(ring_read_slot(&ring) == -1);
+    for (long i = 0; i < 4; i++) {
+        assert(ring_write_slot(&ring) == i);
+        ring_commit_write(&ring);
+    }
+    assert(ring_write_slot(&ring) == -1); // Full
+    assert(ring_count(&ring) == 4);
+
+    assert(ring_read_slot(&ring) == 0);
+    ring_release_read(&ring);
+    assert(ring_write_slot(&ring) == 0); // Wraps around
+    printf("Test SpscRing basics passed!\n\n");
+}
+
+// Producer/consumer pair passing a sequence through the ring
+static SpscRing stress_ring;
+static long stress_slots[8];
+
+static void *stress_producer(void *arg) {
+    (void)arg;
+    for (long value = 1; value <= RING_ITEMS;) {
+        long slot = ring_write_slot(&stress_ring);
+        if (slot < 0) {
+            sched_yield(); // Let the consumer run on single-CPU machines
+            continue;
+        }
+        stress_slots[slot] = value++;
+        ring_commit_write(&stress_ring);
+    }
+    return NULL;
+}
+
+// Test that every value arrives once and in order across threads
+void test_ring_threads() {
+    printf("=== Test SpscRing across threads ===\n");
+    init_spsc_ring(&stress_ring, 8);
+    pthread_t producer;
+    assert(pthread_create(&producer, NULL, stress_producer, NULL) == 0);
+
+    for (long expected = 1; expected <= RING_ITEMS;) {
+        long slot = ring_read_slot(&stress_ring);
+        if (slot < 0) {
+            sched_yield();
+            continue;
+        }
+        assert(stress_slots[slot] == expected);
+        expected++;
+        ring_release_read(&stress_ring);
+    }
+    pthread_join(producer, NULL);
+    printf("Test SpscRing across threads passed!\n\n");
+}
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Test the sampling cadence while the consumer stalls, and report the jitter
+void test_collector_cadence() {
+    printf("=== Test collector cadence ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+
+    const long interval_ms = 20;
+    Collector *collector = create_collector(&cpu, interval_ms, COLLECTOR_PROCESSES | COLLECTOR_SELF);
+    assert(collector != NULL);
+    assert(start_collector(collector) == 0);
+
+    long jitter[256];
+    int count = 0;
+    unsigned long last_seq = 0, dropped = 0;
+    struct timespec first = { 0, 0 }, last = { 0, 0 };
+
+    for (int round = 0; round < 40 && count < 256; round++) {
+        // Every tenth round the "renderer" stalls longer than the whole ring
+        usleep(round % 10 == 9 ? (COLLECTOR_RING_SLOTS + 4) * interval_ms * 1000 : 15000);
+
+        const Sample *s;
+        while ((s = collector_peek(collector)) != NULL && count < 256) {
+            assert(s->seq > last_seq);
+            assert(s->cpu.usage >= 0.0 && s->cpu.usage <= 100.0);
+            assert(s->mem.mem_total > 0);
+            // Every phase is timed and the monitor sees its own sampling thread
+            assert(s->cost.cpu_ns > 0 && s->cost.mem_ns > 0 && s->cost.procs_ns > 0 && s->cost.self_ns > 0);
+            assert(s->self.threads >= 2 && s->self.rss_kb > 0 && s->self.io_delta.reads > 0);
+            if (last_seq == 0)
+                first = s->timestamp;
+            last = s->timestamp;
+            last_seq = s->seq;
+            dropped = s->dropped;
+            jitter[count++] = s->jitter_ns;
+            collector_release(collector);
+        }
+    }
+    destroy_collector(collector);
+
+    qsort(jitter, count, sizeof(long), compare_long);
+    double span = (last.tv_sec - first.tv_sec) + (last.tv_nsec - first.tv_nsec) / 1e9;
+    double mean_period_ms = span * 1e3 / (last_seq - 1);
+    printf("Samples: %d consumed, %lu taken, %lu dropped\n", count, last_seq, dropped);
+    printf("Period: %.3f ms (target %ld ms)\n", mean_period_ms, interval_ms);
+    printf("Jitter: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           jitter[count / 2] / 1e6, jitter[count * 99 / 100] / 1e6, jitter[count - 1] / 1e6);
+
+    // Stalls drop samples instead of stretching the period
+    assert(dropped > 0);
+    assert(mean_period_ms > interval_ms * 0.9 && mean_period_ms < interval_ms * 1.1);
+    assert(jitter[count / 2] < 1000000); // Median wake-up within 1 ms
+
+    free_cpu_info(&cpu);
+    printf("Test collector cadence passed!\n\n");
+}
+
+// Test the sample event descriptor and that stopping does not wait out the interval
+void test_collector_event_and_stop() {
+    printf("=== Test collector event and stop latency ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+
+    Collector *collector = create_collector(&cpu, 1000, 0);
+    assert(collector != NULL);
+    assert(start_collector(collector) == 0);
+
+    // The first sample arrives after COLLECTOR_FIRST_DELAY_MS, not a full interval
+    struct pollfd pfd = { .fd = collector_event_fd(collector), .events = POLLIN };
+    assert(poll(&pfd, 1, COLLECTOR_FIRST_DELAY_MS * 3) == 1);
+    collector_clear_event(collector);
+    assert(collector_peek(collector) != NULL);
+    collector_release(collector);
+    assert(poll(&pfd, 1, 0) == 0); // Cleared
+
+    // Stop in the middle of a 1 s sleep
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stop_collector(collector);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double stop_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("stop_collector(): %.3f ms\n", stop_ms);
+    assert(stop_ms < 10.0);
+
+    // Restart after a stop
+    assert(start_collector(collector) == 0);
+    destroy_collector(collector);
+    free_cpu_info(&cpu);
+    printf("Test collector event and stop latency passed!\n\n");
+}
+
+static volatile int hogs_stop;
+
+static void *hog(void *arg) {
+    (void)arg;
+    while (!hogs_stop)
+        ;
+    return NULL;
+}
+
+// A PSI trigger wakes the collector between two ticks of a 10 s interval
+void test_collector_psi_wake() {
+    printf("=== Test collector PSI wake-up ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    Collector *collector = create_collector(&cpu, 10000, COLLECTOR_PSI);
+    assert(collector != NULL);
+    if (add_collector_psi_trigger(collector, PSI_CPU, 0, 20000, PSI_MIN_WINDOW_US) < 0 &&
+        add_collector_psi_trigger(collector, PSI_CPU, 0, 20000, 2000000) < 0) {
+        printf("No PSI triggers here (%s), skipped\n", strerror(errno));
+        destroy_collector(collector);
+        free_cpu_info(&cpu);
+        printf("Test collector PSI wake-up passed!\n\n");
+        return;
+    }
+    assert(start_collector(collector) == 0);
+    assert(add_collector_psi_trigger(collector, PSI_IO, 0, 20000, 2000000) < 0); // Only before start
+
+    struct pollfd pfd = { .fd = collector_event_fd(collector), .events = POLLIN };
+    assert(poll(&pfd, 1, COLLECTOR_FIRST_DELAY_MS * 3) == 1); // First scheduled sample
+    collector_clear_event(collector);
+    const Sample *s = collector_peek(collector);
+    assert(s != NULL && s->psi.woken == 0);
+    collector_release(collector);
+
+    // Twice as many spinning threads as CPUs stall the CPU at once
+    int n = cpu.num_cpus * 2 < 256 ? cpu.num_cpus * 2 : 256;
+    pthread_t threads[256];
+    hogs_stop = 0;
+    for (int i = 0; i < n; i++)
+        assert(pthread_create(&threads[i], NULL, hog, NULL) == 0);
+    assert(poll(&pfd, 1, 5000) == 1);
+    hogs_stop = 1;
+    for (int i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+    collector_clear_event(collector);
+    s = collector_peek(collector);
+    assert(s != NULL && (s->psi.woken & (1u << PSI_CPU)) && s->jitter_ns == 0);
+    printf("Woken after %.3f s by a stall, cpu some %.1f%%\n", s->interval, s->psi.res[PSI_CPU].some_pct);
+    assert(s->interval < 9.0);
+    collector_release(collector);
+
+    destroy_collector(collector);
+    free_cpu_info(&cpu);
+    printf("Test collector PSI wake-up passed!\n\n");
+}
+
+int main() {
+    test_ring_basic();
+    test_ring_threads();
+    test_collector_cadence();
+    test_collector_event_and_stop();
+    test_collector_psi_wake();
+    return 0;
+}
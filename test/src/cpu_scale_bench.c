@@ -0,0 +1,74 @@
+/**
+ * @file cpu_scale_bench.c
+ * @brief Scaling benchmark for the /proc/stat reader and the usage pass.
+ *
+ * Writes a synthetic /proc/stat for N logical CPUs into a temporary file and
+ * times one tick (read_cpu_stats_all() + calculate_cpu_usage_all()) for
+ * N = 32 .. 1024. The ns/CPU column should stay roughly flat, i.e. the
+ * per-tick cost grows linearly with the CPU count.
+ */
+
+#include <assert.h>
+#include "../../src/cpuinfo_manip.h"
+
+#include <stdio.h>  // For printf, fprintf
+#include <stdlib.h> // For calloc(), mkstemp()
+#include <time.h>   // For clock_gettime()
+#include <unistd.h> // For close(), unlink()
+
+#define ITERATIONS 2000
+
+// Write a /proc/stat look-alike with the aggregate line, n CPU lines and a short tail
+static void write_fake_stat(const char *path, int n) {
+    FILE *f = fopen(path, "w");
+    assert(f != NULL);
+    fprintf(f, "cpu  %d 0 %d %d 10 0 3 0 0 0\n", n * 900, n * 300, n * 40000);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "cpu%d %d %d %d %d %d %d %d %d 0 0\n",
+                i, 900 + i, i % 7, 300 + i, 40000 + i * 3, 10, 0, 3 + i % 5, 0);
+    }
+    fprintf(f, "intr 12345 0 0 0\nctxt 987654\nbtime 1700000000\n");
+    fclose(f);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    printf("%6s %14s %10s\n", "cpus", "ns/tick", "ns/cpu");
+
+    for (int n = 32; n <= 1024; n *= 2) {
+        char path[] = "/tmp/cpu_scale_benchXXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        close(fd);
+        write_fake_stat(path, n);
+
+        ProcFile stat_file;
+        CPUStatsStore prev, curr;
+        double *usage = calloc(n + 1, sizeof(double));
+        assert(open_proc_file(&stat_file, path, (size_t)(n + 1) * STAT_LINE_LEN) == 0);
+        assert(init_cpu_stats_store(&prev, n + 1) == 0);
+        assert(init_cpu_stats_store(&curr, n + 1) == 0);
+        assert(usage != NULL);
+        assert(read_cpu_stats_all(&stat_file, &prev) == 0);
+
+        double start = now_ns();
+        for (int i = 0; i < ITERATIONS; i++) {
+            read_cpu_stats_all(&stat_file, &curr);
+            calculate_cpu_usage_all(&prev, &curr, 0, n + 1, usage);
+        }
+        double per_tick = (now_ns() - start) / ITERATIONS;
+        printf("%6d %14.0f %10.1f\n", n, per_tick, per_tick / n);
+
+        free(usage);
+        free_cpu_stats_store(&prev);
+        free_cpu_stats_store(&curr);
+        close_proc_file(&stat_file);
+        unlink(path);
+    }
+    return 0;
+}
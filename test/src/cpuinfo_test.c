@@ -14,6 +14,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 
 
 
@@ -26,11 +27,15 @@ void test_cpu_info() {
     printf("Name: %s\n", cpu.name);  // Print CPU name
     printf("Cores: %d\n", cpu.cores); // Print core count
     printf("Threads: %d\n", cpu.threads);  // Print thread count
+    printf("CPU slots: %d\n", cpu.num_cpus); // Print online CPU slots
     
     // Verify core count is positive
     assert(cpu.cores > 0);
     // Verify thread count >= core count
     assert(cpu.threads >= cpu.cores);
+    // Per-thread storage is sized from the online CPU mask
+    assert(cpu.num_cpus >= 1 && cpu.thread_usage != NULL);
+    free_cpu_info(&cpu);
     printf("Test get_cpu_info() passed!\n\n");
 }
 
@@ -39,24 +44,129 @@ void test_cpu_usage() {
     CPUInfo cpu;  // Create CPU info structure
     get_cpu_info(&cpu);  // Get static CPU info
     
-    printf("=== Test get_cpu_usage() ===\n");
+    printf("=== Test sample_cpu_usage() ===\n");
     
-    // First measurement
-    get_cpu_usage(&cpu);
-    printf("Fist call: %.2f%%\n", cpu.usage);
+    // Creating the sampler takes the first snapshot without blocking
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    CPUSampler *sampler = create_cpu_sampler(cpu.num_cpus);
+    assert(sampler != NULL);
+    usleep(100000); // 100 ms delta
+    assert(sample_cpu_usage(sampler, &cpu) == 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double first_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("First delta: %.2f%% after %.1f ms\n", cpu.usage, first_ms);
+    assert(first_ms < 500.0); // No hidden 1 s prime
+    assert(cpu.usage >= 0.0 && cpu.usage <= 100.0);
     
     // Second measurement after 1 second
     sleep(1);
-    get_cpu_usage(&cpu);
+    assert(sample_cpu_usage(sampler, &cpu) == 0);
     printf("Second call: %.2f%%\n", cpu.usage);
     
     // Verify usage is between 0% and 100%
     assert(cpu.usage >= 0.0 && cpu.usage <= 100.0);
-    printf("Test get_cpu_usage() passed!\n\n");
+    for (int i = 0; i < cpu.num_cpus; i++) {
+        assert(cpu.thread_usage[i] >= 0.0 && cpu.thread_usage[i] <= 100.0);
+    }
+    destroy_cpu_sampler(sampler);
+    free_cpu_info(&cpu);
+    printf("Test sample_cpu_usage() passed!\n\n");
+}
+
+// Test that the structure-of-arrays pass matches the scalar calculation
+void test_usage_all_matches_scalar() {
+    printf("=== Test calculate_cpu_usage_all() ===\n");
+    const int slots = 1025; // Aggregate + 1024 logical CPUs
+    CPUStatsStore prev, curr;
+    assert(init_cpu_stats_store(&prev, slots) == 0);
+    assert(init_cpu_stats_store(&curr, slots) == 0);
+
+    for (int i = 0; i < slots; i++) {
+        for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+            prev.field[f][i] = (unsigned long)(i * 31 + f * 7);
+            curr.field[f][i] = prev.field[f][i] + (unsigned long)((i + f) % 13);
+        }
+    }
+    // An idle slot with no progress must not divide by zero
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        curr.field[f][5] = prev.field[f][5];
+    }
+
+    double *usage = calloc(slots, sizeof(double));
+    assert(usage != NULL);
+    calculate_cpu_usage_all(&prev, &curr, 0, slots, usage);
+
+    for (int i = 0; i < slots; i++) {
+        CPUStats a = { prev.field[CPU_USER][i], prev.field[CPU_NICE][i], prev.field[CPU_SYSTEM][i],
+                       prev.field[CPU_IDLE][i], prev.field[CPU_IOWAIT][i], prev.field[CPU_IRQ][i],
+                       prev.field[CPU_SOFTIRQ][i], prev.field[CPU_STEAL][i], 0, 0 };
+        CPUStats b = { curr.field[CPU_USER][i], curr.field[CPU_NICE][i], curr.field[CPU_SYSTEM][i],
+                       curr.field[CPU_IDLE][i], curr.field[CPU_IOWAIT][i], curr.field[CPU_IRQ][i],
+                       curr.field[CPU_SOFTIRQ][i], curr.field[CPU_STEAL][i], 0, 0 };
+        double expected = calculate_cpu_usage(&a, &b);
+        assert(usage[i] > expected - 1e-9 && usage[i] < expected + 1e-9);
+    }
+    assert(usage[5] == 0.0);
+
+    free(usage);
+    free_cpu_stats_store(&prev);
+    free_cpu_stats_store(&curr);
+    printf("Test calculate_cpu_usage_all() passed!\n\n");
+}
+
+// Arguments for one sampler thread
+typedef struct {
+    CPUSampler *sampler;
+    useconds_t interval_us;
+    int failures;
+} SamplerThreadArgs;
+
+static void *sampler_thread(void *arg) {
+    SamplerThreadArgs *args = arg;
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    for (int i = 0; i < 5; i++) {
+        usleep(args->interval_us);
+        if (sample_cpu_usage(args->sampler, &cpu) < 0 || cpu.usage < 0.0 || cpu.usage > 100.0)
+            args->failures++;
+    }
+    free_cpu_info(&cpu);
+    return NULL;
+}
+
+// Test that independent samplers and a shared sampler work from several threads
+void test_concurrent_samplers() {
+    printf("=== Test concurrent samplers ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+
+    CPUSampler *fast = create_cpu_sampler(cpu.num_cpus);
+    CPUSampler *slow = create_cpu_sampler(cpu.num_cpus);
+    assert(fast != NULL && slow != NULL);
+
+    // Two threads share "fast", a third uses "slow" at a different interval
+    SamplerThreadArgs args[3] = {
+        { fast, 20000, 0 }, { fast, 30000, 0 }, { slow, 50000, 0 },
+    };
+    pthread_t threads[3];
+    for (int i = 0; i < 3; i++)
+        assert(pthread_create(&threads[i], NULL, sampler_thread, &args[i]) == 0);
+    for (int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+        assert(args[i].failures == 0);
+    }
+
+    destroy_cpu_sampler(fast);
+    destroy_cpu_sampler(slow);
+    free_cpu_info(&cpu);
+    printf("Test concurrent samplers passed!\n\n");
 }
 
 int main() {
     test_cpu_info();    // Run CPU info test
     test_cpu_usage();   // Run CPU usage test
+    test_usage_all_matches_scalar(); // Run structure-of-arrays test
+    test_concurrent_samplers(); // Run multi-sampler test
     return 0;
 }
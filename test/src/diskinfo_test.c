@@ -0,0 +1,293 @@
+/**
+ * @file diskinfo_test.c
+ * @brief Tests for the /proc/diskstats parser, the rate math and the device map.
+ */
+
+#include <assert.h>
+#include "../../src/diskinfo_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>  // For printf
+#include <string.h> // For strcmp()
+
+// Fixture index of a reported device
+static int fixture_disk(const ProcFixture *fx, const char *name) {
+    for (int i = 0; i < FIXTURE_DISKS; i++)
+        if (strcmp(fx->disk_name[i], name) == 0)
+            return i;
+    return -1;
+}
+
+// Rates, latencies and utilization from two snapshots, across a wrap and a reset too
+void test_rates() {
+    printf("=== Test disk rates ===\n");
+    DiskStats prev = { .reads = 1000, .read_sectors = 8000, .read_ms = 2000, .writes = 500,
+                       .write_sectors = 16000, .write_ms = 4000, .io_ms = 10000, .weighted_ms = 30000 };
+    DiskStats curr = prev;
+    curr.reads += 200;         // 100 reads/s over 2 s
+    curr.read_sectors += 4000; // 2.048 MB
+    curr.read_ms += 600;       // 3 ms per read
+    curr.writes += 50;
+    curr.write_sectors += 2000;
+    curr.write_ms += 1000;     // 20 ms per write
+    curr.io_ms += 1500;        // 75% busy
+    curr.weighted_ms += 3000;  // 1.5 requests in flight on average
+    DiskDevice dev;
+    calculate_disk_rates(&prev, &curr, 2.0, &dev);
+    assert(close_to(dev.read_iops, 100.0) && close_to(dev.write_iops, 25.0));
+    assert(close_to(dev.read_mbps, 1.024) && close_to(dev.write_mbps, 0.512));
+    assert(close_to(dev.read_await_ms, 3.0) && close_to(dev.write_await_ms, 20.0));
+    assert(close_to(dev.await_ms, 1600.0 / 250.0));
+    assert(close_to(dev.util, 75.0) && close_to(dev.queue, 1.5));
+
+    // A time field that wrapped since the previous snapshot
+    curr.reads = prev.reads + 20;
+    prev.read_ms = 0xFFFFFFFFUL; // Printed with %u: wraps at 2^32 on 64-bit systems too
+    curr.read_ms = 39;
+    calculate_disk_rates(&prev, &curr, 1.0, &dev);
+    assert(close_to(dev.read_iops, 20.0) && close_to(dev.read_await_ms, 2.0));
+
+    // The other time fields wrap at 2^32 too: no queue or await in the 10^16
+    DiskStats before = prev, after = curr;
+    before.write_ms = 0xFFFFFF00UL;
+    after.write_ms = 0x100UL;          // 512 ms over 50 writes
+    after.writes = before.writes + 50;
+    before.weighted_ms = 0xFFFFF000UL;
+    after.weighted_ms = 3000;          // 4096 + 3000 ms queued
+    before.io_ms = 0xFFFFFFFFUL;
+    after.io_ms = 499;                 // 500 ms busy
+    calculate_disk_rates(&before, &after, 1.0, &dev);
+    assert(close_to(dev.write_await_ms, 512.0 / 50.0));
+    assert(close_to(dev.await_ms, (40.0 + 512.0) / 70.0));
+    assert(close_to(dev.queue, (3000.0 + 4096.0) / 1000.0) && close_to(dev.util, 50.0));
+
+    // A count that went back: the device was re-created and its counters
+    // restarted, so the interval has no rates rather than 10^19 IOPS
+    after = curr;
+    after.reads = 5;
+    calculate_disk_rates(&prev, &after, 1.0, &dev);
+    assert(dev.read_iops == 0.0 && dev.write_iops == 0.0 && dev.read_mbps == 0.0);
+    assert(dev.await_ms == 0.0 && dev.queue == 0.0 && dev.util == 0.0);
+    after = curr;
+    after.write_sectors = prev.write_sectors - 1;
+    calculate_disk_rates(&prev, &after, 1.0, &dev);
+    assert(dev.read_iops == 0.0 && dev.write_mbps == 0.0 && dev.util == 0.0);
+
+    // io_ms overshoots on short intervals; no interval, no rates
+    curr.io_ms = prev.io_ms + 120;
+    calculate_disk_rates(&prev, &curr, 0.1, &dev);
+    assert(dev.util == 100.0);
+    calculate_disk_rates(&prev, &curr, 0.0, &dev);
+    assert(dev.read_iops == 0.0 && dev.util == 0.0 && dev.await_ms == 0.0);
+
+    // Idle device: no division by zero
+    calculate_disk_rates(&prev, &prev, 1.0, &dev);
+    assert(dev.read_await_ms == 0.0 && dev.write_await_ms == 0.0 && dev.await_ms == 0.0 && dev.util == 0.0);
+    printf("Test disk rates passed!\n\n");
+}
+
+// Every device's rates match the counters the fixture wrote, with one pass (two preads) over the file per tick
+void test_fixture_devices() {
+    printf("=== Test disk devices on a fixture ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 4, 21) == 0);
+    assert(add_proc_fixture_disks(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    DiskSampler *s = create_disk_sampler();
+    assert(s != NULL);
+
+    DiskInfo info;
+    for (int tick = 0; tick < 10; tick++) {
+        DiskStats before[FIXTURE_DISKS];
+        memcpy(before, fx.disk, sizeof(before));
+        assert(advance_proc_fixture(&fx) == 0);
+
+        ProcIoCounts io0, io1;
+        get_proc_io_counts(&io0);
+        assert(sample_disk_info(s, &info) == 0);
+        get_proc_io_counts(&io1);
+        assert(io1.opens == io0.opens && io1.reads == io0.reads + 2);
+
+        assert(info.total == FIXTURE_DISKS && info.count == FIXTURE_DISKS && info.interval > 0.0);
+        for (int d = 0; d < info.count; d++) {
+            const DiskDevice *dev = &info.dev[d];
+            int i = fixture_disk(&fx, dev->name);
+            assert(i >= 0);
+            // Whole disks (loop0, mmcblk0, sda) come first
+            assert(dev->partition == (d >= 3));
+            DiskDevice expected;
+            calculate_disk_rates(&before[i], &fx.disk[i], info.interval, &expected);
+            assert(close_to(dev->read_iops, expected.read_iops) && close_to(dev->write_mbps, expected.write_mbps));
+            assert(close_to(dev->await_ms, expected.await_ms) && close_to(dev->util, expected.util));
+            assert(dev->ios == fx.disk[i].reads + fx.disk[i].writes && dev->in_flight == fx.disk[i].in_flight);
+        }
+    }
+    // The device list never changed: the names were compared once
+    assert(disk_map_rebuilds(s) == 1);
+    const DiskDevice *root = &info.dev[4]; // mmcblk0p2
+    printf("%s: %.0f r/s %.0f w/s, await %.1f ms, %.0f%% busy over %.3f ms\n", root->name, root->read_iops,
+           root->write_iops, root->await_ms, root->util, info.interval * 1e3);
+
+    destroy_disk_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test disk devices on a fixture passed!\n\n");
+}
+
+// Unplugging and replugging a disk rebuilds the map once each and keeps the
+// history of the devices that stayed
+void test_hotplug() {
+    printf("=== Test disk hotplug ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 4, 8) == 0);
+    assert(add_proc_fixture_disks(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    DiskSampler *s = create_disk_sampler();
+    assert(s != NULL);
+    DiskInfo info;
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(set_proc_fixture_disk(&fx, 4, 0) == 0); // sda and sda1
+    assert(sample_disk_info(s, &info) == 0);
+    assert(disk_map_rebuilds(s) == 2 && info.total == 4 && info.count == 4);
+    for (int d = 0; d < info.count; d++)
+        assert(strncmp(info.dev[d].name, "sda", 3) != 0);
+    // mmcblk0p2 kept its previous snapshot, so its rates cover the tick
+    assert(strcmp(info.dev[3].name, "mmcblk0p2") == 0 && info.dev[3].read_iops > 0.0);
+
+    assert(set_proc_fixture_disk(&fx, 4, 1) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_disk_info(s, &info) == 0);
+    assert(disk_map_rebuilds(s) == 3 && info.count == FIXTURE_DISKS);
+    // A new device has no previous snapshot yet
+    assert(strcmp(info.dev[2].name, "sda") == 0 && info.dev[2].read_iops == 0.0 && info.dev[2].ios > 0);
+    assert(strcmp(info.dev[4].name, "mmcblk0p2") == 0 && info.dev[4].read_iops > 0.0);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_disk_info(s, &info) == 0);
+    assert(disk_map_rebuilds(s) == 3 && info.dev[2].read_iops > 0.0);
+
+    assert(set_proc_fixture_disk(&fx, 2, 0) < 0); // A partition cannot be unplugged alone
+    destroy_disk_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test disk hotplug passed!\n\n");
+}
+
+// A disk unplugged and replugged between two samples keeps its major:minor,
+// so the map stays, but its counters restarted from 0: it reports no rates
+// for that interval instead of wrapped deltas, then real ones again
+void test_replug() {
+    printf("=== Test disk replug within an interval ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 31) == 0);
+    assert(add_proc_fixture_disks(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    DiskSampler *s = create_disk_sampler();
+    assert(s != NULL);
+    DiskInfo info;
+
+    for (int tick = 0; tick < 3; tick++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(sample_disk_info(s, &info) == 0);
+    }
+    int sda = fixture_disk(&fx, "sda");
+    assert(fx.disk[sda].reads > 0);
+
+    DiskStats before[FIXTURE_DISKS];
+    assert(set_proc_fixture_disk(&fx, sda, 0) == 0);
+    assert(set_proc_fixture_disk(&fx, sda, 1) == 0);
+    memcpy(before, fx.disk, sizeof(before));
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_disk_info(s, &info) == 0);
+    assert(disk_map_rebuilds(s) == 1 && info.count == FIXTURE_DISKS);
+    for (int d = 0; d < info.count; d++) {
+        const DiskDevice *dev = &info.dev[d];
+        if (strncmp(dev->name, "sda", 3) == 0) {
+            assert(dev->read_iops == 0.0 && dev->write_iops == 0.0);
+            assert(dev->read_mbps == 0.0 && dev->write_mbps == 0.0 && dev->util == 0.0);
+        } else {
+            // The other devices kept their counters and their rates
+            int i = fixture_disk(&fx, dev->name);
+            DiskDevice expected;
+            calculate_disk_rates(&before[i], &fx.disk[i], info.interval, &expected);
+            assert(close_to(dev->read_iops, expected.read_iops) && close_to(dev->util, expected.util));
+        }
+    }
+
+    // The next interval has rates again, from the restarted counters
+    memcpy(before, fx.disk, sizeof(before));
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_disk_info(s, &info) == 0);
+    for (int d = 0; d < info.count; d++) {
+        int i = fixture_disk(&fx, info.dev[d].name);
+        DiskDevice expected;
+        calculate_disk_rates(&before[i], &fx.disk[i], info.interval, &expected);
+        assert(close_to(info.dev[d].read_iops, expected.read_iops) && close_to(info.dev[d].write_mbps, expected.write_mbps));
+    }
+
+    destroy_disk_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test disk replug within an interval passed!\n\n");
+}
+
+// /proc/diskstats is an iterative seq_file that returns about a page per
+// pread(): devices past the first page are still sampled
+void test_short_reads() {
+    printf("=== Test disk stats over short reads ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 27) == 0);
+    assert(add_proc_fixture_disks(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    set_proc_fixture_read_limit(64); // About half a line per read
+    DiskSampler *s = create_disk_sampler();
+    assert(s != NULL);
+
+    DiskInfo info;
+    assert(advance_proc_fixture(&fx) == 0);
+    ProcIoCounts io0, io1;
+    get_proc_io_counts(&io0);
+    assert(sample_disk_info(s, &info) == 0);
+    get_proc_io_counts(&io1);
+    assert(io1.reads - io0.reads > 2);
+    assert(info.total == FIXTURE_DISKS && info.count == FIXTURE_DISKS && disk_map_rebuilds(s) == 1);
+    assert(strcmp(info.dev[5].name, "sda1") == 0 && info.dev[5].ios == fx.disk[5].reads + fx.disk[5].writes);
+
+    set_proc_fixture_read_limit(0);
+    destroy_disk_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test disk stats over short reads passed!\n\n");
+}
+
+// The running system's /proc/diskstats parses and gives sane values
+void test_live() {
+    printf("=== Test live disk stats ===\n");
+    DiskSampler *s = create_disk_sampler();
+    assert(s != NULL);
+    DiskInfo info;
+    assert(sample_disk_info(s, &info) == 0);
+    assert(info.count <= info.total && info.count <= DISK_MAX_DEVICES);
+    int disks = 0;
+    for (int d = 0; d < info.count; d++) {
+        const DiskDevice *dev = &info.dev[d];
+        assert(dev->name[0] != '\0' && dev->util >= 0.0 && dev->util <= 100.0);
+        if (d > 0)
+            assert(dev->partition >= info.dev[d - 1].partition);
+        disks += !dev->partition;
+    }
+    printf("This machine: %d devices, %d whole disks\n", info.total, disks);
+    destroy_disk_sampler(s);
+    printf("Test live disk stats passed!\n\n");
+}
+
+int main() {
+    test_rates();
+    test_fixture_devices();
+    test_hotplug();
+    test_replug();
+    test_short_reads();
+    test_live();
+    return 0;
+}
@@ -0,0 +1,414 @@
+/**
+ * @file exporter_test.c
+ * @brief Tests for the Prometheus exporter over TCP and Unix sockets.
+ */
+
+#include <assert.h>
+#include "../../src/exporter.h"
+
+#include <arpa/inet.h>  // For inet_pton()
+#include <netinet/in.h> // For struct sockaddr_in
+#include <pthread.h>    // For the rendering thread
+#include <stdatomic.h>  // For the stop flag
+#include <stdio.h>      // For printf
+#include <stdlib.h>     // For strtoul()
+#include <string.h>     // For strstr()
+#include <sys/socket.h> // For socket(), connect()
+#include <sys/stat.h>   // For stat()
+#include <sys/un.h>     // For struct sockaddr_un
+#include <time.h>       // For clock_gettime()
+#include <unistd.h>     // For read(), write(), close()
+
+#define TEST_CPUS 4
+#define RACE_SCRAPES 5000
+#define CADENCE_SAMPLES 100
+
+static const char get_metrics[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A sample whose every usage is the same percentage
+static void fill_sample(Sample *s, double *threads, unsigned long seq, double usage) {
+    memset(s, 0, sizeof(*s));
+    s->seq = seq;
+    s->wallclock.tv_sec = 1700000000;
+    s->wallclock.tv_nsec = 250000000;
+    s->interval = 0.01;
+    s->jitter_ns = 1500;
+    s->dropped = 3;
+    s->cpu.num_cpus = TEST_CPUS;
+    s->cpu.usage = usage;
+    s->cpu.thread_usage = threads;
+    for (int i = 0; i < TEST_CPUS; i++)
+        threads[i] = usage;
+    s->mem.mem_total = 2048;
+    s->mem.mem_available = 1024;
+    s->mem.swap_total = 512;
+}
+
+static int connect_tcp(int port) {
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((unsigned short)port) };
+    inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    assert(connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+    return fd;
+}
+
+static void send_all(int fd, const char *text) {
+    size_t len = strlen(text);
+    assert(write(fd, text, len) == (ssize_t)len);
+}
+
+/*
+ * Read one response into buf: headers, then Content-Length body bytes.
+ * Returns the status code, with the body in buf + *body_off. 0 on EOF.
+ */
+static int read_response(int fd, char *buf, size_t cap, size_t *body_off, size_t *body_len) {
+    size_t got = 0;
+    char *end = NULL;
+    while (end == NULL) {
+        ssize_t n = read(fd, buf + got, cap - 1 - got);
+        if (n <= 0)
+            return 0;
+        got += (size_t)n;
+        buf[got] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+    }
+    const char *length = strstr(buf, "Content-Length: ");
+    assert(length != NULL && length < end);
+    *body_off = (size_t)(end + 4 - buf);
+    *body_len = strtoul(length + 16, NULL, 10);
+    while (got < *body_off + *body_len) {
+        ssize_t n = read(fd, buf + got, cap - 1 - got);
+        assert(n > 0);
+        got += (size_t)n;
+    }
+    assert(got == *body_off + *body_len); // One request, one response: nothing beyond it
+    buf[got] = '\0';
+    return atoi(buf + 9);
+}
+
+// Value of the first line starting with name followed by a space or '{'
+static double metric(const char *body, const char *name) {
+    size_t len = strlen(name);
+    for (const char *p = body; *p != '\0'; p++) {
+        if (strncmp(p, name, len) == 0 && (p[len] == ' ' || p[len] == '{'))
+            return atof(strchr(p, ' ') + 1);
+        p = strchr(p, '\n');
+        if (p == NULL)
+            break;
+    }
+    return -1.0;
+}
+
+// The server counts a scrape once send() returns, which can be after the client has read it
+static void wait_scrapes(const Exporter *e, unsigned long scrapes, ExporterStats *stats) {
+    for (int tries = 0; tries < 100; tries++) {
+        get_exporter_stats(e, stats);
+        if (stats->scrapes == scrapes)
+            return;
+        usleep(1000);
+    }
+}
+
+// 503 before the first sample, then the rendered sample on a kept-alive connection
+void test_scrape() {
+    printf("=== Test exporter scrape ===\n");
+    Exporter *e = create_exporter("127.0.0.1:0", TEST_CPUS);
+    assert(e != NULL);
+    int port = exporter_port(e);
+    assert(port > 0);
+    assert(start_exporter(e) == 0);
+
+    char buf[16384];
+    size_t off, len;
+    int fd = connect_tcp(port);
+    send_all(fd, get_metrics);
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 503);
+
+    Sample s;
+    double threads[TEST_CPUS];
+    fill_sample(&s, threads, 7, 12.346);
+    threads[3] = 100.0;
+    exporter_sink(e, &s, NULL);
+    send_all(fd, get_metrics);
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 200);
+    assert(strstr(buf, "Content-Type: text/plain; version=0.0.4") != NULL);
+    const char *body = buf + off;
+    assert(strlen(body) == len && body[len - 1] == '\n');
+    assert(strstr(body, "# TYPE resource_mon_cpu_usage_ratio gauge\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_ratio 0.1235\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_thread_usage_ratio{cpu=\"0\"} 0.1235\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_thread_usage_ratio{cpu=\"3\"} 1.0000\n") != NULL);
+    assert(strstr(body, "{cpu=\"4\"}") == NULL);
+    assert(strstr(body, "resource_mon_memory_total_bytes 2097152\n") != NULL);
+    assert(strstr(body, "resource_mon_memory_available_bytes 1048576\n") != NULL);
+    assert(strstr(body, "resource_mon_swap_total_bytes 524288\n") != NULL);
+    assert(strstr(body, "resource_mon_sample_interval_seconds 0.010000\n") != NULL);
+    assert(strstr(body, "resource_mon_sample_jitter_seconds 0.000001500\n") != NULL);
+    assert(strstr(body, "resource_mon_sample_timestamp_seconds 1700000000.250\n") != NULL);
+    assert(strstr(body, "# TYPE resource_mon_samples_total counter\nresource_mon_samples_total 7\n") != NULL);
+    assert(strstr(body, "resource_mon_samples_dropped_total 3\n") != NULL);
+    size_t response_len = off + len;
+    printf("%zu byte body\n", len);
+
+    // Errors keep the connection; pipelined requests are answered in order
+    send_all(fd, "GET /nothing HTTP/1.1\r\n\r\n");
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 404);
+    send_all(fd, "POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 405);
+    send_all(fd, "GET /metrics?x=1 HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\n\r\n");
+    size_t got = 0;
+    while (got < 2 * response_len) {
+        ssize_t n = read(fd, buf + got, sizeof(buf) - 1 - got);
+        assert(n > 0);
+        got += (size_t)n;
+    }
+    assert(got == 2 * response_len && memcmp(buf, buf + response_len, response_len) == 0);
+    assert(strncmp(buf, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+    // Connection: close is honoured
+    send_all(fd, "GET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 200);
+    assert(read(fd, buf, sizeof(buf)) == 0);
+    close(fd);
+
+    ExporterStats stats;
+    get_exporter_stats(e, &stats);
+    assert(stats.renders == 1 && stats.busy == 0 && stats.scrapes == 4 && stats.errors == 3);
+    destroy_exporter(e);
+    assert(create_exporter("127.0.0.1:notaport", TEST_CPUS) == NULL);
+    printf("Test exporter scrape passed!\n\n");
+}
+
+// Window statistics of the total and every CPU, recorded by a sink before the exporter's
+void test_window_stats() {
+    printf("=== Test exporter window statistics ===\n");
+    Exporter *e = create_exporter("127.0.0.1:0", TEST_CPUS);
+    WindowStats *stats = create_window_stats(WINSTATS_SERIES(TEST_CPUS));
+    assert(e != NULL && stats != NULL && set_exporter_stats(e, stats) == 0);
+    assert(start_exporter(e) == 0);
+
+    Sample s;
+    double threads[TEST_CPUS];
+    for (int k = 0; k < 90; k++) { // 90 s: 20% then 80% for the last half minute
+        fill_sample(&s, threads, (unsigned long)k, k < 60 ? 20.0 : 80.0);
+        threads[2] = k;
+        s.timestamp.tv_sec = 100 + k;
+        window_stats_sink(stats, &s, NULL);
+        exporter_sink(e, &s, NULL);
+    }
+
+    char buf[65536];
+    size_t off, len;
+    int fd = connect_tcp(exporter_port(e));
+    send_all(fd, get_metrics);
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 200);
+    const char *body = buf + off;
+    assert(strlen(body) == len);
+    assert(strstr(body, "# TYPE resource_mon_cpu_usage_window_ratio gauge\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_window_ratio{cpu=\"all\",window=\"1m\",stat=\"mean\"} 0.5000\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_window_ratio{cpu=\"all\",window=\"15m\",stat=\"min\"} 0.2000\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_window_ratio{cpu=\"2\",window=\"1m\",stat=\"min\"} 0.3000\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_window_ratio{cpu=\"2\",window=\"5m\",stat=\"p95\"} 0.8500\n") != NULL);
+    assert(strstr(body, "resource_mon_cpu_usage_window_ratio{cpu=\"3\",window=\"15m\",stat=\"max\"} 0.8000\n") != NULL);
+    int lines = 0;
+    for (const char *p = body; (p = strstr(p, "resource_mon_cpu_usage_window_ratio{")) != NULL; p++)
+        lines++;
+    assert(lines == WINSTATS_SERIES(TEST_CPUS) * WINSTATS_WINDOWS * WINSTATS_FIGURES);
+    printf("%d window lines, %zu byte body\n", lines, len);
+    close(fd);
+    destroy_exporter(e);
+    destroy_window_stats(stats);
+    printf("Test exporter window statistics passed!\n\n");
+}
+
+// A Unix socket path is served too and removed on destroy
+void test_unix_socket() {
+    printf("=== Test exporter Unix socket ===\n");
+    char dir[] = "/tmp/exporter_test.XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/metrics.sock", dir);
+
+    Exporter *e = create_exporter(path, TEST_CPUS);
+    assert(e != NULL && exporter_port(e) == 0);
+    assert(start_exporter(e) == 0);
+    Sample s;
+    double threads[TEST_CPUS];
+    fill_sample(&s, threads, 1, 50.0);
+    exporter_sink(e, &s, NULL);
+
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    strcpy(sa.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+    char buf[16384];
+    size_t off, len;
+    send_all(fd, "GET /metrics HTTP/1.0\r\n\r\n");
+    assert(read_response(fd, buf, sizeof(buf), &off, &len) == 200);
+    assert(metric(buf + off, "resource_mon_cpu_usage_ratio") == 0.5);
+    assert(read(fd, buf, sizeof(buf)) == 0); // HTTP/1.0 closes
+    close(fd);
+
+    // A stale socket file from an earlier run is replaced
+    destroy_exporter(e);
+    struct stat st;
+    assert(stat(path, &st) != 0);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+    close(fd);
+    e = create_exporter(path, TEST_CPUS);
+    assert(e != NULL);
+    destroy_exporter(e);
+    rmdir(dir);
+    printf("Test exporter Unix socket passed!\n\n");
+}
+
+typedef struct {
+    Exporter *exporter;
+    atomic_int stop;
+    unsigned long rendered;
+} Renderer;
+
+// Publish samples as fast as possible; sample k has every usage at k % 100
+static void *render_loop(void *arg) {
+    Renderer *r = arg;
+    Sample s;
+    double threads[TEST_CPUS];
+    for (unsigned long k = 1; !atomic_load(&r->stop); k++) {
+        fill_sample(&s, threads, k, (double)(k % 100));
+        exporter_sink(r->exporter, &s, NULL);
+        r->rendered++;
+    }
+    return NULL;
+}
+
+// Every scrape sees one whole sample while the sink keeps publishing
+void test_concurrent_renders() {
+    printf("=== Test exporter consistency under renders ===\n");
+    Exporter *e = create_exporter("127.0.0.1:0", TEST_CPUS);
+    assert(e != NULL && start_exporter(e) == 0);
+    Renderer r = { .exporter = e };
+    Sample s;
+    double threads[TEST_CPUS];
+    fill_sample(&s, threads, 1, 1.0);
+    exporter_sink(e, &s, NULL);
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, render_loop, &r) == 0);
+
+    int fd = connect_tcp(exporter_port(e));
+    char buf[16384];
+    size_t off, len;
+    unsigned long last_seq = 0;
+    double start = now_s();
+    for (int i = 0; i < RACE_SCRAPES; i++) {
+        send_all(fd, get_metrics);
+        assert(read_response(fd, buf, sizeof(buf), &off, &len) == 200);
+        const char *body = buf + off;
+        unsigned long seq = (unsigned long)metric(body, "resource_mon_samples_total");
+        assert(seq >= last_seq);
+        last_seq = seq;
+        double usage = metric(body, "resource_mon_cpu_usage_ratio");
+        assert(usage == (double)(seq % 100) / 100.0);
+        const char *p = body;
+        for (int cpu = 0; cpu < TEST_CPUS; cpu++) {
+            p = strstr(p, "resource_mon_cpu_thread_usage_ratio{");
+            assert(p != NULL && atof(strchr(p, ' ') + 1) == usage);
+            p++;
+        }
+    }
+    double elapsed = now_s() - start;
+    atomic_store(&r.stop, 1);
+    pthread_join(thread, NULL);
+    close(fd);
+
+    ExporterStats stats;
+    wait_scrapes(e, RACE_SCRAPES, &stats);
+    printf("%d scrapes in %.3f s (%.0f/s), %lu renders, %lu skipped busy\n", RACE_SCRAPES, elapsed,
+           RACE_SCRAPES / elapsed, stats.renders, stats.busy);
+    assert(stats.scrapes == RACE_SCRAPES && stats.renders + stats.busy == r.rendered + 1);
+    assert(RACE_SCRAPES / elapsed > 500.0); // Hundreds of scrapes per second, with margin
+    destroy_exporter(e);
+    printf("Test exporter consistency under renders passed!\n\n");
+}
+
+typedef struct {
+    int port;
+    atomic_int stop;
+    unsigned long scrapes;
+} Scraper;
+
+static void *scrape_loop(void *arg) {
+    Scraper *sc = arg;
+    int fd = connect_tcp(sc->port);
+    char buf[65536];
+    size_t off, len;
+    while (!atomic_load(&sc->stop)) {
+        send_all(fd, get_metrics);
+        if (read_response(fd, buf, sizeof(buf), &off, &len) == 200)
+            sc->scrapes++;
+    }
+    close(fd);
+    return NULL;
+}
+
+// The real collector at 10 ms keeps its cadence under continuous scraping
+void test_collector_cadence() {
+    printf("=== Test exporter with the collector ===\n");
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    Exporter *e = create_exporter("127.0.0.1:0", cpu.num_cpus);
+    Collector *c = create_collector(&cpu, 10, 0);
+    assert(e != NULL && c != NULL);
+    assert(add_collector_sink(c, exporter_sink, e) == 0);
+    assert(start_exporter(e) == 0 && start_collector(c) == 0);
+
+    Scraper scrapers[2] = { { .port = exporter_port(e) }, { .port = exporter_port(e) } };
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++)
+        assert(pthread_create(&threads[i], NULL, scrape_loop, &scrapers[i]) == 0);
+    unsigned long samples = 0;
+    long max_jitter_ns = 0;
+    while (samples < CADENCE_SAMPLES) {
+        const Sample *s = collector_peek(c);
+        if (s == NULL) {
+            usleep(2000);
+            continue;
+        }
+        if (s->jitter_ns > max_jitter_ns)
+            max_jitter_ns = s->jitter_ns;
+        collector_release(c);
+        samples++;
+    }
+    for (int i = 0; i < 2; i++) {
+        atomic_store(&scrapers[i].stop, 1);
+        pthread_join(threads[i], NULL);
+    }
+    destroy_collector(c);
+
+    unsigned long scraped = scrapers[0].scrapes + scrapers[1].scrapes;
+    ExporterStats stats;
+    wait_scrapes(e, scraped, &stats);
+    printf("%lu samples, %lu scrapes, %lu renders, %lu busy, max jitter %.3f ms\n", samples,
+           scraped, stats.renders, stats.busy, max_jitter_ns / 1e6);
+    assert(stats.renders + stats.busy >= CADENCE_SAMPLES && stats.renders > 0);
+    assert(stats.scrapes == scraped && scraped > CADENCE_SAMPLES);
+    destroy_exporter(e);
+    free_cpu_info(&cpu);
+    printf("Test exporter with the collector passed!\n\n");
+}
+
+int main() {
+    test_scrape();
+    test_window_stats();
+    test_unix_socket();
+    test_concurrent_renders();
+    test_collector_cadence();
+    return 0;
+}
@@ -0,0 +1,266 @@
+/**
+ * @file fixture_test.c
+ * @brief Parser correctness and throughput on synthetic /proc trees.
+ *
+ * Every collector is pointed at a generated tree with set_proc_root(), so
+ * machines with hundreds of CPUs are checked on any build box, with the same
+ * counters on every run.
+ */
+
+#include <assert.h>
+#include "proc_fixture.h"
+#include "../../src/collector.h"
+
+#include <math.h>   // For fabs()
+#include <stdlib.h> // For calloc()
+#include <stdio.h>  // For printf
+#include <string.h> // For strcmp()
+#include <time.h>   // For clock_gettime()
+#include <unistd.h> // For usleep()
+
+#define TICKS 20
+#define BENCH_TICKS 200
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Static info, per-tick usage and meminfo of an n-CPU tree match the generator
+static void check_machine(int n) {
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 1234) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    assert(strcmp(get_proc_root(), fx.root) == 0);
+
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    assert(cpu.num_cpus == n);
+    assert(strcmp(cpu.name, FIXTURE_MODEL_NAME) == 0);
+    assert(cpu.threads == n && cpu.cores == (n > 1 ? n / 2 : 1));
+
+    CPUSampler *sampler = create_cpu_sampler(cpu.num_cpus);
+    assert(sampler != NULL);
+    for (int t = 0; t < TICKS; t++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(sample_cpu_usage(sampler, &cpu) == 0);
+        assert(fabs(cpu.usage - fx.expected_usage[0]) < 1e-9);
+        for (int i = 0; i < n; i++)
+            assert(fabs(cpu.thread_usage[i] - fx.expected_usage[i + 1]) < 1e-9);
+
+        MemInfo mem;
+        assert(get_memory_info(&mem) == 0);
+        assert(memcmp(&mem, &fx.mem, sizeof(mem)) == 0);
+    }
+    printf("%4d CPUs: %d ticks match (stat %zu bytes, cpuinfo %zu bytes)\n",
+           n, TICKS, fx.stat_bytes, fx.cpuinfo_bytes);
+
+    destroy_cpu_sampler(sampler);
+    free_cpu_info(&cpu);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+}
+
+// Usage and memory parsing from 1 to 512 CPUs
+void test_parsers() {
+    printf("=== Test parsers on synthetic trees ===\n");
+    int sizes[] = { 1, 2, 64, 512 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        check_machine(sizes[i]);
+    assert(strcmp(get_proc_root(), "/") == 0);
+    printf("Test parsers on synthetic trees passed!\n\n");
+}
+
+// An offline CPU has no cpuN line in /proc/stat: it reads 0% while away and
+// again for the first sample back, never a delta against an older sample
+void test_cpu_hotplug() {
+    printf("=== Test CPU usage across hotplug ===\n");
+    const int n = 8;
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 77) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    CPUSampler *sampler = create_cpu_sampler(cpu.num_cpus);
+    assert(sampler != NULL);
+
+    // A hole (CPU 5) and the tail (CPU 7) of the store
+    assert(set_proc_fixture_online(&fx, 5, 0) == 0 && set_proc_fixture_online(&fx, 7, 0) == 0);
+    for (int t = 0; t < 5; t++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(sample_cpu_usage(sampler, &cpu) == 0);
+        assert(fabs(cpu.usage - fx.expected_usage[0]) < 1e-9);
+        for (int i = 0; i < n; i++)
+            assert(fabs(cpu.thread_usage[i] - fx.expected_usage[i + 1]) < 1e-9);
+        assert(cpu.thread_usage[5] == 0.0 && cpu.thread_usage[7] == 0.0);
+    }
+
+    assert(set_proc_fixture_online(&fx, 5, 1) == 0 && set_proc_fixture_online(&fx, 7, 1) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_cpu_usage(sampler, &cpu) == 0);
+    assert(cpu.thread_usage[5] == 0.0 && cpu.thread_usage[7] == 0.0); // No previous reading yet
+    assert(fabs(cpu.thread_usage[6] - fx.expected_usage[7]) < 1e-9);
+    for (int t = 0; t < 3; t++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(sample_cpu_usage(sampler, &cpu) == 0);
+        for (int i = 0; i < n; i++)
+            assert(fabs(cpu.thread_usage[i] - fx.expected_usage[i + 1]) < 1e-9);
+    }
+
+    destroy_cpu_sampler(sampler);
+    free_cpu_info(&cpu);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test CPU usage across hotplug passed!\n\n");
+}
+
+// A CPU parked at startup and numbered above every online one, as a
+// big.LITTLE board parks its big cores, has a slot from the start and is
+// tracked once brought up
+void test_parked_cpus() {
+    printf("=== Test CPUs parked at startup ===\n");
+    const int n = 8;
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 78) == 0);
+    assert(set_proc_fixture_online(&fx, 6, 0) == 0 && set_proc_fixture_online(&fx, 7, 0) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    assert(count_cpu_slots() == n);
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    assert(cpu.num_cpus == n && cpu.threads == n - 2);
+    CPUSampler *sampler = create_cpu_sampler(cpu.num_cpus);
+    assert(sampler != NULL);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_cpu_usage(sampler, &cpu) == 0);
+    assert(cpu.thread_usage[6] == 0.0 && cpu.thread_usage[7] == 0.0);
+
+    assert(set_proc_fixture_online(&fx, 7, 1) == 0);
+    CPUTopology *topo = discover_cpu_topology(cpu.num_cpus);
+    assert(topo != NULL && topo->online == n - 1 && topo->cpu[7].online && !topo->cpu[6].online);
+    assert(topo->cpu[7].core_index >= 0 && topo->untracked == 0);
+    destroy_cpu_topology(topo);
+    topo = discover_cpu_topology(n - 2); // Sized from the online mask at startup
+    assert(topo != NULL && topo->online == n - 2 && topo->untracked == 1);
+    destroy_cpu_topology(topo);
+    for (int t = 0; t < 3; t++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(sample_cpu_usage(sampler, &cpu) == 0);
+        if (t > 0) // The first sample back has no previous reading
+            assert(cpu.thread_usage[7] > 0.0 && fabs(cpu.thread_usage[7] - fx.expected_usage[8]) < 1e-9);
+        assert(fabs(cpu.usage - fx.expected_usage[0]) < 1e-9);
+    }
+
+    destroy_cpu_sampler(sampler);
+    free_cpu_info(&cpu);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test CPUs parked at startup passed!\n\n");
+}
+
+// The collector opens its sources under the root too
+void test_collector_root() {
+    printf("=== Test collector on a synthetic tree ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 256, 99) == 0);
+    assert(add_proc_fixture_thermal(&fx) == 0 && add_proc_fixture_disks(&fx) == 0);
+    assert(add_proc_fixture_net(&fx) == 0 && add_proc_fixture_pressure(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+
+    CPUInfo cpu;
+    get_cpu_info(&cpu);
+    Collector *c = create_collector(&cpu, 20, COLLECTOR_TOPOLOGY | COLLECTOR_THERMAL | COLLECTOR_DISKS |
+                                                  COLLECTOR_NET | COLLECTOR_PSI);
+    assert(c != NULL);
+    assert(start_collector(c) == 0);
+    const Sample *s;
+    while ((s = collector_peek(c)) == NULL)
+        usleep(5000);
+    assert(s->cpu.num_cpus == 256);
+    assert(s->mem.mem_total == fx.mem.mem_total && s->mem.mem_available == fx.mem.mem_available);
+    assert(s->topology != NULL && s->topology->online == 256 && s->topology->cores == 128);
+    assert(s->freq_khz[0] == fx.freq_khz[0] && s->freq_khz[255] == fx.freq_khz[1]);
+    assert(s->thermal.zone_count == 2 && s->thermal.zones[1].temp_mc == fx.temp_mc[1]);
+    assert(s->thermal.zones[0].trip_mc == FIXTURE_TRIP_MC && s->thermal.flags == 0);
+    assert(s->disks.total == FIXTURE_DISKS && strcmp(s->disks.dev[1].name, "mmcblk0") == 0);
+    assert(s->net.count == FIXTURE_IFACES && strcmp(s->net.iface[1].name, "eth0") == 0);
+    assert(s->psi.res[PSI_IO].available && s->psi.res[PSI_IO].some.total_us == fx.psi_some[PSI_IO].total_us);
+    assert(s->psi.woken == 0);
+
+    // Hotplug while this sample is held: the collector switches to a new
+    // layout and keeps the old one alive until the slot is released
+    const CPUTopology *held = s->topology;
+    assert(set_proc_fixture_online(&fx, 200, 0) == 0);
+    while (collector_pending(c) < 4)
+        usleep(5000);
+    assert(s->topology == held && held->online == 256 && held->cpu[200].online);
+    collector_release(c);
+    int seen = 0;
+    while (!seen) {
+        while ((s = collector_peek(c)) == NULL)
+            usleep(5000);
+        seen = s->topology != held && s->topology->online == 255;
+        if (seen)
+            assert(!s->topology->cpu[200].online && s->freq_khz[200] == 0);
+        collector_release(c);
+    }
+    destroy_collector(c);
+
+    free_cpu_info(&cpu);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test collector on a synthetic tree passed!\n\n");
+}
+
+// Time the parse of one tick for growing machines (files prepared up front)
+void test_throughput() {
+    printf("=== Parser throughput ===\n");
+    printf("%6s %12s %10s %10s %14s\n", "cpus", "stat ns", "ns/cpu", "MB/s", "meminfo ns");
+    for (int n = 8; n <= 512; n *= 4) {
+        ProcFixture fx;
+        assert(create_proc_fixture(&fx, n, 7) == 0);
+        assert(advance_proc_fixture(&fx) == 0);
+        assert(set_proc_root(fx.root) == 0);
+
+        CPUSampler *sampler = create_cpu_sampler(n);
+        CPUInfo cpu = { .num_cpus = n };
+        cpu.thread_usage = calloc((size_t)n, sizeof(double));
+        assert(sampler != NULL && cpu.thread_usage != NULL);
+
+        // The content does not change between samples: only the parse is timed
+        double start = now_ns();
+        for (int t = 0; t < BENCH_TICKS; t++)
+            sample_cpu_usage(sampler, &cpu);
+        double stat_ns = (now_ns() - start) / BENCH_TICKS;
+
+        ProcFile meminfo_file;
+        MemInfo mem;
+        char path[PROC_PATH_MAX];
+        assert(open_proc_file(&meminfo_file, proc_path("/proc/meminfo", path), MEMINFO_BUF_LEN) == 0);
+        start = now_ns();
+        for (int t = 0; t < BENCH_TICKS; t++)
+            read_memory_info(&meminfo_file, &mem);
+        double meminfo_ns = (now_ns() - start) / BENCH_TICKS;
+        assert(mem.mem_total == fx.mem.mem_total);
+
+        printf("%6d %12.0f %10.1f %10.1f %14.0f\n", n, stat_ns, stat_ns / n,
+               (double)fx.stat_bytes / stat_ns * 1e3, meminfo_ns);
+
+        close_proc_file(&meminfo_file);
+        free_cpu_info(&cpu);
+        destroy_cpu_sampler(sampler);
+        set_proc_root(NULL);
+        destroy_proc_fixture(&fx);
+    }
+    printf("\n");
+}
+
+int main() {
+    test_parsers();
+    test_cpu_hotplug();
+    test_parked_cpus();
+    test_collector_root();
+    test_throughput();
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file gen_fixture.c
+ * @brief Command line front end of proc_fixture: keeps a synthetic tree alive.
+ *
+ * Usage: gen_fixture CPUS [SECONDS] [SEED]
+ *
+ * Prints the root of a synthetic tree for CPUS logical CPUs, then advances
+ * its counters once per second for SECONDS (default: until SIGINT/SIGTERM)
+ * and removes it on exit. Run the monitor against it with
+ * "bin/resource_mon --root DIR".
+ */
+
+#include "proc_fixture.h"
+
+#include <signal.h> // For sigaction()
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For strtol()
+#include <unistd.h> // For sleep()
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s CPUS [SECONDS] [SEED]\n", argv[0]);
+        return 2;
+    }
+    int cpus = (int)strtol(argv[1], NULL, 10);
+    long seconds = argc > 2 ? strtol(argv[2], NULL, 10) : 0;
+    unsigned int seed = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 1;
+    if (cpus < 1 || seconds < 0) {
+        fprintf(stderr, "Usage: %s CPUS [SECONDS] [SEED]\n", argv[0]);
+        return 2;
+    }
+
+    // No SA_RESTART: the signal cuts sleep() short
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    ProcFixture fx;
+    if (create_proc_fixture(&fx, cpus, seed) < 0) {
+        perror("gen_fixture");
+        return 1;
+    }
+    // The monitor reads every subsystem
+    if (add_proc_fixture_disks(&fx) < 0 || add_proc_fixture_net(&fx) < 0 || add_proc_fixture_pressure(&fx) < 0 ||
+        add_proc_fixture_cgroups(&fx) < 0 || add_proc_fixture_irqs(&fx) < 0 || add_proc_fixture_thermal(&fx) < 0) {
+        perror("gen_fixture");
+        destroy_proc_fixture(&fx);
+        return 1;
+    }
+    printf("%s\n", fx.root);
+    fflush(stdout);
+
+    for (long t = 0; !stop && (seconds == 0 || t < seconds); t++) {
+        sleep(1);
+        if (!stop && advance_proc_fixture(&fx) < 0) {
+            perror("gen_fixture");
+            break;
+        }
+    }
+    destroy_proc_fixture(&fx);
+    return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file history_test.c
+ * @brief Tests for the fixed-capacity sample history.
+ */
+
+#include <assert.h>
+#include "../../src/history.h"
+
+#include <stdio.h> // For printf
+
+// Fill column k of a 3-series store with k, 100 + k and 200 + k
+static void push_column(History *h, int k) {
+    float *column = push_history(h);
+    column[0] = (float)k;
+    column[1] = 100.0f + (float)k;
+    column[2] = 200.0f + (float)k;
+}
+
+// Bad sizes, an empty store and the first columns
+void test_create() {
+    printf("=== Test history create ===\n");
+    assert(create_history(0, 10) == NULL && create_history(3, 0) == NULL);
+    History *h = create_history(3, 4);
+    assert(h != NULL);
+    assert(history_count(h) == 0 && history_series(h) == 3 && history_pushes(h) == 0);
+    assert(history_column(h, 0) == NULL);
+
+    float out[4];
+    assert(read_history(h, 0, out, 4) == 0);
+    push_column(h, 1);
+    push_column(h, 2);
+    assert(history_count(h) == 2 && history_pushes(h) == 2);
+    assert(history_column(h, 0)[1] == 102.0f && history_column(h, 1)[2] == 201.0f);
+    assert(history_column(h, 2) == NULL && history_column(h, -1) == NULL);
+    assert(read_history(h, 1, out, 4) == 2 && out[0] == 101.0f && out[1] == 102.0f);
+    assert(read_history(h, 3, out, 4) == 0);
+    destroy_history(h);
+    destroy_history(NULL);
+    printf("Test history create passed!\n\n");
+}
+
+// Once full, every push drops the oldest column and the count stays put
+void test_wrap() {
+    printf("=== Test history wrap ===\n");
+    History *h = create_history(3, 4);
+    assert(h != NULL);
+    for (int k = 1; k <= 11; k++) {
+        push_column(h, k);
+        int held = k < 4 ? k : 4;
+        assert(history_count(h) == held && history_pushes(h) == (unsigned long)k);
+        for (int age = 0; age < held; age++)
+            assert(history_column(h, age)[0] == (float)(k - age));
+    }
+    float out[8];
+    assert(read_history(h, 2, out, 8) == 4);
+    assert(out[0] == 208.0f && out[1] == 209.0f && out[2] == 210.0f && out[3] == 211.0f);
+    assert(read_history(h, 0, out, 2) == 2 && out[0] == 10.0f && out[1] == 11.0f);
+
+    // A pushed column comes back with the dropped one's values until filled
+    const float *oldest = history_column(h, 3);
+    float dropped = oldest[0];
+    assert(push_history(h) == oldest && oldest[0] == dropped);
+    destroy_history(h);
+    printf("Test history wrap passed!\n\n");
+}
+
+int main() {
+    test_create();
+    test_wrap();
+    return 0;
+}
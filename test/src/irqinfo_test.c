@@ -0,0 +1,238 @@
+/**
+ * @file irqinfo_test.c
+ * @brief Tests for the interrupt and softirq sampler: rates, 32-bit wraps,
+ * cached layouts rebuilt on hotplug and new sources, and the per-CPU ranking.
+ */
+
+#include <assert.h>
+#include "../../src/irqinfo_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>  // For printf, fopen()
+#include <string.h> // For strcmp()
+#include <time.h>   // For clock_gettime()
+
+// Replace a file of the tree in place, as procfs content changes
+static void write_text(const ProcFixture *fx, const char *rel, const char *text) {
+    char path[PROC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", fx->root, rel);
+    FILE *f = fopen(path, "w");
+    assert(f != NULL);
+    fputs(text, f);
+    fclose(f);
+}
+
+// Every rate of the matrix, times the interval, is the fixture's increase
+static void check_rates(const IrqSampler *s, const ProcFixture *fx, const IrqInfo *info, int skip_cpu) {
+    int n = fx->num_cpus;
+    for (int cpu = 0; cpu < n; cpu++) {
+        if (cpu == skip_cpu)
+            continue;
+        double hard = 0.0, soft = 0.0, best = 0.0;
+        for (int r = 0; r < irq_row_count(s); r++) {
+            double events = (double)irq_row_rates(s, r)[cpu] * info->interval;
+            assert(close_to_float(events, fx->irq_delta[(size_t)r * n + cpu]));
+            if (r < FIXTURE_IRQS)
+                hard += events;
+            else
+                soft += events;
+            if (irq_row_rates(s, r)[cpu] > best)
+                best = irq_row_rates(s, r)[cpu];
+        }
+        const IrqCpu *c = &info->cpu[cpu];
+        assert(close_to_float(c->irq_ps * info->interval, hard) && close_to_float(c->softirq_ps * info->interval, soft));
+        assert(close_to_float(c->top[0].rate, best));
+        for (int k = 1; k < IRQ_TOP_SOURCES; k++)
+            assert(c->top[k].rate <= c->top[k - 1].rate);
+    }
+}
+
+// Deltas are taken modulo 2^32, as the kernel prints the counters
+void test_rate() {
+    printf("=== Test interrupt rate ===\n");
+    assert(calculate_irq_rate(10, 110, 2.0) == 50.0);
+    assert(calculate_irq_rate(0xFFFFFF00U, 0x100U, 1.0) == 512.0); // Wrapped once
+    assert(calculate_irq_rate(5, 5, 1.0) == 0.0);
+    assert(calculate_irq_rate(10, 110, 0.0) == 0.0);
+    printf("Test interrupt rate passed!\n\n");
+}
+
+// The matrix follows the fixture with one pread per file, plus the one that
+// finds the end, and no open per sample, through the wrap of eth0-rx-0 on CPU 1
+void test_fixture_irqs() {
+    printf("=== Test interrupts on a fixture ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 8, 31) == 0);
+    assert(add_proc_fixture_irqs(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    IrqSampler *s = create_irq_sampler(fx.num_cpus);
+    assert(s != NULL);
+    assert(irq_row_count(s) == FIXTURE_IRQS + FIXTURE_SOFTIRQS && irq_skipped_rows(s) == 0);
+    for (int r = 0; r < irq_row_count(s); r++) {
+        assert(strcmp(irq_row_name(s, r), fx.irq_name[r]) == 0); // ERR and MIS are left out
+        assert(irq_row_table(s, r) == (r < FIXTURE_IRQS ? IRQ_HARD : IRQ_SOFT));
+    }
+
+    IrqCpu cpus[8];
+    IrqInfo info = { .cpu = cpus };
+    for (int tick = 0; tick < 10; tick++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        ProcIoCounts io0, io1;
+        get_proc_io_counts(&io0);
+        assert(sample_irq_info(s, &info) == FIXTURE_IRQS + FIXTURE_SOFTIRQS);
+        get_proc_io_counts(&io1);
+        assert(io1.opens == io0.opens && io1.reads == io0.reads + 2 * 2);
+        assert(info.available && info.num_cpus == 8 && info.sources == FIXTURE_IRQS + FIXTURE_SOFTIRQS);
+        check_rates(s, &fx, &info, -1);
+    }
+    assert(irq_layout_changes(s) == 0);
+    assert(fx.irq_count[(size_t)2 * fx.num_cpus + 1] < 0x80000000U); // The counter did wrap
+
+    // The NIC queues make CPU 1 the hot core
+    assert(strcmp(cpus[1].top[0].name, "eth0-rx-0") == 0 || strcmp(cpus[1].top[0].name, "NET_RX") == 0);
+    printf("cpu1: %.0f irq/s %.0f softirq/s, top %s %.0f/s %s %.0f/s\n", cpus[1].irq_ps, cpus[1].softirq_ps,
+           cpus[1].top[0].name, cpus[1].top[0].rate, cpus[1].top[1].name, cpus[1].top[1].rate);
+
+    destroy_irq_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test interrupts on a fixture passed!\n\n");
+}
+
+// A CPU leaving the /proc/interrupts header rebuilds the layout once; the
+// other CPUs keep their counters and the returning CPU starts from zero
+void test_hotplug() {
+    printf("=== Test interrupt layout on hotplug ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 8, 37) == 0);
+    assert(add_proc_fixture_irqs(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    IrqSampler *s = create_irq_sampler(fx.num_cpus);
+    assert(s != NULL);
+    IrqCpu cpus[8];
+    IrqInfo info = { .cpu = cpus };
+
+    assert(set_proc_fixture_online(&fx, 5, 0) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_irq_info(s, &info) > 0);
+    assert(irq_layout_changes(s) == 1);
+    check_rates(s, &fx, &info, -1); // CPU 5 took nothing
+    assert(cpus[5].irq_ps == 0.0 && cpus[5].top[0].rate == 0.0 && cpus[5].top[0].name[0] == '\0');
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_irq_info(s, &info) > 0);
+    assert(irq_layout_changes(s) == 1);
+    check_rates(s, &fx, &info, -1);
+
+    assert(set_proc_fixture_online(&fx, 5, 1) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_irq_info(s, &info) > 0);
+    assert(irq_layout_changes(s) == 2);
+    check_rates(s, &fx, &info, 5);
+    assert(cpus[5].irq_ps == 0.0 && cpus[5].softirq_ps > 0.0); // First reading of its interrupts column
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_irq_info(s, &info) > 0);
+    check_rates(s, &fx, &info, -1);
+    assert(cpus[5].irq_ps > 0.0);
+
+    destroy_irq_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test interrupt layout on hotplug passed!\n\n");
+}
+
+// Names, rows that are not per CPU, and a driver registering an IRQ
+void test_new_source() {
+    printf("=== Test new interrupt source ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 41) == 0);
+    assert(add_proc_fixture_irqs(&fx) == 0);
+    const char *before = "           CPU0       CPU1\n"
+                         "  1:         10         20   IO-APIC   1-edge      i8042\n"
+                         "  9:          0          4   IO-APIC   9-fasteoi   acpi\n"
+                         " 16:        100          0   IO-APIC  16-fasteoi   ehci_hcd:usb1, snd_hda_intel\n"
+                         "NMI:          1          1   Non-maskable interrupts\n"
+                         "ERR:          0\n"
+                         "MIS:          0\n";
+    const char *after = "           CPU0       CPU1\n"
+                        "  1:         30         20   IO-APIC   1-edge      i8042\n"
+                        "  9:          0          8   IO-APIC   9-fasteoi   acpi\n"
+                        " 16:        100          0   IO-APIC  16-fasteoi   ehci_hcd:usb1, snd_hda_intel\n"
+                        "130:          0          0   PCI-MSI 1048576-edge      nvme0q1\n"
+                        "NMI:          3          1   Non-maskable interrupts\n"
+                        "ERR:          0\n"
+                        "MIS:          0\n";
+    write_text(&fx, "/proc/interrupts", before);
+    write_text(&fx, "/proc/softirqs", "      CPU0  CPU1\n    HI:  5  7\n");
+    assert(set_proc_root(fx.root) == 0);
+    IrqSampler *s = create_irq_sampler(2);
+    assert(s != NULL);
+    assert(irq_row_count(s) == 5);
+    assert(strcmp(irq_row_name(s, 0), "i8042") == 0 && strcmp(irq_row_name(s, 2), "snd_hda_intel") == 0);
+    assert(strcmp(irq_row_name(s, 3), "NMI") == 0 && strcmp(irq_row_name(s, 4), "HI") == 0);
+
+    write_text(&fx, "/proc/interrupts", after);
+    IrqCpu cpus[2];
+    IrqInfo info = { .cpu = cpus };
+    assert(sample_irq_info(s, &info) == 6);
+    assert(irq_layout_changes(s) == 1);
+    assert(strcmp(irq_row_name(s, 3), "nvme0q1") == 0 && irq_row_rates(s, 3)[0] == 0.0f);
+    // Counters of the sources already known are kept across the rebuild
+    assert(close_to_float(irq_row_rates(s, 0)[0] * info.interval, 20.0));
+    assert(close_to_float(irq_row_rates(s, 1)[1] * info.interval, 4.0));
+    assert(close_to_float(irq_row_rates(s, 4)[0] * info.interval, 2.0));
+    assert(strcmp(cpus[0].top[0].name, "i8042") == 0 && strcmp(cpus[0].top[1].name, "NMI") == 0);
+    assert(cpus[0].top[2].rate == 0.0);
+    assert(strcmp(cpus[1].top[0].name, "acpi") == 0);
+
+    destroy_irq_sampler(s);
+    destroy_irq_sampler(NULL);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test new interrupt source passed!\n\n");
+}
+
+// A 512-CPU machine: two reads per file per sample and no layout work in the steady state
+void test_scale() {
+    printf("=== Test interrupts at 512 CPUs ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 512, 43) == 0);
+    assert(add_proc_fixture_irqs(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    IrqSampler *s = create_irq_sampler(fx.num_cpus);
+    assert(s != NULL);
+    static IrqCpu cpus[512];
+    IrqInfo info = { .cpu = cpus };
+
+    double total_ms = 0.0;
+    ProcIoCounts io0, io1;
+    get_proc_io_counts(&io0);
+    for (int tick = 0; tick < 20; tick++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        assert(sample_irq_info(s, &info) == FIXTURE_IRQS + FIXTURE_SOFTIRQS);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total_ms += (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    }
+    get_proc_io_counts(&io1);
+    assert(io1.opens == io0.opens && io1.reads == io0.reads + 20 * 2 * 2);
+    assert(irq_layout_changes(s) == 0);
+    check_rates(s, &fx, &info, -1);
+    printf("512 CPUs, %d sources: %.1f us per sample\n", info.sources, total_ms * 1e3 / 20);
+
+    destroy_irq_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test interrupts at 512 CPUs passed!\n\n");
+}
+
+int main() {
+    test_rate();
+    test_fixture_irqs();
+    test_hotplug();
+    test_new_source();
+    test_scale();
+    return 0;
+}
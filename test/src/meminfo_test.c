@@ -2,12 +2,12 @@
  * @file meminfo_test.c
  * @brief Test suite for the meminfo_manip library.
  *
- * This file tests the function that retrieves system memory information
- * to ensure that the output is valid and correctly formatted.
+ * This file tests the functions that retrieve system memory information
+ * to ensure that the snapshot is complete and consistent.
  * Uses assert.h for basic validation checks.
  *
  * @author Alex
- * @version 1.0
+ * @version 2.0
  * @date 2025
  */
 
@@ -16,17 +16,84 @@
 #include <stdio.h>
 #include <string.h>
 
-int main() {
-    const char* info = get_memory_info();
+// A trimmed /proc/meminfo with known values, including keys we do not track
+static const char *sample_meminfo =
+    "MemTotal:       16000000 kB\n"
+    "MemFree:         2000000 kB\n"
+    "MemAvailable:   12000000 kB\n"
+    "Buffers:          100000 kB\n"
+    "Cached:          3000000 kB\n"
+    "Active(anon):     700000 kB\n"
+    "Inactive(file):   900000 kB\n"
+    "SwapTotal:       4000000 kB\n"
+    "SwapFree:        3000000 kB\n"
+    "Dirty:               120 kB\n"
+    "Writeback:            40 kB\n"
+    "Shmem:            250000 kB\n"
+    "Slab:             500000 kB\n"
+    "SecPageTables:         0 kB\n"
+    "HugePages_Total:      64\n"
+    "HugePages_Free:       60\n"
+    "HugePages_Rsvd:        2\n"
+    "HugePages_Surp:        0\n"
+    "Hugepagesize:       2048 kB\n"
+    "DirectMap4k:      123456 kB\n";
+
+// Test the single-pass keyed parser on known input
+void test_parse() {
+    MemInfo mem;
+    int found = parse_memory_info(sample_meminfo, &mem);
+
+    assert(found == 18); // SecPageTables and DirectMap4k are not tracked
+    assert(mem.mem_total == 16000000);
+    assert(mem.mem_free == 2000000);
+    assert(mem.mem_available == 12000000);
+    assert(mem.cached == 3000000);
+    assert(mem.active_anon == 700000);
+    assert(mem.inactive_file == 900000);
+    assert(mem.dirty == 120 && mem.writeback == 40);
+    assert(mem.shmem == 250000 && mem.slab == 500000);
+    assert(mem.hugepages_total == 64 && mem.hugepages_free == 60);
+    assert(mem.hugepages_rsvd == 2 && mem.hugepage_size == 2048);
+    assert(mem.page_tables == 0); // "SecPageTables" must not match "PageTables"
+
+    // "used" is based on MemAvailable
+    assert(mem_used_kb(&mem) == 4000000);
+    assert(swap_used_kb(&mem) == 1000000);
+
+    // Without MemAvailable fall back to free + buffers + cached
+    mem.mem_available = 0;
+    assert(mem_used_kb(&mem) == 16000000 - 2000000 - 100000 - 3000000);
+    printf("Parser tests passed.\n");
+}
 
-    printf("Memory Info Output: %s\n", info);
+// Test both readers against the live /proc/meminfo
+void test_live() {
+    MemInfo mem;
+    assert(get_memory_info(&mem) == 0);
 
-    // Automatic tests
-    // Check if the output string is not NULL and has a reasonable length
-    assert(info != NULL);
-    assert(strlen(info) > 0); 
-    assert(strstr(info, "MB") != NULL);
-    assert(strstr(info, "Usage") != NULL); // Check for "Usage"
+    printf("Memory Info Output: total %lu kB, available %lu kB, used %lu kB, swap %lu kB\n",
+           mem.mem_total, mem.mem_available, mem_used_kb(&mem), mem.swap_total);
+
+    assert(mem.mem_total > 0);
+    assert(mem.mem_free <= mem.mem_total);
+    assert(mem_used_kb(&mem) <= mem.mem_total);
+    assert(swap_used_kb(&mem) <= mem.swap_total);
+
+    ProcFile meminfo_file;
+    assert(open_proc_file(&meminfo_file, "/proc/meminfo", MEMINFO_BUF_LEN) == 0);
+    for (int i = 0; i < 3; i++) {
+        MemInfo again;
+        assert(read_memory_info(&meminfo_file, &again) == 0);
+        assert(again.mem_total == mem.mem_total);
+    }
+    close_proc_file(&meminfo_file);
+    printf("Live tests passed.\n");
+}
+
+int main() {
+    test_parse();
+    test_live();
 
     printf("All tests passed.\n");
 
@@ -0,0 +1,197 @@
+/**
+ * @file netinfo_test.c
+ * @brief Tests for the /proc/net/dev parser, the counter wrap and the interface slots.
+ */
+
+#include <assert.h>
+#include "../../src/netinfo_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>  // For printf
+#include <string.h> // For strcmp()
+
+// Fixture index of a reported interface
+static int fixture_iface(const ProcFixture *fx, const char *name) {
+    for (int i = 0; i < FIXTURE_IFACES; i++)
+        if (strcmp(fx->iface_name[i], name) == 0)
+            return i;
+    return -1;
+}
+
+// Plain deltas, 32-bit wraps and resets
+void test_counter_delta() {
+    printf("=== Test net counter delta ===\n");
+    assert(net_counter_delta(100, 250) == 150);
+    assert(net_counter_delta(0xFFFFFF00ULL, 0x100ULL) == 0x200);        // 32-bit wrap
+    assert(net_counter_delta(0xFFFFFFFFULL, 0) == 1);
+    assert(net_counter_delta(0x1FFFFFFFFULL, 0x200000000ULL) == 1);     // 64-bit counter past 2^32
+    assert(net_counter_delta(0x500000000ULL, 4096) == 4096);            // Reset of a 64-bit counter
+
+    NetStats prev = { .rx_bytes = 0xFFFFF000ULL, .rx_packets = 10, .tx_bytes = 5000, .tx_packets = 5,
+                      .rx_drops = 1, .tx_errors = 2 };
+    NetStats curr = prev;
+    curr.rx_bytes = 0x1000;      // 8192 bytes across the wrap
+    curr.rx_packets += 8;
+    curr.tx_bytes += 1000;
+    curr.tx_packets += 2;
+    curr.rx_drops += 3;
+    curr.tx_errors += 1;
+    NetIface iface;
+    calculate_net_rates(&prev, &curr, 2.0, &iface);
+    assert(close_to(iface.rx_bytes_ps, 4096.0) && close_to(iface.tx_bytes_ps, 500.0));
+    assert(close_to(iface.rx_packets_ps, 4.0) && close_to(iface.tx_packets_ps, 1.0));
+    assert(close_to(iface.rx_drops_ps, 1.5) && close_to(iface.tx_errors_ps, 0.5));
+    assert(iface.tx_drops_ps == 0.0 && iface.rx_errors_ps == 0.0);
+    calculate_net_rates(&prev, &curr, 0.0, &iface);
+    assert(iface.rx_bytes_ps == 0.0 && iface.tx_packets_ps == 0.0);
+    printf("Test net counter delta passed!\n\n");
+}
+
+// Rates follow the fixture's 64-bit counters while eth0's written ones wrap,
+// with one pass (two preads) over the file and no open per tick
+void test_fixture_ifaces() {
+    printf("=== Test net interfaces on a fixture ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 4, 17) == 0);
+    assert(add_proc_fixture_net(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    NetSampler *s = create_net_sampler();
+    assert(s != NULL);
+    assert(net_slot_changes(s) == FIXTURE_IFACES);
+
+    NetInfo info;
+    unsigned long long eth0_start = fx.net[1].rx_bytes;
+    for (int tick = 0; tick < 10; tick++) {
+        NetStats before[FIXTURE_IFACES];
+        memcpy(before, fx.net, sizeof(before));
+        assert(advance_proc_fixture(&fx) == 0);
+
+        ProcIoCounts io0, io1;
+        get_proc_io_counts(&io0);
+        assert(sample_net_info(s, &info) == 0);
+        get_proc_io_counts(&io1);
+        assert(io1.opens == io0.opens && io1.reads == io0.reads + 2);
+
+        assert(info.total == FIXTURE_IFACES && info.count == FIXTURE_IFACES && info.interval > 0.0);
+        for (int k = 0; k < info.count; k++) {
+            const NetIface *n = &info.iface[k];
+            int i = fixture_iface(&fx, n->name);
+            assert(i == k && n->slot == k);
+            double seconds = info.interval;
+            assert(close_to(n->rx_bytes_ps, (double)(fx.net[i].rx_bytes - before[i].rx_bytes) / seconds));
+            assert(close_to(n->tx_bytes_ps, (double)(fx.net[i].tx_bytes - before[i].tx_bytes) / seconds));
+            assert(close_to(n->rx_packets_ps, (double)(fx.net[i].rx_packets - before[i].rx_packets) / seconds));
+            assert(close_to(n->rx_drops_ps, (double)(fx.net[i].rx_drops - before[i].rx_drops) / seconds));
+            assert(close_to(n->rx_errors_ps, (double)(fx.net[i].rx_errors - before[i].rx_errors) / seconds));
+        }
+    }
+    // eth0 went past 2^32 and its total kept counting
+    assert(fx.net[1].rx_bytes > 0xFFFFFFFFULL);
+    assert(info.iface[1].rx_total == fx.net[1].rx_bytes - eth0_start);
+    assert(net_slot_changes(s) == FIXTURE_IFACES);
+    const NetIface *up = &info.iface[1];
+    printf("%s: %.1f Mbit/s in, %.1f Mbit/s out over %.3f ms\n", up->name, up->rx_bytes_ps * 8 / 1e6,
+           up->tx_bytes_ps * 8 / 1e6, info.interval * 1e3);
+
+    destroy_net_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test net interfaces on a fixture passed!\n\n");
+}
+
+// Unplugging and replugging an interface frees and retakes a slot without
+// moving the others
+void test_hotplug() {
+    printf("=== Test net hotplug ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 4) == 0);
+    assert(add_proc_fixture_net(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    NetSampler *s = create_net_sampler();
+    assert(s != NULL);
+    NetInfo info;
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(set_proc_fixture_iface(&fx, 2, 0) == 0); // wlan0 goes away
+    assert(sample_net_info(s, &info) == 0);
+    assert(info.count == 3 && net_slot_changes(s) == FIXTURE_IFACES + 1);
+    assert(strcmp(info.iface[2].name, "usb0") == 0 && info.iface[2].slot == 3);
+    assert(info.iface[2].rx_bytes_ps > 0.0);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(set_proc_fixture_iface(&fx, 2, 1) == 0);
+    assert(set_proc_fixture_iface(&fx, 3, 0) == 0); // usb0 goes, wlan0 is back in the freed slot
+    assert(sample_net_info(s, &info) == 0);
+    assert(info.count == 3 && net_slot_changes(s) == FIXTURE_IFACES + 3);
+    assert(strcmp(info.iface[2].name, "wlan0") == 0 && info.iface[2].slot == 2);
+    assert(info.iface[2].rx_bytes_ps == 0.0 && info.iface[2].rx_total == 0); // No previous reading
+    assert(info.iface[1].slot == 1 && info.iface[1].rx_bytes_ps > 0.0);
+
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(sample_net_info(s, &info) == 0);
+    assert(net_slot_changes(s) == FIXTURE_IFACES + 3 && info.iface[2].rx_bytes_ps > 0.0);
+    assert(set_proc_fixture_iface(&fx, FIXTURE_IFACES, 0) < 0);
+
+    destroy_net_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test net hotplug passed!\n\n");
+}
+
+// /proc/net/dev is an iterative seq_file that returns about a page per
+// pread(): interfaces past the first page are still sampled
+void test_short_reads() {
+    printf("=== Test net stats over short reads ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 2, 19) == 0);
+    assert(add_proc_fixture_net(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    set_proc_fixture_read_limit(100); // The header alone is two reads
+    NetSampler *s = create_net_sampler();
+    assert(s != NULL);
+    assert(net_slot_changes(s) == FIXTURE_IFACES);
+
+    NetInfo info;
+    assert(advance_proc_fixture(&fx) == 0);
+    ProcIoCounts io0, io1;
+    get_proc_io_counts(&io0);
+    assert(sample_net_info(s, &info) == 0);
+    get_proc_io_counts(&io1);
+    assert(io1.reads - io0.reads > 2);
+    assert(info.total == FIXTURE_IFACES && info.count == FIXTURE_IFACES);
+    assert(strcmp(info.iface[3].name, "usb0") == 0 && info.iface[3].rx_bytes_ps > 0.0);
+    assert(net_slot_changes(s) == FIXTURE_IFACES);
+
+    set_proc_fixture_read_limit(0);
+    destroy_net_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test net stats over short reads passed!\n\n");
+}
+
+// The running system's /proc/net/dev parses and lists loopback
+void test_live() {
+    printf("=== Test live net stats ===\n");
+    NetSampler *s = create_net_sampler();
+    assert(s != NULL);
+    NetInfo info;
+    assert(sample_net_info(s, &info) == 0);
+    assert(info.count <= info.total && info.count <= NET_MAX_IFACES);
+    int lo = 0;
+    for (int k = 0; k < info.count; k++) {
+        assert(info.iface[k].name[0] != '\0' && info.iface[k].rx_bytes_ps >= 0.0);
+        lo |= strcmp(info.iface[k].name, "lo") == 0;
+    }
+    printf("This machine: %d interfaces%s\n", info.total, lo ? " including lo" : "");
+    destroy_net_sampler(s);
+    printf("Test live net stats passed!\n\n");
+}
+
+int main() {
+    test_counter_delta();
+    test_fixture_ifaces();
+    test_hotplug();
+    test_short_reads();
+    test_live();
+    return 0;
+}
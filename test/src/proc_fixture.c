@@ -0,0 +1,1159 @@
+/**
+ * @file proc_fixture.c
+ * @brief Implementation of the synthetic /proc and /sys trees.
+ */
+
+#include "proc_fixture.h"
+#include <fcntl.h>    // For open()
+#include <math.h>     // For fabs()
+#include <stddef.h>   // For offsetof()
+#include <stdio.h>    // For snprintf()
+#include <stdlib.h>   // For calloc(), free(), mkdtemp()
+#include <string.h>   // For strcpy()
+#include <sys/stat.h>    // For mkdir()
+#include <sys/syscall.h> // For SYS_pread64
+#include <unistd.h>      // For write(), link(), unlink(), rmdir(), syscall()
+
+#define CPUINFO_ENTRY_LEN 2048 // One processor block of proc/cpuinfo, flags line included
+#define STAT_TAIL_LEN 1024     // intr, ctxt, btime, processes and softirq lines
+#define NO_FIELD ((size_t)-1)
+#define CPU_DIR "/sys/devices/system/cpu"
+#define THERMAL_DIR "/sys/class/thermal"
+#define CGROUP_DIR "/sys/fs/cgroup"
+#define CGROUP_PERIOD_US 100000 // cpu.max period: ten enforcement periods per tick
+
+// Subsystems added to the tree, a bit each in ProcFixture.added
+enum { ADD_DISKS = 1, ADD_NET = 2, ADD_PRESSURE = 4, ADD_CGROUPS = 8, ADD_IRQS = 16, ADD_THERMAL = 32 };
+
+// Directories of the tree, parents first (removed in reverse order), with the
+// subsystem that creates them (0: create_proc_fixture())
+static const struct {
+    const char *path;
+    unsigned int part;
+} fixture_dirs[] = {
+    { "/proc", 0 }, { "/proc/net", ADD_NET }, { "/proc/pressure", ADD_PRESSURE }, { "/sys", 0 },
+    { "/sys/devices", 0 }, { "/sys/devices/system", 0 }, { "/sys/devices/system/cpu", 0 },
+    { "/sys/class", ADD_THERMAL }, { "/sys/class/thermal", ADD_THERMAL }, { "/sys/block", ADD_DISKS },
+    { "/sys/block/loop0", ADD_DISKS }, { "/sys/block/mmcblk0", ADD_DISKS }, { "/sys/block/sda", ADD_DISKS },
+    { "/sys/fs", ADD_CGROUPS }, { "/sys/fs/cgroup", ADD_CGROUPS },
+};
+static const char *const fixture_files[] = {
+    "/proc/stat", "/proc/cpuinfo", "/proc/meminfo", "/proc/diskstats", "/proc/net/dev",
+    "/proc/interrupts", "/proc/softirqs",
+    "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
+    "/sys/devices/system/cpu/online", "/sys/devices/system/cpu/possible", "/sys/devices/system/cpu/present",
+    "/sys/fs/cgroup/cgroup.controllers",
+};
+
+// Block devices in /proc/diskstats order; whole disks have a sys/block entry
+static const struct {
+    const char *name;
+    unsigned int major, minor;
+    int parent;          // Whole disk of a partition, -1 for a disk
+    unsigned int iops;   // Requests per tick at full load
+} fixture_disks[FIXTURE_DISKS] = {
+    { "loop0", 7, 0, -1, 0 },        // Never used
+    { "mmcblk0", 179, 0, -1, 0 },    // Sum of its partitions
+    { "mmcblk0p1", 179, 1, 1, 2 },   // Boot partition, almost idle
+    { "mmcblk0p2", 179, 2, 1, 150 }, // Root file system on eMMC: slow
+    { "sda", 8, 0, -1, 0 },
+    { "sda1", 8, 1, 4, 2000 },       // USB SSD
+};
+
+// Network interfaces in /proc/net/dev order
+static const struct {
+    const char *name;
+    unsigned long bytes;  // Received bytes per tick at full load; half as much is sent
+    unsigned long packet; // Average packet size
+    int counter32;        // Driver with 32-bit statistics: written modulo 2^32
+} fixture_ifaces[FIXTURE_IFACES] = {
+    { "lo", 20000, 500, 0 },
+    { "eth0", 12000000, 1200, 1 }, // Gateway uplink near 100 Mbit/s, wraps every few minutes
+    { "wlan0", 800000, 900, 0 },
+    { "usb0", 150000, 600, 0 },    // Cellular modem, hot-pluggable
+};
+
+// Cgroups below sys/fs/cgroup, parents first. Counters are per cgroup and
+// not summed into the parents
+static const struct {
+    const char *name;
+    int parent;                 // Index of the parent, -1 below the root
+    unsigned long load_us;      // CPU time wanted per tick at full load
+    unsigned long quota_us;     // cpu.max quota per tick, 0 for none
+    int cpu;                    // cpu controller enabled: bandwidth fields in cpu.stat
+    int memory;                 // memory controller enabled: memory.* files
+    unsigned long long mem_mb;  // Typical memory.current
+} fixture_cgroups[FIXTURE_CGROUPS] = {
+    { "system.slice", -1, 300000, 0, 1, 1, 900 },
+    { "system.slice/sshd.service", 0, 20000, 0, 0, 1, 12 },
+    { "system.slice/docker-web.scope", 0, 1500000, 1000000, 1, 1, 480 }, // Wants 1.5 CPUs, may use one
+    { "user.slice", -1, 400000, 0, 0, 0, 0 },
+};
+// Rows of proc/interrupts, then of proc/softirqs. A routed source counts on
+// one CPU (modulo the CPU count), the others on every online CPU
+static const struct {
+    const char *label;
+    const char *desc;  // Chip, hardware IRQ and action of a numbered IRQ, or the description
+    const char *name;  // Name a sampler reports
+    unsigned int rate; // Events per tick at full load
+    int cpu;           // CPU the source is routed to, -1 for all
+} fixture_irqs[FIXTURE_IRQS + FIXTURE_SOFTIRQS] = {
+    { "0", "IO-APIC    2-edge      timer", "timer", 4, 0 },
+    { "8", "IO-APIC    8-edge      rtc0", "rtc0", 2, 0 },
+    { "24", "PCI-MSI 524288-edge      eth0-rx-0", "eth0-rx-0", 9000, 1 }, // The uplink: one hot core
+    { "25", "PCI-MSI 524289-edge      eth0-tx-0", "eth0-tx-0", 4000, 2 },
+    { "40", "GICv3  56 Level     mmc0", "mmc0", 300, 0 },
+    { "NMI", "Non-maskable interrupts", "NMI", 2, -1 },
+    { "LOC", "Local timer interrupts", "LOC", 250, -1 },
+    { "RES", "Rescheduling interrupts", "RES", 400, -1 },
+    { "HI", NULL, "HI", 1, -1 },
+    { "TIMER", NULL, "TIMER", 250, -1 },
+    { "NET_TX", NULL, "NET_TX", 500, 2 },
+    { "NET_RX", NULL, "NET_RX", 7000, 1 },
+    { "BLOCK", NULL, "BLOCK", 150, 0 },
+    { "IRQ_POLL", NULL, "IRQ_POLL", 0, -1 },
+    { "TASKLET", NULL, "TASKLET", 20, 0 },
+    { "SCHED", NULL, "SCHED", 300, -1 },
+    { "HRTIMER", NULL, "HRTIMER", 3, -1 },
+    { "RCU", NULL, "RCU", 200, -1 },
+};
+static const char *const cgroup_files[] = { "cpu.stat", "cpu.pressure", "memory.current", "memory.stat", "memory.events" };
+
+// proc/meminfo lines in kernel order; untracked keys are written as constants
+static const struct {
+    const char *key;
+    size_t offset;       // MemInfo member, or NO_FIELD
+    unsigned long value; // Value of an untracked key
+    int pages;           // HugePages_* counts have no unit
+} meminfo_lines[] = {
+    { "MemTotal", offsetof(MemInfo, mem_total), 0, 0 },
+    { "MemFree", offsetof(MemInfo, mem_free), 0, 0 },
+    { "MemAvailable", offsetof(MemInfo, mem_available), 0, 0 },
+    { "Buffers", offsetof(MemInfo, buffers), 0, 0 },
+    { "Cached", offsetof(MemInfo, cached), 0, 0 },
+    { "SwapCached", offsetof(MemInfo, swap_cached), 0, 0 },
+    { "Active", offsetof(MemInfo, active), 0, 0 },
+    { "Inactive", offsetof(MemInfo, inactive), 0, 0 },
+    { "Active(anon)", offsetof(MemInfo, active_anon), 0, 0 },
+    { "Inactive(anon)", offsetof(MemInfo, inactive_anon), 0, 0 },
+    { "Active(file)", offsetof(MemInfo, active_file), 0, 0 },
+    { "Inactive(file)", offsetof(MemInfo, inactive_file), 0, 0 },
+    { "Unevictable", offsetof(MemInfo, unevictable), 0, 0 },
+    { "Mlocked", offsetof(MemInfo, mlocked), 0, 0 },
+    { "SwapTotal", offsetof(MemInfo, swap_total), 0, 0 },
+    { "SwapFree", offsetof(MemInfo, swap_free), 0, 0 },
+    { "Zswap", offsetof(MemInfo, zswap), 0, 0 },
+    { "Zswapped", offsetof(MemInfo, zswapped), 0, 0 },
+    { "Dirty", offsetof(MemInfo, dirty), 0, 0 },
+    { "Writeback", offsetof(MemInfo, writeback), 0, 0 },
+    { "AnonPages", offsetof(MemInfo, anon_pages), 0, 0 },
+    { "Mapped", offsetof(MemInfo, mapped), 0, 0 },
+    { "Shmem", offsetof(MemInfo, shmem), 0, 0 },
+    { "KReclaimable", offsetof(MemInfo, kreclaimable), 0, 0 },
+    { "Slab", offsetof(MemInfo, slab), 0, 0 },
+    { "SReclaimable", offsetof(MemInfo, sreclaimable), 0, 0 },
+    { "SUnreclaim", offsetof(MemInfo, sunreclaim), 0, 0 },
+    { "KernelStack", offsetof(MemInfo, kernel_stack), 0, 0 },
+    { "PageTables", offsetof(MemInfo, page_tables), 0, 0 },
+    { "SecPageTables", NO_FIELD, 0, 0 },
+    { "NFS_Unstable", NO_FIELD, 0, 0 },
+    { "Bounce", NO_FIELD, 0, 0 },
+    { "WritebackTmp", NO_FIELD, 0, 0 },
+    { "CommitLimit", offsetof(MemInfo, commit_limit), 0, 0 },
+    { "Committed_AS", offsetof(MemInfo, committed_as), 0, 0 },
+    { "VmallocTotal", offsetof(MemInfo, vmalloc_total), 0, 0 },
+    { "VmallocUsed", offsetof(MemInfo, vmalloc_used), 0, 0 },
+    { "VmallocChunk", NO_FIELD, 0, 0 },
+    { "Percpu", offsetof(MemInfo, percpu), 0, 0 },
+    { "HardwareCorrupted", NO_FIELD, 0, 0 },
+    { "AnonHugePages", offsetof(MemInfo, anon_huge_pages), 0, 0 },
+    { "ShmemHugePages", offsetof(MemInfo, shmem_huge_pages), 0, 0 },
+    { "ShmemPmdMapped", NO_FIELD, 0, 0 },
+    { "FileHugePages", offsetof(MemInfo, file_huge_pages), 0, 0 },
+    { "FilePmdMapped", NO_FIELD, 0, 0 },
+    { "Unaccepted", NO_FIELD, 0, 0 },
+    { "HugePages_Total", offsetof(MemInfo, hugepages_total), 0, 1 },
+    { "HugePages_Free", offsetof(MemInfo, hugepages_free), 0, 1 },
+    { "HugePages_Rsvd", offsetof(MemInfo, hugepages_rsvd), 0, 1 },
+    { "HugePages_Surp", offsetof(MemInfo, hugepages_surp), 0, 1 },
+    { "Hugepagesize", offsetof(MemInfo, hugepage_size), 0, 0 },
+    { "Hugetlb", offsetof(MemInfo, hugetlb), 0, 0 },
+    { "DirectMap4k", NO_FIELD, 415232, 0 },
+    { "DirectMap2M", NO_FIELD, 9021440, 0 },
+    { "DirectMap1G", NO_FIELD, 7340032, 0 },
+};
+
+// xorshift64*: small, fast and identical on every build
+static uint32_t next_random(ProcFixture *fx) {
+    fx->rng ^= fx->rng >> 12;
+    fx->rng ^= fx->rng << 25;
+    fx->rng ^= fx->rng >> 27;
+    return (uint32_t)((fx->rng * 2685821657736338717ULL) >> 32);
+}
+
+static unsigned long random_below(ProcFixture *fx, unsigned long bound) {
+    return bound ? next_random(fx) % bound : 0;
+}
+
+// Threads i and i + cores are the two siblings of a core
+static int fixture_core(const ProcFixture *fx, int cpu) {
+    return cpu % fx->cores;
+}
+
+// The upper half of the cores forms the second cluster
+int proc_fixture_cluster(const ProcFixture *fx, int cpu) {
+    return fx->clusters > 1 && fixture_core(fx, cpu) >= fx->cores / 2;
+}
+
+// Lowest CPU of a cluster, which owns its cpufreq file
+static int cluster_first_cpu(const ProcFixture *fx, int cluster) {
+    return cluster == 0 ? 0 : fx->cores / 2;
+}
+
+// Create the directories of one subsystem
+static int make_dirs(const ProcFixture *fx, unsigned int part) {
+    char path[PROC_PATH_MAX];
+    for (size_t i = 0; i < sizeof(fixture_dirs) / sizeof(fixture_dirs[0]); i++) {
+        if (fixture_dirs[i].part != part)
+            continue;
+        snprintf(path, sizeof(path), "%s%s", fx->root, fixture_dirs[i].path);
+        if (mkdir(path, 0755) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Write the whole file in place so open descriptors see the new content
+static int write_fixture_file(const ProcFixture *fx, const char *name, const char *data, size_t len) {
+    char path[PROC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", fx->root, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+    ssize_t n = write(fd, data, len);
+    close(fd);
+    return n == (ssize_t)len ? 0 : -1;
+}
+
+// One "cpu" line: the label, then the ten counters
+static char *put_stat_line(char *p, const char *label, const unsigned long *f) {
+    return p + sprintf(p, "%s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu\n", label,
+                       f[CPU_USER], f[CPU_NICE], f[CPU_SYSTEM], f[CPU_IDLE], f[CPU_IOWAIT],
+                       f[CPU_IRQ], f[CPU_SOFTIRQ], f[CPU_STEAL], f[CPU_GUEST], f[CPU_GUEST_NICE]);
+}
+
+static int write_stat(ProcFixture *fx) {
+    unsigned long total[CPU_STAT_FIELDS] = { 0 };
+    for (int i = 0; i < fx->num_cpus; i++)
+        for (int f = 0; f < CPU_STAT_FIELDS; f++)
+            total[f] += fx->cpu[i][f];
+
+    char *p = fx->buf;
+    p = put_stat_line(p, "cpu ", total); // The aggregate label has two spaces
+    for (int i = 0; i < fx->num_cpus; i++) {
+        if (!fx->online[i])
+            continue; // The kernel lists online CPUs only
+        char label[16];
+        snprintf(label, sizeof(label), "cpu%d", i);
+        p = put_stat_line(p, label, fx->cpu[i]);
+    }
+    unsigned long ticks = fx->ticks;
+    p += sprintf(p, "intr %lu 0 9 0 0 0 0 0 0 0 1 0 0 156 0 0 0\n", 1200000 + ticks * 4000UL * fx->num_cpus);
+    p += sprintf(p, "ctxt %lu\nbtime 1700000000\nprocesses %lu\n", 5000000 + ticks * 9000UL * fx->num_cpus,
+                 40000 + ticks * 3);
+    p += sprintf(p, "procs_running %lu\nprocs_blocked 0\n", 1 + ticks % 4);
+    p += sprintf(p, "softirq %lu 0 %lu 1 %lu 0 0 %lu %lu 0 %lu\n", 900000 + ticks * 2500UL,
+                 300000 + ticks * 700UL, 20000 + ticks * 40UL, 1000 + ticks, 200000 + ticks * 900UL,
+                 350000 + ticks * 800UL);
+    fx->stat_bytes = (size_t)(p - fx->buf);
+    return write_fixture_file(fx, "/proc/stat", fx->buf, fx->stat_bytes);
+}
+
+static int write_meminfo(ProcFixture *fx) {
+    char *p = fx->buf;
+    for (size_t i = 0; i < sizeof(meminfo_lines) / sizeof(meminfo_lines[0]); i++) {
+        unsigned long v = meminfo_lines[i].value;
+        if (meminfo_lines[i].offset != NO_FIELD)
+            v = *(const unsigned long *)((const char *)&fx->mem + meminfo_lines[i].offset);
+        // "Key:" is padded to 16 columns and the value to 8, as the kernel does
+        int key_len = sprintf(p, "%s:", meminfo_lines[i].key);
+        p += key_len;
+        p += sprintf(p, "%*lu%s\n", key_len < 16 ? 24 - key_len : 8, v, meminfo_lines[i].pages ? "" : " kB");
+    }
+    return write_fixture_file(fx, "/proc/meminfo", fx->buf, (size_t)(p - fx->buf));
+}
+
+// One line per present device: major, minor, name, the 11 classic fields,
+// then discard and flush fields as kernels from 5.5 on write them
+static int write_diskstats(ProcFixture *fx) {
+    char *p = fx->buf;
+    for (int i = 0; i < FIXTURE_DISKS; i++) {
+        if (!fx->disk_present[i])
+            continue;
+        const DiskStats *d = &fx->disk[i];
+        p += sprintf(p, "%4u %7u %s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu 0 0 0 0 0 0\n",
+                     fixture_disks[i].major, fixture_disks[i].minor, fixture_disks[i].name,
+                     d->reads, d->read_merges, d->read_sectors, d->read_ms, d->writes, d->write_merges,
+                     d->write_sectors, d->write_ms, d->in_flight, d->io_ms, d->weighted_ms);
+    }
+    return write_fixture_file(fx, "/proc/diskstats", fx->buf, (size_t)(p - fx->buf));
+}
+
+// Two header lines, then one line per present interface as the kernel writes it
+static int write_net_dev(ProcFixture *fx) {
+    char *p = fx->buf;
+    p += sprintf(p, "Inter-|   Receive                                                |  Transmit\n"
+                    " face |bytes    packets errs drop fifo frame compressed multicast|"
+                    "bytes    packets errs drop fifo colls carrier compressed\n");
+    for (int i = 0; i < FIXTURE_IFACES; i++) {
+        if (!fx->iface_present[i])
+            continue;
+        NetStats n = fx->net[i];
+        if (fixture_ifaces[i].counter32) {
+            n.rx_bytes &= 0xFFFFFFFFULL;
+            n.tx_bytes &= 0xFFFFFFFFULL;
+            n.rx_packets &= 0xFFFFFFFFULL;
+            n.tx_packets &= 0xFFFFFFFFULL;
+        }
+        p += sprintf(p, "%6s:%8llu %7llu %4llu %4llu %4u %5u %10u %9u %8llu %7llu %4llu %4llu %4u %5u %7u %10u\n",
+                     fixture_ifaces[i].name, n.rx_bytes, n.rx_packets, n.rx_errors, n.rx_drops, 0, 0, 0, 0,
+                     n.tx_bytes, n.tx_packets, n.tx_errors, n.tx_drops, 0, 0, 0, 0);
+    }
+    return write_fixture_file(fx, "/proc/net/dev", fx->buf, (size_t)(p - fx->buf));
+}
+
+// "some" and "full" lines of each pressure file, averages with two decimals
+static int write_pressure(ProcFixture *fx) {
+    static const char *const files[PSI_RESOURCES] = { "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io" };
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        char *p = fx->buf;
+        for (int full = 0; full < 2; full++) {
+            const PSILine *l = full ? &fx->psi_full[r] : &fx->psi_some[r];
+            p += sprintf(p, "%s avg10=%.2f avg60=%.2f avg300=%.2f total=%llu\n", full ? "full" : "some", l->avg10,
+                         l->avg60, l->avg300, l->total_us);
+        }
+        if (write_fixture_file(fx, files[r], fx->buf, (size_t)(p - fx->buf)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// proc/interrupts has a column per online CPU and ends with the ERR and MIS
+// totals; proc/softirqs has one per possible CPU. Counters are 32-bit
+static int write_interrupts(ProcFixture *fx) {
+    char *p = fx->buf + sprintf(fx->buf, "     ");
+    for (int cpu = 0; cpu < fx->num_cpus; cpu++)
+        if (fx->online[cpu])
+            p += sprintf(p, "CPU%-8d", cpu);
+    *p++ = '\n';
+    for (int r = 0; r < FIXTURE_IRQS; r++) {
+        p += sprintf(p, "%3s:", fixture_irqs[r].label);
+        for (int cpu = 0; cpu < fx->num_cpus; cpu++)
+            if (fx->online[cpu])
+                p += sprintf(p, " %10u", fx->irq_count[(size_t)r * fx->num_cpus + cpu]);
+        p += sprintf(p, "   %s\n", fixture_irqs[r].desc);
+    }
+    p += sprintf(p, "ERR: %10u\nMIS: %10u\n", 0, 0);
+    if (write_fixture_file(fx, "/proc/interrupts", fx->buf, (size_t)(p - fx->buf)) < 0)
+        return -1;
+
+    p = fx->buf + sprintf(fx->buf, "                    ");
+    for (int cpu = 0; cpu < fx->num_cpus; cpu++)
+        p += sprintf(p, "CPU%-8d", cpu);
+    *p++ = '\n';
+    for (int r = FIXTURE_IRQS; r < FIXTURE_IRQS + FIXTURE_SOFTIRQS; r++) {
+        p += sprintf(p, "%12s:", fixture_irqs[r].label);
+        for (int cpu = 0; cpu < fx->num_cpus; cpu++)
+            p += sprintf(p, " %10u", fx->irq_count[(size_t)r * fx->num_cpus + cpu]);
+        *p++ = '\n';
+    }
+    return write_fixture_file(fx, "/proc/softirqs", fx->buf, (size_t)(p - fx->buf));
+}
+
+// The files of a cgroup as the kernel writes them; memory.* only with the
+// memory controller
+static int write_cgroup(ProcFixture *fx, int i) {
+    const CgroupStats *c = &fx->cgroup[i];
+    char name[PROC_PATH_MAX / 2];
+    char *p = fx->buf;
+    p += sprintf(p, "usage_usec %llu\nuser_usec %llu\nsystem_usec %llu\n", c->usage_usec, c->user_usec,
+                 c->system_usec);
+    if (fixture_cgroups[i].cpu)
+        p += sprintf(p, "nr_periods %llu\nnr_throttled %llu\nthrottled_usec %llu\nnr_bursts 0\nburst_usec 0\n",
+                     c->nr_periods, c->nr_throttled, c->throttled_usec);
+    snprintf(name, sizeof(name), CGROUP_DIR "/%s/cpu.stat", fixture_cgroups[i].name);
+    if (write_fixture_file(fx, name, fx->buf, (size_t)(p - fx->buf)) < 0)
+        return -1;
+
+    p = fx->buf;
+    p += sprintf(p, "some avg10=0.00 avg60=0.00 avg300=0.00 total=%llu\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=%llu\n",
+                 c->some_usec, c->some_usec / 2);
+    snprintf(name, sizeof(name), CGROUP_DIR "/%s/cpu.pressure", fixture_cgroups[i].name);
+    if (write_fixture_file(fx, name, fx->buf, (size_t)(p - fx->buf)) < 0)
+        return -1;
+    if (!fixture_cgroups[i].memory)
+        return 0;
+
+    p = fx->buf;
+    p += sprintf(p, "%llu\n", c->memory_current);
+    snprintf(name, sizeof(name), CGROUP_DIR "/%s/memory.current", fixture_cgroups[i].name);
+    if (write_fixture_file(fx, name, fx->buf, (size_t)(p - fx->buf)) < 0)
+        return -1;
+    p = fx->buf;
+    p += sprintf(p, "anon %llu\nfile %llu\nkernel 1048576\nkernel_stack 65536\npagetables 131072\n"
+                    "sock 0\nshmem 0\nfile_mapped %llu\nfile_dirty 0\nanon_thp 0\n",
+                 c->anon, c->file, c->file / 4);
+    snprintf(name, sizeof(name), CGROUP_DIR "/%s/memory.stat", fixture_cgroups[i].name);
+    if (write_fixture_file(fx, name, fx->buf, (size_t)(p - fx->buf)) < 0)
+        return -1;
+    p = fx->buf;
+    p += sprintf(p, "low 0\nhigh %llu\nmax %llu\noom 0\noom_kill %llu\noom_group_kill 0\n", c->high_events,
+                 c->max_events, c->oom_kills);
+    snprintf(name, sizeof(name), CGROUP_DIR "/%s/memory.events", fixture_cgroups[i].name);
+    return write_fixture_file(fx, name, fx->buf, (size_t)(p - fx->buf));
+}
+
+static int write_cgroups(ProcFixture *fx) {
+    for (int i = 0; i < FIXTURE_CGROUPS; i++)
+        if (fx->cgroup_present[i] && write_cgroup(fx, i) < 0)
+            return -1;
+    return 0;
+}
+
+// Two threads per core, one package
+static int write_cpuinfo(ProcFixture *fx) {
+    int cores = fx->cores;
+    char *p = fx->buf;
+    for (int i = 0; i < fx->num_cpus; i++) {
+        p += sprintf(p,
+                     "processor\t: %d\nvendor_id\t: GenuineIntel\ncpu family\t: 6\nmodel\t\t: 143\n"
+                     "model name\t: %s\nstepping\t: 8\nmicrocode\t: 0x2b000590\n"
+                     "cpu MHz\t\t: %d.%03d\ncache size\t: 107520 KB\nphysical id\t: 0\n"
+                     "siblings\t: %d\ncore id\t\t: %d\ncpu cores\t: %d\napicid\t\t: %d\n"
+                     "initial apicid\t: %d\nfpu\t\t: yes\nfpu_exception\t: yes\ncpuid level\t: 32\nwp\t\t: yes\n"
+                     "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 "
+                     "clflush dts acpi mmx fxsr sse sse2 ss ht tm pbe syscall nx pdpe1gb rdtscp lm "
+                     "constant_tsc art arch_perfmon pebs bts rep_good nopl xtopology nonstop_tsc cpuid "
+                     "aperfmperf tsc_known_freq pni pclmulqdq dtes64 monitor ds_cpl vmx smx est tm2 ssse3 "
+                     "sdbg fma cx16 xtpr pdcm pcid dca sse4_1 sse4_2 x2apic movbe popcnt "
+                     "tsc_deadline_timer aes xsave avx f16c rdrand lahf_lm abm 3dnowprefetch cpuid_fault "
+                     "epb cat_l3 cat_l2 cdp_l3 invpcid_single intel_ppin cdp_l2 ssbd mba ibrs ibpb stibp "
+                     "ibrs_enhanced tpr_shadow flexpriority ept vpid ept_ad fsgsbase tsc_adjust bmi1 avx2 "
+                     "smep bmi2 erms invpcid cqm rdt_a avx512f avx512dq rdseed adx smap avx512ifma "
+                     "clflushopt clwb intel_pt avx512cd sha_ni avx512bw avx512vl xsaveopt xsavec xgetbv1 "
+                     "xsaves cqm_llc cqm_occup_llc cqm_mbm_total cqm_mbm_local split_lock_detect avx_vnni "
+                     "avx512_bf16 wbnoinvd dtherm ida arat pln pts hfi vnmi avx512vbmi umip pku ospke "
+                     "waitpkg avx512_vbmi2 gfni vaes vpclmulqdq avx512_vnni avx512_bitalg tme "
+                     "avx512_vpopcntdq la57 rdpid bus_lock_detect cldemote movdiri movdir64b enqcmd "
+                     "fsrm md_clear serialize tsxldtrk pconfig arch_lbr ibt amx_bf16 avx512_fp16 amx_tile "
+                     "amx_int8 flush_l1d arch_capabilities\n"
+                     "bugs\t\t: spectre_v1 spectre_v2 spec_store_bypass swapgs eibrs_pbrsb\n"
+                     "bogomips\t: 4800.00\nclflush size\t: 64\ncache_alignment\t: 64\n"
+                     "address sizes\t: 46 bits physical, 57 bits virtual\npower management:\n\n",
+                     i, FIXTURE_MODEL_NAME, 800 + (int)random_below(fx, 3000), (int)random_below(fx, 1000),
+                     fx->num_cpus, i % cores, cores, i * 2, i * 2);
+    }
+    fx->cpuinfo_bytes = (size_t)(p - fx->buf);
+    return write_fixture_file(fx, "/proc/cpuinfo", fx->buf, fx->cpuinfo_bytes);
+}
+
+// Every CPU of the fixture is possible and present, whether online or not
+static int write_possible(ProcFixture *fx) {
+    int len = sprintf(fx->buf, "0-%d\n", fx->num_cpus - 1);
+    if (fx->num_cpus == 1)
+        len = sprintf(fx->buf, "0\n");
+    if (write_fixture_file(fx, CPU_DIR "/possible", fx->buf, (size_t)len) < 0)
+        return -1;
+    return write_fixture_file(fx, CPU_DIR "/present", fx->buf, (size_t)len);
+}
+
+// The online mask as ranges, e.g. "0-3,5,7-11"
+static int write_online(ProcFixture *fx) {
+    char *p = fx->buf;
+    for (int i = 0; i < fx->num_cpus; i++) {
+        if (!fx->online[i])
+            continue;
+        int last = i;
+        while (last + 1 < fx->num_cpus && fx->online[last + 1])
+            last++;
+        if (p != fx->buf)
+            *p++ = ',';
+        p += last > i ? sprintf(p, "%d-%d", i, last) : sprintf(p, "%d", i);
+        i = last;
+    }
+    *p++ = '\n';
+    return write_fixture_file(fx, CPU_DIR "/online", fx->buf, (size_t)(p - fx->buf));
+}
+
+// One scaling_cur_freq per cluster; the other CPUs of the cluster link to it
+static int write_freq(ProcFixture *fx) {
+    for (int c = 0; c < fx->clusters; c++) {
+        char name[96], value[16];
+        snprintf(name, sizeof(name), CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", cluster_first_cpu(fx, c));
+        int len = snprintf(value, sizeof(value), "%u\n", fx->freq_khz[c]);
+        if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// The little cluster runs around 1.8 GHz and the big one around 2.4 GHz
+static void advance_freq(ProcFixture *fx) {
+    for (int c = 0; c < fx->clusters; c++)
+        fx->freq_khz[c] = (unsigned int)((c ? 2400000L : 1800000L) + ((long)random_below(fx, 401) - 200) * 1000);
+}
+
+// Trip points of every zone: a fan, the passive (throttling) trip and shutdown
+static const struct {
+    const char *type;
+    long temp_mc;
+} zone_trips[] = {
+    { "active", FIXTURE_FAN_MC }, { "passive", FIXTURE_TRIP_MC }, { "critical", FIXTURE_CRITICAL_MC },
+};
+static const char *const zone_files[] = {
+    "type", "temp", "trip_point_0_type", "trip_point_0_temp", "trip_point_1_type", "trip_point_1_temp",
+    "trip_point_2_type", "trip_point_2_temp",
+};
+
+static int write_zone_temp(ProcFixture *fx, int zone) {
+    char name[96], value[24];
+    snprintf(name, sizeof(name), THERMAL_DIR "/thermal_zone%d/temp", zone);
+    int len = snprintf(value, sizeof(value), "%ld\n", fx->temp_mc[zone]);
+    return write_fixture_file(fx, name, value, (size_t)len);
+}
+
+// Both counters of one CPU; siblings show the same core count, as in sysfs
+static int write_throttles(ProcFixture *fx, int cpu) {
+    char name[96], value[24];
+    snprintf(name, sizeof(name), CPU_DIR "/cpu%d/thermal_throttle/core_throttle_count", cpu);
+    int len = snprintf(value, sizeof(value), "%lu\n", fx->core_throttles[fixture_core(fx, cpu)]);
+    if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+        return -1;
+    snprintf(name, sizeof(name), CPU_DIR "/cpu%d/thermal_throttle/package_throttle_count", cpu);
+    len = snprintf(value, sizeof(value), "%lu\n", fx->package_throttles);
+    return write_fixture_file(fx, name, value, (size_t)len);
+}
+
+// thermal_zoneN for each cluster, with its type and trip points
+static int write_zones(ProcFixture *fx) {
+    char path[PROC_PATH_MAX], name[96], value[24];
+    for (int z = 0; z < fx->clusters; z++) {
+        snprintf(path, sizeof(path), "%s" THERMAL_DIR "/thermal_zone%d", fx->root, z);
+        if (mkdir(path, 0755) < 0)
+            return -1;
+        snprintf(name, sizeof(name), THERMAL_DIR "/thermal_zone%d/type", z);
+        int len = snprintf(value, sizeof(value), "cluster%d-thermal\n", z);
+        if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+            return -1;
+        for (size_t k = 0; k < sizeof(zone_trips) / sizeof(zone_trips[0]); k++) {
+            snprintf(name, sizeof(name), THERMAL_DIR "/thermal_zone%d/trip_point_%zu_type", z, k);
+            len = snprintf(value, sizeof(value), "%s\n", zone_trips[k].type);
+            if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+                return -1;
+            snprintf(name, sizeof(name), THERMAL_DIR "/thermal_zone%d/trip_point_%zu_temp", z, k);
+            len = snprintf(value, sizeof(value), "%ld\n", zone_trips[k].temp_mc);
+            if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+                return -1;
+        }
+        if (write_zone_temp(fx, z) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Zones drift between 50 and 65 C, the second cluster running warmer; held zones stay put
+static void advance_temps(ProcFixture *fx) {
+    for (int z = 0; z < fx->clusters; z++)
+        if (!fx->held[z])
+            fx->temp_mc[z] = 50000 + z * 5000 + (long)random_below(fx, 10001);
+}
+
+// cpuN with its topology ids, cpufreq file and NUMA node entry
+static int write_cpu_dirs(ProcFixture *fx) {
+    static const char *const id_files[] = { "physical_package_id", "core_id", "cluster_id" };
+    char path[PROC_PATH_MAX], target[PROC_PATH_MAX], name[96], value[16];
+    for (int i = 0; i < fx->num_cpus; i++) {
+        int cluster = proc_fixture_cluster(fx, i);
+        const char *const subdirs[] = { "", "/topology", "/cpufreq", cluster ? "/node1" : "/node0" };
+        for (size_t d = 0; d < sizeof(subdirs) / sizeof(subdirs[0]); d++) {
+            snprintf(path, sizeof(path), "%s" CPU_DIR "/cpu%d%s", fx->root, i, subdirs[d]);
+            if (mkdir(path, 0755) < 0)
+                return -1;
+        }
+        int ids[] = { 0, fixture_core(fx, i), cluster };
+        for (size_t f = 0; f < sizeof(id_files) / sizeof(id_files[0]); f++) {
+            snprintf(name, sizeof(name), CPU_DIR "/cpu%d/topology/%s", i, id_files[f]);
+            int len = snprintf(value, sizeof(value), "%d\n", ids[f]);
+            if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+                return -1;
+        }
+        // The first CPU of a cluster comes first, so its file exists for the links
+        int first = cluster_first_cpu(fx, cluster);
+        if (i == first) {
+            snprintf(name, sizeof(name), CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", i);
+            int len = snprintf(value, sizeof(value), "%u\n", fx->freq_khz[cluster]);
+            if (write_fixture_file(fx, name, value, (size_t)len) < 0)
+                return -1;
+            continue;
+        }
+        snprintf(target, sizeof(target), "%s" CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", fx->root, first);
+        snprintf(path, sizeof(path), "%s" CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", fx->root, i);
+        if (link(target, path) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// A 16 GB machine with a warm page cache
+static void init_memory(ProcFixture *fx) {
+    MemInfo *m = &fx->mem;
+    m->mem_total = 16318264;
+    m->mem_free = 3145728;
+    m->buffers = 524288;
+    m->cached = 6291456;
+    m->swap_cached = 1024;
+    m->active_anon = 4194304;
+    m->inactive_anon = 262144;
+    m->active_file = 3145728;
+    m->inactive_file = 3670016;
+    m->active = m->active_anon + m->active_file;
+    m->inactive = m->inactive_anon + m->inactive_file;
+    m->unevictable = 32768;
+    m->mlocked = 32768;
+    m->swap_total = 8388604;
+    m->swap_free = 8126460;
+    m->dirty = 2048;
+    m->anon_pages = 4325376;
+    m->mapped = 1048576;
+    m->shmem = 262144;
+    m->kreclaimable = 786432;
+    m->slab = 1048576;
+    m->sreclaimable = 786432;
+    m->sunreclaim = 262144;
+    m->kernel_stack = 16384 + (unsigned long)fx->num_cpus * 16;
+    m->page_tables = 65536;
+    m->commit_limit = m->mem_total / 2 + m->swap_total;
+    m->committed_as = 12582912;
+    m->vmalloc_total = 34359738367UL;
+    m->vmalloc_used = 131072;
+    m->percpu = 4096 + (unsigned long)fx->num_cpus * 64;
+    m->anon_huge_pages = 1048576;
+    m->hugepage_size = 2048;
+    m->mem_available = m->mem_free + m->cached + m->sreclaimable - m->shmem;
+}
+
+// Memory drifts by a few pages per tick; the page cache grows slowly
+static void advance_memory(ProcFixture *fx) {
+    MemInfo *m = &fx->mem;
+    long step = (long)random_below(fx, 8192) - 4096;
+    if ((long)m->mem_free + step < 65536)
+        step = 4096;
+    m->mem_free += step;
+    m->anon_pages -= step / 2;
+    m->active_anon -= step / 2;
+    if (random_below(fx, 4) == 0) {
+        m->cached += 64;
+        m->inactive_file += 64;
+        m->mem_free -= 64;
+    }
+    m->dirty = random_below(fx, 65536);
+    m->writeback = random_below(fx, 8) == 0 ? random_below(fx, 4096) : 0;
+    m->committed_as += random_below(fx, 2048);
+    m->active = m->active_anon + m->active_file;
+    m->inactive = m->inactive_anon + m->inactive_file;
+    m->mem_available = m->mem_free + m->cached + m->sreclaimable - m->shmem;
+}
+
+static void add_disk_delta(DiskStats *t, const DiskStats *delta) {
+    t->reads += delta->reads;
+    t->read_merges += delta->read_merges;
+    t->read_sectors += delta->read_sectors;
+    t->read_ms += delta->read_ms;
+    t->writes += delta->writes;
+    t->write_merges += delta->write_merges;
+    t->write_sectors += delta->write_sectors;
+    t->write_ms += delta->write_ms;
+    t->weighted_ms += delta->weighted_ms;
+}
+
+// Partitions do random reads and writes; a disk is the sum of its partitions
+// and is busy while any of them is, at most the whole tick
+static void advance_disks(ProcFixture *fx) {
+    unsigned long disk_busy[FIXTURE_DISKS] = { 0 };
+    for (int i = 0; i < FIXTURE_DISKS; i++)
+        if (fixture_disks[i].parent < 0)
+            fx->disk[i].in_flight = 0;
+    for (int i = 0; i < FIXTURE_DISKS; i++) {
+        unsigned int iops = fixture_disks[i].iops;
+        if (iops == 0)
+            continue;
+        int parent = fixture_disks[i].parent;
+        unsigned long reads = random_below(fx, iops), writes = random_below(fx, iops / 2 + 1);
+        // Slower devices take longer per request
+        unsigned long read_ms = reads * (500 / iops + 1), write_ms = writes * (2000 / iops + 1);
+        unsigned long busy = read_ms + write_ms > 1000 ? 1000 : read_ms + write_ms;
+        DiskStats delta = {
+            .reads = reads, .read_merges = reads / 8, .read_sectors = reads * 8, .read_ms = read_ms,
+            .writes = writes, .write_merges = writes / 4, .write_sectors = writes * 16, .write_ms = write_ms,
+            .weighted_ms = read_ms + write_ms,
+        };
+        add_disk_delta(&fx->disk[i], &delta);
+        add_disk_delta(&fx->disk[parent], &delta);
+        fx->disk[i].io_ms += busy;
+        fx->disk[i].in_flight = random_below(fx, 4);
+        fx->disk[parent].in_flight += fx->disk[i].in_flight;
+        disk_busy[parent] += busy;
+    }
+    for (int i = 0; i < FIXTURE_DISKS; i++)
+        fx->disk[i].io_ms += disk_busy[i] > 1000 ? 1000 : disk_busy[i];
+}
+
+// Every interface moves a random share of its full load; wlan0 sees some
+// errors and a busy uplink drops a few packets
+static void advance_net(ProcFixture *fx) {
+    for (int i = 0; i < FIXTURE_IFACES; i++) {
+        NetStats *n = &fx->net[i];
+        unsigned long rx = random_below(fx, fixture_ifaces[i].bytes), tx = random_below(fx, fixture_ifaces[i].bytes / 2);
+        n->rx_bytes += rx;
+        n->tx_bytes += tx;
+        n->rx_packets += rx / fixture_ifaces[i].packet;
+        n->tx_packets += tx / fixture_ifaces[i].packet;
+        if (rx > fixture_ifaces[i].bytes * 9 / 10)
+            n->rx_drops += random_below(fx, 50);
+        if (strcmp(fixture_ifaces[i].name, "wlan0") == 0) {
+            n->rx_errors += random_below(fx, 3);
+            n->tx_errors += random_below(fx, 2);
+        }
+    }
+}
+
+// Every source raises a random share of its full rate on its CPUs; an
+// offline CPU takes none
+static void advance_irqs(ProcFixture *fx) {
+    for (int r = 0; r < FIXTURE_IRQS + FIXTURE_SOFTIRQS; r++) {
+        int routed = fixture_irqs[r].cpu < 0 ? -1 : fixture_irqs[r].cpu % fx->num_cpus;
+        for (int cpu = 0; cpu < fx->num_cpus; cpu++) {
+            size_t i = (size_t)r * fx->num_cpus + cpu;
+            unsigned int delta = 0;
+            if (fx->online[cpu] && (routed < 0 || routed == cpu))
+                delta = (unsigned int)random_below(fx, fixture_irqs[r].rate + 1);
+            fx->irq_delta[i] = delta;
+            fx->irq_count[i] += delta;
+        }
+    }
+}
+
+// Every cgroup runs a random share of its load, cut to its quota: the
+// periods in which the quota ran out are throttled
+static void advance_cgroups(ProcFixture *fx) {
+    for (int i = 0; i < FIXTURE_CGROUPS; i++) {
+        CgroupStats *c = &fx->cgroup[i];
+        unsigned long long want = random_below(fx, fixture_cgroups[i].load_us);
+        unsigned long long used = want;
+        if (fixture_cgroups[i].quota_us > 0 && want > fixture_cgroups[i].quota_us) {
+            used = fixture_cgroups[i].quota_us;
+            // The quota runs out in the throttled share of the periods
+            unsigned long long periods = 1000000 / CGROUP_PERIOD_US;
+            c->nr_throttled += (want - used) * periods / want + 1;
+            c->throttled_usec += want - used;
+        }
+        if (fixture_cgroups[i].cpu)
+            c->nr_periods += fixture_cgroups[i].quota_us > 0 ? 1000000 / CGROUP_PERIOD_US : 0;
+        c->usage_usec += used;
+        c->user_usec += used * 7 / 10;
+        c->system_usec += used - used * 7 / 10;
+        c->some_usec += (want - used) + random_below(fx, 20000);
+        if (fixture_cgroups[i].memory) {
+            unsigned long long base = fixture_cgroups[i].mem_mb << 20;
+            c->memory_current = base - base / 8 + random_below(fx, (unsigned long)(base / 4));
+            c->anon = c->memory_current * 3 / 5;
+            c->file = c->memory_current - c->anon;
+            if (fixture_cgroups[i].quota_us > 0)
+                c->high_events += random_below(fx, 4);
+        }
+    }
+}
+
+// Exponential average over a window of the given ticks, rounded as the kernel prints it
+static double psi_average(double avg, double pct, double ticks) {
+    avg += (pct - avg) / ticks;
+    return (double)(long)(avg * 100.0 + 0.5) / 100.0;
+}
+
+// Each tick stalls some tasks for a random share of the second; "full" is a
+// part of it, never for the CPU
+static void advance_pressure(ProcFixture *fx) {
+    static const unsigned long max_stall_us[PSI_RESOURCES] = { 300000, 50000, 200000 };
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        unsigned long some = random_below(fx, max_stall_us[r]);
+        unsigned long full = r == PSI_CPU ? 0 : some / 2;
+        PSILine *lines[2] = { &fx->psi_some[r], &fx->psi_full[r] };
+        unsigned long stall[2] = { some, full };
+        for (int k = 0; k < 2; k++) {
+            double pct = stall[k] / 1e4;
+            lines[k]->total_us += stall[k];
+            lines[k]->avg10 = psi_average(lines[k]->avg10, pct, 10);
+            lines[k]->avg60 = psi_average(lines[k]->avg60, pct, 60);
+            lines[k]->avg300 = psi_average(lines[k]->avg300, pct, 300);
+        }
+    }
+}
+
+// Each online CPU accounts FIXTURE_TICK_JIFFIES per tick around its own load level
+static void advance_cpus(ProcFixture *fx) {
+    unsigned long busy_sum = 0;
+    int online = 0;
+    for (int i = 0; i < fx->num_cpus; i++) {
+        unsigned long *f = fx->cpu[i];
+        if (!fx->online[i]) {
+            fx->busy[i] = 0;
+            fx->expected_usage[i + 1] = 0.0;
+            continue;
+        }
+        online++;
+        // Load level per CPU: some idle, some busy, jittered every tick
+        long level = (long)(i * 37 % 100) + (long)random_below(fx, 21) - 10;
+        unsigned long busy = level < 0 ? 0 : level > FIXTURE_TICK_JIFFIES ? FIXTURE_TICK_JIFFIES : (unsigned long)level;
+        unsigned long user = busy * 7 / 10;
+        unsigned long system = busy - user;
+        unsigned long softirq = system > 2 ? random_below(fx, 3) : 0;
+        unsigned long irq = system - softirq > 1 ? random_below(fx, 2) : 0;
+        unsigned long nice = user > 4 && random_below(fx, 8) == 0 ? 2 : 0;
+        f[CPU_USER] += user - nice;
+        f[CPU_NICE] += nice;
+        f[CPU_SYSTEM] += system - softirq - irq;
+        f[CPU_SOFTIRQ] += softirq;
+        f[CPU_IRQ] += irq;
+        unsigned long iowait = busy < FIXTURE_TICK_JIFFIES && random_below(fx, 5) == 0 ? 1 : 0;
+        f[CPU_IOWAIT] += iowait;
+        f[CPU_IDLE] += FIXTURE_TICK_JIFFIES - busy - iowait;
+        fx->busy[i] = busy;
+        fx->expected_usage[i + 1] = (double)busy * 100.0 / FIXTURE_TICK_JIFFIES;
+        busy_sum += busy;
+    }
+    fx->expected_usage[0] = online ? (double)busy_sum * 100.0 / ((double)FIXTURE_TICK_JIFFIES * online) : 0.0;
+}
+
+int create_proc_fixture(ProcFixture *fx, int num_cpus, unsigned int seed) {
+    memset(fx, 0, sizeof(*fx));
+    strcpy(fx->root, "/tmp/proc_fixtureXXXXXX");
+    if (mkdtemp(fx->root) == NULL)
+        return -1;
+    fx->num_cpus = num_cpus;
+    fx->cores = num_cpus > 1 ? num_cpus / 2 : 1;
+    fx->clusters = fx->cores >= 2 ? 2 : 1;
+    fx->rng = 0x9E3779B97F4A7C15ULL ^ seed;
+    fx->online = malloc((size_t)num_cpus);
+    fx->cpu = calloc((size_t)num_cpus, sizeof(*fx->cpu));
+    fx->busy = calloc((size_t)num_cpus, sizeof(*fx->busy));
+    fx->expected_usage = calloc((size_t)num_cpus + 1, sizeof(*fx->expected_usage));
+    fx->core_throttles = calloc((size_t)fx->cores, sizeof(*fx->core_throttles));
+    fx->irq_count = calloc((size_t)(FIXTURE_IRQS + FIXTURE_SOFTIRQS) * num_cpus, sizeof(*fx->irq_count));
+    fx->irq_delta = calloc((size_t)(FIXTURE_IRQS + FIXTURE_SOFTIRQS) * num_cpus, sizeof(*fx->irq_delta));
+    // proc/cpuinfo is the largest file; the stat lines are far shorter
+    fx->cap = (size_t)num_cpus * CPUINFO_ENTRY_LEN + STAT_TAIL_LEN + MEMINFO_BUF_LEN;
+    fx->buf = malloc(fx->cap);
+    if (fx->online == NULL || fx->cpu == NULL || fx->busy == NULL || fx->expected_usage == NULL ||
+        fx->core_throttles == NULL || fx->irq_count == NULL || fx->irq_delta == NULL || fx->buf == NULL)
+        goto fail;
+    memset(fx->online, 1, (size_t)num_cpus);
+
+    if (make_dirs(fx, 0) < 0)
+        goto fail;
+
+    // Counters start where a machine up for about a day would be
+    for (int i = 0; i < num_cpus; i++) {
+        unsigned long *f = fx->cpu[i];
+        f[CPU_USER] = 2000000 + random_below(fx, 500000);
+        f[CPU_NICE] = random_below(fx, 10000);
+        f[CPU_SYSTEM] = 600000 + random_below(fx, 200000);
+        f[CPU_IDLE] = 6000000 + random_below(fx, 1000000);
+        f[CPU_IOWAIT] = random_below(fx, 50000);
+        f[CPU_IRQ] = random_below(fx, 20000);
+        f[CPU_SOFTIRQ] = random_below(fx, 40000);
+    }
+    init_memory(fx);
+    for (int i = 0; i < FIXTURE_DISKS; i++) {
+        fx->disk_name[i] = fixture_disks[i].name;
+        fx->disk_present[i] = 1;
+    }
+    for (int i = 0; i < FIXTURE_IFACES; i++) {
+        fx->iface_name[i] = fixture_ifaces[i].name;
+        fx->iface_present[i] = 1;
+        fx->net[i].rx_bytes = 1000000000ULL + random_below(fx, 1000000000UL);
+        fx->net[i].tx_bytes = fx->net[i].rx_bytes / 3;
+    }
+    fx->net[1].rx_bytes = 0xFFFFFFFFULL - 30000000; // eth0 wraps within the first ticks
+    for (int i = 0; i < FIXTURE_CGROUPS; i++) {
+        fx->cgroup_name[i] = fixture_cgroups[i].name;
+        fx->cgroup_present[i] = 1;
+        fx->cgroup[i].usage_usec = 3600000000ULL + random_below(fx, 1000000000UL);
+    }
+    fx->cgroup[2].oom_kills = 1; // The container was OOM-killed once before
+    for (int r = 0; r < FIXTURE_IRQS + FIXTURE_SOFTIRQS; r++) {
+        fx->irq_name[r] = fixture_irqs[r].name;
+        for (int cpu = 0; cpu < num_cpus; cpu++)
+            fx->irq_count[(size_t)r * num_cpus + cpu] = (unsigned int)random_below(fx, 100000000UL);
+    }
+    fx->irq_count[(size_t)2 * num_cpus + 1 % num_cpus] = 0xFFFFFFFFU - 20000; // eth0-rx-0 wraps within the first ticks
+    // Every subsystem runs whether its files are added or not, so a seed
+    // gives the same counters whichever a test adds
+    advance_disks(fx);
+    advance_net(fx);
+    advance_pressure(fx);
+    advance_cgroups(fx);
+    advance_irqs(fx);
+    advance_freq(fx);
+    advance_temps(fx);
+
+    if (write_possible(fx) < 0 || write_online(fx) < 0 || write_cpu_dirs(fx) < 0 || write_cpuinfo(fx) < 0 ||
+        write_stat(fx) < 0 || write_meminfo(fx) < 0)
+        goto fail;
+    return 0;
+
+fail:
+    destroy_proc_fixture(fx);
+    return -1;
+}
+
+int add_proc_fixture_disks(ProcFixture *fx) {
+    if (make_dirs(fx, ADD_DISKS) < 0 || write_diskstats(fx) < 0)
+        return -1;
+    fx->added |= ADD_DISKS;
+    return 0;
+}
+
+int add_proc_fixture_net(ProcFixture *fx) {
+    if (make_dirs(fx, ADD_NET) < 0 || write_net_dev(fx) < 0)
+        return -1;
+    fx->added |= ADD_NET;
+    return 0;
+}
+
+int add_proc_fixture_pressure(ProcFixture *fx) {
+    if (make_dirs(fx, ADD_PRESSURE) < 0 || write_pressure(fx) < 0)
+        return -1;
+    fx->added |= ADD_PRESSURE;
+    return 0;
+}
+
+int add_proc_fixture_cgroups(ProcFixture *fx) {
+    if (make_dirs(fx, ADD_CGROUPS) < 0 ||
+        write_fixture_file(fx, CGROUP_DIR "/cgroup.controllers", "cpuset cpu io memory pids\n", 26) < 0)
+        return -1;
+    char path[PROC_PATH_MAX];
+    for (int i = 0; i < FIXTURE_CGROUPS; i++) {
+        if (!fx->cgroup_present[i])
+            continue;
+        snprintf(path, sizeof(path), "%s" CGROUP_DIR "/%s", fx->root, fixture_cgroups[i].name);
+        if (mkdir(path, 0755) < 0 || write_cgroup(fx, i) < 0)
+            return -1;
+    }
+    fx->added |= ADD_CGROUPS;
+    return 0;
+}
+
+int add_proc_fixture_irqs(ProcFixture *fx) {
+    if (write_interrupts(fx) < 0)
+        return -1;
+    fx->added |= ADD_IRQS;
+    return 0;
+}
+
+int add_proc_fixture_thermal(ProcFixture *fx) {
+    if (make_dirs(fx, ADD_THERMAL) < 0 || write_zones(fx) < 0)
+        return -1;
+    char path[PROC_PATH_MAX];
+    for (int i = 0; i < fx->num_cpus; i++) {
+        snprintf(path, sizeof(path), "%s" CPU_DIR "/cpu%d/thermal_throttle", fx->root, i);
+        if (mkdir(path, 0755) < 0 || write_throttles(fx, i) < 0)
+            return -1;
+    }
+    fx->added |= ADD_THERMAL;
+    return 0;
+}
+
+int advance_proc_fixture(ProcFixture *fx) {
+    fx->ticks++;
+    advance_cpus(fx);
+    advance_memory(fx);
+    advance_disks(fx);
+    advance_net(fx);
+    advance_pressure(fx);
+    advance_cgroups(fx);
+    advance_irqs(fx);
+    advance_freq(fx);
+    advance_temps(fx);
+    if (write_stat(fx) < 0 || write_meminfo(fx) < 0 || write_freq(fx) < 0)
+        return -1;
+    if (((fx->added & ADD_DISKS) && write_diskstats(fx) < 0) || ((fx->added & ADD_NET) && write_net_dev(fx) < 0) ||
+        ((fx->added & ADD_PRESSURE) && write_pressure(fx) < 0) || ((fx->added & ADD_CGROUPS) && write_cgroups(fx) < 0) ||
+        ((fx->added & ADD_IRQS) && write_interrupts(fx) < 0))
+        return -1;
+    for (int z = 0; z < fx->clusters && (fx->added & ADD_THERMAL); z++)
+        if (write_zone_temp(fx, z) < 0)
+            return -1;
+    return 0;
+}
+
+int set_proc_fixture_online(ProcFixture *fx, int cpu, int online) {
+    if (cpu < 0 || cpu >= fx->num_cpus)
+        return -1;
+    fx->online[cpu] = online ? 1 : 0;
+    if (write_online(fx) < 0 || write_stat(fx) < 0)
+        return -1;
+    return (fx->added & ADD_IRQS) ? write_interrupts(fx) : 0;
+}
+
+int set_proc_fixture_disk(ProcFixture *fx, int disk, int present) {
+    if (!(fx->added & ADD_DISKS) || disk < 0 || disk >= FIXTURE_DISKS || fixture_disks[disk].parent >= 0)
+        return -1;
+    for (int i = 0; i < FIXTURE_DISKS; i++) {
+        if (i != disk && fixture_disks[i].parent != disk)
+            continue;
+        if (present && !fx->disk_present[i])
+            memset(&fx->disk[i], 0, sizeof(fx->disk[i]));
+        fx->disk_present[i] = present ? 1 : 0;
+    }
+    return write_diskstats(fx);
+}
+
+int set_proc_fixture_iface(ProcFixture *fx, int iface, int present) {
+    if (!(fx->added & ADD_NET) || iface < 0 || iface >= FIXTURE_IFACES)
+        return -1;
+    fx->iface_present[iface] = present ? 1 : 0;
+    return write_net_dev(fx);
+}
+
+// Remove the files and directory of a cgroup; missing ones are skipped
+static int remove_cgroup(ProcFixture *fx, int i) {
+    char path[PROC_PATH_MAX];
+    for (size_t f = 0; f < sizeof(cgroup_files) / sizeof(cgroup_files[0]); f++) {
+        snprintf(path, sizeof(path), "%s" CGROUP_DIR "/%s/%s", fx->root, fixture_cgroups[i].name, cgroup_files[f]);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s" CGROUP_DIR "/%s", fx->root, fixture_cgroups[i].name);
+    return rmdir(path);
+}
+
+int set_proc_fixture_cgroup(ProcFixture *fx, int cgroup, int present) {
+    if (!(fx->added & ADD_CGROUPS) || cgroup < 0 || cgroup >= FIXTURE_CGROUPS)
+        return -1;
+    int parent = fixture_cgroups[cgroup].parent;
+    for (int i = 0; i < FIXTURE_CGROUPS; i++)
+        if (!present && fixture_cgroups[i].parent == cgroup && fx->cgroup_present[i])
+            return -1;
+    if (present && parent >= 0 && !fx->cgroup_present[parent])
+        return -1;
+    if (present == fx->cgroup_present[cgroup])
+        return 0;
+    fx->cgroup_present[cgroup] = present ? 1 : 0;
+    if (!present)
+        return remove_cgroup(fx, cgroup);
+    char path[PROC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s" CGROUP_DIR "/%s", fx->root, fixture_cgroups[cgroup].name);
+    if (mkdir(path, 0755) < 0)
+        return -1;
+    return write_cgroup(fx, cgroup);
+}
+
+int heat_proc_fixture(ProcFixture *fx, int zone, long temp_mc, unsigned long throttles) {
+    if (!(fx->added & ADD_THERMAL) || zone < 0 || zone >= fx->clusters)
+        return -1;
+    fx->held[zone] = temp_mc != 0;
+    if (temp_mc != 0) {
+        fx->temp_mc[zone] = temp_mc;
+        if (write_zone_temp(fx, zone) < 0)
+            return -1;
+    }
+    if (throttles == 0)
+        return 0;
+    for (int core = 0; core < fx->cores; core++)
+        if (proc_fixture_cluster(fx, core) == zone)
+            fx->core_throttles[core] += throttles;
+    fx->package_throttles += throttles;
+    for (int i = 0; i < fx->num_cpus; i++)
+        if (write_throttles(fx, i) < 0)
+            return -1;
+    return 0;
+}
+
+// Largest byte count one pread() returns, 0 for none
+static size_t read_limit;
+
+void set_proc_fixture_read_limit(size_t bytes) {
+    read_limit = bytes;
+}
+
+// Stands in for the C library's pread() in every program linked with the
+// fixture, so a limit makes regular files read like an iterative seq_file
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    if (read_limit != 0 && count > read_limit)
+        count = read_limit;
+    return (ssize_t)syscall(SYS_pread64, fd, buf, count, offset);
+}
+
+// Relative tolerance, absolute below 1
+static int within(double a, double b, double tolerance) {
+    return fabs(a - b) <= tolerance * (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+int close_to(double a, double b) {
+    return within(a, b, 1e-9);
+}
+
+int close_to_float(double a, double b) {
+    return within(a, b, 1e-4);
+}
+
+void destroy_proc_fixture(ProcFixture *fx) {
+    char path[PROC_PATH_MAX];
+    if (fx->root[0] != '\0') {
+        // Per-CPU entries, children first; missing ones (a failed create, a
+        // subsystem not added) are skipped
+        static const char *const cpu_files[] = {
+            "/topology/physical_package_id", "/topology/core_id", "/topology/cluster_id",
+            "/cpufreq/scaling_cur_freq", "/thermal_throttle/core_throttle_count",
+            "/thermal_throttle/package_throttle_count",
+        };
+        static const char *const cpu_dirs[] = { "/topology", "/cpufreq", "/thermal_throttle", "/node0", "/node1", "" };
+        for (int cpu = 0; cpu < fx->num_cpus; cpu++) {
+            for (size_t i = 0; i < sizeof(cpu_files) / sizeof(cpu_files[0]); i++) {
+                snprintf(path, sizeof(path), "%s" CPU_DIR "/cpu%d%s", fx->root, cpu, cpu_files[i]);
+                unlink(path);
+            }
+            for (size_t i = 0; i < sizeof(cpu_dirs) / sizeof(cpu_dirs[0]); i++) {
+                snprintf(path, sizeof(path), "%s" CPU_DIR "/cpu%d%s", fx->root, cpu, cpu_dirs[i]);
+                rmdir(path);
+            }
+        }
+        for (int z = 0; z < FIXTURE_MAX_CLUSTERS; z++) {
+            for (size_t i = 0; i < sizeof(zone_files) / sizeof(zone_files[0]); i++) {
+                snprintf(path, sizeof(path), "%s" THERMAL_DIR "/thermal_zone%d/%s", fx->root, z, zone_files[i]);
+                unlink(path);
+            }
+            snprintf(path, sizeof(path), "%s" THERMAL_DIR "/thermal_zone%d", fx->root, z);
+            rmdir(path);
+        }
+        for (int i = FIXTURE_CGROUPS; i-- > 0;)
+            remove_cgroup(fx, i);
+        for (size_t i = 0; i < sizeof(fixture_files) / sizeof(fixture_files[0]); i++) {
+            snprintf(path, sizeof(path), "%s%s", fx->root, fixture_files[i]);
+            unlink(path);
+        }
+        for (size_t i = sizeof(fixture_dirs) / sizeof(fixture_dirs[0]); i-- > 0;) {
+            snprintf(path, sizeof(path), "%s%s", fx->root, fixture_dirs[i].path);
+            rmdir(path);
+        }
+        rmdir(fx->root);
+    }
+    free(fx->online);
+    free(fx->cpu);
+    free(fx->busy);
+    free(fx->expected_usage);
+    free(fx->core_throttles);
+    free(fx->irq_count);
+    free(fx->irq_delta);
+    free(fx->buf);
+    memset(fx, 0, sizeof(*fx));
+}
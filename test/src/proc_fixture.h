@@ -0,0 +1,236 @@
+/**
+ * @file proc_fixture.h
+ * @brief Synthetic /proc and /sys trees for tests and benchmarks.
+ *
+ * A fixture is a temporary directory with proc/stat, proc/cpuinfo,
+ * proc/meminfo, sys/devices/system/cpu/online, possible and present (every
+ * CPU of the fixture) and the topology, cpufreq and NUMA node entries of
+ * sys/devices/system/cpu/cpuN, laid out like a real machine with any number
+ * of CPUs. A test adds the other subsystems it reads with their own writers:
+ * add_proc_fixture_disks(), add_proc_fixture_net(),
+ * add_proc_fixture_pressure(), add_proc_fixture_cgroups(),
+ * add_proc_fixture_irqs() and add_proc_fixture_thermal(). Point the monitor
+ * at it with set_proc_root().
+ *
+ * The machine has one package and two threads per core; from 4 CPUs on, the
+ * cores are split into two clusters, each its own NUMA node and cpufreq
+ * policy (the CPUs of a cluster share one scaling_cur_freq file through hard
+ * links, as sysfs shares it through the policy directory). Each cluster has
+ * a thermal zone with an active, a passive and a critical trip point.
+ * advance_proc_fixture() moves every counter forward by one tick from a
+ * seeded generator, so runs are reproducible, and records the usage a correct
+ * parser must compute for that tick. Counters of subsystems not added run
+ * too, so a seed gives the same values whichever a test adds.
+ *
+ * Files are rewritten in place (same inode) so descriptors kept open by a
+ * ProcFile see the new content, as with procfs. Do not advance a fixture
+ * while another thread reads it.
+ */
+
+#ifndef PROC_FIXTURE_H
+#define PROC_FIXTURE_H
+
+#include "../../src/cgroupinfo_manip.h"
+#include "../../src/cpuinfo_manip.h"
+#include "../../src/diskinfo_manip.h"
+#include "../../src/meminfo_manip.h"
+#include "../../src/netinfo_manip.h"
+#include "../../src/psi_manip.h"
+#include <stdint.h> // For uint64_t
+
+#define FIXTURE_TICK_JIFFIES 100 // Jiffies each CPU accounts per tick (USER_HZ for one second)
+#define FIXTURE_MODEL_NAME "Fixture(R) Synthetic CPU @ 2.40GHz"
+#define FIXTURE_MAX_CLUSTERS 2
+#define FIXTURE_DISKS 6            // loop0, mmcblk0, mmcblk0p1, mmcblk0p2, sda, sda1
+#define FIXTURE_IFACES 4           // lo, eth0, wlan0, usb0
+#define FIXTURE_CGROUPS 4          // system.slice, its sshd.service and docker-web.scope, user.slice
+#define FIXTURE_IRQS 8             // Per-CPU rows of proc/interrupts: five IRQs, NMI, LOC and RES
+#define FIXTURE_SOFTIRQS 10        // Rows of proc/softirqs, HI to RCU
+#define FIXTURE_FAN_MC 60000       // Active trip point of every zone
+#define FIXTURE_TRIP_MC 85000      // Passive trip point
+#define FIXTURE_CRITICAL_MC 105000 // Critical trip point
+
+/**
+ * @brief A synthetic tree and the values last written to it.
+ */
+typedef struct {
+    char root[PROC_PATH_MAX / 2];          /**< Directory to pass to set_proc_root(). */
+    int num_cpus;                          /**< Logical CPUs. */
+    int cores;                             /**< Physical cores (num_cpus / 2, at least 1). */
+    int clusters;                          /**< Clusters, NUMA nodes and cpufreq policies (1 or 2). */
+    unsigned char *online;                 /**< 1 for each CPU in the online mask. */
+    unsigned int freq_khz[FIXTURE_MAX_CLUSTERS]; /**< Frequency of each cluster in the last tick. */
+    long temp_mc[FIXTURE_MAX_CLUSTERS];    /**< Temperature of each cluster's thermal zone. */
+    int held[FIXTURE_MAX_CLUSTERS];        /**< 1 while heat_proc_fixture() holds the zone's temperature. */
+    unsigned long *core_throttles;         /**< core_throttle_count of each core. */
+    unsigned long package_throttles;       /**< package_throttle_count of the package. */
+    unsigned long ticks;                   /**< advance_proc_fixture() calls so far. */
+    unsigned int added;                    /**< Subsystems added so far, a bit each. */
+    uint64_t rng;                          /**< Generator state. */
+    unsigned long (*cpu)[CPU_STAT_FIELDS]; /**< Counters of each CPU line. */
+    unsigned long *busy;                   /**< Busy jiffies of each CPU in the last tick. */
+    double *expected_usage;                /**< Usage over the last tick: [0] aggregate, [i + 1] CPU i. */
+    MemInfo mem;                           /**< Values in the last proc/meminfo written. */
+    const char *disk_name[FIXTURE_DISKS];  /**< Block devices in proc/diskstats order. */
+    DiskStats disk[FIXTURE_DISKS];         /**< Their counters in the last proc/diskstats written. */
+    unsigned char disk_present[FIXTURE_DISKS]; /**< 1 for each device listed in proc/diskstats. */
+    const char *iface_name[FIXTURE_IFACES]; /**< Interfaces in proc/net/dev order. */
+    NetStats net[FIXTURE_IFACES];          /**< Their counters, before eth0's are cut to 32 bits. */
+    unsigned char iface_present[FIXTURE_IFACES]; /**< 1 for each interface listed in proc/net/dev. */
+    PSILine psi_some[PSI_RESOURCES];       /**< "some" lines of proc/pressure/{cpu,memory,io}. */
+    PSILine psi_full[PSI_RESOURCES];       /**< "full" lines (zero for the CPU). */
+    const char *cgroup_name[FIXTURE_CGROUPS]; /**< Cgroup paths below sys/fs/cgroup, parents first. */
+    CgroupStats cgroup[FIXTURE_CGROUPS];   /**< Their counters in the last files written. */
+    unsigned char cgroup_present[FIXTURE_CGROUPS]; /**< 1 for each cgroup directory in the tree. */
+    const char *irq_name[FIXTURE_IRQS + FIXTURE_SOFTIRQS]; /**< Source names a sampler reports, IRQs then softirqs. */
+    unsigned int *irq_count;               /**< Their counters, (FIXTURE_IRQS + FIXTURE_SOFTIRQS) x num_cpus. */
+    unsigned int *irq_delta;               /**< Increase of each counter in the last tick, likewise. */
+    char *buf;                             /**< Text buffer for the largest file. */
+    size_t cap;
+    size_t stat_bytes;                     /**< Size of the last proc/stat. */
+    size_t cpuinfo_bytes;                  /**< Size of proc/cpuinfo. */
+} ProcFixture;
+
+/**
+ * @brief Creates a tree for num_cpus CPUs under /tmp.
+ *
+ * @return int 0 on success, -1 on failure.
+ */
+int create_proc_fixture(ProcFixture *fx, int num_cpus, unsigned int seed);
+
+/**
+ * @brief Adds proc/diskstats (an eMMC and a USB disk with partitions and an
+ * unused loop device) and the sys/block entries of the whole disks.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_disks(ProcFixture *fx);
+
+/**
+ * @brief Adds proc/net/dev: loopback, an uplink with 32-bit counters, Wi-Fi
+ * and a USB modem.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_net(ProcFixture *fx);
+
+/**
+ * @brief Adds proc/pressure/cpu, memory and io.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_pressure(ProcFixture *fx);
+
+/**
+ * @brief Adds a cgroup v2 hierarchy under sys/fs/cgroup: two slices, a
+ * service and a container throttled by its CPU quota.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_cgroups(ProcFixture *fx);
+
+/**
+ * @brief Adds proc/interrupts and proc/softirqs, with the NIC queues routed
+ * to CPUs 1 and 2.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_irqs(ProcFixture *fx);
+
+/**
+ * @brief Adds a sys/class/thermal zone per cluster and the thermal_throttle
+ * counters of every CPU.
+ *
+ * @return int 0 on success, -1 on a file system error.
+ */
+int add_proc_fixture_thermal(ProcFixture *fx);
+
+/**
+ * @brief Moves every counter one tick forward and rewrites proc/stat,
+ * proc/meminfo, each cluster's scaling_cur_freq and the files of the
+ * subsystems added: proc/diskstats, proc/net/dev, proc/pressure,
+ * proc/interrupts and proc/softirqs, the files of every present cgroup and
+ * each zone's temperature.
+ *
+ * @return int 0 on success, -1 on a write error.
+ */
+int advance_proc_fixture(ProcFixture *fx);
+
+/**
+ * @brief Takes a CPU offline or brings it back by rewriting the online mask,
+ * as a hotplug event would. Its sysfs entries stay in place; its cpuN line
+ * leaves proc/stat and its column the proc/interrupts header (once added),
+ * and it accounts no more time and takes no more interrupts.
+ *
+ * @return int 0 on success, -1 on a write error or a bad CPU number.
+ */
+int set_proc_fixture_online(ProcFixture *fx, int cpu, int online);
+
+/**
+ * @brief Removes a whole disk and its partitions from proc/diskstats, or
+ * brings them back, as unplugging a USB disk would. A disk brought back starts
+ * its counters again from 0, as the kernel creates the device anew.
+ *
+ * @return int 0 on success, -1 on a write error, if disk is not a whole disk
+ * or if the disks were not added.
+ */
+int set_proc_fixture_disk(ProcFixture *fx, int disk, int present);
+
+/**
+ * @brief Removes an interface from proc/net/dev or brings it back, as
+ * unplugging a USB modem would. Counters keep running.
+ *
+ * @return int 0 on success, -1 on a write error, a bad interface number or
+ * if the interfaces were not added.
+ */
+int set_proc_fixture_iface(ProcFixture *fx, int iface, int present);
+
+/**
+ * @brief Removes a cgroup directory (rmdir) or creates it again (mkdir), as
+ * a container stopping or starting would. Counters keep running.
+ *
+ * @return int 0 on success, -1 on a file system error, a bad cgroup number,
+ * cgroups not added, or a parent that is absent (create) or a child still
+ * present (remove).
+ */
+int set_proc_fixture_cgroup(ProcFixture *fx, int cgroup, int present);
+
+/**
+ * @brief Holds a zone at temp_mc (0 lets it drift again) and adds
+ * throttles to the core counters of its cluster and to the package counter.
+ *
+ * @return int 0 on success, -1 on a write error, a bad zone number or if
+ * the zones were not added.
+ */
+int heat_proc_fixture(ProcFixture *fx, int zone, long temp_mc, unsigned long throttles);
+
+/**
+ * @brief Cluster of a CPU in the fixture's layout.
+ */
+int proc_fixture_cluster(const ProcFixture *fx, int cpu);
+
+/**
+ * @brief Makes every pread() of the process return at most bytes (0 lifts
+ * the limit), as an iterative seq_file such as /proc/net/dev returns about a
+ * page per call however much is asked for. Regular files otherwise fill the
+ * whole request, so a reader that stops at the first short read goes unseen.
+ */
+void set_proc_fixture_read_limit(size_t bytes);
+
+/**
+ * @brief Whether a equals b within 1e-9 of b (of 1 when |b| < 1), for rates
+ * the test recomputes in double from the fixture's counters.
+ */
+int close_to(double a, double b);
+
+/**
+ * @brief close_to() within 1e-4, for figures kept as floats.
+ */
+int close_to_float(double a, double b);
+
+/**
+ * @brief Removes the tree and frees the fixture.
+ */
+void destroy_proc_fixture(ProcFixture *fx);
+
+#endif // PROC_FIXTURE_H
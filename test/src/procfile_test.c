@@ -0,0 +1,109 @@
+/**
+ * @file procfile_test.c
+ * @brief Tests for the persistent-descriptor reader and the in-place scanners.
+ */
+
+#include <assert.h>
+#include "../../src/procfile.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For mkstemp()
+#include <string.h> // For strlen(), memset()
+#include <unistd.h> // For write(), unlink()
+
+// Test the integer and line scanners on a /proc/stat style buffer
+void test_scanners() {
+    printf("=== Test scan_ulong() / next_line() ===\n");
+    const char *text = "cpu  10 20\t30 18446744073709551615\ncpu0 7\n";
+    const char *p = text + 3;
+
+    assert(scan_ulong(&p) == 10);
+    assert(scan_ulong(&p) == 20);
+    assert(scan_ulong(&p) == 30);
+    assert(scan_ulong(&p) == 18446744073709551615UL);
+    // Missing fields scan as 0 and never cross the newline
+    assert(scan_ulong(&p) == 0);
+    assert(*p == '\n');
+
+    p = next_line(p);
+    assert(strncmp(p, "cpu0", 4) == 0);
+    p += 3;
+    assert(scan_ulong(&p) == 0);
+    assert(scan_ulong(&p) == 7);
+    p = next_line(p);
+    assert(*p == '\0');
+    printf("Test scanners passed!\n\n");
+}
+
+// Test that re-reading picks up new content and that the buffer grows when needed
+void test_reread_and_grow() {
+    printf("=== Test read_proc_file() ===\n");
+    char path[] = "/tmp/procfile_testXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+
+    char big[10000];
+    memset(big, 'x', sizeof(big));
+    assert(write(fd, "first\n", 6) == 6);
+
+    ProcFile pf;
+    assert(open_proc_file(&pf, path, 16) == 0);
+    assert(read_proc_file(&pf) == 6);
+    assert(strcmp(pf.buf, "first\n") == 0);
+
+    // Append past the initial capacity: the buffer must grow once
+    assert(write(fd, big, sizeof(big)) == (ssize_t)sizeof(big));
+    assert(read_proc_file(&pf) == (ssize_t)(6 + sizeof(big)));
+    assert(pf.cap > 6 + sizeof(big));
+    assert(strlen(pf.buf) == 6 + sizeof(big));
+
+    close_proc_file(&pf);
+    close_proc_file(&pf); // Second close is harmless
+    assert(pf.fd == -1 && pf.buf == NULL);
+
+    close(fd);
+    unlink(path);
+
+    // Missing files fail cleanly
+    assert(open_proc_file(&pf, "/nonexistent/procfile", 0) == -1);
+    printf("Test read_proc_file() passed!\n\n");
+}
+
+// An iterative seq_file returns about a page per pread() however much is
+// asked for: the whole file must still be read, not just its first page
+void test_seq_file() {
+    printf("=== Test read_proc_file() on a multi-page seq_file ===\n");
+    ProcFile pf;
+    if (open_proc_file(&pf, "/proc/kallsyms", 0) < 0) {
+        printf("No /proc/kallsyms, skipped\n\n");
+        return;
+    }
+    // Reference size from a second, sequential reader
+    size_t expected = 0;
+    static char chunk[65536];
+    FILE *f = fopen("/proc/kallsyms", "r");
+    assert(f != NULL);
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        expected += got;
+    fclose(f);
+
+    ProcIoCounts io0, io1;
+    get_proc_io_counts(&io0);
+    ssize_t len = read_proc_file(&pf);
+    get_proc_io_counts(&io1);
+    assert(len > 0 && (size_t)len == expected && strlen(pf.buf) == expected);
+    assert(expected > 4096 && io1.reads - io0.reads > 2); // Several short reads before the empty one
+    assert(pf.buf[len - 1] == '\n');
+    printf("%zu bytes in %lu reads\n", expected, io1.reads - io0.reads);
+
+    close_proc_file(&pf);
+    printf("Test read_proc_file() on a multi-page seq_file passed!\n\n");
+}
+
+int main() {
+    test_scanners();
+    test_reread_and_grow();
+    test_seq_file();
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file procinfo_test.c
+ * @brief Tests for the per-process top-N table.
+ */
+
+#include <assert.h>
+#include "../../src/procinfo_manip.h"
+
+#include <dirent.h>       // For counting /proc/self/fd entries
+#include <fcntl.h>        // For open()
+#include <signal.h>       // For kill()
+#include <stdio.h>        // For printf
+#include <string.h>       // For strcmp()
+#include <sys/resource.h> // For setrlimit()
+#include <sys/wait.h>     // For waitpid()
+#include <unistd.h>       // For fork(), usleep()
+
+// Number of descriptors open in this process
+static int count_open_fds(void) {
+    int count = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    assert(dir != NULL);
+    while (readdir(dir) != NULL)
+        count++;
+    closedir(dir);
+    return count;
+}
+
+// Find pid in the top table, or NULL
+static const ProcEntry *find_entry(const ProcTop *top, int pid) {
+    for (int i = 0; i < top->count; i++) {
+        if (top->entries[i].pid == pid)
+            return &top->entries[i];
+    }
+    return NULL;
+}
+
+// Test ranking order and that a busy child shows up at the top by CPU
+void test_top_by_cpu() {
+    printf("=== Test sample_processes() by CPU ===\n");
+    ProcTable *table = create_proc_table(0);
+    assert(table != NULL);
+
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        for (;;) { } // Burn CPU until killed
+    }
+
+    ProcTop top;
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    usleep(300000);
+    assert(sample_processes(table, PROC_SORT_CPU, 5, &top) == 0);
+
+    printf("Processes: %d, top: %d (%s) %.1f%%\n", top.total, top.entries[0].pid,
+           top.entries[0].comm, top.entries[0].cpu_usage);
+    assert(top.total > 1);
+    assert(top.count == 5 || top.count == top.total);
+    for (int i = 1; i < top.count; i++) {
+        assert(top.entries[i - 1].cpu_usage >= top.entries[i].cpu_usage);
+    }
+    const ProcEntry *busy = find_entry(&top, child);
+    assert(busy != NULL);
+    assert(busy->cpu_usage > 10.0);
+    assert(strcmp(busy->comm, "procinfo_test") == 0);
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    destroy_proc_table(table);
+    printf("Test sample_processes() by CPU passed!\n\n");
+}
+
+// Test the RSS ordering
+void test_top_by_rss() {
+    printf("=== Test sample_processes() by RSS ===\n");
+    ProcTable *table = create_proc_table(0);
+    assert(table != NULL);
+
+    ProcTop top;
+    assert(sample_processes(table, PROC_SORT_RSS, PROC_TOP_MAX, &top) == 0);
+    assert(top.count > 0);
+    for (int i = 1; i < top.count; i++) {
+        assert(top.entries[i - 1].rss_kb >= top.entries[i].rss_kb);
+    }
+    destroy_proc_table(table);
+    printf("Test sample_processes() by RSS passed!\n\n");
+}
+
+// Test that exited processes release their descriptors and the budget is respected
+void test_no_fd_leak() {
+    printf("=== Test descriptor cache ===\n");
+    int before = count_open_fds();
+
+    ProcTable *table = create_proc_table(4); // Tiny budget exercises the uncached path
+    assert(table != NULL);
+
+    pid_t children[8];
+    for (int i = 0; i < 8; i++) {
+        children[i] = fork();
+        assert(children[i] >= 0);
+        if (children[i] == 0) {
+            pause();
+            _exit(0);
+        }
+    }
+
+    ProcTop top;
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    assert(proc_table_open_fds(table) <= 4);
+
+    for (int i = 0; i < 8; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+    }
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    for (int i = 0; i < 8; i++) {
+        assert(find_entry(&top, children[i]) == NULL);
+    }
+    assert(proc_table_open_fds(table) <= 4);
+
+    destroy_proc_table(table);
+    assert(count_open_fds() == before);
+    printf("Test descriptor cache passed!\n\n");
+}
+
+// With few descriptors left under RLIMIT_NOFILE, the default budget caches
+// none, and a table that runs out while caching gives its descriptors back
+// and keeps reading every process instead of dropping them
+void test_fd_exhaustion() {
+    printf("=== Test descriptor exhaustion ===\n");
+    enum { CHILDREN = 24, LIMIT = 64 };
+    pid_t children[CHILDREN];
+    for (int i = 0; i < CHILDREN; i++) {
+        children[i] = fork();
+        assert(children[i] >= 0);
+        if (children[i] == 0) {
+            pause();
+            _exit(0);
+        }
+    }
+
+    struct rlimit saved, low;
+    assert(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    low = saved;
+    low.rlim_cur = LIMIT;
+    assert(setrlimit(RLIMIT_NOFILE, &low) == 0);
+    // Leave a handful of descriptors free, as a program with many sources open would
+    int held[LIMIT];
+    int count = 0;
+    int fd;
+    while ((fd = open("/dev/null", O_RDONLY)) >= 0 && fd < LIMIT - 8)
+        held[count++] = fd;
+    if (fd >= 0)
+        close(fd);
+
+    ProcTop top;
+    ProcTable *table = create_proc_table(0);
+    assert(table != NULL);
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    assert(top.total >= CHILDREN + 1 && proc_table_open_fds(table) == 0);
+    destroy_proc_table(table);
+
+    table = create_proc_table(1000); // More than the limit allows
+    assert(table != NULL);
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    assert(top.total >= CHILDREN + 1 && proc_table_open_fds(table) == 0);
+    fd = open("/dev/null", O_RDONLY); // The rest of the program still gets one
+    assert(fd >= 0);
+    close(fd);
+    assert(sample_processes(table, PROC_SORT_CPU, PROC_TOP_MAX, &top) == 0);
+    assert(top.total >= CHILDREN + 1);
+    printf("%d processes read under a limit of %d descriptors\n", top.total, LIMIT);
+    destroy_proc_table(table);
+
+    for (int i = 0; i < count; i++)
+        close(held[i]);
+    assert(setrlimit(RLIMIT_NOFILE, &saved) == 0);
+    for (int i = 0; i < CHILDREN; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+    }
+    printf("Test descriptor exhaustion passed!\n\n");
+}
+
+int main() {
+    test_top_by_cpu();
+    test_top_by_rss();
+    test_no_fd_leak();
+    test_fd_exhaustion();
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file psi_test.c
+ * @brief Tests for the PSI parser, stall percentages and triggers.
+ */
+
+#include <assert.h>
+#include "../../src/psi_manip.h"
+#include "proc_fixture.h"
+
+#include <errno.h>     // For errno
+#include <poll.h>      // For poll()
+#include <pthread.h>   // For the CPU hogs
+#include <stdatomic.h> // For the stop flag
+#include <stdio.h>     // For printf
+#include <stdlib.h>    // For mkdtemp()
+#include <string.h>    // For strcmp()
+#include <unistd.h>    // For sysconf(), rmdir()
+
+// Kernel text, a missing "full" line, unknown fields and garbage
+void test_parse() {
+    printf("=== Test PSI parse ===\n");
+    PSILine some, full;
+    assert(parse_psi_lines("some avg10=12.34 avg60=5.06 avg300=0.70 total=123456789012\n"
+                           "full avg10=1.00 avg60=0.50 avg300=0.25 total=42\n", &some, &full) == 0);
+    assert(close_to(some.avg10, 12.34) && close_to(some.avg60, 5.06) && close_to(some.avg300, 0.70));
+    assert(some.total_us == 123456789012ULL && full.total_us == 42 && close_to(full.avg60, 0.5));
+
+    // Kernels before 5.13 have no "full" line for the CPU
+    assert(parse_psi_lines("some avg10=0.00 avg60=0.00 avg300=0.00 total=7\n", &some, &full) == 0);
+    assert(some.total_us == 7 && full.total_us == 0 && full.avg10 == 0.0);
+    assert(parse_psi_lines("some avg10=1.50 avg42=9.99 total=8 avg300=3.00\n", &some, &full) == 0);
+    assert(close_to(some.avg10, 1.5) && close_to(some.avg300, 3.0) && some.total_us == 8);
+    assert(parse_psi_lines("", &some, &full) < 0);
+    assert(parse_psi_lines("full avg10=1.00 avg60=0.00 avg300=0.00 total=1\n", &some, &full) < 0);
+    printf("Test PSI parse passed!\n\n");
+}
+
+// Stall percentages of an interval
+void test_stall() {
+    printf("=== Test PSI stall ===\n");
+    assert(close_to(calculate_psi_stall(1000, 251000, 1.0), 25.0));
+    assert(close_to(calculate_psi_stall(0, 50000, 0.5), 10.0));
+    assert(calculate_psi_stall(0, 3000000, 2.0) == 100.0); // Kernel clock ahead of ours
+    assert(calculate_psi_stall(500, 400, 1.0) == 0.0);
+    assert(calculate_psi_stall(0, 1000, 0.0) == 0.0);
+    printf("Test PSI stall passed!\n\n");
+}
+
+// Every resource of a fixture: values, percentages and one pass (two preads) per file per tick
+void test_fixture() {
+    printf("=== Test PSI on a fixture ===\n");
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, 4, 23) == 0);
+    assert(add_proc_fixture_pressure(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    PSISampler *s = create_psi_sampler();
+    assert(s != NULL);
+
+    PSIInfo info;
+    for (int tick = 0; tick < 10; tick++) {
+        PSILine before[PSI_RESOURCES];
+        memcpy(before, fx.psi_some, sizeof(before));
+        assert(advance_proc_fixture(&fx) == 0);
+        ProcIoCounts io0, io1;
+        get_proc_io_counts(&io0);
+        assert(sample_psi_info(s, &info) == PSI_RESOURCES);
+        get_proc_io_counts(&io1);
+        assert(io1.opens == io0.opens && io1.reads == io0.reads + 2 * PSI_RESOURCES);
+        for (int r = 0; r < PSI_RESOURCES; r++) {
+            const PSIPressure *p = &info.res[r];
+            assert(p->available && p->some.total_us == fx.psi_some[r].total_us);
+            assert(p->full.total_us == fx.psi_full[r].total_us);
+            assert(close_to(p->some.avg10, fx.psi_some[r].avg10) && close_to(p->full.avg300, fx.psi_full[r].avg300));
+            assert(p->some_pct == calculate_psi_stall(before[r].total_us, fx.psi_some[r].total_us, info.interval));
+        }
+        assert(info.res[PSI_CPU].full_pct == 0.0);
+    }
+    printf("cpu some avg10 %.2f, io some/full avg10 %.2f/%.2f\n", info.res[PSI_CPU].some.avg10,
+           info.res[PSI_IO].some.avg10, info.res[PSI_IO].full.avg10);
+
+    // A trigger would be written into the fixture file: refused
+    errno = 0;
+    assert(add_psi_trigger(s, PSI_MEMORY, 0, 100000, 1000000) < 0 && errno == ENOTSUP);
+    assert(psi_trigger_count(s) == 0 && sample_psi_info(s, &info) == PSI_RESOURCES);
+
+    destroy_psi_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test PSI on a fixture passed!\n\n");
+}
+
+// Without /proc/pressure nothing is available and nothing fails
+void test_missing() {
+    printf("=== Test PSI missing ===\n");
+    char empty[] = "/tmp/psi_emptyXXXXXX";
+    assert(mkdtemp(empty) != NULL);
+    assert(set_proc_root(empty) == 0);
+    PSISampler *s = create_psi_sampler();
+    assert(s != NULL);
+    PSIInfo info;
+    assert(sample_psi_info(s, &info) == 0);
+    for (int r = 0; r < PSI_RESOURCES; r++)
+        assert(!info.res[r].available && info.res[r].some_pct == 0.0);
+    assert(add_psi_trigger(s, PSI_IO, 0, 100000, 2000000) < 0);
+    destroy_psi_sampler(s);
+    set_proc_root(NULL);
+    rmdir(empty);
+    printf("Test PSI missing passed!\n\n");
+}
+
+static atomic_int hogs_stop;
+
+static void *hog(void *arg) {
+    (void)arg;
+    volatile unsigned long n = 0;
+    while (!atomic_load_explicit(&hogs_stop, memory_order_relaxed))
+        n++;
+    return NULL;
+}
+
+// A real trigger fires while twice as many threads as CPUs compete
+void test_live_trigger() {
+    printf("=== Test live PSI trigger ===\n");
+    PSISampler *s = create_psi_sampler();
+    assert(s != NULL);
+    PSIInfo info;
+    if (sample_psi_info(s, &info) == 0) {
+        printf("No PSI on this kernel, skipped\n");
+        destroy_psi_sampler(s);
+        printf("Test live PSI trigger passed!\n\n");
+        return;
+    }
+    // Short windows need privileges; 2 s ones do not from Linux 6.5 on
+    if (add_psi_trigger(s, PSI_CPU, 0, 20000, PSI_MIN_WINDOW_US) < 0 &&
+        add_psi_trigger(s, PSI_CPU, 0, 20000, 2000000) < 0) {
+        printf("Triggers refused (%s), skipped\n", strerror(errno));
+        destroy_psi_sampler(s);
+        printf("Test live PSI trigger passed!\n\n");
+        return;
+    }
+    assert(psi_trigger_count(s) == 1 && psi_trigger_resource(s, 0) == PSI_CPU);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = cpus > 0 && cpus < 128 ? (int)cpus * 2 : 8;
+    pthread_t threads[256];
+    atomic_store(&hogs_stop, 0);
+    for (int i = 0; i < n; i++)
+        assert(pthread_create(&threads[i], NULL, hog, NULL) == 0);
+    struct pollfd pfd = { .fd = psi_trigger_fd(s, 0), .events = POLLPRI };
+    int ready = poll(&pfd, 1, 5000);
+    atomic_store(&hogs_stop, 1);
+    for (int i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+    assert(ready == 1 && (pfd.revents & POLLPRI));
+
+    assert(sample_psi_info(s, &info) > 0 && info.res[PSI_CPU].some_pct > 0.0);
+    printf("%d threads on %ld CPUs: trigger fired, cpu some %.1f%% of the last %.2f s\n", n, cpus,
+           info.res[PSI_CPU].some_pct, info.interval);
+    destroy_psi_sampler(s);
+    printf("Test live PSI trigger passed!\n\n");
+}
+
+int main() {
+    test_parse();
+    test_stall();
+    test_fixture();
+    test_missing();
+    test_live_trigger();
+    return 0;
+}
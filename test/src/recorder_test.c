@@ -0,0 +1,301 @@
+/**
+ * @file recorder_test.c
+ * @brief Tests for the delta/varint recording writer and the mmap reader.
+ */
+
+#include <assert.h>
+#include "../../src/recorder.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For rand_r()
+#include <string.h> // For memset()
+#include <unistd.h> // For truncate(), unlink()
+
+#define TEST_CPUS 8
+#define TEST_SLOTS (TEST_CPUS + 1)
+#define TEST_SAMPLES 1000
+#define TEST_INTERVAL_MS 1000
+#define TEST_START_US 1700000000000000LL
+
+static const char *path = "recorder_test.rec";
+
+// Synthetic recording: counters of a typical, lightly loaded machine
+typedef struct {
+    CPUStatsStore store;
+    Sample sample;
+    unsigned int seed;
+    int step_at;           // From this sample on the wall clock is step_us behind
+    long long step_us;
+    unsigned long long (*expected)[TEST_SLOTS * CPU_STAT_FIELDS + RECORDING_MEM_WORDS];
+    long long *expected_time;
+} Synth;
+
+// Advance every counter the way /proc/stat and /proc/meminfo move in one second
+static void next_sample(Synth *sy, int n) {
+    unsigned long *mem = (unsigned long *)&sy->sample.mem;
+    if (n == 0) {
+        for (int i = 1; i < TEST_SLOTS; i++) {
+            sy->store.field[CPU_USER][i] = 500000 + (unsigned long)i * 1000;
+            sy->store.field[CPU_SYSTEM][i] = 200000;
+            sy->store.field[CPU_IDLE][i] = 9000000;
+            sy->store.field[CPU_IOWAIT][i] = 3000;
+            sy->store.field[CPU_IRQ][i] = 100;
+            sy->store.field[CPU_SOFTIRQ][i] = 2500;
+        }
+        for (size_t i = 0; i < RECORDING_MEM_WORDS; i++)
+            mem[i] = 1000 + i * 777;
+        sy->sample.mem.mem_total = 8000000;
+        sy->sample.mem.mem_free = 3000000;
+        sy->sample.mem.mem_available = 6000000;
+        sy->sample.mem.cached = 2500000;
+    } else {
+        for (int i = 1; i < TEST_SLOTS; i++) {
+            unsigned long busy = rand_r(&sy->seed) % 30;
+            sy->store.field[CPU_USER][i] += busy;
+            sy->store.field[CPU_SYSTEM][i] += rand_r(&sy->seed) % 8;
+            sy->store.field[CPU_IDLE][i] += 100 - busy;
+            if (rand_r(&sy->seed) % 4 == 0)
+                sy->store.field[CPU_IOWAIT][i] += 1;
+            if (rand_r(&sy->seed) % 3 == 0)
+                sy->store.field[CPU_SOFTIRQ][i] += 1;
+        }
+        // A few memory counters move by a few pages each second
+        long step = (long)(rand_r(&sy->seed) % 512) - 256;
+        sy->sample.mem.mem_free += step;
+        sy->sample.mem.mem_available += step;
+        sy->sample.mem.active += rand_r(&sy->seed) % 64;
+        sy->sample.mem.dirty = rand_r(&sy->seed) % 2048;
+        if (rand_r(&sy->seed) % 10 == 0)
+            sy->sample.mem.cached += 4;
+    }
+    // The aggregate line is the sum of the CPU lines
+    for (int f = 0; f < CPU_STAT_FIELDS; f++) {
+        sy->store.field[f][0] = 0;
+        for (int i = 1; i < TEST_SLOTS; i++)
+            sy->store.field[f][0] += sy->store.field[f][i];
+    }
+
+    // Wall clock drifts by up to +-2 ms around the nominal second
+    long long time_us = TEST_START_US + (long long)n * TEST_INTERVAL_MS * 1000 +
+                        (long long)(rand_r(&sy->seed) % 4000) - 2000;
+    if (sy->step_at > 0 && n >= sy->step_at)
+        time_us -= sy->step_us;
+    sy->sample.wallclock.tv_sec = time_us / 1000000;
+    sy->sample.wallclock.tv_nsec = (time_us % 1000000) * 1000 + 123; // Sub-us part is dropped
+    sy->expected_time[n] = time_us;
+
+    size_t k = 0;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++)
+        for (int i = 0; i < TEST_SLOTS; i++)
+            sy->expected[n][k++] = sy->store.field[f][i];
+    for (size_t i = 0; i < RECORDING_MEM_WORDS; i++)
+        sy->expected[n][k++] = mem[i];
+}
+
+static void check_sample(const Synth *sy, const RecordedSample *r, int n) {
+    assert(r->time_us == sy->expected_time[n]);
+    assert(r->cpu_slots == TEST_SLOTS);
+    size_t cpu_values = (size_t)TEST_SLOTS * CPU_STAT_FIELDS;
+    assert(memcmp(r->counters, sy->expected[n], sizeof(sy->expected[n])) == 0);
+    const unsigned long *mem = (const unsigned long *)&r->mem;
+    for (size_t i = 0; i < RECORDING_MEM_WORDS; i++)
+        assert(mem[i] == sy->expected[n][cpu_values + i]);
+}
+
+static Synth synth;
+
+// Record TEST_SAMPLES samples, check the size and the exact round trip
+void test_round_trip() {
+    printf("=== Test recording round trip ===\n");
+    memset(&synth, 0, sizeof(synth));
+    synth.seed = 42;
+    assert(init_cpu_stats_store(&synth.store, TEST_SLOTS) == 0);
+    synth.expected = calloc(TEST_SAMPLES, sizeof(*synth.expected));
+    synth.expected_time = calloc(TEST_SAMPLES, sizeof(*synth.expected_time));
+    assert(synth.expected != NULL && synth.expected_time != NULL);
+
+    Recorder *rec = create_recorder(path, TEST_SLOTS, TEST_INTERVAL_MS, 0);
+    assert(rec != NULL);
+    for (int n = 0; n < TEST_SAMPLES; n++) {
+        next_sample(&synth, n);
+        assert(record_sample(rec, &synth.sample, &synth.store) == 0);
+    }
+    unsigned long long bytes;
+    unsigned long samples;
+    get_recorder_stats(rec, &bytes, &samples);
+    assert(samples == TEST_SAMPLES);
+    assert(close_recorder(rec) == 0);
+
+    size_t counters = (size_t)TEST_SLOTS * CPU_STAT_FIELDS + RECORDING_MEM_WORDS;
+    double per_counter = (double)bytes / ((double)TEST_SAMPLES * (double)counters);
+    printf("%d samples x %zu counters: %llu bytes, %.1f bytes/sample, %.3f bytes/counter\n",
+           TEST_SAMPLES, counters, bytes, (double)bytes / TEST_SAMPLES, per_counter);
+    assert(per_counter < 2.0);
+
+    RecordingReader *rd = open_recording(path);
+    assert(rd != NULL);
+    assert(recording_header(rd)->cpu_slots == TEST_SLOTS);
+    assert(recording_keyframes(rd) == (TEST_SAMPLES + RECORDING_DEFAULT_KEYFRAME - 1) / RECORDING_DEFAULT_KEYFRAME);
+    RecordedSample r;
+    for (int n = 0; n < TEST_SAMPLES; n++) {
+        assert(read_recording(rd, &r) == 1);
+        check_sample(&synth, &r, n);
+    }
+    assert(read_recording(rd, &r) == 0);
+    close_recording(rd);
+    printf("Test recording round trip passed!\n\n");
+}
+
+// Seek to exact, in-between, early and late timestamps
+void test_seek() {
+    printf("=== Test recording seek ===\n");
+    RecordingReader *rd = open_recording(path);
+    assert(rd != NULL);
+    RecordedSample r;
+    int targets[] = { 0, 1, 63, 64, 65, 500, 777, TEST_SAMPLES - 1 };
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        int n = targets[t];
+        assert(seek_recording(rd, synth.expected_time[n]) == 0);
+        assert(read_recording(rd, &r) == 1);
+        check_sample(&synth, &r, n);
+        // Reading on continues from there
+        if (n + 1 < TEST_SAMPLES) {
+            assert(read_recording(rd, &r) == 1);
+            check_sample(&synth, &r, n + 1);
+        }
+        // Just after sample n lands on sample n + 1
+        if (n + 1 < TEST_SAMPLES) {
+            assert(seek_recording(rd, synth.expected_time[n] + 1) == 0);
+            assert(read_recording(rd, &r) == 1);
+            check_sample(&synth, &r, n + 1);
+        }
+    }
+    assert(seek_recording(rd, TEST_START_US - 1000000) == 0);
+    assert(read_recording(rd, &r) == 1);
+    check_sample(&synth, &r, 0);
+    assert(seek_recording(rd, synth.expected_time[TEST_SAMPLES - 1] + 1) == -1);
+    close_recording(rd);
+    printf("Test recording seek passed!\n\n");
+}
+
+// A recording cut short (no index, half a record) is still readable
+void test_truncated() {
+    printf("=== Test truncated recording ===\n");
+    RecordingReader *rd = open_recording(path);
+    assert(rd != NULL);
+    // Cut the file in the middle of the block before the last keyframe
+    size_t keyframes = recording_keyframes(rd);
+    close_recording(rd);
+
+    FILE *f = fopen(path, "rb");
+    assert(f != NULL);
+    RecordingTrailer trailer;
+    fseek(f, -(long)sizeof(trailer), SEEK_END);
+    assert(fread(&trailer, sizeof(trailer), 1, f) == 1);
+    RecordingIndexEntry last;
+    fseek(f, (long)(trailer.index_offset + (keyframes - 1) * sizeof(last)), SEEK_SET);
+    assert(fread(&last, sizeof(last), 1, f) == 1);
+    fclose(f);
+    assert(truncate(path, (off_t)last.offset - 5) == 0);
+
+    rd = open_recording(path);
+    assert(rd != NULL);
+    assert(recording_keyframes(rd) == keyframes - 1);
+    RecordedSample r;
+    int n = 0;
+    while (read_recording(rd, &r) == 1) {
+        check_sample(&synth, &r, n);
+        n++;
+    }
+    int expected = (int)(keyframes - 1) * RECORDING_DEFAULT_KEYFRAME - 1;
+    printf("Recovered %d of %d samples\n", n, TEST_SAMPLES);
+    assert(n == expected);
+    assert(seek_recording(rd, synth.expected_time[n / 2]) == 0);
+    assert(read_recording(rd, &r) == 1);
+    check_sample(&synth, &r, n / 2);
+    close_recording(rd);
+
+    unlink(path);
+    free(synth.expected);
+    free(synth.expected_time);
+    free_cpu_stats_store(&synth.store);
+    printf("Test truncated recording passed!\n\n");
+}
+
+// Seeks of a recording whose wall clock steps back, closed and rebuilt
+static void check_step_seeks(const Synth *sy, int samples, int keyframe_interval) {
+    RecordingReader *rd = open_recording(path);
+    assert(rd != NULL);
+    // Keyframes from the step on are indexed only once past the last one before it
+    size_t indexed = 0;
+    long long last = 0;
+    for (int n = 0; n < samples; n += keyframe_interval) {
+        if (indexed == 0 || sy->expected_time[n] >= last) {
+            last = sy->expected_time[n];
+            indexed++;
+        }
+    }
+    assert(recording_keyframes(rd) == indexed);
+
+    // Times from before the step land on the first pass over them, later ones exactly
+    long long last_before = sy->expected_time[sy->step_at - 1];
+    RecordedSample r;
+    for (int n = 0; n < samples; n++) {
+        assert(seek_recording(rd, sy->expected_time[n]) == 0);
+        assert(read_recording(rd, &r) == 1);
+        if (n < sy->step_at || sy->expected_time[n] > last_before) {
+            check_sample(sy, &r, n);
+        } else {
+            assert(r.time_us >= sy->expected_time[n] && r.time_us <= last_before);
+            assert(r.time_us - sy->expected_time[n] <= TEST_INTERVAL_MS * 1000 + 4000); // Drift
+        }
+    }
+    close_recording(rd);
+}
+
+// An NTP step back mid-recording leaves the index sorted and seeks correct
+void test_clock_step() {
+    printf("=== Test wall clock stepped back ===\n");
+    enum { SAMPLES = 300, KEYFRAME = 16 };
+    memset(&synth, 0, sizeof(synth));
+    synth.seed = 7;
+    synth.step_at = 150;
+    synth.step_us = 100 * 1000000LL;
+    assert(init_cpu_stats_store(&synth.store, TEST_SLOTS) == 0);
+    synth.expected = calloc(SAMPLES, sizeof(*synth.expected));
+    synth.expected_time = calloc(SAMPLES, sizeof(*synth.expected_time));
+    assert(synth.expected != NULL && synth.expected_time != NULL);
+
+    Recorder *rec = create_recorder(path, TEST_SLOTS, TEST_INTERVAL_MS, KEYFRAME);
+    assert(rec != NULL);
+    for (int n = 0; n < SAMPLES; n++) {
+        next_sample(&synth, n);
+        assert(record_sample(rec, &synth.sample, &synth.store) == 0);
+    }
+    assert(close_recorder(rec) == 0);
+    check_step_seeks(&synth, SAMPLES, KEYFRAME);
+
+    // Without the trailer the rebuilt index drops the same keyframes
+    FILE *f = fopen(path, "rb");
+    assert(f != NULL);
+    RecordingTrailer trailer;
+    fseek(f, -(long)sizeof(trailer), SEEK_END);
+    assert(fread(&trailer, sizeof(trailer), 1, f) == 1);
+    fclose(f);
+    assert(truncate(path, (off_t)trailer.index_offset) == 0);
+    check_step_seeks(&synth, SAMPLES, KEYFRAME);
+
+    unlink(path);
+    free(synth.expected);
+    free(synth.expected_time);
+    free_cpu_stats_store(&synth.store);
+    printf("Test wall clock stepped back passed!\n\n");
+}
+
+int main() {
+    test_round_trip();
+    test_seek();
+    test_truncated();
+    test_clock_step();
+    return 0;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file rules_test.c
+ * @brief Tests for the alert rule compiler and evaluator.
+ */
+
+#include <assert.h>
+#include "../../src/rules.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For mkdtemp(), mkstemp()
+#include <string.h> // For strcmp(), strncmp(), strstr()
+#include <unistd.h> // For usleep(), unlink()
+
+#define TEST_CPUS 4
+
+static Sample sample;
+static double threads[TEST_CPUS];
+
+// A quiet sample at t seconds: 10% everywhere, memory 50% used
+static void reset_sample(double t) {
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp.tv_sec = (time_t)t;
+    sample.timestamp.tv_nsec = (long)((t - (double)(time_t)t) * 1e9);
+    sample.interval = 1.0;
+    sample.cpu.num_cpus = TEST_CPUS;
+    sample.cpu.usage = 10.0;
+    sample.cpu.thread_usage = threads;
+    for (int i = 0; i < TEST_CPUS; i++)
+        threads[i] = 10.0;
+    sample.mem.mem_total = 1000000;
+    sample.mem.mem_available = 500000;
+}
+
+// Compile text that must fail and check the reason
+static void expect_error(const char *text, const char *reason) {
+    char err[128];
+    assert(compile_rules(text, TEST_CPUS, err, sizeof(err)) == NULL);
+    printf("  %-36s -> %s\n", text, err);
+    assert(strstr(err, reason) != NULL);
+}
+
+// Syntax, names and error messages
+void test_compile() {
+    printf("=== Test rule compiler ===\n");
+    char err[128];
+    RuleSet *rs = compile_rules("# Alerts\n"
+                                "\n"
+                                "hot_thread: cpu.thread[*] > 95 for 10s\n"
+                                "mem.used_pct   rising >5/min   # trend\n"
+                                "cpu.usage>=90 for 500ms clear 80\n"
+                                "low_mem: mem.available_mb < 200\n"
+                                "cpu.thread[3] <= 1 for 2m\n",
+                                TEST_CPUS, err, sizeof(err));
+    assert(rs != NULL && rule_count(rs) == 5);
+    assert(strcmp(rule_name(rs, 0), "hot_thread") == 0);
+    assert(strcmp(rule_name(rs, 1), "mem.used_pct rising > 5/min") == 0);
+    assert(strcmp(rule_name(rs, 2), "cpu.usage >= 90 for 500ms clear 80") == 0);
+    assert(strcmp(rule_name(rs, 4), "cpu.thread[3] <= 1 for 2m") == 0);
+    char label[RULES_LABEL_LEN];
+    assert(format_alert_label(rs, 0, 2, label, sizeof(label)) == 17 && strcmp(label, "hot_thread (cpu2)") == 0);
+    format_alert_label(rs, 3, 0, label, sizeof(label));
+    assert(strcmp(label, "low_mem") == 0);
+    destroy_rules(rs);
+
+    expect_error("cpu.usage > 90\nload > 3\n", "line 2: unknown metric 'load'");
+    expect_error("cpu.usage 90", "expected >, >=, < or <=");
+    expect_error("cpu.usage = 90", "expected >, >=, < or <=");
+    expect_error("cpu.thread[4] > 90", "unknown metric");
+    expect_error("mem.used_pct rising > 5", "a rate needs a unit");
+    expect_error("mem.used_pct rising > 5/day", "unknown rate unit");
+    expect_error("mem.used_pct > 5/min", "unexpected '/'");
+    expect_error("cpu.usage > 90 for ten", "invalid duration");
+    expect_error("cpu.usage > 90 clear 95", "firing side");
+    expect_error("cpu.usage > 90 for 1s for 2s", "unexpected 'for'");
+    expect_error("bad name: cpu.usage > 90", "unknown metric 'bad'");
+    expect_error("b@d: cpu.usage > 90", "invalid rule name");
+
+    // From a file: errors carry its path
+    char path[] = "/tmp/rules_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    FILE *f = fdopen(fd, "w");
+    fputs("cpu.usage > 90\ncpu.usage > 90 for\n", f);
+    fclose(f);
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%s:2: ", path);
+    assert(load_rules(path, TEST_CPUS, err, sizeof(err)) == NULL && strncmp(err, expected, strlen(expected)) == 0);
+    printf("  %s\n", err);
+    unlink(path);
+    assert(load_rules(path, TEST_CPUS, err, sizeof(err)) == NULL && strstr(err, path) == err);
+    printf("Test rule compiler passed!\n\n");
+}
+
+// "for" delays firing; the default clear band keeps a hovering value firing
+void test_for_and_hysteresis() {
+    printf("=== Test duration and hysteresis ===\n");
+    RuleSet *rs = compile_rules("cpu.usage > 90 for 3s\n", TEST_CPUS, NULL, 0);
+    assert(rs != NULL);
+    const double usage[] = { 95, 95, 95, 95, 88, 91, 87, 86, 85, 91, 92 };
+    const int expect[] = { 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0 }; // Clears below 85.5
+    for (int t = 0; t < (int)(sizeof(usage) / sizeof(usage[0])); t++) {
+        reset_sample(100.0 + t);
+        sample.cpu.usage = usage[t];
+        int changes = evaluate_rules(rs, &sample);
+        printf("  t=%2d usage %5.1f -> %s\n", t, usage[t], rules_firing(rs) ? "FIRING" : "-");
+        assert(rules_firing(rs) == expect[t]);
+        assert(changes == (t > 0 && expect[t] != expect[t - 1]));
+    }
+    int count;
+    const RuleEvent *events = rule_events(rs, &count);
+    assert(count == 0 && events != NULL);
+
+    // A dip below the threshold restarts the duration
+    const double times[] = { 200.0, 201.0, 203.0, 204.0, 206.5, 207.0 };
+    const double dips[] = { 80, 95, 80, 95, 95, 95 };
+    for (int i = 0; i < 6; i++) {
+        reset_sample(times[i]);
+        sample.cpu.usage = dips[i];
+        evaluate_rules(rs, &sample);
+        assert(rules_firing(rs) == (i == 5));
+    }
+
+    RuleStats stats;
+    get_rule_stats(rs, &stats);
+    assert(stats.fired == 2 && stats.cleared == 1 && stats.evaluations == 17);
+    destroy_rules(rs);
+    printf("Test duration and hysteresis passed!\n\n");
+}
+
+// One alert per CPU, with its own state
+void test_per_cpu() {
+    printf("=== Test per-CPU rules ===\n");
+    RuleSet *rs = compile_rules("hot: cpu.thread[*] > 95\nidle: cpu.thread[*] < 1 clear 5\n", TEST_CPUS, NULL, 0);
+    assert(rs != NULL);
+    reset_sample(1.0);
+    assert(evaluate_rules(rs, &sample) == 0);
+
+    reset_sample(2.0);
+    threads[2] = 99.0;
+    threads[0] = 0.5;
+    assert(evaluate_rules(rs, &sample) == 2 && rules_firing(rs) == 2);
+    RuleAlert alerts[4];
+    assert(list_firing_alerts(rs, alerts, 4) == 2);
+    assert(alerts[0].rule == 0 && alerts[0].instance == 2 && alerts[0].value == 99.0);
+    assert(alerts[1].rule == 1 && alerts[1].instance == 0);
+
+    reset_sample(3.0);
+    threads[2] = 99.0;
+    threads[3] = 97.0;
+    threads[0] = 3.0; // Inside the clear band of "idle"
+    int count;
+    assert(evaluate_rules(rs, &sample) == 1);
+    const RuleEvent *e = rule_events(rs, &count);
+    assert(count == 1 && e[0].rule == 0 && e[0].instance == 3 && e[0].firing == 1);
+    assert(rules_firing(rs) == 3);
+
+    reset_sample(4.0);
+    assert(evaluate_rules(rs, &sample) == 3 && rules_firing(rs) == 0);
+    e = rule_events(rs, &count);
+    for (int i = 0; i < count; i++)
+        assert(e[i].firing == 0);
+    destroy_rules(rs);
+    printf("Test per-CPU rules passed!\n\n");
+}
+
+// A rising rate fires on a steep ramp only and reads its slope
+void test_rate() {
+    printf("=== Test rate rules ===\n");
+    RuleSet *rs = compile_rules("fast: mem.used_pct rising > 5/min\nslow: cpu.usage falling > 1/s\n", TEST_CPUS,
+                                NULL, 0);
+    assert(rs != NULL);
+
+    // 3 points per minute for 200 s: never above 5/min
+    int t = 0;
+    for (; t < 200; t++) {
+        reset_sample(t);
+        sample.mem.mem_available = 900000 - (unsigned long)t * 500; // 0.05 point per second
+        evaluate_rules(rs, &sample);
+        assert(rules_firing(rs) == 0);
+    }
+    // Then 10 points per minute: fires once the average has caught up
+    int fired_at = -1;
+    for (int k = 1; k <= 360; k++, t++) {
+        reset_sample(t);
+        sample.mem.mem_available = 800000 - (unsigned long)k * 1667;
+        evaluate_rules(rs, &sample);
+        if (fired_at < 0 && rules_firing(rs) == 1)
+            fired_at = k;
+    }
+    RuleAlert alert;
+    assert(list_firing_alerts(rs, &alert, 1) == 1 && alert.rule == 0);
+    printf("  10/min ramp fired after %d s, rate %.2f/min\n", fired_at, alert.value);
+    assert(fired_at > 0 && fired_at < 90);
+    assert(alert.value > 9.9 && alert.value < 10.1);
+
+    // Memory holds: the rate decays and the alert clears
+    int cleared_at = -1;
+    for (int k = 1; k <= 300 && cleared_at < 0; k++, t++) {
+        reset_sample(t);
+        sample.mem.mem_available = 800000 - 360UL * 1667;
+        evaluate_rules(rs, &sample);
+        if (rules_firing(rs) == 0)
+            cleared_at = k;
+    }
+    printf("  flat memory cleared after %d s\n", cleared_at);
+    assert(cleared_at > 0);
+
+    // A sharp drop of CPU usage fires "falling" at once
+    reset_sample(t++);
+    sample.cpu.usage = 80.0;
+    evaluate_rules(rs, &sample);
+    reset_sample(t++);
+    sample.cpu.usage = 20.0;
+    evaluate_rules(rs, &sample);
+    assert(list_firing_alerts(rs, &alert, 1) == 1 && alert.rule == 1);
+    destroy_rules(rs);
+    printf("Test rate rules passed!\n\n");
+}
+
+// A metric the sample does not carry leaves its rules alone
+void test_missing_metric() {
+    printf("=== Test missing metrics ===\n");
+    RuleSet *rs = compile_rules("psi.io.some > 10\nthermal.temp_c > 80\ndisk.util >= 0\n", TEST_CPUS, NULL, 0);
+    assert(rs != NULL);
+    reset_sample(1.0);
+    assert(evaluate_rules(rs, &sample) == 0);
+    sample.psi.res[PSI_IO].available = 1;
+    sample.psi.res[PSI_IO].some_pct = 25.0;
+    sample.thermal.zone_count = 1;
+    sample.thermal.hottest = 0;
+    sample.thermal.zones[0].temp_mc = 85000;
+    sample.disks.count = 1;
+    assert(evaluate_rules(rs, &sample) == 3);
+    reset_sample(2.0); // Sources gone: the alerts stay as they were
+    assert(evaluate_rules(rs, &sample) == 0 && rules_firing(rs) == 3);
+    destroy_rules(rs);
+    printf("Test missing metrics passed!\n\n");
+}
+
+// The hook runs with the alert in its environment
+void test_hook() {
+    printf("=== Test alert hook ===\n");
+    char dir[] = "/tmp/rules_test.XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64], command[160];
+    snprintf(path, sizeof(path), "%s/hook.out", dir);
+    snprintf(command, sizeof(command), "echo \"$RESOURCE_MON_ALERT|$RESOURCE_MON_STATE|$RESOURCE_MON_VALUE\" >> %s",
+             path);
+
+    RuleSet *rs = compile_rules("hot: cpu.thread[*] > 95\n", TEST_CPUS, NULL, 0);
+    assert(rs != NULL && set_rule_hook(rs, command) == 0);
+    reset_sample(1.0);
+    threads[1] = 99.5;
+    assert(evaluate_rules(rs, &sample) == 1);
+
+    char line[128] = "";
+    for (int tries = 0; tries < 200; tries++) {
+        FILE *f = fopen(path, "r");
+        if (f != NULL) {
+            char *got = fgets(line, sizeof(line), f);
+            fclose(f);
+            if (got != NULL && strchr(line, '\n') != NULL)
+                break;
+        }
+        usleep(10000);
+    }
+    printf("  hook wrote: %s", line);
+    assert(strcmp(line, "hot (cpu1)|firing|99.50\n") == 0);
+
+    RuleStats stats;
+    get_rule_stats(rs, &stats);
+    assert(stats.hooks == 1 && stats.hooks_skipped == 0);
+    reset_sample(2.0); // No change: only reaps the finished hook
+    threads[1] = 99.0;
+    assert(evaluate_rules(rs, &sample) == 0);
+    destroy_rules(rs);
+    unlink(path);
+    rmdir(dir);
+    printf("Test alert hook passed!\n\n");
+}
+
+int main() {
+    test_compile();
+    test_for_and_hysteresis();
+    test_per_cpu();
+    test_rate();
+    test_missing_metric();
+    test_hook();
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file selfinfo_test.c
+ * @brief Tests for the monitor's self-usage sampler and the procfs I/O counters.
+ */
+
+#include <assert.h>
+#include "../../src/selfinfo_manip.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For malloc(), free()
+#include <time.h>   // For clock_gettime()
+
+// Burn about ms milliseconds of CPU on this thread
+static void spin_ms(long ms) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    volatile unsigned long x = 0;
+    do {
+        for (int i = 0; i < 10000; i++)
+            x += (unsigned long)i;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < ms);
+}
+
+// Static figures of this process are sane
+void test_snapshot() {
+    printf("=== Test self snapshot ===\n");
+    SelfSampler *s = create_self_sampler();
+    assert(s != NULL);
+    SelfInfo info;
+    assert(sample_self_info(s, &info) == 0);
+    assert(info.threads == 1);
+    assert(info.rss_kb > 0 && info.hwm_kb >= info.rss_kb);
+    assert(info.min_faults > 0);
+
+    // Touching 16 MB raises RSS and the fault count
+    unsigned long faults = info.min_faults;
+    volatile char *block = malloc(16 << 20);
+    assert(block != NULL);
+    for (size_t off = 0; off < (16 << 20); off += 4096) // volatile: the stores must happen
+        block[off] = 1;
+    assert(sample_self_info(s, &info) == 0);
+    assert(info.rss_kb >= 16 * 1024 && info.min_faults > faults);
+    printf("RSS %lu kB, peak %lu kB, %lu minor faults\n", info.rss_kb, info.hwm_kb, info.min_faults);
+    free((char *)block);
+
+    destroy_self_sampler(s);
+    printf("Test self snapshot passed!\n\n");
+}
+
+// CPU usage follows a busy loop and an idle wait
+void test_cpu_usage() {
+    printf("=== Test self CPU usage ===\n");
+    SelfSampler *s = create_self_sampler();
+    assert(s != NULL);
+    SelfInfo info;
+
+    spin_ms(200);
+    assert(sample_self_info(s, &info) == 0);
+    printf("Busy: %.1f%% (user %lu ms, system %lu ms)\n", info.cpu_usage, info.utime_ms, info.stime_ms);
+    assert(info.cpu_usage > 50.0);
+    assert(info.cpu_us >= 150000);
+    assert(info.utime_ms + info.stime_ms >= 100);
+
+    // Sleeping is a voluntary context switch
+    unsigned long switches = info.ctxt_switches;
+    struct timespec pause = { 0, 200000000L };
+    nanosleep(&pause, NULL);
+    assert(sample_self_info(s, &info) == 0);
+    printf("Idle: %.1f%%\n", info.cpu_usage);
+    assert(info.cpu_usage < 20.0);
+    assert(info.ctxt_switches > switches);
+
+    destroy_self_sampler(s);
+    printf("Test self CPU usage passed!\n\n");
+}
+
+// Opens and reads of ProcFiles show up in the per-sample deltas
+void test_io_counts() {
+    printf("=== Test procfs I/O counters ===\n");
+    SelfSampler *s = create_self_sampler();
+    assert(s != NULL);
+    SelfInfo info;
+    assert(sample_self_info(s, &info) == 0);
+    // The sampler's own two files, each read up to the empty pread() at its end
+    assert(info.io_delta.opens == 0 && info.io_delta.reads == 2 * 2);
+
+    ProcFile pf;
+    assert(open_proc_file(&pf, "/proc/self/stat", 0) == 0);
+    for (int i = 0; i < 3; i++)
+        assert(read_proc_file(&pf) > 0);
+    close_proc_file(&pf);
+
+    assert(sample_self_info(s, &info) == 0);
+    assert(info.io_delta.opens == 1 && info.io_delta.reads == 3 * 2 + 2 * 2);
+    assert(info.io.opens >= 3 && info.io.reads >= info.io_delta.reads);
+    printf("Totals: %lu opens, %lu reads\n", info.io.opens, info.io.reads);
+
+    destroy_self_sampler(s);
+    printf("Test procfs I/O counters passed!\n\n");
+}
+
+int main() {
+    test_snapshot();
+    test_cpu_usage();
+    test_io_counts();
+    return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file snapshot_test.c
+ * @brief Tests for the shared-memory snapshot publisher and reader.
+ */
+
+#include <assert.h>
+#include "../../src/snapshot.h"
+
+#include <errno.h>    // For errno
+#include <fcntl.h>    // For O_RDWR
+#include <sched.h>    // For sched_yield()
+#include <stdio.h>    // For printf
+#include <stdlib.h>   // For exit()
+#include <string.h>   // For memcpy()
+#include <sys/mman.h> // For shm_open() in the version test
+#include <sys/wait.h> // For waitpid()
+#include <time.h>     // For clock_gettime()
+#include <unistd.h>   // For fork(), ftruncate()
+
+#define TEST_CPUS 8
+#define STRESS_CPUS 64
+#define STRESS_READERS 4
+#define STRESS_SECONDS 1.0
+
+static char shm_name[64];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Sample k of a pattern every reader can check: every value derives from k,
+ * so a record mixing two publishes is detected.
+ */
+static void fill_pattern(Sample *s, double *threads, CPUStatsStore *store, int cpus, unsigned long k) {
+    memset(s, 0, sizeof(*s));
+    s->seq = k;
+    s->wallclock.tv_sec = (time_t)k;
+    s->timestamp.tv_nsec = (long)(k % 1000000);
+    s->interval = 0.01;
+    s->jitter_ns = (long)k;
+    s->dropped = k * 3;
+    s->cpu.num_cpus = cpus;
+    s->cpu.usage = (double)(k % 1000);
+    s->cpu.thread_usage = threads;
+    for (int i = 0; i < cpus; i++)
+        threads[i] = (double)(k + (unsigned long)i);
+    s->mem.mem_total = k;
+    s->mem.mem_available = k + 1;
+    s->mem.swap_free = k + 2;
+    for (int f = 0; f < CPU_STAT_FIELDS; f++)
+        for (int i = 0; i < store->count; i++)
+            store->field[f][i] = k * 100 + (unsigned long)(f * store->count + i);
+}
+
+static int alloc_store(CPUStatsStore *store, int slots) {
+    store->count = slots;
+    unsigned long *all = calloc((size_t)CPU_STAT_FIELDS * (size_t)slots, sizeof(unsigned long));
+    for (int f = 0; f < CPU_STAT_FIELDS; f++)
+        store->field[f] = all + (size_t)f * (size_t)slots;
+    return all != NULL ? 0 : -1;
+}
+
+// True if every value of the record derives from its seq
+static int check_pattern(const SnapshotRecord *r) {
+    uint64_t k = r->seq;
+    if (r->time_ns != (int64_t)k * 1000000000LL || r->monotonic_ns != (int64_t)(k % 1000000) ||
+        r->jitter_ns != (int64_t)k || r->dropped != k * 3 || r->cpu_usage != (double)(k % 1000) ||
+        r->mem_total_kb != k || r->mem_available_kb != k + 1 || r->swap_free_kb != k + 2)
+        return 0;
+    const double *threads = snapshot_thread_usage(r);
+    for (uint32_t i = 0; i < r->num_cpus; i++)
+        if (threads[i] != (double)(k + i))
+            return 0;
+    const uint64_t *counters = snapshot_counters(r);
+    for (uint32_t j = 0; j < CPU_STAT_FIELDS * r->cpu_slots; j++)
+        if (counters[j] != k * 100 + j)
+            return 0;
+    return 1;
+}
+
+// Layout, first read, unchanged reads and a closed segment
+void test_publish_read() {
+    printf("=== Test snapshot publish and read ===\n");
+    assert(open_snapshot(shm_name) == NULL && errno == ENOENT);
+    SnapshotWriter *w = create_snapshot_writer(shm_name, TEST_CPUS);
+    assert(w != NULL);
+    SnapshotReader *r = open_snapshot(shm_name);
+    assert(r != NULL);
+    const SnapshotHeader *h = snapshot_header(r);
+    assert(h->version == SNAPSHOT_VERSION && h->num_cpus == TEST_CPUS && h->cpu_slots == TEST_CPUS + 1);
+    assert(h->pid == getpid() && h->record_size % 64 == 0);
+
+    const SnapshotRecord *rec;
+    assert(read_snapshot(r, &rec) == -1 && errno == EAGAIN);
+
+    Sample s;
+    double threads[TEST_CPUS];
+    CPUStatsStore store;
+    assert(alloc_store(&store, TEST_CPUS + 1) == 0);
+    fill_pattern(&s, threads, &store, TEST_CPUS, 5);
+    publish_snapshot(w, &s, &store);
+    assert(read_snapshot(r, &rec) == 1);
+    assert(rec->seq == 5 && rec->num_cpus == TEST_CPUS && check_pattern(rec));
+    assert(rec->interval_ns == 10000000);
+    assert(snapshot_counters(rec)[CPU_IDLE * (TEST_CPUS + 1) + 2] == 500 + CPU_IDLE * (TEST_CPUS + 1) + 2);
+    assert(read_snapshot(r, &rec) == 0 && rec->seq == 5); // Nothing new: no copy
+
+    // Fewer CPUs and no counters: the rest reads as zero
+    fill_pattern(&s, threads, &store, 3, 6);
+    snapshot_sink(w, &s, NULL);
+    assert(read_snapshot(r, &rec) == 1 && rec->seq == 6);
+    assert(snapshot_thread_usage(rec)[2] == 8.0 && snapshot_thread_usage(rec)[3] == 0.0);
+    assert(snapshot_counters(rec)[0] == 0);
+
+    // A second reader sees the same record
+    SnapshotReader *r2 = open_snapshot(shm_name);
+    const SnapshotRecord *rec2;
+    assert(r2 != NULL && read_snapshot(r2, &rec2) == 1 && memcmp(rec, rec2, h->record_size) == 0);
+    close_snapshot(r2);
+
+    destroy_snapshot_writer(w);
+    assert(read_snapshot(r, &rec) == -1 && errno == ESTALE);
+    close_snapshot(r);
+    assert(open_snapshot(shm_name) == NULL && errno == ENOENT);
+    free(store.field[0]);
+    printf("Test snapshot publish and read passed!\n\n");
+}
+
+// A segment of another layout version is refused
+void test_version() {
+    printf("=== Test snapshot version check ===\n");
+    SnapshotWriter *w = create_snapshot_writer(shm_name, TEST_CPUS);
+    assert(w != NULL);
+    int fd = shm_open(shm_name, O_RDWR, 0);
+    assert(fd >= 0);
+    SnapshotHeader h;
+    assert(pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h));
+    h.version = SNAPSHOT_VERSION + 1;
+    assert(pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h));
+    assert(open_snapshot(shm_name) == NULL && errno == EPROTO);
+    assert(ftruncate(fd, sizeof(h)) == 0); // Too short for its records
+    h.version = SNAPSHOT_VERSION;
+    assert(pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h));
+    assert(open_snapshot(shm_name) == NULL && errno == EPROTO);
+    close(fd);
+    destroy_snapshot_writer(w);
+    printf("Test snapshot version check passed!\n\n");
+}
+
+// Reader process: check every record until the publisher closes the segment
+static void run_reader(int id) {
+    SnapshotReader *r = open_snapshot(shm_name);
+    if (r == NULL)
+        exit(2);
+    unsigned long reads = 0, fresh = 0, torn = 0;
+    uint64_t last = 0;
+    const SnapshotRecord *rec;
+    int rc;
+    while ((rc = read_snapshot(r, &rec)) != -1 || errno == EAGAIN) {
+        if (rc < 0)
+            continue;
+        reads++;
+        if (rc == 0) {
+            sched_yield(); // Let the publisher run on small machines
+            continue;
+        }
+        fresh++;
+        if (!check_pattern(rec) || rec->seq < last)
+            torn++;
+        last = rec->seq;
+    }
+    printf("reader %d: %lu reads, %lu new records, %lu retries, %lu torn\n", id, reads, fresh,
+           snapshot_retries(r), torn);
+    close_snapshot(r);
+    exit(errno == ESTALE && torn == 0 && fresh > 0 ? 0 : 1);
+}
+
+// Concurrent reader processes never see a record mixing two publishes
+void test_torn_reads() {
+    printf("=== Test snapshot readers under continuous publishing ===\n");
+    SnapshotWriter *w = create_snapshot_writer(shm_name, STRESS_CPUS);
+    assert(w != NULL);
+    fflush(stdout);
+    pid_t readers[STRESS_READERS];
+    for (int i = 0; i < STRESS_READERS; i++) {
+        readers[i] = fork();
+        assert(readers[i] >= 0);
+        if (readers[i] == 0)
+            run_reader(i);
+    }
+
+    Sample s;
+    double threads[STRESS_CPUS];
+    CPUStatsStore store;
+    assert(alloc_store(&store, STRESS_CPUS + 1) == 0);
+    unsigned long published = 0;
+    double start = now_s(), elapsed;
+    while ((elapsed = now_s() - start) < STRESS_SECONDS) {
+        fill_pattern(&s, threads, &store, STRESS_CPUS, ++published);
+        publish_snapshot(w, &s, &store);
+    }
+    destroy_snapshot_writer(w);
+    printf("%lu publishes in %.2f s (%.2f us each)\n", published, elapsed, elapsed * 1e6 / published);
+
+    for (int i = 0; i < STRESS_READERS; i++) {
+        int status;
+        assert(waitpid(readers[i], &status, 0) == readers[i]);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    free(store.field[0]);
+    printf("Test snapshot readers under continuous publishing passed!\n\n");
+}
+
+int main() {
+    snprintf(shm_name, sizeof(shm_name), "/resource_mon_test.%d", (int)getpid());
+    test_publish_read();
+    test_version();
+    test_torn_reads();
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file thermal_test.c
+ * @brief Tests for thermal zone discovery, throttle counters and throttled-frame detection.
+ */
+
+#include <assert.h>
+#include "../../src/thermal_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For mkdtemp()
+#include <string.h> // For strcmp()
+#include <unistd.h> // For rmdir()
+
+// A CPUInfo with every CPU at the same usage
+static void set_usage(CPUInfo *cpu, double *threads, int n, double usage) {
+    cpu->num_cpus = n;
+    cpu->thread_usage = threads;
+    cpu->usage = usage;
+    for (int i = 0; i < n; i++)
+        threads[i] = usage;
+}
+
+// One zone per cluster, passive trip preferred, one counter per core and per package
+void test_discovery() {
+    printf("=== Test thermal discovery ===\n");
+    const int sizes[] = { 1, 8, 64 };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        int n = sizes[k];
+        ProcFixture fx;
+        assert(create_proc_fixture(&fx, n, 5) == 0);
+        assert(add_proc_fixture_thermal(&fx) == 0);
+        assert(set_proc_root(fx.root) == 0);
+
+        ThermalSampler *s = create_thermal_sampler(n);
+        assert(s != NULL);
+        assert(thermal_counter_count(s) == fx.cores + 1);
+
+        double threads[64];
+        CPUInfo cpu;
+        set_usage(&cpu, threads, n, 50.0);
+        ThermalInfo info;
+        assert(sample_thermal_info(s, &cpu, &info) == 0);
+        assert(info.zone_count == fx.clusters);
+        for (int z = 0; z < info.zone_count; z++) {
+            char type[THERMAL_TYPE_LEN];
+            snprintf(type, sizeof(type), "cluster%d-thermal", z);
+            assert(strcmp(info.zones[z].type, type) == 0 && info.zones[z].index == z);
+            assert(info.zones[z].trip_mc == FIXTURE_TRIP_MC);
+            assert(info.zones[z].temp_mc == fx.temp_mc[z]);
+        }
+        assert(info.hottest == (fx.clusters > 1 && fx.temp_mc[1] > fx.temp_mc[0]));
+        assert(info.flags == 0 && info.throttle_total == 0);
+
+        printf("%2d CPUs: %d zones, %d counters, hottest %s at %.1f C\n", n, info.zone_count,
+               thermal_counter_count(s), info.zones[info.hottest].type, info.zones[info.hottest].temp_mc / 1000.0);
+        destroy_thermal_sampler(s);
+        set_proc_root(NULL);
+        destroy_proc_fixture(&fx);
+    }
+    printf("Test thermal discovery passed!\n\n");
+}
+
+// A tick reads each zone and counter once and opens nothing
+void test_per_tick_io() {
+    printf("=== Test thermal per-tick I/O ===\n");
+    const int n = 16;
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 9) == 0);
+    assert(add_proc_fixture_thermal(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    ThermalSampler *s = create_thermal_sampler(n);
+    assert(s != NULL);
+
+    double threads[16];
+    CPUInfo cpu;
+    set_usage(&cpu, threads, n, 30.0);
+    ThermalInfo info;
+    for (int tick = 0; tick < 5; tick++) {
+        assert(advance_proc_fixture(&fx) == 0);
+        ProcIoCounts before, after;
+        get_proc_io_counts(&before);
+        assert(sample_thermal_info(s, &cpu, &info) == 0);
+        get_proc_io_counts(&after);
+        assert(after.opens == before.opens);
+        assert(after.reads - before.reads == (unsigned long)(fx.clusters + thermal_counter_count(s)));
+        for (int z = 0; z < fx.clusters; z++)
+            assert(info.zones[z].temp_mc == fx.temp_mc[z]);
+    }
+    printf("%d reads per tick\n", fx.clusters + thermal_counter_count(s));
+
+    destroy_thermal_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test thermal per-tick I/O passed!\n\n");
+}
+
+// Throttled needs the trip point and either a counter increase or a usage drop
+void test_throttled_frames() {
+    printf("=== Test throttled frames ===\n");
+    const int n = 8; // 4 cores, 2 per cluster
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 13) == 0);
+    assert(add_proc_fixture_thermal(&fx) == 0);
+    assert(set_proc_root(fx.root) == 0);
+    ThermalSampler *s = create_thermal_sampler(n);
+    assert(s != NULL);
+
+    double threads[8];
+    CPUInfo cpu;
+    ThermalInfo info;
+    set_usage(&cpu, threads, n, 80.0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0 && info.flags == 0);
+
+    // Hot but nothing lost
+    assert(heat_proc_fixture(&fx, 1, FIXTURE_TRIP_MC + 1000, 0) == 0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.flags == THERMAL_AT_TRIP && info.hottest == 1 && info.throttled_frames == 0);
+
+    // Counters go up on a cool machine: an event, not a throttled frame
+    assert(heat_proc_fixture(&fx, 1, 0, 0) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    assert(heat_proc_fixture(&fx, 0, 0, 3) == 0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.flags == THERMAL_THROTTLE_EVENT);
+    assert(info.core_throttles == 2 * 3 && info.package_throttles == 3);
+    assert(info.throttle_total == 3 * 3);
+
+    // At trip with new throttle events
+    assert(heat_proc_fixture(&fx, 0, FIXTURE_TRIP_MC, 2) == 0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.flags == (THERMAL_AT_TRIP | THERMAL_THROTTLE_EVENT | THERMAL_THROTTLED));
+    assert(info.throttled_frames == 1 && info.throttle_total == 3 * 5);
+
+    // At trip and usage falls on two CPUs out of eight, without counters (e.g. ARM)
+    threads[2] = 60.0;
+    threads[5] = 65.0;
+    cpu.usage = 76.0;
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.dropped_threads == 2 && info.usage_drop > 3.9 && info.usage_drop < 4.1);
+    assert(info.flags == (THERMAL_AT_TRIP | THERMAL_USAGE_DROP | THERMAL_THROTTLED));
+    assert(info.throttled_frames == 2);
+
+    // One CPU dropping is load moving around, not throttling
+    threads[3] = 50.0;
+    cpu.usage = 72.0;
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.dropped_threads == 1 && info.flags == THERMAL_AT_TRIP && info.throttled_frames == 2);
+
+    // Usage rising back is not a drop; cooling clears the trip
+    assert(heat_proc_fixture(&fx, 0, 0, 0) == 0);
+    assert(advance_proc_fixture(&fx) == 0);
+    set_usage(&cpu, threads, n, 20.0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.flags == THERMAL_USAGE_DROP);
+    set_usage(&cpu, threads, n, 90.0);
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.flags == 0 && info.usage_drop == 0.0 && info.throttled_frames == 2);
+    printf("%lu throttled frames, %lu throttle events in total\n", info.throttled_frames, info.throttle_total);
+
+    destroy_thermal_sampler(s);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test throttled frames passed!\n\n");
+}
+
+// Without sysfs the sampler is empty; the running system gives sane values
+void test_empty_and_live() {
+    printf("=== Test empty and live thermal ===\n");
+    char empty[] = "/tmp/thermal_emptyXXXXXX";
+    assert(mkdtemp(empty) != NULL);
+    assert(set_proc_root(empty) == 0);
+    ThermalSampler *s = create_thermal_sampler(4);
+    assert(s != NULL && thermal_counter_count(s) == 0);
+    double threads[4];
+    CPUInfo cpu;
+    set_usage(&cpu, threads, 4, 10.0);
+    ThermalInfo info;
+    assert(sample_thermal_info(s, &cpu, &info) == 0);
+    assert(info.zone_count == 0 && info.hottest == -1 && info.flags == 0);
+    destroy_thermal_sampler(s);
+    set_proc_root(NULL);
+    rmdir(empty);
+
+    int slots = count_cpu_slots();
+    s = create_thermal_sampler(slots);
+    assert(s != NULL);
+    double live[1024];
+    set_usage(&cpu, live, slots < 1024 ? slots : 1024, 10.0);
+    sample_thermal_info(s, &cpu, &info); // A sensor may fail to read; the rest is still filled
+    printf("This machine: %d zones, %d throttle counters", info.zone_count, thermal_counter_count(s));
+    if (info.zone_count > 0)
+        printf(", %s at %.1f C", info.zones[info.hottest].type, info.zones[info.hottest].temp_mc / 1000.0);
+    printf("\n");
+    destroy_thermal_sampler(s);
+    printf("Test empty and live thermal passed!\n\n");
+}
+
+int main() {
+    test_discovery();
+    test_per_tick_io();
+    test_throttled_frames();
+    test_empty_and_live();
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file topology_test.c
+ * @brief Tests for sysfs topology discovery, frequency reads and hotplug checks.
+ */
+
+#include <assert.h>
+#include "../../src/topology_manip.h"
+#include "../../src/cpuinfo_manip.h"
+#include "proc_fixture.h"
+
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For mkdtemp()
+#include <string.h> // For strcpy()
+#include <unistd.h> // For rmdir()
+
+// Packages, cores, clusters and the sort order match the fixture's layout
+void test_layout() {
+    printf("=== Test topology layout ===\n");
+    const int sizes[] = { 1, 2, 8, 64 };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        int n = sizes[k];
+        ProcFixture fx;
+        assert(create_proc_fixture(&fx, n, 7) == 0);
+        assert(set_proc_root(fx.root) == 0);
+
+        CPUTopology *topo = discover_cpu_topology(n);
+        assert(topo != NULL && topo->from_sysfs);
+        assert(topo->online == n && topo->packages == 1);
+        assert(topo->cores == fx.cores && topo->clusters == fx.clusters && topo->nodes == fx.clusters);
+        assert(topo->smt == (n > 1 ? 2 : 1));
+
+        // Sorted by cluster then core; the dense indices follow the order
+        for (int i = 0; i < n; i++) {
+            const CPUTopoEntry *e = &topo->cpu[topo->order[i]];
+            assert(e->online && e->cluster == proc_fixture_cluster(&fx, topo->order[i]));
+            assert(e->node == e->cluster && e->cluster_index == e->cluster);
+            if (i > 0) {
+                const CPUTopoEntry *prev = &topo->cpu[topo->order[i - 1]];
+                assert(e->cluster_index >= prev->cluster_index);
+                assert(e->core_index == prev->core_index || e->core_index == prev->core_index + 1);
+            }
+        }
+        assert(topo->cpu[topo->order[n - 1]].core_index == fx.cores - 1);
+
+        // get_cpu_info() takes its totals from the same files
+        CPUInfo cpu;
+        get_cpu_info(&cpu);
+        assert(cpu.cores == fx.cores && cpu.threads == n && cpu.packages == 1);
+        free_cpu_info(&cpu);
+
+        printf("%3d CPUs: %d cores, %d clusters, %d nodes, SMT %d\n",
+               n, topo->cores, topo->clusters, topo->nodes, topo->smt);
+        destroy_cpu_topology(topo);
+        set_proc_root(NULL);
+        destroy_proc_fixture(&fx);
+    }
+    printf("Test topology layout passed!\n\n");
+}
+
+// One read per cpufreq policy per tick, and the values follow the fixture
+void test_frequencies() {
+    printf("=== Test CPU frequencies ===\n");
+    const int n = 16;
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 11) == 0);
+    assert(set_proc_root(fx.root) == 0);
+
+    CPUTopology *topo = discover_cpu_topology(n);
+    assert(topo != NULL);
+    // The CPUs of a cluster share one file
+    assert(open_cpu_freq(topo) == fx.clusters);
+
+    unsigned int khz[16];
+    for (int tick = 0; tick < 5; tick++) {
+        ProcIoCounts before, after;
+        get_proc_io_counts(&before);
+        assert(read_cpu_freq(topo, khz) == 0);
+        get_proc_io_counts(&after);
+        assert(after.opens == before.opens && after.reads - before.reads == (unsigned long)fx.clusters);
+        for (int i = 0; i < n; i++)
+            assert(khz[i] == fx.freq_khz[proc_fixture_cluster(&fx, i)]);
+        assert(advance_proc_fixture(&fx) == 0);
+    }
+    printf("Clusters at %u and %u kHz\n", khz[0], khz[n - 1]);
+
+    destroy_cpu_topology(topo);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test CPU frequencies passed!\n\n");
+}
+
+// A changed online mask is seen with one pass (two preads) over the mask and rediscovery drops the CPU
+void test_hotplug() {
+    printf("=== Test CPU hotplug ===\n");
+    const int n = 8; // 4 cores: CPU i and i + 4 are siblings
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 3) == 0);
+    assert(set_proc_root(fx.root) == 0);
+
+    CPUTopology *topo = discover_cpu_topology(n);
+    assert(topo != NULL && strcmp(topo->mask, "0-7") == 0);
+    ProcFile online;
+    assert(open_cpu_online(&online) == 0);
+
+    ProcIoCounts before, after;
+    get_proc_io_counts(&before);
+    assert(topology_is_current(topo, &online) == 1);
+    get_proc_io_counts(&after);
+    assert(after.opens == before.opens && after.reads == before.reads + 2);
+
+    // One sibling offline: same cores, fewer threads
+    assert(set_proc_fixture_online(&fx, 3, 0) == 0);
+    assert(topology_is_current(topo, &online) == 0);
+    destroy_cpu_topology(topo);
+    topo = discover_cpu_topology(n);
+    assert(topo != NULL && strcmp(topo->mask, "0-2,4-7") == 0);
+    assert(topo->online == 7 && !topo->cpu[3].online && topo->cores == 4 && topo->smt == 2);
+    assert(topology_is_current(topo, &online) == 1);
+
+    // Both siblings offline: the core is gone
+    assert(set_proc_fixture_online(&fx, 7, 0) == 0);
+    assert(topology_is_current(topo, &online) == 0);
+    destroy_cpu_topology(topo);
+    topo = discover_cpu_topology(n);
+    assert(topo != NULL && topo->online == 6 && topo->cores == 3);
+    for (int i = 0; i < topo->online; i++)
+        assert(topo->order[i] != 3 && topo->order[i] != 7);
+
+    // Offline CPUs read as 0 kHz
+    unsigned int khz[8];
+    assert(open_cpu_freq(topo) == fx.clusters);
+    assert(read_cpu_freq(topo, khz) == 0);
+    assert(khz[3] == 0 && khz[7] == 0 && khz[6] == fx.freq_khz[1]);
+
+    assert(set_proc_fixture_online(&fx, 3, 1) == 0 && set_proc_fixture_online(&fx, 7, 1) == 0);
+    assert(topology_is_current(topo, &online) == 0);
+
+    close_proc_file(&online);
+    destroy_cpu_topology(topo);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test CPU hotplug passed!\n\n");
+}
+
+// On arm64 core_id restarts at 0 in each cluster: two single-core clusters
+// are two cores, not one core with four threads
+void test_cluster_core_ids() {
+    printf("=== Test core ids per cluster ===\n");
+    const int n = 4; // Core 0 (CPUs 0, 2) in cluster 0, core 1 (CPUs 1, 3) in cluster 1
+    ProcFixture fx;
+    assert(create_proc_fixture(&fx, n, 5) == 0 && fx.clusters == 2 && fx.cores == 2);
+    for (int cpu = 0; cpu < n; cpu++) {
+        char path[PROC_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d/topology/core_id", fx.root, cpu);
+        FILE *f = fopen(path, "w");
+        assert(f != NULL);
+        fputs("0\n", f);
+        fclose(f);
+    }
+    assert(set_proc_root(fx.root) == 0);
+
+    CPUTopology *topo = discover_cpu_topology(n);
+    assert(topo != NULL && topo->from_sysfs);
+    assert(topo->clusters == 2 && topo->cores == 2 && topo->smt == 2);
+    assert(topo->cpu[0].core_index == topo->cpu[2].core_index);
+    assert(topo->cpu[1].core_index == topo->cpu[3].core_index);
+    assert(topo->cpu[0].core_index != topo->cpu[1].core_index);
+
+    destroy_cpu_topology(topo);
+    set_proc_root(NULL);
+    destroy_proc_fixture(&fx);
+    printf("Test core ids per cluster passed!\n\n");
+}
+
+// Without sysfs every CPU is its own core; the running system gives sane counts
+void test_fallback_and_live() {
+    printf("=== Test fallback and live topology ===\n");
+    char empty[] = "/tmp/topology_emptyXXXXXX";
+    assert(mkdtemp(empty) != NULL);
+    assert(set_proc_root(empty) == 0);
+    CPUTopology *topo = discover_cpu_topology(4);
+    assert(topo != NULL && !topo->from_sysfs);
+    assert(topo->online == 4 && topo->cores == 4 && topo->packages == 1 && topo->smt == 1);
+    assert(open_cpu_freq(topo) == 0);
+    destroy_cpu_topology(topo);
+    set_proc_root(NULL);
+    rmdir(empty);
+
+    int slots = count_cpu_slots();
+    topo = discover_cpu_topology(slots);
+    assert(topo != NULL);
+    assert(topo->online >= 1 && topo->cores >= 1 && topo->cores <= topo->online);
+    assert(topo->packages >= 1 && topo->packages <= topo->cores);
+    printf("This machine: %d CPUs, %d cores, %d packages, %d clusters, %d nodes, %d cpufreq policies (%s)\n",
+           topo->online, topo->cores, topo->packages, topo->clusters, topo->nodes, open_cpu_freq(topo),
+           topo->from_sysfs ? "sysfs" : "fallback");
+    destroy_cpu_topology(topo);
+    printf("Test fallback and live topology passed!\n\n");
+}
+
+int main() {
+    test_layout();
+    test_frequencies();
+    test_hotplug();
+    test_cluster_core_ids();
+    test_fallback_and_live();
+    return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file tui_bytes_bench.c
+ * @brief Bytes sent to the terminal per frame: full redraw vs retained fields.
+ *
+ * A child process renders a dashboard-like screen on a pseudo-terminal,
+ * either the old way (ui_clear() + tui_draw_text() + ui_refresh()) or with
+ * retained fields (ui_begin_frame() + tui_draw_field() + ui_end_frame()).
+ * After each frame the child signals the parent on a pipe and waits; the
+ * parent drains the pty master, counts what the terminal would have received
+ * and lets the child continue.
+ */
+
+#include "../../src/tui.h"
+
+#include <fcntl.h>   // For O_NONBLOCK
+#include <poll.h>    // For poll()
+#include <pty.h>     // For forkpty()
+#include <stdio.h>   // For printf
+#include <string.h>  // For strcmp()
+#include <sys/wait.h> // For waitpid()
+#include <time.h>    // For clock_gettime()
+
+#define BENCH_ROWS 50
+#define BENCH_COLS 132
+#define BENCH_FRAMES 200
+#define BENCH_THREADS 32
+#define BENCH_PROCS 20
+
+// Draw one synthetic frame: static labels, per-thread percentages that all
+// change, a few memory values that sometimes change and a status line
+static void draw_bench_frame(int frame, int retained) {
+    void (*draw)(tui_coord_t, const char *) = retained ? tui_draw_field : tui_draw_text;
+    char line[128];
+
+    if (retained)
+        ui_begin_frame();
+    else
+        ui_clear();
+
+    draw((tui_coord_t){ 2, 6 }, "--- CPU Information ---");
+    draw((tui_coord_t){ 4, 6 }, "Model: Synthetic CPU @ 2.00GHz");
+    draw((tui_coord_t){ 5, 6 }, "Cores: 16");
+    snprintf(line, sizeof(line), "Usage: %.2f%%", (frame * 37 % 10000) / 100.0);
+    draw((tui_coord_t){ 6, 6 }, line);
+    for (int i = 0; i < BENCH_THREADS && 9 + i < BENCH_ROWS - 1; i++) {
+        snprintf(line, sizeof(line), "Thread %2d: %6.2f%%", i, ((frame + 1) * (i + 3) * 71 % 10000) / 100.0);
+        draw((tui_coord_t){ 9 + i, 6 }, line);
+    }
+
+    draw((tui_coord_t){ 2, 66 }, "--- Memory Information ---");
+    for (int i = 0; i < 8; i++) {
+        snprintf(line, sizeof(line), "Memory line %d: %d MB", i, 1000 + (i < 2 ? frame / 4 : 0));
+        draw((tui_coord_t){ 4 + i, 66 }, line);
+    }
+    draw((tui_coord_t){ 14, 66 }, "    PID COMMAND          S   CPU%     RSS MB");
+    for (int i = 0; i < BENCH_PROCS; i++) {
+        snprintf(line, sizeof(line), "%7d %-16s %c %6.1f %10.1f", 1000 + i, "process",
+                 'S', (frame * (i + 1) % 50) / 10.0, 100.0 + i);
+        draw((tui_coord_t){ 15 + i, 66 }, line);
+    }
+
+    snprintf(line, sizeof(line), "sample #%d  interval 1.000 s", frame + 1);
+    draw((tui_coord_t){ BENCH_ROWS - 1, 0 }, line);
+
+    if (retained)
+        ui_end_frame();
+    else
+        ui_refresh();
+}
+
+// Child side: render every frame in lockstep with the parent, then report render time
+static void run_renderer(int sync_fd, int ack_fd, int retained) {
+    ui_init();
+    long render_ns = 0;
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        draw_bench_frame(frame, retained);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        render_ns += (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+
+        char done = 1;
+        if (write(sync_fd, &done, 1) != 1 || read(ack_fd, &done, 1) != 1)
+            break;
+    }
+    ui_cleanup();
+    if (write(sync_fd, &render_ns, sizeof(render_ns)) != sizeof(render_ns))
+        _exit(1);
+    _exit(0);
+}
+
+// Read everything currently available on the pty master
+static long drain_master(int master) {
+    char buf[65536];
+    long total = 0;
+    struct pollfd pfd = { .fd = master, .events = POLLIN };
+    while (poll(&pfd, 1, 1) > 0) {
+        ssize_t n = read(master, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+// Run one mode and print bytes and render time per frame
+static void bench_mode(int retained) {
+    int sync[2], ack[2];
+    if (pipe(sync) < 0 || pipe(ack) < 0) {
+        perror("pipe");
+        return;
+    }
+    struct winsize ws = { .ws_row = BENCH_ROWS, .ws_col = BENCH_COLS };
+    int master;
+    pid_t pid = forkpty(&master, NULL, NULL, &ws);
+    if (pid < 0) {
+        perror("forkpty");
+        return;
+    }
+    if (pid == 0) {
+        close(sync[0]);
+        close(ack[1]);
+        setenv("TERM", "xterm", 1);
+        run_renderer(sync[1], ack[0], retained);
+    }
+    close(sync[1]);
+    close(ack[0]);
+
+    long first_bytes = 0, steady_bytes = 0;
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        char done;
+        if (read(sync[0], &done, 1) != 1)
+            break;
+        long bytes = drain_master(master);
+        if (frame == 0)
+            first_bytes = bytes; // Includes terminal setup
+        else
+            steady_bytes += bytes;
+        if (write(ack[1], &done, 1) != 1)
+            break;
+    }
+    long render_ns = 0;
+    if (read(sync[0], &render_ns, sizeof(render_ns)) != sizeof(render_ns))
+        render_ns = 0;
+    drain_master(master);
+    waitpid(pid, NULL, 0);
+    close(sync[0]);
+    close(ack[1]);
+    close(master);
+
+    printf("%-9s  first frame %6ld B  steady %8.1f B/frame  render %7.1f us/frame\n",
+           retained ? "retained" : "full", first_bytes,
+           (double)steady_bytes / (BENCH_FRAMES - 1), render_ns / 1e3 / BENCH_FRAMES);
+}
+
+int main(int argc, char *argv[]) {
+    printf("%d frames on a %dx%d terminal (TERM=xterm)\n", BENCH_FRAMES, BENCH_COLS, BENCH_ROWS);
+    if (argc < 2 || strcmp(argv[1], "retained") != 0)
+        bench_mode(0);
+    if (argc < 2 || strcmp(argv[1], "full") != 0)
+        bench_mode(1);
+    return 0;
+}
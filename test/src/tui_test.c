@@ -4,10 +4,13 @@
  * @brief Here an explanation
  */
 
+#define NCURSES_WIDECHAR 1 // For mvinnwstr()
+
 #include <assert.h>
 #include "../../src/tui.h"
 
 #include <stdio.h>    // For printing test status
+#include <string.h>   // For strcmp()
 #include <unistd.h>   // For sleep() in the drawing test
 
 /**
@@ -101,6 +104,183 @@ void test_clamp_coord() {
     printf("tui_clamp_coord tests passed.\n\n");
 }
 
+/**
+ * @brief Reads back row from column col of the virtual screen (trailing blanks kept).
+ */
+static void read_screen(int row, int col, char *buf, int len) {
+    mvinnstr(row, col, buf, len);
+}
+
+/**
+ * @brief Tests the retained field model.
+ * Unchanged fields must not be rewritten, shrinking text must not leave
+ * stale characters and fields that are not drawn again must be erased.
+ */
+void test_retained_fields() {
+    printf("Testing retained fields...\n");
+    ui_init();
+
+    tui_frame_stats_t stats;
+    tui_coord_t a = {1, 1}, b = {2, 1}, c = {3, 1};
+    char buf[16];
+
+    ui_begin_frame();
+    tui_draw_field(a, "alpha");
+    tui_draw_field(b, "beta 100%");
+    tui_draw_field(c, "gamma");
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.fields == 3 && stats.redrawn == 3);
+    printf("  [PASS] First frame draws every field\n");
+
+    ui_begin_frame();
+    tui_draw_field(a, "alpha");
+    tui_draw_field(b, "beta 9%");
+    tui_draw_field(c, "gamma");
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.fields == 3 && stats.redrawn == 1);
+    read_screen(2, 1, buf, 9);
+    assert(strcmp(buf, "beta 9%  ") == 0);
+    printf("  [PASS] Only the changed field is redrawn, old tail blanked\n");
+
+    ui_begin_frame();
+    tui_draw_field(a, "alpha");
+    tui_draw_field(b, "beta 9%");
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.fields == 2 && stats.redrawn == 0 && stats.cells == 5);
+    read_screen(3, 1, buf, 5);
+    assert(strcmp(buf, "     ") == 0);
+    printf("  [PASS] Vanished field erased\n");
+
+    ui_begin_frame();
+    tui_draw_field_attr(a, "alpha", A_REVERSE);
+    tui_draw_field(b, "beta 9%");
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.redrawn == 1 && (mvinch(1, 1) & A_REVERSE) && !(mvinch(2, 1) & A_REVERSE));
+    printf("  [PASS] Changed attributes redraw the field\n");
+
+    // Cached dimensions must match ncurses
+    int rows, cols;
+    ui_get_dims(&rows, &cols);
+    assert(rows == LINES && cols == COLS);
+    printf("  [PASS] Cached dimensions\n");
+
+    ui_cleanup();
+    printf("Retained field tests passed.\n\n");
+}
+
+/**
+ * @brief Reads back cols cells of a graph row as wide characters.
+ */
+static void read_graph_row(int row, int col, wchar_t *buf, int cols) {
+    mvinnwstr(row, col, buf, cols);
+}
+
+/**
+ * @brief Tests the retained graphs.
+ * A graph is written only when it scrolled, moved or was blanked, pushes
+ * shift the row left, and a graph that is not drawn again is erased.
+ */
+void test_graphs() {
+    printf("Testing retained graphs...\n");
+    ui_init();
+
+    tui_frame_stats_t stats;
+    int levels;
+    const wchar_t *glyphs = tui_graph_glyphs(TUI_SPARKLINE, &levels);
+    assert(levels >= 5 && glyphs[0] == L' ');
+    assert(tui_create_graph(TUI_SPARKLINE, 0, 8) == NULL);
+    tui_graph_t *g = tui_create_graph(TUI_SPARKLINE, 2, 4);
+    assert(g != NULL && tui_graph_rows(g) == 2 && tui_graph_width(g) == 4);
+    tui_coord_t at = {5, 2};
+    wchar_t buf[8];
+
+    float col[2] = { 1.0f, 0.0f };
+    tui_push_graph(g, col);
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){4, 2}, "label");
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 1 && stats.cells == 5 + 8);
+    read_graph_row(5, 2, buf, 4);
+    assert(buf[0] == L' ' && buf[3] == glyphs[levels - 1]);
+    printf("  [PASS] First frame writes the graph, newest column on the right\n");
+
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){4, 2}, "label");
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 0 && stats.cells == 0);
+    printf("  [PASS] Unchanged graph is not written\n");
+
+    col[0] = 0.0f;
+    col[1] = 2.0f; // Clamped to the top level
+    tui_push_graph(g, col);
+    tui_push_graph(g, col);
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){4, 2}, "label");
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 1 && stats.redrawn == 0);
+    read_graph_row(5, 2, buf, 4);
+    assert(buf[1] == glyphs[levels - 1] && buf[2] == L' ' && buf[3] == L' ');
+    read_graph_row(6, 2, buf, 4);
+    assert(buf[1] == L' ' && buf[2] == glyphs[levels - 1] && buf[3] == glyphs[levels - 1]);
+    printf("  [PASS] Pushes scroll every row left\n");
+
+    // A field that shrinks next to the graph blanks only its own cells
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){5, 0}, "xx");
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){5, 0}, "x");
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 0 && stats.cells == 2 + 1); // "xx" ends before the graph
+    printf("  [PASS] Fields beside the graph leave it alone\n");
+
+    // Moving one column right blanks the old area, then writes the new one
+    at.col = 3;
+    ui_begin_frame();
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 1 && stats.cells == 8 + 8 + 1); // And the "x" that vanished
+    read_graph_row(6, 2, buf, 5);
+    assert(buf[0] == L' ' && buf[3] == glyphs[levels - 1] && buf[4] == glyphs[levels - 1]);
+    printf("  [PASS] Moved graph rewritten at its new place\n");
+
+    ui_begin_frame();
+    tui_draw_field((tui_coord_t){4, 2}, "label");
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 0 && stats.cells == 5 + 8);
+    read_graph_row(6, 3, buf, 4);
+    assert(buf[2] == L' ' && buf[3] == L' ');
+    printf("  [PASS] Vanished graph erased\n");
+
+    ui_begin_frame();
+    tui_draw_graph(at, g);
+    ui_end_frame();
+    tui_destroy_graph(g);
+    ui_begin_frame();
+    ui_end_frame();
+    ui_get_frame_stats(&stats);
+    assert(stats.graphs == 0 && stats.cells == 8);
+    printf("  [PASS] Destroyed graph erased\n");
+
+    ui_cleanup();
+    printf("Retained graph tests passed.\n\n");
+}
+
 /**
  * @brief Tests the drawing functions (visual check only).
  * This function draws text at various positions. Since we cannot use
@@ -145,6 +325,8 @@ int main() {
     // Run tests for coordinate functions
     test_relative_coord();
     test_clamp_coord();
+    test_retained_fields();
+    test_graphs();
 
     // Run the visual drawing test
     test_drawing();
@@ -0,0 +1,280 @@
+/**
+ * @file winstats_test.c
+ * @brief Tests for the rolling window statistics against a brute-force
+ * computation over every sample kept.
+ */
+
+#include <assert.h>
+#include "../../src/winstats.h"
+
+#include <math.h>   // For ceil(), fabs()
+#include <stdio.h>  // For printf
+#include <stdlib.h> // For qsort(), rand()
+#include <string.h> // For memset()
+#include <time.h>   // For clock_gettime()
+
+#define MAX_SAMPLES 40000
+#define BASE_NS 1000000000000LL // Monotonic times start here
+
+// Every sample pushed to series 0, in bins
+static long long kept_ns[MAX_SAMPLES];
+static int kept_bin[MAX_SAMPLES];
+static int kept;
+
+static int to_bin(float v) {
+    return !(v > 0.0f) ? 0 : v >= 100.0f ? 200 : (int)(v * 2.0f + 0.5f);
+}
+
+static void push(WindowStats *ws, long long t_ns, float v) {
+    float values[2] = { v, 100.0f - v };
+    push_window_stats(ws, t_ns, values);
+    assert(kept < MAX_SAMPLES);
+    kept_ns[kept] = t_ns;
+    kept_bin[kept++] = to_bin(v);
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// The window's figures from every sample since the reset at first
+static void brute_force(int first, int window, WindowSummary *out) {
+    static int means[WINSTATS_SLOTS];
+    memset(out, 0, sizeof(*out));
+    long long newest = kept_ns[kept - 1] / WINSTATS_SLOT_NS;
+    long long oldest = newest - window_seconds(window) + 1;
+    int min = 200, max = 0, n = 0;
+    long sum = 0;
+    for (int i = first; i < kept;) {
+        long long slot = kept_ns[i] / WINSTATS_SLOT_NS;
+        int slot_sum = 0, count = 0;
+        for (; i < kept && kept_ns[i] / WINSTATS_SLOT_NS == slot; i++) {
+            if (slot < oldest)
+                continue;
+            slot_sum += kept_bin[i];
+            count++;
+            min = kept_bin[i] < min ? kept_bin[i] : min;
+            max = kept_bin[i] > max ? kept_bin[i] : max;
+        }
+        if (count == 0)
+            continue;
+        means[n++] = (2 * slot_sum + count) / (2 * count);
+        sum += slot_sum;
+        out->samples += (unsigned long)count;
+    }
+    if (n == 0)
+        return;
+    qsort(means, (size_t)n, sizeof(int), compare_int);
+    out->seconds = n;
+    out->min = min / 2.0;
+    out->max = max / 2.0;
+    out->mean = sum / 2.0 / (double)out->samples;
+    out->p95 = means[(int)ceil(0.95 * n - 1e-9) - 1] / 2.0;
+    out->p99 = means[(int)ceil(0.99 * n - 1e-9) - 1] / 2.0;
+}
+
+static void check_windows(const WindowStats *ws, int first) {
+    for (int w = 0; w < WINSTATS_WINDOWS; w++) {
+        WindowSummary got, want;
+        get_window_summary(ws, 0, w, &got);
+        brute_force(first, w, &want);
+        assert(got.samples == want.samples && got.seconds == want.seconds);
+        assert(got.min == want.min && got.max == want.max);
+        assert(fabs(got.mean - want.mean) < 1e-9);
+        assert(got.p95 == want.p95 && got.p99 == want.p99);
+        // The second series mirrors the first
+        WindowSummary mirror;
+        get_window_summary(ws, 1, w, &mirror);
+        assert(mirror.max == 100.0 - got.min && mirror.min == 100.0 - got.max);
+    }
+}
+
+// Empty statistics, names, sizes and clamping
+void test_create() {
+    printf("=== Test window stats create ===\n");
+    assert(create_window_stats(0) == NULL);
+    WindowStats *ws = create_window_stats(2);
+    assert(ws != NULL && window_stats_series(ws) == 2);
+    WindowSummary s;
+    get_window_summary(ws, 0, 0, &s);
+    assert(s.samples == 0 && s.max == 0.0 && window_percentile(ws, 0, 2, 0.5) == 0.0);
+    assert(strcmp(window_name(0), "1m") == 0 && strcmp(window_name(2), "15m") == 0);
+    assert(window_seconds(0) == 60 && window_seconds(1) == 300 && window_seconds(2) == 900);
+
+    float values[2] = { -5.0f, 250.0f };
+    push_window_stats(ws, BASE_NS, values);
+    get_window_summary(ws, 0, 0, &s);
+    assert(s.samples == 1 && s.seconds == 1 && s.min == 0.0 && s.max == 0.0);
+    get_window_summary(ws, 1, 2, &s);
+    assert(s.min == 100.0 && s.p99 == 100.0 && s.mean == 100.0);
+    destroy_window_stats(ws);
+
+    size_t size = window_stats_size(WINSTATS_SERIES(1024));
+    printf("  %d series: %zu bytes (%zu per series)\n", WINSTATS_SERIES(1024), size,
+           size / WINSTATS_SERIES(1024));
+    assert(size < 9u * 1024 * 1024);
+    printf("Test window stats create passed!\n\n");
+}
+
+// One sample a second for 40 minutes, checked against every sample kept
+void test_one_hertz() {
+    printf("=== Test window stats at 1 Hz ===\n");
+    WindowStats *ws = create_window_stats(2);
+    kept = 0;
+    srand(7);
+    for (int k = 0; k < 2400; k++) {
+        // A slow wave, noise and a burst now and then
+        float v = 40.0f + 30.0f * (float)sin(k / 90.0) + (float)(rand() % 200) / 20.0f;
+        if (rand() % 97 == 0)
+            v = 99.0f;
+        push(ws, BASE_NS + k * WINSTATS_SLOT_NS + 123456789LL, v);
+        if (k % 7 == 0 || k % 900 == 899)
+            check_windows(ws, 0);
+    }
+    WindowSummary s;
+    get_window_summary(ws, 0, 1, &s);
+    printf("  5m: %lu samples, min %.1f mean %.2f p95 %.1f p99 %.1f max %.1f\n", s.samples, s.min, s.mean,
+           s.p95, s.p99, s.max);
+    assert(s.samples == 300 && s.seconds == 300);
+    destroy_window_stats(ws);
+    printf("Test window stats at 1 Hz passed!\n\n");
+}
+
+// Ten samples a second: extremes and mean of every sample, percentiles of one-second means
+void test_sub_second() {
+    printf("=== Test window stats at 10 Hz ===\n");
+    WindowStats *ws = create_window_stats(2);
+    kept = 0;
+    srand(11);
+    for (int k = 0; k < 12000; k++) {
+        float v = (float)(rand() % 1000) / 10.0f;
+        push(ws, BASE_NS + k * (WINSTATS_SLOT_NS / 10), v);
+        if (k % 97 == 0)
+            check_windows(ws, 0);
+    }
+    check_windows(ws, 0);
+    WindowSummary s;
+    get_window_summary(ws, 0, 0, &s);
+    printf("  1m: %lu samples in %d s, min %.1f p95 %.1f max %.1f\n", s.samples, s.seconds, s.min, s.p95, s.max);
+    assert(s.samples == 600 && s.seconds == 60);
+    assert(s.p99 < s.max); // One-second means spread less than samples
+    destroy_window_stats(ws);
+    printf("Test window stats at 10 Hz passed!\n\n");
+}
+
+// Irregular intervals, gaps and a gap longer than every window
+void test_gaps() {
+    printf("=== Test window stats with gaps ===\n");
+    WindowStats *ws = create_window_stats(2);
+    kept = 0;
+    srand(13);
+    long long t = BASE_NS;
+    for (int k = 0; k < 3000; k++) {
+        t += (rand() % 4 == 0 ? 45 : 1) * WINSTATS_SLOT_NS / (1 + rand() % 3);
+        push(ws, t, (float)(rand() % 201) / 2.0f);
+        if (k % 5 == 0)
+            check_windows(ws, 0);
+    }
+    // Nothing left of the earlier samples after 15 minutes without one
+    t += (long long)WINSTATS_SLOTS * WINSTATS_SLOT_NS;
+    int first = kept;
+    push(ws, t, 42.0f);
+    check_windows(ws, first);
+    WindowSummary s;
+    get_window_summary(ws, 0, 2, &s);
+    assert(s.samples == 1 && s.min == 42.0 && s.max == 42.0 && s.p95 == 42.0);
+    // Just under 15 minutes: the 15m window still holds the first sample
+    push(ws, t + (WINSTATS_SLOTS - 1) * WINSTATS_SLOT_NS, 1.0f);
+    check_windows(ws, first);
+    get_window_summary(ws, 0, 2, &s);
+    assert(s.samples == 2 && s.max == 42.0);
+    get_window_summary(ws, 0, 0, &s);
+    assert(s.samples == 1 && s.max == 1.0);
+    destroy_window_stats(ws);
+    printf("Test window stats with gaps passed!\n\n");
+}
+
+// CLOCK_MONOTONIC starts at boot: during the first 15 minutes no slot has
+// aged out of the longer windows, and none may be looked up before slot 0
+void test_after_boot() {
+    printf("=== Test window stats after boot ===\n");
+    WindowStats *ws = create_window_stats(2);
+    kept = 0;
+    srand(17);
+    for (int k = 0; k < 1000; k++) {
+        push(ws, WINSTATS_SLOT_NS + k * WINSTATS_SLOT_NS, (float)(rand() % 201) / 2.0f);
+        if (k % 11 == 0)
+            check_windows(ws, 0);
+    }
+    check_windows(ws, 0);
+    WindowSummary s;
+    get_window_summary(ws, 0, 2, &s);
+    assert(s.samples == WINSTATS_SLOTS);
+    destroy_window_stats(ws);
+    printf("Test window stats after boot passed!\n\n");
+}
+
+// Samples from the collector: the CPU total, then every thread
+void test_record_sample() {
+    printf("=== Test window stats from samples ===\n");
+    WindowStats *ws = create_window_stats(WINSTATS_SERIES(4));
+    double threads[4];
+    Sample s;
+    memset(&s, 0, sizeof(s));
+    s.cpu.num_cpus = 3; // One CPU went offline: its series reads 0
+    s.cpu.thread_usage = threads;
+    for (int k = 0; k < 120; k++) {
+        s.timestamp.tv_sec = 5000 + k;
+        s.cpu.usage = k % 2 ? 60.0 : 20.0;
+        for (int i = 0; i < 3; i++)
+            threads[i] = 10.0 * i + (k >= 100 ? 50.0 : 0.0);
+        window_stats_sink(ws, &s, NULL);
+    }
+    WindowSummary sum;
+    get_window_summary(ws, WINSTATS_CPU, 0, &sum);
+    assert(sum.min == 20.0 && sum.max == 60.0 && sum.mean == 40.0 && sum.p95 == 60.0);
+    get_window_summary(ws, WINSTATS_THREADS + 2, 0, &sum);
+    assert(sum.min == 20.0 && sum.max == 70.0 && sum.p95 == 70.0);
+    assert(window_percentile(ws, WINSTATS_THREADS + 2, 0, 0.5) == 20.0);
+    get_window_summary(ws, WINSTATS_THREADS + 3, 2, &sum);
+    assert(sum.samples == 120 && sum.max == 0.0);
+    destroy_window_stats(ws);
+    printf("Test window stats from samples passed!\n\n");
+}
+
+// Cost of one sample of 1024 CPUs
+void test_update_cost() {
+    printf("=== Test window stats update cost ===\n");
+    int series = WINSTATS_SERIES(1024);
+    WindowStats *ws = create_window_stats(series);
+    float *values = calloc((size_t)series, sizeof(float));
+    assert(ws != NULL && values != NULL);
+    struct timespec t0, t1;
+    int n = 2000;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int k = 0; k < n; k++) {
+        for (int s = 0; s < series; s++)
+            values[s] = (float)((k * 7 + s * 13) % 1000) / 10.0f;
+        push_window_stats(ws, BASE_NS + k * WINSTATS_SLOT_NS, values);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double us = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / n;
+    printf("  %d series: %.1f us per sample (%.1f ns per series)\n", series, us, us * 1e3 / series);
+    WindowSummary s;
+    get_window_summary(ws, 1024, 2, &s);
+    assert(s.samples == 900 && s.seconds == 900);
+    free(values);
+    destroy_window_stats(ws);
+    printf("Test window stats update cost passed!\n\n");
+}
+
+int main() {
+    test_create();
+    test_one_hertz();
+    test_sub_second();
+    test_gaps();
+    test_after_boot();
+    test_record_sample();
+    test_update_cost();
+    return 0;
+}